@@ -16,6 +16,7 @@ IndexBundleConfiguration::IndexBundleConfiguration(const std::string& collection
     , isAutoRebuild_(false)
     , enable_parallel_searching_(false)
     , enable_forceget_doc_(false)
+    , enable_block_max_wand_(false)
     , isMasterAggregator_(false)
     , isWorkerNode_(false)
     , encoding_(izenelib::util::UString::UNKNOWN)
@@ -173,6 +173,11 @@ public:
     /// @brief filter cache number
     size_t filterCacheNum_;
 
+    /// @brief whether WAND skips the posting blocks by their upper bounds,
+    /// it drops the docs which could not score above the threshold, so the
+    /// total count is less than WAND
+    bool enable_block_max_wand_;
+
     /// @brief master search cache number
     size_t masterSearchCacheNum_;
 
@@ -217,6 +217,86 @@ public:
         return true;
     }
 
+    bool hasSortKey() const
+    {
+        return true;
+    }
+
+    uint64_t getSortKey(std::size_t pos, bool isLock) const
+    {
+        ScopedReadBoolLock lock(mutex_, isLock);
+        if (pos >= data_.size() || data_[pos] == invalidValue_)
+            return kInvalidSortKey;
+
+        if (std::numeric_limits<T>::is_integer)
+            return int64SortKey(static_cast<int64_t>(data_[pos]));
+
+        return doubleSortKey(static_cast<double>(data_[pos]));
+    }
+
+    void updateFloatRange(const docid_t* docs, std::size_t num,
+                          float& lowValue, float& highValue,
+                          bool isLock) const
+    {
+        ScopedReadBoolLock lock(mutex_, isLock);
+        const std::size_t size = data_.size();
+        std::size_t i = 0;
+        while (i < num && (docs[i] >= size || data_[docs[i]] == invalidValue_))
+        {
+            ++i;
+        }
+        if (i == num)
+            return;
+
+        T low = data_[docs[i]];
+        T high = low;
+        for (++i; i < num; ++i)
+        {
+            if (docs[i] >= size)
+                continue;
+
+            const T& value = data_[docs[i]];
+            if (value == invalidValue_)
+                continue;
+
+            low = std::min(low, value);
+            high = std::max(high, value);
+        }
+
+        lowValue = std::min(lowValue, static_cast<float>(low));
+        highValue = std::max(highValue, static_cast<float>(high));
+    }
+
+    void sumInt32Values(const docid_t* docs, std::size_t num,
+                        uint32_t& sum, bool isLock) const
+    {
+        ScopedReadBoolLock lock(mutex_, isLock);
+        const std::size_t size = data_.size();
+        uint32_t blockSum = 0;
+
+        if (num > 0 && docs[num-1] < size && docs[num-1] - docs[0] == num - 1)
+        {
+            // consecutive docs, like "*", the loop could be vectorized
+            const T* data = &data_[docs[0]];
+            for (std::size_t i = 0; i < num; ++i)
+            {
+                blockSum += data[i] == invalidValue_ ? 0 : static_cast<int32_t>(data[i]);
+            }
+        }
+        else
+        {
+            for (std::size_t i = 0; i < num; ++i)
+            {
+                if (docs[i] >= size)
+                    continue;
+
+                const T& value = data_[docs[i]];
+                blockSum += value == invalidValue_ ? 0 : static_cast<int32_t>(value);
+            }
+        }
+        sum += blockSum;
+    }
+
     bool getValue(std::size_t pos, T& value, bool isLock = true) const
     {
         ScopedReadBoolLock lock(mutex_, isLock);
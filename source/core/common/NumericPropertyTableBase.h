@@ -3,7 +3,9 @@
 
 #include "type_defs.h"
 #include "PropSharedLock.h"
+#include "SortKey.h"
 #include <boost/thread/shared_mutex.hpp>
+#include <algorithm>
 
 namespace sf1r
 {
@@ -38,9 +40,52 @@ public:
     virtual bool getDoublePairValue(std::size_t pos, std::pair<double, double>& value, bool isLock = true) const = 0;
     virtual bool getInt64PairValue(std::size_t pos, std::pair<int64_t, int64_t>& value, bool isLock = true) const = 0;
 
+    /**
+     * whether getSortKey() orders the values like compareValues().
+     */
+    virtual bool hasSortKey() const { return false; }
+
+    /**
+     * @return the value at @p pos encoded by SortKey.h,
+     *         kInvalidSortKey if it has no value
+     */
+    virtual uint64_t getSortKey(std::size_t pos, bool isLock = true) const { return kInvalidSortKey; }
+
     virtual bool getFloatMinValue(float& minValue, bool isLock = true) const { return false; }
     virtual bool getFloatMaxValue(float& maxValue, bool isLock = true) const { return false; }
 
+    /**
+     * block versions of getFloatValue() and getInt32Value() for the docs
+     * @p docs[0, num), the docs without value are skipped.
+     */
+    virtual void updateFloatRange(const docid_t* docs, std::size_t num,
+                                  float& lowValue, float& highValue,
+                                  bool isLock = true) const
+    {
+        float value = 0;
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            if (getFloatValue(docs[i], value, isLock))
+            {
+                lowValue = std::min(lowValue, value);
+                highValue = std::max(highValue, value);
+            }
+        }
+    }
+
+    virtual void sumInt32Values(const docid_t* docs, std::size_t num,
+                                uint32_t& sum, bool isLock = true) const
+    {
+        int32_t value = 0;
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            if (getInt32Value(docs[i], value, isLock))
+            {
+                sum += value;
+            }
+        }
+    }
+
     virtual void* getValueList() = 0;
     virtual const void* getValueList() const = 0;
 
@@ -12,26 +12,59 @@
 #include <stdint.h>
 #include <memory.h>
 #include <vector>
+#include <set>
 #include <limits>
 #include <glog/logging.h>
 
 #include "PropSharedLock.h"
-
-#include "PropSharedLock.h"
+#include "SortKey.h"
 
 namespace sf1r
 {
 
+/**
+ * When sort is enabled, the values are also kept in memory for
+ * compareValues(). The distinct values are stored back to back in one
+ * arena. Each one has a rank, ordered like the strings, so comparing two
+ * docs compares two integers. A new value takes a rank between its
+ * neighbours, the ranks are respaced when there is no gap left.
+ * The values no longer used by any doc stay until the next load.
+ */
 class RTypeStringPropTable : public PropSharedLock
 {
-    typedef std::vector<std::string> RTypeVector;
+    typedef uint32_t valueid_t;
+
+    struct ValueRef
+    {
+        std::size_t offset;
+        std::size_t length;
+    };
+
+    /// compare the strings of two values in the arena
+    class ValueLess
+    {
+    public:
+        explicit ValueLess(const RTypeStringPropTable* table) : table_(table) {}
+
+        bool operator()(valueid_t lhs, valueid_t rhs) const
+        {
+            return table_->lessValue_(lhs, rhs);
+        }
+
+    private:
+        const RTypeStringPropTable* table_;
+    };
+
+    typedef std::set<valueid_t, ValueLess> ValueSet;
+
 public:
     RTypeStringPropTable(PropertyDataType type)
         : type_(type)
         , data_(new Lux::IO::Array(Lux::IO::NONCLUSTER))
         , sortEnabled_(false)
         , maxDocId_(0)
-        , invalidValue_("")
+        , rankEpoch_(0)
+        , valueSet_(ValueLess(this))
     {
         data_->set_noncluster_params(Lux::IO::Linked);
         data_->set_lock_type(Lux::IO::LOCK_THREAD);
@@ -61,7 +94,7 @@ public:
 
     void enableSort()
     {
-        ScopedWriteBoolLock(mutex_, true);
+        ScopedWriteBoolLock lock(mutex_, true);
         if (sortEnabled_)
             return;
         sortEnabled_ = true;
@@ -153,11 +186,11 @@ public:
             ScopedWriteBoolLock lock(mutex_, true);
             if (sortEnabled_)
             {
-                if (docId >= dataInMem_.size())
+                if (docId >= docValues_.size())
                 {
-                    dataInMem_.resize(docId+1, invalidValue_);
+                    docValues_.resize(docId+1, kInvalidValueId);
                 }
-                dataInMem_[docId]=rtype_value;
+                docValues_[docId] = intern_(rtype_value);
             }
             if (docId > maxDocId_)
             {
@@ -183,40 +216,174 @@ public:
     int compareValues(std::size_t lhs, std::size_t rhs, bool isLock)
     {
         ScopedReadBoolLock lock(mutex_, isLock);
-        if ( lhs > maxDocId_ || rhs > maxDocId_ )
+        if ( lhs >= docValues_.size() || rhs >= docValues_.size() )
         {
             return -1;
         }
-        const std::string lv = dataInMem_[lhs];
-        if (lv == invalidValue_) return -1;
-        const std::string rv = dataInMem_[rhs];
-        if (rv == invalidValue_) return 1;
-        if (lv < rv ) return -1;
-        if (lv > rv ) return 1;
+        const valueid_t lv = docValues_[lhs];
+        if (lv == kInvalidValueId) return -1;
+        const valueid_t rv = docValues_[rhs];
+        if (rv == kInvalidValueId) return 1;
+        const uint64_t lr = valueRanks_[lv];
+        const uint64_t rr = valueRanks_[rv];
+        if (lr < rr) return -1;
+        if (lr > rr) return 1;
         return 0;
     }
+    /**
+     * @return the rank of the value of @p docId, kInvalidSortKey if it
+     *         has no value. Valid until the next update.
+     */
+    uint64_t getSortKey(std::size_t docId, bool isLock) const
+    {
+        ScopedReadBoolLock lock(mutex_, isLock);
+        if (docId >= docValues_.size() || docValues_[docId] == kInvalidValueId)
+            return kInvalidSortKey;
+
+        return valueRanks_[docValues_[docId]];
+    }
+
+    /**
+     * @return the count of rank respacings, the sort keys got with
+     *         different epochs can't be compared.
+     */
+    uint64_t getRankEpoch(bool isLock) const
+    {
+        ScopedReadBoolLock lock(mutex_, isLock);
+        return rankEpoch_;
+    }
+
 private:
     void load_()
     {
-        dataInMem_.clear();
-        dataInMem_.resize(maxDocId_+1, invalidValue_);
+        arena_.clear();
+        valueRefs_.clear();
+        valueRanks_.clear();
+        valueSet_.clear();
+        docValues_.clear();
+        docValues_.resize(maxDocId_+1, kInvalidValueId);
+
+        std::string value;
         for (unsigned int docId = 0; docId <= maxDocId_; ++docId)
         {
-            std::string value;
             if (getRTypeString(docId, value))
             {
-                dataInMem_[docId]=value;
+                docValues_[docId] = intern_(value, true);
             }
         }
+        respaceRanks_();
+        std::vector<char>(arena_).swap(arena_);
+    }
+
+    bool lessValue_(valueid_t lhs, valueid_t rhs) const
+    {
+        const ValueRef& l = valueRefs_[lhs];
+        const ValueRef& r = valueRefs_[rhs];
+        // empty values may sit at the end of the arena, or in an empty one
+        const char* data = arena_.empty() ? "" : &arena_[0];
+        const int result = memcmp(data + l.offset, data + r.offset,
+                                  std::min(l.length, r.length));
+        if (result != 0)
+            return result < 0;
+        return l.length < r.length;
+    }
+
+    /// @return the id of @p value, added if it is new. When loading, the
+    /// ranks are given by respaceRanks_() at the end.
+    valueid_t intern_(const std::string& value, bool isLoading = false)
+    {
+        const valueid_t valueId = valueRefs_.size();
+        ValueRef ref;
+        ref.offset = arena_.size();
+        ref.length = value.size();
+        arena_.insert(arena_.end(), value.begin(), value.end());
+        valueRefs_.push_back(ref);
+
+        std::pair<ValueSet::iterator, bool> result = valueSet_.insert(valueId);
+        if (!result.second)
+        {
+            arena_.resize(ref.offset);
+            valueRefs_.pop_back();
+            return *result.first;
+        }
+
+        valueRanks_.push_back(0);
+        if (!isLoading && !rankBetween_(result.first))
+        {
+            respaceRanks_();
+        }
+        return valueId;
+    }
+
+    /// give @p it a rank between its neighbours
+    bool rankBetween_(ValueSet::iterator it)
+    {
+        const uint64_t maxRank = std::numeric_limits<uint64_t>::max();
+        ValueSet::iterator prev = it;
+        ValueSet::iterator next = it;
+        const bool hasPrev = it != valueSet_.begin();
+        const bool hasNext = ++next != valueSet_.end();
+
+        uint64_t low = hasPrev ? valueRanks_[*--prev] : 0;
+        uint64_t high = hasNext ? valueRanks_[*next] : maxRank;
+
+        // keep the room at both ends for the values added in order
+        if (!hasPrev && hasNext && high > 2 * kRankGap)
+        {
+            low = high - 2 * kRankGap;
+        }
+        else if (hasPrev && !hasNext && maxRank - low > 2 * kRankGap)
+        {
+            high = low + 2 * kRankGap;
+        }
+
+        if (high - low < 2)
+            return false;
+
+        valueRanks_[*it] = low + (high - low) / 2;
+        return true;
+    }
+
+    /// spread the ranks evenly around the middle of the rank space
+    void respaceRanks_()
+    {
+        const uint64_t maxRank = std::numeric_limits<uint64_t>::max();
+        const uint64_t valueNum = valueSet_.size();
+        const uint64_t maxGap = maxRank / (valueNum + 1);
+        const uint64_t gap = maxGap < kRankGap ? maxGap : kRankGap;
+        uint64_t rank = (maxRank - gap * valueNum) / 2;
+        ++rankEpoch_;
+        for (ValueSet::const_iterator it = valueSet_.begin();
+             it != valueSet_.end(); ++it)
+        {
+            rank += gap;
+            valueRanks_[*it] = rank;
+        }
     }
+
+protected:
+    enum { kInvalidValueId = 0xFFFFFFFF };
+    /// the ranks are this far apart after respacing
+    static const uint64_t kRankGap = 1ULL << 32;
+
 protected:
     PropertyDataType type_;
     std::string path_;
     Lux::IO::Array* data_;
-    RTypeVector dataInMem_;
     bool sortEnabled_;
     unsigned int maxDocId_;
-    std::string invalidValue_;
+    /// increased by respaceRanks_()
+    uint64_t rankEpoch_;
+
+    /// the bytes of the distinct values
+    std::vector<char> arena_;
+    /// indexed by value id
+    std::vector<ValueRef> valueRefs_;
+    std::vector<uint64_t> valueRanks_;
+    /// the value ids in the order of their strings
+    ValueSet valueSet_;
+    /// the value id of each doc
+    std::vector<valueid_t> docValues_;
 };
 
 }
@@ -0,0 +1,45 @@
+///
+/// @file SortKey.h
+/// @brief encode the sort values into unsigned integers of the same order
+///
+
+#ifndef SF1R_SORT_KEY_H
+#define SF1R_SORT_KEY_H
+
+#include <stdint.h>
+#include <string.h>
+
+namespace sf1r
+{
+
+/// the key of the docs without value, lower than any other key
+const uint64_t kInvalidSortKey = 0;
+
+inline uint64_t validSortKey(uint64_t key)
+{
+    return key == kInvalidSortKey ? kInvalidSortKey + 1 : key;
+}
+
+inline uint64_t int64SortKey(int64_t value)
+{
+    return validSortKey(static_cast<uint64_t>(value) ^ (1ULL << 63));
+}
+
+/// the negative values have all bits flipped, the others the sign bit
+inline uint64_t doubleSortKey(double value)
+{
+    // -0.0 equals 0.0
+    if (value == 0)
+        value = 0;
+
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bits >> 63)
+        return validSortKey(~bits);
+
+    return validSortKey(bits | (1ULL << 63));
+}
+
+} // namespace sf1r
+
+#endif // SF1R_SORT_KEY_H
@@ -60,6 +60,10 @@ public:
     int kvport;
     std::string mqaddr;
     int mqport;
+    // centroids are grouped into coarse cells for clustering assignment,
+    // 0 scans every centroid
+    int coarseClusteringNum;
+    int coarseClusteringProbe;
 
     LaserPara() 
         : modelType("")
@@ -69,6 +73,8 @@ public:
         , kvport(0)
         , mqaddr("")
         , mqport(0)
+        , coarseClusteringNum(0)
+        , coarseClusteringProbe(1)
     {}
 public:
     bool isEnableLaser()
@@ -88,6 +94,8 @@ private:
         ar & kvport;
         ar & mqaddr;
         ar & mqport;
+        ar & coarseClusteringNum;
+        ar & coarseClusteringProbe;
     }
 };
 
@@ -156,6 +156,14 @@ public:
 
     bool hasAttrtoken;
 
+    /**
+     * @brief: if true, the candidates retrieved for a query sorted only by
+     * relevance depend on the requested page, then the total count of the
+     * search result only counts the retrieved candidates, not all the
+     * matches; if false, up to 500000 candidates are retrieved;
+     */
+    bool adaptiveCandidate;
+
     /**
      * @brief: @properties, and @virtualPropeties
      * this is used to build zambezi index, and to build zambeziIndexSchema;
@@ -178,6 +186,7 @@ public:
                     , vocabSize(1U << 25) // 32M terms in default
                     , indexType_(ZambeziIndexType::DefultIndexType)
                     , hasAttrtoken(false)
+                    , adaptiveCandidate(false)
     {}
 
 
@@ -193,6 +202,7 @@ public:
         std::cout << "tokenPath: "<< tokenPath << std::endl;
         std::cout << "indexType: " << indexType_ << std::endl;
         std::cout << "hasAttrtoken: "<< hasAttrtoken << std::endl;
+        std::cout << "adaptiveCandidate: "<< adaptiveCandidate << std::endl;
         std::cout << "system_resource_path_: "<< system_resource_path_ << std::endl;
 
         /*for (std::vector<ZambeziProperty>::iterator i = properties.begin();
@@ -127,6 +127,7 @@ namespace sf1r
 
 InvertedIndexManager::InvertedIndexManager(IndexBundleConfiguration* bundleConfig)
     :bundleConfig_(bundleConfig)
+    ,indexGeneration_(0)
 {
     bool hasDateInConfig = false;
     collectionId_ = 1;
@@ -376,6 +377,7 @@ void InvertedIndexManager::finishIndex()
 void InvertedIndexManager::finishRebuild()
 {
     flush();
+    indexGeneration_.fetch_add(1, boost::memory_order_release);
 }
 
 // inverted index always true here, that means the doc an not be out-of-order;
@@ -1106,6 +1108,7 @@ bool InvertedIndexManager::updateDocument(const Document& olddoc, const Document
         if( mergeDocument_(olddoc, newdoc, new_indexdoc) )
         {
             izenelib::ir::indexmanager::Indexer::updateDocument(new_indexdoc);
+            indexGeneration_.fetch_add(1, boost::memory_order_release);
         }
         break;
     }
@@ -24,6 +24,7 @@
 
 #include <3rdparty/am/stx/btree_map.h>
 #include <boost/tuple/tuple.hpp>
+#include <boost/atomic.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include "IIncSupportedIndex.h"
@@ -147,6 +148,13 @@ public:
 
     void getDocsByPropertyValue(const std::string& property, const PropertyType& value, std::vector<docid_t>& idlist, uint16_t max_return = 10000);
 
+    /// increased when the postings of the indexed docs might be changed,
+    /// the docs appended or removed don't change it
+    uint64_t getIndexGeneration() const
+    {
+        return indexGeneration_.load(boost::memory_order_acquire);
+    }
+
 private:
     static void convertData(const std::string& property, const PropertyValue& in, PropertyType& out);
     bool makeForwardIndex_(
@@ -205,6 +213,7 @@ private:
     boost::shared_ptr<DocumentManager> documentManager_;
     boost::shared_ptr<izenelib::ir::idmanager::IDManager> idManager_;
     PropertyConfig dateProperty_;
+    boost::atomic<uint64_t> indexGeneration_;
 
     friend class IndexBundleActivator;
     //friend class ProductBundleActivator;
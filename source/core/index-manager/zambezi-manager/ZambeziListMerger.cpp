@@ -0,0 +1,192 @@
+#include "ZambeziListMerger.h"
+#include <algorithm>
+
+namespace
+{
+
+struct ListCursor
+{
+    const sf1r::docid_t* doc;
+    const sf1r::docid_t* end;
+    const float* score;
+    float weight;
+};
+
+/**
+ * A loser tree on the list cursors, each internal node keeps the loser of
+ * its subtree, so that advancing the winner takes log(k) comparisons on
+ * the way to the root.
+ *
+ * The cursors are compared by their keys, the doc in the merged order in
+ * the high bits and the list in the low bits, so on the same doc the lower
+ * list wins, and the scores of a doc are always summed in the order of
+ * the lists. An exhausted list has the max key.
+ */
+template <bool reverse>
+class LoserTree
+{
+public:
+    explicit LoserTree(std::vector<ListCursor>& cursors)
+        : cursors_(cursors)
+        , size_(cursors.size())
+        , keys_(size_)
+        , losers_(size_)
+    {
+        for (std::size_t i = 0; i < size_; ++i)
+        {
+            updateKey_(i);
+        }
+
+        // the winners of the subtrees, with the leaves at [size_, 2*size_)
+        std::vector<std::size_t> winners(2 * size_);
+        for (std::size_t i = 0; i < size_; ++i)
+        {
+            winners[size_ + i] = i;
+        }
+
+        for (std::size_t node = size_ - 1; node > 0; --node)
+        {
+            std::size_t left = winners[2 * node];
+            std::size_t right = winners[2 * node + 1];
+            if (keys_[left] > keys_[right])
+                std::swap(left, right);
+
+            winners[node] = left;
+            losers_[node] = right;
+        }
+        losers_[0] = size_ > 1 ? winners[1] : 0;
+    }
+
+    ListCursor& top()
+    {
+        return cursors_[losers_[0]];
+    }
+
+    /// replay the winner after its cursor is advanced
+    void adjust()
+    {
+        std::size_t winner = losers_[0];
+        updateKey_(winner);
+
+        const uint64_t* keys = &keys_[0];
+        for (std::size_t node = (size_ + winner) / 2; node > 0; node /= 2)
+        {
+            const std::size_t loser = losers_[node];
+            if (keys[winner] > keys[loser])
+            {
+                losers_[node] = winner;
+                winner = loser;
+            }
+        }
+        losers_[0] = winner;
+    }
+
+private:
+    void updateKey_(std::size_t i)
+    {
+        const ListCursor& cursor = cursors_[i];
+        if (cursor.doc == cursor.end)
+        {
+            keys_[i] = static_cast<uint64_t>(-1);
+            return;
+        }
+
+        const uint32_t order = reverse ? ~*cursor.doc : *cursor.doc;
+        keys_[i] = static_cast<uint64_t>(order) << 32 | i;
+    }
+
+private:
+    std::vector<ListCursor>& cursors_;
+    const std::size_t size_;
+    std::vector<uint64_t> keys_;
+
+    /// losers_[0] is the overall winner
+    std::vector<std::size_t> losers_;
+};
+
+template <bool reverse>
+std::size_t mergeCursors(
+    std::vector<ListCursor>& cursors,
+    std::size_t totalCount,
+    sf1r::docid_t* docids,
+    float* scores)
+{
+    LoserTree<reverse> tree(cursors);
+    std::size_t docCount = 0;
+
+    for (std::size_t i = 0; i < totalCount; ++i)
+    {
+        ListCursor& cursor = tree.top();
+        const float score = *cursor.score * cursor.weight;
+
+        if (docCount == 0 || docids[docCount - 1] != *cursor.doc)
+        {
+            docids[docCount] = *cursor.doc;
+            scores[docCount] = score;
+            ++docCount;
+        }
+        else
+        {
+            scores[docCount - 1] += score;
+        }
+
+        ++cursor.doc;
+        ++cursor.score;
+        tree.adjust();
+    }
+
+    return docCount;
+}
+
+}
+
+namespace sf1r
+{
+
+void mergeZambeziLists(
+    const std::vector<std::vector<docid_t> >& docidsList,
+    const std::vector<std::vector<float> >& scoresList,
+    const std::vector<float>& weightList,
+    bool reverse,
+    std::vector<docid_t>& docids,
+    std::vector<float>& scores)
+{
+    std::size_t totalCount = 0;
+    std::vector<ListCursor> cursors;
+    cursors.reserve(docidsList.size());
+
+    for (std::size_t i = 0; i < docidsList.size(); ++i)
+    {
+        if (docidsList[i].empty())
+            continue;
+
+        totalCount += docidsList[i].size();
+
+        ListCursor cursor;
+        cursor.doc = &docidsList[i][0];
+        cursor.end = cursor.doc + docidsList[i].size();
+        cursor.score = &scoresList[i][0];
+        cursor.weight = weightList[i];
+        cursors.push_back(cursor);
+    }
+
+    docids.resize(totalCount);
+    scores.resize(totalCount);
+    if (totalCount == 0)
+        return;
+
+    std::size_t docCount = 0;
+    if (reverse)
+    {
+        docCount = mergeCursors<true>(cursors, totalCount, &docids[0], &scores[0]);
+    }
+    else
+    {
+        docCount = mergeCursors<false>(cursors, totalCount, &docids[0], &scores[0]);
+    }
+
+    docids.resize(docCount);
+    scores.resize(docCount);
+}
+
+} // namespace sf1r
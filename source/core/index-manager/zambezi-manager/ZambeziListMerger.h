@@ -0,0 +1,40 @@
+/**
+ * @file ZambeziListMerger.h
+ * @brief merge the docs retrieved from each zambezi property.
+ */
+
+#ifndef SF1R_ZAMBEZI_LIST_MERGER_H
+#define SF1R_ZAMBEZI_LIST_MERGER_H
+
+#include <common/inttypes.h>
+#include <vector>
+
+namespace sf1r
+{
+
+/**
+ * Merge the sorted doc lists of @p docidsList into @p docids, a doc in
+ * several lists gets the weighted sum of its scores.
+ *
+ * The lists are merged by a loser tree on their current docs, it takes
+ * O(n log k) for n docs in k lists.
+ *
+ * @param docidsList each list is in ascending docid order, or in descending
+ *                   order if @p reverse is true
+ * @param scoresList the scores of @p docidsList, in the same size
+ * @param weightList the weight of each list
+ * @param reverse whether the docids are in descending order
+ * @param docids the merged docs, in the same order as the lists
+ * @param scores the merged scores
+ */
+void mergeZambeziLists(
+    const std::vector<std::vector<docid_t> >& docidsList,
+    const std::vector<std::vector<float> >& scoresList,
+    const std::vector<float>& weightList,
+    bool reverse,
+    std::vector<docid_t>& docids,
+    std::vector<float>& scores);
+
+} // namespace sf1r
+
+#endif // SF1R_ZAMBEZI_LIST_MERGER_H
@@ -1,8 +1,11 @@
 #include "ZambeziManager.h"
+#include "ZambeziListMerger.h"
 #include <common/PropSharedLock.h>
 #include "../zambezi-tokenizer/ZambeziTokenizer.h"
 #include <boost/utility.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 #include <fstream>
 #include <math.h>
 #include <algorithm>
@@ -10,6 +13,34 @@
 
 using namespace sf1r;
 
+namespace
+{
+
+typedef std::vector<std::pair<std::string, int> > TokenList;
+
+void retrieveProperty(
+        ZambeziIndexBase* index,
+        izenelib::ir::Zambezi::Algorithm algorithm,
+        const TokenList* tokens,
+        const ZambeziFilterBase* filter,
+        uint32_t limit,
+        std::vector<docid_t>* docids,
+        std::vector<float>* scores)
+{
+    try
+    {
+        index->retrieve(algorithm, *tokens, filter, limit, *docids, *scores);
+    }
+    catch (const std::exception& e)
+    {
+        LOG(ERROR) << "exception in zambezi retrieve: " << e.what();
+        docids->clear();
+        scores->clear();
+    }
+}
+
+}
+
 ZambeziManager::ZambeziManager(
         const ZambeziConfig& config)
     : config_(config)
@@ -178,10 +209,27 @@ void ZambeziManager::search(
     std::vector<float> weightList;
     for (unsigned int i = 0; i < searchPropertyList.size(); ++i)
     {
-        property_index_map_[searchPropertyList[i]]->retrieve(algorithm, tokens, filter, limit, docidsList[i], scoresList[i]);
         weightList.push_back(config_.getWeight(searchPropertyList[i]));
     }
 
+    // the properties are in separate indexes, each one is retrieved in its
+    // own thread, while the filter is only read by them
+    boost::thread_group threads;
+    for (unsigned int i = 1; i < searchPropertyList.size(); ++i)
+    {
+        threads.create_thread(boost::bind(&retrieveProperty,
+                                          property_index_map_[searchPropertyList[i]],
+                                          algorithm, &tokens, filter, limit,
+                                          &docidsList[i], &scoresList[i]));
+    }
+    retrieveProperty(property_index_map_[searchPropertyList[0]],
+                     algorithm, &tokens, filter, limit,
+                     &docidsList[0], &scoresList[0]);
+    threads.join_all();
+
+    LOG(INFO) << "zambezi retrieves " << docidsList.size()
+              << " properties, costs :" << timer.elapsed() << " seconds";
+
     izenelib::util::ClockTimer timer_merge;
 
     for (unsigned int i = 0; i < docidsList.size(); ++i)
@@ -197,7 +245,7 @@ void ZambeziManager::search(
     }
 
     //set weightList of preproty;
-    merge_(docidsList, scoresList, weightList, docids, scores);
+    mergeZambeziLists(docidsList, scoresList, weightList, config_.reverse, docids, scores);
 
     LOG(INFO) << "zambezi merge " << docidsList.size()
               << " properties, costs :" << timer_merge.elapsed() << " seconds";
@@ -205,79 +253,3 @@ void ZambeziManager::search(
     LOG(INFO) << "zambezi returns docid num: " << docids.size()
               << ", costs :" << timer.elapsed() << " seconds";
 }
-
-// to do, add weight to each posting
-void ZambeziManager::merge_(
-        const std::vector<std::vector<docid_t> >& docidsList,
-        const std::vector<std::vector<float> >& scoresList,
-        const std::vector<float>& weightList,
-        std::vector<docid_t>& docids,
-        std::vector<float>& scores)
-{
-    // init
-    unsigned int docidsListSize = docidsList.size();
-    int totalCount = 0;
-    int docCount = 0;
-
-    std::list<pair<int, unsigned int> > existingList;
-    for (unsigned int i = 0; i < docidsListSize; ++i)
-    {
-        if (docidsList[i].size() != 0)
-        {
-            totalCount += docidsList[i].size();
-            existingList.push_back(std::make_pair(i, 0));
-        }
-    }
-    docids.resize(totalCount);
-    scores.resize(totalCount);
-
-    // count
-    std::vector<std::list<pair<int, unsigned int> >::iterator> minDocList;
-
-    unsigned int min = -1;
-    while(existingList.size() > 1)
-    {
-        if (config_.reverse)
-            min = 0;
-        else
-            min = -1;
-
-        for (std::list<pair<int, unsigned int> >::iterator i = existingList.begin(); i != existingList.end(); ++i)
-        {
-            if ((config_.reverse && min < docidsList[i->first][i->second]) ||
-                (!config_.reverse && min > docidsList[i->first][i->second]))
-            {
-                min = docidsList[i->first][i->second];
-                minDocList.clear();
-                minDocList.push_back(i);
-                continue;
-            }
-            if (min == docidsList[i->first][i->second])
-                minDocList.push_back(i);
-        }
-
-        for (unsigned int i = 0; i < minDocList.size(); ++i)
-        {
-            int k = minDocList[i]->first;
-            int j = minDocList[i]->second++;
-            if (minDocList[i]->second == docidsList[k].size())
-                existingList.erase(minDocList[i]);
-
-            docids[docCount] = docidsList[k][j];
-            scores[docCount] += scoresList[k][j]*weightList[k];
-        }
-        docCount++;
-    }
-
-    if (existingList.size() == 1)
-    {
-        int k = existingList.begin()->first;
-        for (unsigned int i = existingList.begin()->second; i < docidsList[k].size(); ++i)
-        {
-            docids[docCount] = docidsList[k][i];
-            scores[docCount++] = scoresList[k][i]*weightList[k];
-        }
-    }
-    docids.resize(docCount);
-    scores.resize(docCount);
-}
@@ -69,18 +69,16 @@ public:
         return config_.hasAttrtoken;
     }
 
+    bool isAdaptiveCandidate()
+    {
+        return config_.adaptiveCandidate;
+    }
+
     void buildTokenizeDic();
 
     ZambeziTokenizer* getTokenizer();
 
 private:
-    void merge_(
-        const std::vector<std::vector<docid_t> >& docidsList,
-        const std::vector<std::vector<float> >& scoresList,
-        const std::vector<float>& weightList,
-        std::vector<docid_t>& docids,
-        std::vector<float>& scores);
-
     void createZambeziIndex_(ZambeziIndexBase* &zambeziIndex, uint32_t poolSize);
 
 private:
@@ -2,38 +2,94 @@
 #include "LaserManager.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/crc.hpp>
 #include <util/izene_serialization.h>
 #include <fstream>
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #include <mining-manager/MiningManager.h>
 #include <glog/logging.h>
 
 namespace sf1r { namespace laser {
 
+// rewrite the base files once this many delta segments piled up
+static const std::size_t MAX_DELTA_NUM = 16;
+static const uint32_t DELTA_MAGIC = 0x544c444c;
+static const uint32_t DELTA_VERSION = 1;
+
+struct DeltaHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t checksum;
+    // number of records
+    uint32_t count;
+    // bytes after the header
+    uint64_t dataSize;
+};
+
+// followed by n elements of the ad vector
+struct DeltaRecord
+{
+    uint32_t docid;
+    uint32_t clusteringId;
+    uint32_t n;
+};
+
+static const uint32_t DELTA_NO_CLUSTERING = (uint32_t)-1;
+
 AdIndexManager::AdIndexManager(const std::string& workdir, 
         const bool isEnableClustering, 
         LaserManager* laserManager)
     : workdir_(workdir + "/index/")
     , isEnableClustering_(isEnableClustering)
-    , adPtr_(NULL)
+    , adArena_(NULL)
     , adClusteringPtr_(NULL)
     , clusteringPtr_(NULL)
     , lastDocId_(0)
+    , baseSeq_(0)
+    , nextSeq_(0)
+    , needCompact_(false)
     , laserManager_(laserManager)
-    , documentManager_(laserManager_->documentManager_)
+{
+    open(isEnableClustering_ ? laserManager_->clusteringContainer_->size() : 0);
+}
+
+AdIndexManager::AdIndexManager(const std::string& workdir,
+        const std::size_t clusteringNum)
+    : workdir_(workdir + "/index/")
+    , isEnableClustering_(0 != clusteringNum)
+    , adArena_(NULL)
+    , adClusteringPtr_(NULL)
+    , clusteringPtr_(NULL)
+    , lastDocId_(0)
+    , baseSeq_(0)
+    , nextSeq_(0)
+    , needCompact_(false)
+    , laserManager_(NULL)
+{
+    open(clusteringNum);
+}
+
+void AdIndexManager::open(const std::size_t clusteringNum)
 {
     if (!boost::filesystem::exists(workdir_))
     {
         boost::filesystem::create_directories(workdir_);
     }
-    adPtr_ = new std::vector<std::vector<std::pair<int, float> > >();
-    loadAdIndex();
+    adArena_ = new AdVectorArena();
+    const bool isBaseLoaded = loadAdIndex();
     if (isEnableClustering_)
     {
-        clusteringPtr_ = new std::vector<std::vector<docid_t> >(laserManager_->clusteringContainer_->size());
+        clusteringPtr_ = new std::vector<std::vector<docid_t> >(clusteringNum);
         adClusteringPtr_ = new std::vector<std::size_t>();
         loadClusteringIndex();
     }
+    loadDeltas(isBaseLoaded);
 }
 
 AdIndexManager::~AdIndexManager()
@@ -48,59 +104,114 @@ AdIndexManager::~AdIndexManager()
         delete adClusteringPtr_;
         adClusteringPtr_ = NULL;
     }
-    if (NULL != adPtr_)
+    if (NULL != adArena_)
     {
-        delete adPtr_;
-        adPtr_ = NULL;
+        delete adArena_;
+        adArena_ = NULL;
     }
 }
 
 void AdIndexManager::index(const docid_t& docid, 
     const std::vector<std::pair<int, float> >& vec)
 {
+    appendAd(docid, vec);
+    boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+    unsaved_.push_back(docid);
+}
+
+void AdIndexManager::index(const std::vector<IndexItem>& batch)
+{
+    for (std::size_t i = 0; i < batch.size(); ++i)
+    {
+        appendAd(batch[i].docid, batch[i].vec);
+    }
     boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
-    if (adPtr_->size() <= docid)
+    for (std::size_t i = 0; i < batch.size(); ++i)
     {
-        adPtr_->resize(docid + 1);
+        const docid_t docid = batch[i].docid;
+        const std::size_t clusteringId = batch[i].clusteringId;
+        unsaved_.push_back(docid);
+        if (NO_CLUSTERING == clusteringId || NULL == clusteringPtr_ || clusteringId >= clusteringPtr_->size())
+        {
+            continue;
+        }
+        (*clusteringPtr_)[clusteringId].push_back(docid);
+        if (adClusteringPtr_->size() <= docid)
+        {
+            adClusteringPtr_->resize(docid + 1);
+        }
+        (*adClusteringPtr_)[docid] = clusteringId;
     }
-    (*adPtr_)[docid] = vec;
 }
 
 void AdIndexManager::index(const std::size_t& clusteringId, 
         const docid_t& docid,
         const std::vector<std::pair<int, float> >& vec)
 {
+    // publish the vector first, a reader that finds docid in the
+    // clustering always finds its vector
+    appendAd(docid, vec);
     boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+    unsaved_.push_back(docid);
     (*clusteringPtr_)[clusteringId].push_back(docid);
     if (adClusteringPtr_->size() <= docid)
     {
         adClusteringPtr_->resize(docid + 1);
     }
     (*adClusteringPtr_)[docid] = clusteringId;
-    if (adPtr_->size() <= docid)
+}
+
+void AdIndexManager::appendAd(const docid_t docid, const std::vector<std::pair<int, float> >& vec)
+{
+    // scoring walks the terms in order, the tokenizer already sorts them
+    if (std::is_sorted(vec.begin(), vec.end()))
     {
-        adPtr_->resize(docid + 1);
+        adArena_->append(docid, vec);
+        return;
     }
-    (*adPtr_)[docid] = vec;
+    std::vector<std::pair<int, float> > sorted(vec);
+    std::sort(sorted.begin(), sorted.end());
+    adArena_->append(docid, sorted);
 }
 
 bool AdIndexManager::get(const std::size_t& clusteringId, ADVector& advec) const
 {
-    //boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
+    boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
     if (clusteringId >= clusteringPtr_->size())
     {
         return false;
     }
     const std::vector<docid_t>& docidList = (*clusteringPtr_)[clusteringId];
+    advec.reserve(advec.size() + docidList.size());
+    AdVectorView view;
     for (std::size_t i = 0; i < docidList.size(); ++i)
     {
-        advec.push_back(std::make_pair(docidList[i], (*adPtr_)[docidList[i]]));
+        adArena_->get(docidList[i], view);
+        advec.push_back(std::make_pair(docidList[i], std::vector<std::pair<int, float> >(view.begin(), view.end())));
+    }
+    return true;
+}
+
+bool AdIndexManager::get(const std::size_t& clusteringId, AdViewVector& advec) const
+{
+    boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
+    if (clusteringId >= clusteringPtr_->size())
+    {
+        return false;
+    }
+    const std::vector<docid_t>& docidList = (*clusteringPtr_)[clusteringId];
+    advec.reserve(advec.size() + docidList.size());
+    for (std::size_t i = 0; i < docidList.size(); ++i)
+    {
+        advec.push_back(std::make_pair(docidList[i], AdVectorView()));
+        adArena_->get(docidList[i], advec.back().second);
     }
     return true;
 }
 
 bool AdIndexManager::get(const docid_t& docid, std::size_t& clustering) const
 {
+    boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
     if (docid >= adClusteringPtr_->size())
     {
         return false;
@@ -112,16 +223,23 @@ bool AdIndexManager::get(const docid_t& docid, std::size_t& clustering) const
 bool AdIndexManager::get(const docid_t& docid, 
     std::vector<std::pair<int, float> > & vec) const
 {
-    if (docid >= adPtr_->size())
+    AdVectorView view;
+    if (!adArena_->get(docid, view))
     {
         return false;
     }
-    vec = (*adPtr_)[docid];
+    view.copyTo(vec);
     return true;
 }
 
+bool AdIndexManager::get(const docid_t& docid, AdVectorView& vec) const
+{
+    return adArena_->get(docid, vec);
+}
+
 bool AdIndexManager::get(const std::size_t& clusteringId, std::vector<docid_t>& docids) const
 {
+    boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
     if (clusteringId >= clusteringPtr_->size())
     {
         return false;
@@ -131,77 +249,373 @@ bool AdIndexManager::get(const std::size_t& clusteringId, std::vector<docid_t>&
 }
 
 
-void AdIndexManager::preIndex()
+void AdIndexManager::postIndex()
+{
+    const bool ret = needCompact_ || nextSeq_ - baseSeq_ >= MAX_DELTA_NUM ? compact() : saveDelta();
+    // documents that are not on disk are indexed again after a restart
+    if (ret)
+    {
+        saveLastDocId();
+    }
+    if (NULL != laserManager_)
+    {
+        laserManager_->recommend_->updateAdDimension(lastDocId_);
+    }
+}
+    
+bool AdIndexManager::saveAdIndex()
 {
-    laserManager_->recommend_->preUpdateAdDimension();
+    LOG(INFO)<<"save ad-index, "<<adArena_->garbage()<<" elements of replaced ad vectors are held until restart";
+    if (!adArena_->save(workdir_ + "ad-arena"))
+    {
+        LOG(ERROR)<<"save ad-index failed";
+        return false;
+    }
+    return true;
 }
 
-void AdIndexManager::postIndex()
+void AdIndexManager::saveLastDocId() const
 {
-    saveAdIndex();
-    if (isEnableClustering_)
+    const std::string filename = workdir_ + "ad-last-docid";
+    std::ofstream ofs(filename.c_str(), std::ofstream::trunc);
+    ofs << lastDocId_;
+    ofs.close();
+}
+
+std::string AdIndexManager::deltaFile(const std::size_t seq) const
+{
+    std::stringstream ss;
+    ss << workdir_ << "delta." << seq;
+    return ss.str();
+}
+
+bool AdIndexManager::saveDelta()
+{
+    std::vector<docid_t> docids;
+    {
+        boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+        docids.swap(unsaved_);
+    }
+    if (docids.empty())
+    {
+        return true;
+    }
+
+    std::vector<char> data;
+    {
+        boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
+        AdVectorView view;
+        for (std::size_t i = 0; i < docids.size(); ++i)
+        {
+            const docid_t docid = docids[i];
+            adArena_->get(docid, view);
+            DeltaRecord record;
+            record.docid = docid;
+            record.clusteringId = NULL != adClusteringPtr_ && docid < adClusteringPtr_->size() ?
+                (*adClusteringPtr_)[docid] : DELTA_NO_CLUSTERING;
+            record.n = view.size();
+            const std::size_t offset = data.size();
+            const std::size_t size = sizeof(AdVectorView::Element) * view.size();
+            data.resize(offset + sizeof(record) + size);
+            memcpy(&data[offset], &record, sizeof(record));
+            if (0 != size)
+            {
+                memcpy(&data[offset + sizeof(record)], view.begin(), size);
+            }
+        }
+    }
+
+    DeltaHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = DELTA_MAGIC;
+    header.version = DELTA_VERSION;
+    header.count = docids.size();
+    header.dataSize = data.size();
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    header.checksum = crc.checksum();
+
+    const std::string filename = deltaFile(nextSeq_);
+    const std::string tmpfile = filename + ".tmp";
+    bool ret = false;
+    FILE* fp = fopen(tmpfile.c_str(), "wb");
+    if (NULL != fp)
     {
-        saveClusteringIndex();
+        ret = 1 == fwrite(&header, sizeof(header), 1, fp);
+        ret &= 1 == fwrite(data.data(), data.size(), 1, fp);
+        ret &= 0 == fflush(fp);
+        ret &= 0 == fsync(fileno(fp));
+        fclose(fp);
+        ret = ret && 0 == rename(tmpfile.c_str(), filename.c_str());
     }
-    laserManager_->recommend_->updateAdDimension(lastDocId_);
-    laserManager_->recommend_->postUpdateAdDimension();
+    if (!ret)
+    {
+        LOG(ERROR)<<"save delta segment "<<filename<<" failed";
+        boost::filesystem::remove(tmpfile);
+        // kept for the next save
+        boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+        unsaved_.insert(unsaved_.begin(), docids.begin(), docids.end());
+        return false;
+    }
+    LOG(INFO)<<"save delta segment "<<filename<<", ad size = "<<docids.size();
+    ++nextSeq_;
+    return true;
 }
-    
-void AdIndexManager::saveAdIndex()
+
+bool AdIndexManager::compact()
 {
-    LOG(INFO)<<"save ad-index...";
-    const std::string filename = workdir_ + "ad-index";
-    std::ofstream ofs(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
-    boost::archive::binary_oarchive oa(ofs);
-    try
+    LOG(INFO)<<"compact ad-index, "<<nextSeq_ - baseSeq_<<" delta segments";
+    std::vector<docid_t> docids;
     {
-        oa << *adPtr_;
-        oa << lastDocId_;
+        boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+        docids.swap(unsaved_);
     }
-    catch(std::exception& e)
+    bool ret = saveAdIndex();
+    if (ret && isEnableClustering_)
     {
-        LOG(INFO)<<e.what();
+        ret = saveClusteringIndex();
+    }
+    if (!ret)
+    {
+        boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+        unsaved_.insert(unsaved_.begin(), docids.begin(), docids.end());
+        return false;
+    }
+
+    // written before the segments go, a crash in between skips them on load,
+    // a crash before replays them, which loadDeltas() makes harmless
+    const std::string filename = workdir_ + "delta-base";
+    {
+        const std::string tmpfile = filename + ".tmp";
+        std::ofstream ofs(tmpfile.c_str(), std::ofstream::trunc);
+        ofs << nextSeq_;
+        ofs.close();
+        if (!ofs || 0 != rename(tmpfile.c_str(), filename.c_str()))
+        {
+            LOG(ERROR)<<"save "<<filename<<" failed";
+            return false;
+        }
+    }
+    for (std::size_t seq = baseSeq_; seq < nextSeq_; ++seq)
+    {
+        boost::filesystem::remove(deltaFile(seq));
+    }
+    baseSeq_ = nextSeq_;
+    needCompact_ = false;
+    return true;
+}
+
+void AdIndexManager::loadDeltas(const bool isBaseLoaded)
+{
+    const std::string filename = workdir_ + "delta-base";
+    if (boost::filesystem::exists(filename))
+    {
+        std::ifstream ifs(filename.c_str());
+        ifs >> baseSeq_;
+    }
+    nextSeq_ = baseSeq_;
+    // deltas of a lost base are useless, everything is indexed again
+    needCompact_ |= !isBaseLoaded;
+    // the clustering index can be newer than delta-base, compact() writes
+    // it first, and the documents indexed while it is written go to the next
+    // segment as well, so the replay skips the documents already listed
+    std::vector<bool> isClustered;
+    if (isBaseLoaded && isEnableClustering_)
+    {
+        for (std::size_t i = 0; i < clusteringPtr_->size(); ++i)
+        {
+            const std::vector<docid_t>& docids = (*clusteringPtr_)[i];
+            for (std::size_t k = 0; k < docids.size(); ++k)
+            {
+                if (isClustered.size() <= docids[k])
+                {
+                    isClustered.resize(docids[k] + 1, false);
+                }
+                isClustered[docids[k]] = true;
+            }
+        }
+    }
+    while (boost::filesystem::exists(deltaFile(nextSeq_)))
+    {
+        if (!isBaseLoaded || !loadDelta(deltaFile(nextSeq_), isClustered))
+        {
+            // the documents from here on are indexed again, ad-last-docid
+            // was saved with the dropped segments
+            LOG(ERROR)<<"drop delta segments from "<<deltaFile(nextSeq_);
+            lastDocId_ = std::min(lastDocId_, adArena_->size());
+            for (std::size_t seq = nextSeq_; boost::filesystem::exists(deltaFile(seq)); ++seq)
+            {
+                boost::filesystem::remove(deltaFile(seq));
+            }
+            break;
+        }
+        ++nextSeq_;
+    }
+    if (nextSeq_ != baseSeq_)
+    {
+        LOG(INFO)<<"replay "<<nextSeq_ - baseSeq_<<" delta segments, last docid = "<<lastDocId_;
     }
-    ofs.close();
+}
+
+bool AdIndexManager::loadDelta(const std::string& filename, const std::vector<bool>& isClustered)
+{
+    std::vector<char> data;
+    DeltaHeader header;
+    {
+        std::ifstream ifs(filename.c_str(), std::ios::binary);
+        ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!ifs || DELTA_MAGIC != header.magic || DELTA_VERSION != header.version ||
+            boost::filesystem::file_size(filename) != sizeof(header) + header.dataSize)
+        {
+            LOG(ERROR)<<filename<<" has unsupported version or bad size";
+            return false;
+        }
+        data.resize(header.dataSize);
+        ifs.read(data.data(), data.size());
+        if (!ifs)
+        {
+            LOG(ERROR)<<"read "<<filename<<" failed";
+            return false;
+        }
+    }
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    if (crc.checksum() != header.checksum)
+    {
+        LOG(ERROR)<<filename<<" checksum mismatch";
+        return false;
+    }
+
+    std::vector<IndexItem> batch(header.count);
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < header.count; ++i)
+    {
+        DeltaRecord record;
+        if (offset + sizeof(record) > data.size())
+        {
+            LOG(ERROR)<<filename<<" is truncated";
+            return false;
+        }
+        memcpy(&record, &data[offset], sizeof(record));
+        offset += sizeof(record);
+        const std::size_t size = sizeof(AdVectorView::Element) * record.n;
+        if (offset + size > data.size())
+        {
+            LOG(ERROR)<<filename<<" is truncated";
+            return false;
+        }
+        IndexItem& item = batch[i];
+        item.docid = record.docid;
+        item.clusteringId = DELTA_NO_CLUSTERING == record.clusteringId || !isEnableClustering_ ?
+            NO_CLUSTERING : record.clusteringId;
+        if (NO_CLUSTERING != item.clusteringId && item.docid < isClustered.size() && isClustered[item.docid] &&
+            item.docid < adClusteringPtr_->size() && (*adClusteringPtr_)[item.docid] == item.clusteringId)
+        {
+            // the vector is appended again, the same content
+            item.clusteringId = NO_CLUSTERING;
+        }
+        item.vec.resize(record.n);
+        if (0 != size)
+        {
+            memcpy(&item.vec[0], &data[offset], size);
+        }
+        offset += size;
+        if (lastDocId_ <= item.docid)
+        {
+            lastDocId_ = item.docid + 1;
+        }
+    }
+    index(batch);
+    // already on disk
+    boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
+    unsaved_.clear();
+    return true;
 }
     
-void AdIndexManager::loadAdIndex()
+bool AdIndexManager::loadAdIndex()
 {
-    const std::string filename = workdir_ + "ad-index";
+    const std::string filename = workdir_ + "ad-arena";
     if (!boost::filesystem::exists(filename))
     {
-        return;
+        // indexes saved before the arena, converted on the next save
+        needCompact_ = loadLegacyAdIndex(workdir_ + "ad-index");
     }
-    LOG(INFO)<<"open ad-index...";
+    else
+    {
+        LOG(INFO)<<"open ad-index...";
+        if (!adArena_->load(filename))
+        {
+            LOG(ERROR)<<"open ad-index failed";
+            return false;
+        }
+    }
+    // a fresh index has only delta segments and the last docid
+    const std::string lastDocIdFile = workdir_ + "ad-last-docid";
+    if (boost::filesystem::exists(lastDocIdFile))
+    {
+        std::ifstream ifs(lastDocIdFile.c_str());
+        ifs >> lastDocId_;
+    }
+    return true;
+}
+
+bool AdIndexManager::loadLegacyAdIndex(const std::string& filename)
+{
+    if (!boost::filesystem::exists(filename))
+    {
+        return false;
+    }
+    LOG(INFO)<<"open legacy ad-index...";
+    std::vector<std::vector<std::pair<int, float> > > ad;
     try
     {
         std::ifstream ifs(filename.c_str(), std::ios::binary);
         boost::archive::binary_iarchive ia(ifs);
-        ia >> *adPtr_;
+        ia >> ad;
         ia >> lastDocId_;
     }
     catch (std::exception& e)
     {
         LOG(INFO)<<e.what();
+        return false;
     }
+    for (std::size_t i = 0; i < ad.size(); ++i)
+    {
+        appendAd(i, ad[i]);
+    }
+    return true;
 }
 
-void AdIndexManager::saveClusteringIndex()
+bool AdIndexManager::saveClusteringIndex()
 {
     LOG(INFO)<<"save clustering-index...";
+    boost::shared_lock<boost::shared_mutex> sharedLock(mtx_);
     const std::string filename = workdir_ + "clustering-index";
-    std::ofstream ofs(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
-    boost::archive::binary_oarchive oa(ofs);
+    const std::string tmpfile = filename + ".tmp";
     try
     {
+        std::ofstream ofs(tmpfile.c_str(), std::ofstream::binary | std::ofstream::trunc);
+        boost::archive::binary_oarchive oa(ofs);
         oa << *clusteringPtr_;
         oa << *adClusteringPtr_;
+        ofs.close();
+        if (!ofs)
+        {
+            LOG(ERROR)<<"write "<<tmpfile<<" failed";
+            return false;
+        }
     }
     catch(std::exception& e)
     {
-        LOG(INFO)<<e.what();
+        LOG(ERROR)<<e.what();
+        return false;
     }
-    ofs.close();
+    if (0 != rename(tmpfile.c_str(), filename.c_str()))
+    {
+        LOG(ERROR)<<"rename "<<tmpfile<<" to "<<filename<<" failed";
+        return false;
+    }
+    return true;
 }
     
 void AdIndexManager::loadClusteringIndex()
@@ -227,6 +641,10 @@ void AdIndexManager::loadClusteringIndex()
     
 bool AdIndexManager::convertDocId(const std::string& docStr, docid_t& docId) const
 {
+    if (NULL == laserManager_)
+    {
+        return false;
+    }
     return laserManager_->convertDocId(docStr, docId);
 }
 } }
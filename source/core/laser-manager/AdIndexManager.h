@@ -1,8 +1,10 @@
 #ifndef SF1R_LASER_AD_INDEX_MANAGER_H
 #define SF1R_LASER_AD_INDEX_MANAGER_H
 
+#include "AdVectorArena.h"
 #include <3rdparty/am/luxio/array.h>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/shared_mutex.hpp>
 #include <vector>
 #include <common/inttypes.h>
 #include <document-manager/DocumentManager.h>
@@ -19,14 +21,33 @@ class AdIndexManager
 
     friend class LaserRecommend;
 public:
+    typedef std::vector<std::pair<docid_t, AdVectorView> > AdViewVector;
+
+    // one document of an indexing batch
+    struct IndexItem
+    {
+        docid_t docid;
+        // NO_CLUSTERING when clustering is disabled
+        std::size_t clusteringId;
+        std::vector<std::pair<int, float> > vec;
+    };
+    static const std::size_t NO_CLUSTERING = (std::size_t)-1;
+
     AdIndexManager(const std::string& workdir,
         const bool isEnableClustering, 
         LaserManager* laserManager);
+    // without a LaserManager, for tools and benchmarks, docids can't be
+    // converted and postIndex doesn't notify the recommend
+    AdIndexManager(const std::string& workdir,
+        const std::size_t clusteringNum);
     ~AdIndexManager();
 
 public:
     void index(const docid_t& docid, const std::vector<std::pair<int, float> >& vec);
     bool get(const docid_t& docid, std::vector<std::pair<int, float> >& vec) const;
+    // views point into the arena and stay valid as long as this manager,
+    // terms are sorted by index
+    bool get(const docid_t& docid, AdVectorView& vec) const;
     
     // for clustering system
     void index(const std::size_t& clusteringId, 
@@ -35,8 +56,13 @@ public:
     
     bool get(const std::size_t& clusteringId, std::vector<docid_t>& docids) const;
     bool get(const docid_t& docid, std::size_t& clustering) const;
+
+    // vectors are appended lock free, the clustering lists of the whole
+    // batch are updated under one lock
+    void index(const std::vector<IndexItem>& batch);
     
     bool get(const std::size_t& clusteringId, ADVector& adList) const;
+    bool get(const std::size_t& clusteringId, AdViewVector& adList) const;
     
     docid_t getLastDocId() const
     {
@@ -50,24 +76,44 @@ public:
     
     bool convertDocId(const std::string& docStr, docid_t& docId) const;
     
-    void preIndex();
     void postIndex();
 private:
+    void open(const std::size_t clusteringNum);
     void loadClusteringIndex();
-    void saveClusteringIndex();
-    void loadAdIndex();
-    void saveAdIndex();
+    bool saveClusteringIndex();
+    // false if the base file exists but cannot be loaded
+    bool loadAdIndex();
+    bool saveAdIndex();
+    bool loadLegacyAdIndex(const std::string& filename);
+    void appendAd(const docid_t docid, const std::vector<std::pair<int, float> >& vec);
+
+    // documents indexed since the last save go to a new delta segment,
+    // every MAX_DELTA_NUM segments the base files are rewritten instead
+    bool saveDelta();
+    bool compact();
+    void loadDeltas(const bool isBaseLoaded);
+    // documents marked in isClustered are not added to their clustering again
+    bool loadDelta(const std::string& filename, const std::vector<bool>& isClustered);
+    std::string deltaFile(const std::size_t seq) const;
+    void saveLastDocId() const;
 private:
     const std::string workdir_;
     const bool isEnableClustering_;
-    std::vector<std::vector<std::pair<int, float> > >* adPtr_;
+    // appends and reads of the ad vectors are lock free
+    AdVectorArena* adArena_;
     std::vector<std::size_t>* adClusteringPtr_;
     std::vector<std::vector<docid_t> >* clusteringPtr_;
     docid_t lastDocId_;
+    // guards the clustering lists and unsaved_
     mutable boost::shared_mutex mtx_;
+    // indexed, but in neither the base files nor a delta segment
+    std::vector<docid_t> unsaved_;
+    // segments before baseSeq_ are in the base files
+    std::size_t baseSeq_;
+    std::size_t nextSeq_;
+    bool needCompact_;
 
     LaserManager* laserManager_;
-    const boost::shared_ptr<DocumentManager>& documentManager_;
 };
 
 } }
@@ -0,0 +1,377 @@
+#include "AdVectorArena.h"
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sf1r { namespace laser {
+
+// slot layout: PUBLISHED bit, START_BITS of start, SIZE_BITS of size
+static const uint64_t PUBLISHED = 1ULL << 63;
+static const std::size_t SIZE_BITS = 21;
+static const uint64_t SIZE_MASK = (1ULL << SIZE_BITS) - 1;
+
+static std::size_t alignOffset(std::size_t offset)
+{
+    const std::size_t mask = AdVectorArena::ALIGNMENT - 1;
+    return (offset + mask) & ~mask;
+}
+
+AdVectorArena::AdVectorArena()
+    : chunks_(NULL)
+    , tail_(0)
+    , slots_(NULL)
+    , docNum_(0)
+    , garbage_(0)
+    , addr_(NULL)
+    , mapSize_(0)
+    , baseDocNum_(0)
+    , baseOffset_(NULL)
+    , baseData_(NULL)
+{
+    chunks_ = new boost::atomic<Element*>[MAX_CHUNK_NUM];
+    for (std::size_t i = 0; i < MAX_CHUNK_NUM; ++i)
+    {
+        chunks_[i].store(NULL, boost::memory_order_relaxed);
+    }
+    slots_ = new boost::atomic<boost::atomic<uint64_t>*>[MAX_SLOT_CHUNK_NUM];
+    for (std::size_t i = 0; i < MAX_SLOT_CHUNK_NUM; ++i)
+    {
+        slots_[i].store(NULL, boost::memory_order_relaxed);
+    }
+}
+
+AdVectorArena::~AdVectorArena()
+{
+    if (NULL != chunks_)
+    {
+        for (std::size_t i = 0; i < MAX_CHUNK_NUM; ++i)
+        {
+            delete[] chunks_[i].load(boost::memory_order_relaxed);
+        }
+        delete[] chunks_;
+        chunks_ = NULL;
+    }
+    if (NULL != slots_)
+    {
+        for (std::size_t i = 0; i < MAX_SLOT_CHUNK_NUM; ++i)
+        {
+            delete[] slots_[i].load(boost::memory_order_relaxed);
+        }
+        delete[] slots_;
+        slots_ = NULL;
+    }
+    unmap();
+}
+
+bool AdVectorArena::append(const docid_t docid, const std::vector<Element>& vec)
+{
+    AdVectorView current;
+    if (get(docid, current) && current.size() == vec.size() &&
+        std::equal(vec.begin(), vec.end(), current.begin()))
+    {
+        // unchanged, the same docid indexed again
+        return true;
+    }
+
+    uint64_t start = 0;
+    if (!vec.empty())
+    {
+        if (!reserve(vec.size(), start))
+        {
+            LOG(ERROR)<<"ad vector of docid "<<docid<<" with "<<vec.size()<<" elements does not fit in the arena";
+            return false;
+        }
+        std::copy(vec.begin(), vec.end(), at(start));
+    }
+
+    boost::atomic<uint64_t>* s = slot(docid, true);
+    if (NULL == s)
+    {
+        LOG(ERROR)<<"docid "<<docid<<" out of range";
+        return false;
+    }
+    // the elements above happen before any reader that sees this slot
+    const uint64_t old = s->exchange(PUBLISHED | (start << SIZE_BITS) | vec.size(), boost::memory_order_release);
+    if (old & PUBLISHED)
+    {
+        garbage_.fetch_add(old & SIZE_MASK, boost::memory_order_relaxed);
+    }
+
+    docid_t num = docNum_.load(boost::memory_order_relaxed);
+    while (num <= docid &&
+        !docNum_.compare_exchange_weak(num, docid + 1, boost::memory_order_release, boost::memory_order_relaxed))
+    {
+    }
+    return true;
+}
+
+bool AdVectorArena::get(const docid_t docid, AdVectorView& view) const
+{
+    const boost::atomic<uint64_t>* s = slot(docid);
+    const uint64_t v = NULL == s ? 0 : s->load(boost::memory_order_acquire);
+    if (v & PUBLISHED)
+    {
+        const std::size_t size = v & SIZE_MASK;
+        view = 0 == size ? AdVectorView() : AdVectorView(at((v & ~PUBLISHED) >> SIZE_BITS), size);
+        return true;
+    }
+    if (docid < baseDocNum_)
+    {
+        view = AdVectorView(baseData_ + baseOffset_[docid], baseOffset_[docid + 1] - baseOffset_[docid]);
+        return true;
+    }
+    view = AdVectorView();
+    return docid < size();
+}
+
+bool AdVectorArena::reserve(const std::size_t n, uint64_t& start)
+{
+    if (n > CHUNK_SIZE || n > SIZE_MASK)
+    {
+        return false;
+    }
+    uint64_t tail = tail_.load(boost::memory_order_relaxed);
+    uint64_t end = 0;
+    do
+    {
+        start = tail;
+        // a vector never straddles two chunks, skip the rest of this one
+        if ((start & (CHUNK_SIZE - 1)) + n > CHUNK_SIZE)
+        {
+            start = (start | (CHUNK_SIZE - 1)) + 1;
+        }
+        end = start + n;
+        if (end > MAX_CHUNK_NUM * CHUNK_SIZE)
+        {
+            return false;
+        }
+    } while (!tail_.compare_exchange_weak(tail, end, boost::memory_order_relaxed));
+
+    boost::atomic<Element*>& chunk = chunks_[start >> CHUNK_BITS];
+    if (NULL == chunk.load(boost::memory_order_acquire))
+    {
+        Element* expected = NULL;
+        Element* data = new Element[CHUNK_SIZE];
+        if (!chunk.compare_exchange_strong(expected, data, boost::memory_order_acq_rel))
+        {
+            delete[] data;
+        }
+    }
+    return true;
+}
+
+AdVectorArena::Element* AdVectorArena::at(uint64_t pos) const
+{
+    return chunks_[pos >> CHUNK_BITS].load(boost::memory_order_acquire) + (pos & (CHUNK_SIZE - 1));
+}
+
+boost::atomic<uint64_t>* AdVectorArena::slot(const docid_t docid, bool create)
+{
+    const std::size_t c = docid >> SLOT_BITS;
+    if (c >= MAX_SLOT_CHUNK_NUM)
+    {
+        return NULL;
+    }
+    boost::atomic<uint64_t>* slots = slots_[c].load(boost::memory_order_acquire);
+    if (NULL == slots && create)
+    {
+        boost::atomic<uint64_t>* data = new boost::atomic<uint64_t>[SLOT_CHUNK_SIZE];
+        for (std::size_t i = 0; i < SLOT_CHUNK_SIZE; ++i)
+        {
+            data[i].store(0, boost::memory_order_relaxed);
+        }
+        if (slots_[c].compare_exchange_strong(slots, data, boost::memory_order_acq_rel))
+        {
+            slots = data;
+        }
+        else
+        {
+            delete[] data;
+        }
+    }
+    return NULL == slots ? NULL : slots + (docid & (SLOT_CHUNK_SIZE - 1));
+}
+
+const boost::atomic<uint64_t>* AdVectorArena::slot(const docid_t docid) const
+{
+    return const_cast<AdVectorArena*>(this)->slot(docid, false);
+}
+
+bool AdVectorArena::save(const std::string& filename) const
+{
+    // every vector is read once, so offsets and data agree even if a
+    // docid is appended again meanwhile
+    const std::size_t docNum = size();
+    std::vector<AdVectorView> views(docNum);
+    std::vector<uint64_t> offsets(docNum + 1, 0);
+    for (std::size_t i = 0; i < docNum; ++i)
+    {
+        get(i, views[i]);
+        offsets[i + 1] = offsets[i] + views[i].size();
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.docNum = docNum;
+    header.elementNum = offsets[docNum];
+    header.dataOffset = alignOffset(sizeof(header) + sizeof(uint64_t) * offsets.size());
+    header.dataSize = header.dataOffset + sizeof(Element) * header.elementNum - sizeof(header);
+
+    const std::string tmpfile = filename + ".tmp";
+    FILE* fp = fopen(tmpfile.c_str(), "wb");
+    if (NULL == fp)
+    {
+        LOG(ERROR)<<"open "<<tmpfile<<" failed";
+        return false;
+    }
+
+    boost::crc_32_type crc;
+    bool ret = true;
+    // header is rewritten with the checksum once all data is written
+    ret &= 1 == fwrite(&header, sizeof(header), 1, fp);
+    const std::size_t offsetSize = sizeof(uint64_t) * offsets.size();
+    ret &= 1 == fwrite(offsets.data(), offsetSize, 1, fp);
+    crc.process_bytes(offsets.data(), offsetSize);
+    static const char zero[ALIGNMENT] = {0};
+    const std::size_t pad = header.dataOffset - sizeof(header) - offsetSize;
+    if (pad > 0)
+    {
+        ret &= 1 == fwrite(zero, pad, 1, fp);
+        crc.process_bytes(zero, pad);
+    }
+    for (std::size_t i = 0; ret && i < docNum; ++i)
+    {
+        if (views[i].empty())
+            continue;
+        const std::size_t size = sizeof(Element) * views[i].size();
+        ret &= 1 == fwrite(views[i].begin(), size, 1, fp);
+        crc.process_bytes(views[i].begin(), size);
+    }
+
+    header.checksum = crc.checksum();
+    ret &= 0 == fseek(fp, 0, SEEK_SET);
+    ret &= 1 == fwrite(&header, sizeof(header), 1, fp);
+    ret &= 0 == fflush(fp);
+    ret &= 0 == fsync(fileno(fp));
+    fclose(fp);
+
+    if (!ret)
+    {
+        LOG(ERROR)<<"write "<<tmpfile<<" failed";
+        boost::filesystem::remove(tmpfile);
+        return false;
+    }
+    if (0 != rename(tmpfile.c_str(), filename.c_str()))
+    {
+        LOG(ERROR)<<"rename "<<tmpfile<<" to "<<filename<<" failed";
+        return false;
+    }
+    return true;
+}
+
+bool AdVectorArena::load(const std::string& filename)
+{
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || (std::size_t)st.st_size < sizeof(Header))
+    {
+        ::close(fd);
+        LOG(ERROR)<<filename<<" is truncated";
+        return false;
+    }
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (MAP_FAILED == addr)
+    {
+        LOG(ERROR)<<"mmap "<<filename<<" failed";
+        return false;
+    }
+    const char* base = static_cast<const char*>(addr);
+    const std::size_t size = st.st_size;
+
+    const Header* header = reinterpret_cast<const Header*>(base);
+    bool ret = MAGIC == header->magic && VERSION == header->version &&
+        sizeof(*header) + header->dataSize == size &&
+        header->dataOffset >= sizeof(*header) + sizeof(uint64_t) * (header->docNum + 1) &&
+        header->dataOffset + sizeof(Element) * header->elementNum == size;
+    if (!ret)
+    {
+        LOG(ERROR)<<filename<<" has unsupported version or bad size";
+    }
+    else
+    {
+        // sequential scan for the checksum also warms the page cache
+        madvise(addr, size, MADV_SEQUENTIAL);
+        boost::crc_32_type crc;
+        crc.process_bytes(base + sizeof(*header), header->dataSize);
+        madvise(addr, size, MADV_NORMAL);
+        ret = crc.checksum() == header->checksum;
+        if (!ret)
+        {
+            LOG(ERROR)<<filename<<" checksum mismatch";
+        }
+    }
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + sizeof(*header));
+    for (std::size_t i = 0; ret && i < header->docNum; ++i)
+    {
+        ret = offsets[i] <= offsets[i + 1];
+    }
+    if (ret && offsets[header->docNum] != header->elementNum)
+    {
+        ret = false;
+    }
+    if (!ret)
+    {
+        munmap(addr, size);
+        return false;
+    }
+
+    // drop the appended vectors, the file holds all of them
+    for (std::size_t i = 0; i < MAX_CHUNK_NUM; ++i)
+    {
+        delete[] chunks_[i].exchange(NULL, boost::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < MAX_SLOT_CHUNK_NUM; ++i)
+    {
+        delete[] slots_[i].exchange(NULL, boost::memory_order_relaxed);
+    }
+    tail_.store(0, boost::memory_order_relaxed);
+    garbage_.store(0, boost::memory_order_relaxed);
+    unmap();
+
+    addr_ = base;
+    mapSize_ = size;
+    baseDocNum_ = header->docNum;
+    baseOffset_ = offsets;
+    baseData_ = reinterpret_cast<const Element*>(base + header->dataOffset);
+    docNum_.store(baseDocNum_, boost::memory_order_release);
+    return true;
+}
+
+void AdVectorArena::unmap()
+{
+    if (NULL != addr_)
+    {
+        munmap(const_cast<char*>(addr_), mapSize_);
+        addr_ = NULL;
+        mapSize_ = 0;
+    }
+    baseDocNum_ = 0;
+    baseOffset_ = NULL;
+    baseData_ = NULL;
+}
+
+} }
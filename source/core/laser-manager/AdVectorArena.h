@@ -0,0 +1,176 @@
+#ifndef SF1R_LASER_AD_VECTOR_ARENA_H
+#define SF1R_LASER_AD_VECTOR_ARENA_H
+#include <string>
+#include <vector>
+#include <common/inttypes.h>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace sf1r { namespace laser {
+
+// read-only view of one ad's sparse vector inside an AdVectorArena
+class AdVectorView
+{
+public:
+    typedef std::pair<int, float> Element;
+    typedef const Element* const_iterator;
+
+    AdVectorView()
+        : begin_(NULL)
+        , size_(0)
+    {
+    }
+
+    AdVectorView(const Element* begin, std::size_t size)
+        : begin_(begin)
+        , size_(size)
+    {
+    }
+
+public:
+    const_iterator begin() const
+    {
+        return begin_;
+    }
+
+    const_iterator end() const
+    {
+        return begin_ + size_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    bool empty() const
+    {
+        return 0 == size_;
+    }
+
+    const Element& operator[](std::size_t i) const
+    {
+        return begin_[i];
+    }
+
+    void copyTo(std::vector<Element>& vec) const
+    {
+        vec.assign(begin(), end());
+    }
+
+private:
+    const Element* begin_;
+    std::size_t size_;
+};
+
+/*
+ * Append-only CSR storage of the ad vectors, docid -> [Element].
+ *
+ * Elements live in fixed size chunks that are never moved or freed while
+ * the arena lives, so a view stays valid without any lock. A writer
+ * reserves a contiguous range with a CAS on the tail, copies the vector
+ * in and then publishes (range, size) to the docid with one release
+ * store, readers load it with acquire. Several writers may append at
+ * once, a docid written again points to its new range.
+ *
+ * Views are handed out without a lock, so the old range of a docid written
+ * again is never reused while the arena lives, save() frees nothing and
+ * only load() releases it. To bound that garbage, appending the vector a
+ * docid already has is a no-op, and garbage() tells how many elements are
+ * held by replaced vectors.
+ *
+ * save() writes the live vectors compacted as one CSR file:
+ *
+ *   Header        magic, version, crc32, docid and element number
+ *   uint64_t[]    docNum + 1 offsets into the elements
+ *   Element[]     all vectors back to back, aligned to ALIGNMENT bytes
+ *
+ * written to "filename.tmp" and renamed like a LaserModelFile. load() maps
+ * it read-only as the base segment, later appends shadow the base one
+ * docid at a time.
+ */
+class AdVectorArena : boost::noncopyable
+{
+public:
+    typedef AdVectorView::Element Element;
+
+    const static uint32_t MAGIC = 0x4153524c; // "LRSA"
+    const static uint32_t VERSION = 1;
+    const static std::size_t ALIGNMENT = 64;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t checksum;
+        uint32_t reserved;
+        uint64_t docNum;
+        uint64_t elementNum;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+        char padding[16];
+    };
+
+public:
+    AdVectorArena();
+    ~AdVectorArena();
+
+public:
+    // false when vec is longer than a chunk
+    bool append(const docid_t docid, const std::vector<Element>& vec);
+
+    // an empty view for docids never appended
+    bool get(const docid_t docid, AdVectorView& view) const;
+
+    // elements of appended vectors that were replaced, held until load()
+    uint64_t garbage() const
+    {
+        return garbage_.load(boost::memory_order_relaxed);
+    }
+
+    // one past the largest docid appended or loaded
+    docid_t size() const
+    {
+        return docNum_.load(boost::memory_order_acquire);
+    }
+
+    // safe under concurrent appends, a vector appended meanwhile may or
+    // may not be in the file
+    bool save(const std::string& filename) const;
+
+    // must not run concurrently with any other call
+    bool load(const std::string& filename);
+
+private:
+    bool reserve(const std::size_t n, uint64_t& start);
+    Element* at(uint64_t pos) const;
+    boost::atomic<uint64_t>* slot(const docid_t docid, bool create);
+    const boost::atomic<uint64_t>* slot(const docid_t docid) const;
+    void unmap();
+
+private:
+    const static std::size_t CHUNK_BITS = 20;
+    const static std::size_t CHUNK_SIZE = 1 << CHUNK_BITS;
+    const static std::size_t MAX_CHUNK_NUM = 1 << 16;
+    const static std::size_t SLOT_BITS = 16;
+    const static std::size_t SLOT_CHUNK_SIZE = 1 << SLOT_BITS;
+    const static std::size_t MAX_SLOT_CHUNK_NUM = 1 << 16;
+
+    // element chunks, allocated on demand
+    boost::atomic<Element*>* chunks_;
+    boost::atomic<uint64_t> tail_;
+    // docid -> PUBLISHED | start << SIZE_BITS | size, 0 when not appended
+    boost::atomic<boost::atomic<uint64_t>*>* slots_;
+    boost::atomic<docid_t> docNum_;
+    boost::atomic<uint64_t> garbage_;
+
+    // the mapped base segment
+    const char* addr_;
+    std::size_t mapSize_;
+    std::size_t baseDocNum_;
+    const uint64_t* baseOffset_;
+    const Element* baseData_;
+};
+
+} }
+#endif
@@ -0,0 +1,348 @@
+#include "CentroidMatrix.h"
+#include <glog/logging.h>
+#include <smmintrin.h>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cmath>
+
+namespace sf1r { namespace laser {
+
+namespace
+{
+const std::size_t KMEANS_ITERATION = 5;
+
+std::size_t padding(std::size_t n)
+{
+    return (n + 3) / 4 * 4;
+}
+
+bool greaterSpread(const std::pair<std::pair<int, float>, float>& lv,
+    const std::pair<std::pair<int, float>, float>& rv)
+{
+    return lv.second > rv.second;
+}
+
+// the largest and the second largest of the lanes kept by scan()
+void top2(const __m128 m1, const __m128 m2, float& first, float& second)
+{
+    float lane1[4];
+    float lane2[4];
+    _mm_storeu_ps(lane1, m1);
+    _mm_storeu_ps(lane2, m2);
+    std::size_t top = std::max_element(lane1, lane1 + 4) - lane1;
+    first = lane1[top];
+    second = lane2[top];
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        if (i != top)
+        {
+            second = std::max(second, lane1[i]);
+        }
+    }
+}
+}
+
+// query terms in scan order, with the bounds of what the remaining terms
+// can still add to any centroid
+struct CentroidMatrix::Query
+{
+    std::vector<std::pair<int, float> > terms;
+    std::vector<float> upper;
+    std::vector<float> lower;
+};
+
+CentroidMatrix::CentroidMatrix(const std::vector<TokenVector>& centroids,
+    const std::size_t coarseNum,
+    const std::size_t probeNum)
+    : num_(centroids.size())
+    , dim_(0)
+    , stride_(0)
+    , coarse_(NULL)
+    , probeNum_(std::max(probeNum, (std::size_t)1))
+{
+    for (std::size_t i = 0; i < num_; ++i)
+    {
+        dim_ = std::max(dim_, centroids[i].size());
+    }
+    if (coarseNum > 1 && coarseNum < num_)
+    {
+        buildCoarse(centroids, coarseNum);
+    }
+    else
+    {
+        std::vector<std::size_t> cell(num_, 0);
+        build(centroids, cell);
+    }
+}
+
+CentroidMatrix::~CentroidMatrix()
+{
+    if (NULL != coarse_)
+    {
+        delete coarse_;
+        coarse_ = NULL;
+    }
+}
+
+void CentroidMatrix::build(const std::vector<TokenVector>& centroids,
+    const std::vector<std::size_t>& cell)
+{
+    const std::size_t cellNum = cell.empty() ? 1 : *std::max_element(cell.begin(), cell.end()) + 1;
+    std::vector<std::size_t> cellSize(cellNum, 0);
+    for (std::size_t i = 0; i < cell.size(); ++i)
+    {
+        ++cellSize[cell[i]];
+    }
+    cellOffset_.assign(1, 0);
+    for (std::size_t c = 0; c < cellNum; ++c)
+    {
+        cellOffset_.push_back(cellOffset_.back() + padding(cellSize[c]));
+    }
+    stride_ = cellOffset_.back();
+
+    order_.assign(stride_, (std::size_t)-1);
+    data_.assign(dim_ * stride_, 0);
+    // padding columns are 0, so are the bounds at least
+    rowMax_.assign(dim_, 0);
+    rowMin_.assign(dim_, 0);
+    std::vector<std::size_t> next(cellOffset_.begin(), cellOffset_.end() - 1);
+    for (std::size_t i = 0; i < num_; ++i)
+    {
+        const std::size_t col = next[cell[i]]++;
+        order_[col] = i;
+        const TokenVector& centroid = centroids[i];
+        for (std::size_t t = 0; t < centroid.size(); ++t)
+        {
+            if (0 != centroid[t])
+            {
+                data_[t * stride_ + col] = centroid[t];
+                rowMax_[t] = std::max(rowMax_[t], centroid[t]);
+                rowMin_[t] = std::min(rowMin_[t], centroid[t]);
+            }
+        }
+    }
+}
+
+void CentroidMatrix::buildCoarse(const std::vector<TokenVector>& centroids, const std::size_t coarseNum)
+{
+    LOG(INFO)<<"build coarse quantizer, "<<num_<<" centroids into "<<coarseNum<<" cells";
+    std::vector<TokenSparseVector> sparse(num_);
+    for (std::size_t i = 0; i < num_; ++i)
+    {
+        for (std::size_t t = 0; t < centroids[i].size(); ++t)
+        {
+            if (0 != centroids[i][t])
+            {
+                sparse[i].push_back(std::make_pair(t, centroids[i][t]));
+            }
+        }
+    }
+
+    // k-means over the centroids, seeded with evenly spaced ones
+    std::vector<TokenVector> coarse(coarseNum);
+    std::vector<std::size_t> cell(num_);
+    for (std::size_t c = 0; c < coarseNum; ++c)
+    {
+        coarse[c] = centroids[c * num_ / coarseNum];
+        coarse[c].resize(dim_);
+    }
+    for (std::size_t i = 0; i < num_; ++i)
+    {
+        cell[i] = i * coarseNum / num_;
+    }
+    for (std::size_t iter = 0; iter < KMEANS_ITERATION; ++iter)
+    {
+        {
+            CentroidMatrix matrix(coarse);
+            for (std::size_t i = 0; i < num_; ++i)
+            {
+                const std::size_t c = matrix.assign(sparse[i]);
+                if ((std::size_t)-1 != c)
+                {
+                    cell[i] = c;
+                }
+            }
+        }
+        std::vector<std::size_t> count(coarseNum, 0);
+        for (std::size_t i = 0; i < num_; ++i)
+        {
+            ++count[cell[i]];
+        }
+        for (std::size_t c = 0; c < coarseNum; ++c)
+        {
+            // an empty cell keeps its old center
+            if (0 != count[c])
+            {
+                std::fill(coarse[c].begin(), coarse[c].end(), 0);
+            }
+        }
+        for (std::size_t i = 0; i < num_; ++i)
+        {
+            const float norm = 1.0 / count[cell[i]];
+            TokenVector& center = coarse[cell[i]];
+            for (std::size_t k = 0; k < sparse[i].size(); ++k)
+            {
+                center[sparse[i][k].first] += sparse[i][k].second * norm;
+            }
+        }
+    }
+
+    build(centroids, cell);
+    coarse_ = new CentroidMatrix(coarse);
+}
+
+void CentroidMatrix::prepare(const TokenSparseVector& v, Query& query) const
+{
+    std::vector<std::pair<std::pair<int, float>, float> > terms;
+    terms.reserve(v.size());
+    for (std::size_t i = 0; i < v.size(); ++i)
+    {
+        const int t = v[i].first;
+        if (t < 0 || (std::size_t)t >= dim_ || 0 == v[i].second)
+        {
+            continue;
+        }
+        terms.push_back(std::make_pair(v[i], std::fabs(v[i].second) * (rowMax_[t] - rowMin_[t])));
+    }
+    // the terms that move the scores most go first
+    std::sort(terms.begin(), terms.end(), greaterSpread);
+
+    const std::size_t n = terms.size();
+    query.terms.resize(n);
+    query.upper.assign(n + 1, 0);
+    query.lower.assign(n + 1, 0);
+    for (std::size_t j = n; j > 0; --j)
+    {
+        const int t = terms[j - 1].first.first;
+        const float w = terms[j - 1].first.second;
+        query.terms[j - 1] = terms[j - 1].first;
+        query.upper[j - 1] = query.upper[j] + (w > 0 ? w * rowMax_[t] : w * rowMin_[t]);
+        query.lower[j - 1] = query.lower[j] + (w > 0 ? w * rowMin_[t] : w * rowMax_[t]);
+    }
+}
+
+std::size_t CentroidMatrix::scan(const Query& query,
+    const std::size_t begin,
+    const std::size_t end,
+    const bool earlyTerminate,
+    std::vector<float>& scores,
+    float& best) const
+{
+    float* s = &scores[begin];
+    const std::size_t n = end - begin;
+    std::fill(s, s + n, 0);
+    for (std::size_t j = 0; j < query.terms.size(); ++j)
+    {
+        const float* row = &data_[query.terms[j].first * stride_ + begin];
+        const __m128 w = _mm_set1_ps(query.terms[j].second);
+        if (!earlyTerminate || j + 1 == query.terms.size())
+        {
+            for (std::size_t i = 0; i < n; i += 4)
+            {
+                _mm_storeu_ps(s + i, _mm_add_ps(_mm_loadu_ps(s + i), _mm_mul_ps(w, _mm_loadu_ps(row + i))));
+            }
+            continue;
+        }
+
+        // track the two largest scores per lane on the way
+        __m128 m1 = _mm_set1_ps(-std::numeric_limits<float>::max());
+        __m128 m2 = m1;
+        for (std::size_t i = 0; i < n; i += 4)
+        {
+            const __m128 x = _mm_add_ps(_mm_loadu_ps(s + i), _mm_mul_ps(w, _mm_loadu_ps(row + i)));
+            _mm_storeu_ps(s + i, x);
+            m2 = _mm_max_ps(m2, _mm_min_ps(m1, x));
+            m1 = _mm_max_ps(m1, x);
+        }
+
+        // stop when the leader stays ahead whatever the other terms add
+        {
+            float first = 0;
+            float second = 0;
+            top2(m1, m2, first, second);
+            if (first + query.lower[j + 1] > 0 &&
+                first - second > query.upper[j + 1] - query.lower[j + 1])
+            {
+                break;
+            }
+        }
+    }
+
+    best = 0;
+    std::size_t bestCol = (std::size_t)-1;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        if (s[i] > best)
+        {
+            best = s[i];
+            bestCol = begin + i;
+        }
+    }
+    return bestCol;
+}
+
+std::size_t CentroidMatrix::assign(const TokenSparseVector& v) const
+{
+    if (NULL == coarse_)
+    {
+        return assignExact(v);
+    }
+    if (v.empty() || 0 == num_)
+    {
+        return -1;
+    }
+
+    Query coarseQuery;
+    coarse_->prepare(v, coarseQuery);
+    std::vector<float> cellScores(coarse_->stride_);
+    float best = 0;
+    coarse_->scan(coarseQuery, 0, coarse_->stride_, false, cellScores, best);
+    std::vector<std::pair<float, std::size_t> > cells;
+    for (std::size_t c = 0; c < coarse_->num_; ++c)
+    {
+        cells.push_back(std::make_pair(cellScores[c], c));
+    }
+    const std::size_t probeNum = std::min(probeNum_, cells.size());
+    std::partial_sort(cells.begin(), cells.begin() + probeNum, cells.end(),
+        std::greater<std::pair<float, std::size_t> >());
+
+    Query query;
+    prepare(v, query);
+    std::vector<float> scores(stride_);
+    float maxSim = 0;
+    std::size_t maxId = -1;
+    for (std::size_t k = 0; k < probeNum; ++k)
+    {
+        const std::size_t c = cells[k].second;
+        float sim = 0;
+        const std::size_t col = scan(query, cellOffset_[c], cellOffset_[c + 1], true, scores, sim);
+        if ((std::size_t)-1 != col && sim > maxSim)
+        {
+            maxSim = sim;
+            maxId = order_[col];
+        }
+    }
+    return maxId;
+}
+
+std::size_t CentroidMatrix::assignExact(const TokenSparseVector& v) const
+{
+    if (v.empty() || 0 == num_)
+    {
+        return -1;
+    }
+    Query query;
+    prepare(v, query);
+    std::vector<float> scores(stride_);
+    float best = 0;
+    // cells are scanned in one pass, the padding columns are never positive
+    const std::size_t col = scan(query, 0, stride_, true, scores, best);
+    if ((std::size_t)-1 == col)
+    {
+        return -1;
+    }
+    return order_[col];
+}
+
+} }
@@ -0,0 +1,80 @@
+#ifndef SF1R_LASER_CENTROID_MATRIX_H
+#define SF1R_LASER_CENTROID_MATRIX_H
+#include <vector>
+#include <cstddef>
+#include <boost/noncopyable.hpp>
+
+namespace sf1r { namespace laser {
+
+/*
+ * Clustering centroids stored term major: row t holds the weight of term t
+ * in every centroid, so the similarity of a sparse document against all
+ * the centroids is one SIMD axpy per document term.
+ *
+ * Terms are applied from the most to the least discriminative one, and the
+ * scan stops as soon as the remaining terms can't change the winner.
+ *
+ * With a coarse quantizer, the centroids are grouped into coarseNum cells
+ * by k-means and only the probeNum most similar cells are scanned. This is
+ * approximate, a document may miss its best centroid.
+ */
+class CentroidMatrix : boost::noncopyable
+{
+public:
+    typedef std::vector<std::pair<int, float> > TokenSparseVector;
+    typedef std::vector<float> TokenVector;
+
+    CentroidMatrix(const std::vector<TokenVector>& centroids,
+        const std::size_t coarseNum = 0,
+        const std::size_t probeNum = 1);
+    ~CentroidMatrix();
+
+public:
+    // the most similar centroid, -1 when no centroid has a positive similarity
+    std::size_t assign(const TokenSparseVector& v) const;
+
+    // scan every centroid, even with a coarse quantizer
+    std::size_t assignExact(const TokenSparseVector& v) const;
+
+    std::size_t size() const
+    {
+        return num_;
+    }
+
+    std::size_t dimension() const
+    {
+        return dim_;
+    }
+
+private:
+    struct Query;
+
+    void build(const std::vector<TokenVector>& centroids,
+        const std::vector<std::size_t>& order);
+    void buildCoarse(const std::vector<TokenVector>& centroids, const std::size_t coarseNum);
+    void prepare(const TokenSparseVector& v, Query& query) const;
+    std::size_t scan(const Query& query,
+        const std::size_t begin,
+        const std::size_t end,
+        const bool earlyTerminate,
+        std::vector<float>& scores,
+        float& best) const;
+
+private:
+    std::size_t num_;
+    std::size_t dim_;
+    // columns per row, every cell padded to a multiple of 4
+    std::size_t stride_;
+    std::vector<float> data_;
+    std::vector<float> rowMax_;
+    std::vector<float> rowMin_;
+    // column -> centroid id, -1 for padding
+    std::vector<std::size_t> order_;
+    // cell i owns the columns [cellOffset_[i], cellOffset_[i + 1])
+    std::vector<std::size_t> cellOffset_;
+    CentroidMatrix* coarse_;
+    const std::size_t probeNum_;
+};
+
+} }
+#endif
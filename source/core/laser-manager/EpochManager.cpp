@@ -0,0 +1,140 @@
+#include "EpochManager.h"
+#include <boost/thread/thread.hpp>
+#include <boost/functional/hash.hpp>
+
+namespace sf1r { namespace laser {
+
+const std::size_t EpochManager::SLOT_NUM;
+
+EpochManager::EpochManager()
+    : epoch_(1)
+    , slots_(NULL)
+{
+    slots_ = new Slot[SLOT_NUM];
+    for (std::size_t i = 0; i < SLOT_NUM; ++i)
+    {
+        slots_[i].epoch.store(0);
+    }
+}
+
+EpochManager::~EpochManager()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        for (std::size_t i = 0; i < retired_.size(); ++i)
+        {
+            retired_[i].second();
+        }
+        retired_.clear();
+    }
+    delete[] slots_;
+    slots_ = NULL;
+}
+
+std::size_t EpochManager::enter(uint64_t& epoch)
+{
+    static __thread std::size_t hint = (std::size_t)-1;
+    if ((std::size_t)-1 == hint)
+    {
+        hint = boost::hash<boost::thread::id>()(boost::this_thread::get_id()) % SLOT_NUM;
+    }
+    // a slot owned by another reader is skipped, so readers never wait
+    std::size_t i = hint;
+    for (std::size_t n = 0; n < SLOT_NUM; ++n, i = (i + 1) % SLOT_NUM)
+    {
+        uint64_t expected = 0;
+        epoch = epoch_.load();
+        if (slots_[i].epoch.compare_exchange_strong(expected, epoch))
+        {
+            hint = i;
+            return i;
+        }
+    }
+
+    boost::mutex::scoped_lock lock(overflowMutex_);
+    epoch = epoch_.load();
+    ++overflow_[epoch];
+    return SLOT_NUM;
+}
+
+void EpochManager::exit(std::size_t slot, uint64_t epoch)
+{
+    if (SLOT_NUM != slot)
+    {
+        slots_[slot].epoch.store(0, boost::memory_order_release);
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(overflowMutex_);
+    std::map<uint64_t, std::size_t>::iterator it = overflow_.find(epoch);
+    if (0 == --it->second)
+    {
+        overflow_.erase(it);
+    }
+}
+
+void EpochManager::retire(const boost::function<void()>& deleter)
+{
+    // the object was unpublished before, readers entering from now on
+    // get a newer epoch and can't reach it
+    const uint64_t epoch = epoch_.fetch_add(1);
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        retired_.push_back(std::make_pair(epoch, deleter));
+    }
+    reclaim();
+}
+
+void EpochManager::reclaim()
+{
+    uint64_t minEpoch = (uint64_t)-1;
+    for (std::size_t i = 0; i < SLOT_NUM; ++i)
+    {
+        const uint64_t epoch = slots_[i].epoch.load();
+        if (0 != epoch && epoch < minEpoch)
+        {
+            minEpoch = epoch;
+        }
+    }
+    {
+        boost::mutex::scoped_lock lock(overflowMutex_);
+        if (!overflow_.empty() && overflow_.begin()->first < minEpoch)
+        {
+            minEpoch = overflow_.begin()->first;
+        }
+    }
+
+    std::deque<std::pair<uint64_t, boost::function<void()> > > reclaimed;
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!retired_.empty() && retired_.front().first < minEpoch)
+        {
+            reclaimed.push_back(retired_.front());
+            retired_.pop_front();
+        }
+    }
+    for (std::size_t i = 0; i < reclaimed.size(); ++i)
+    {
+        reclaimed[i].second();
+    }
+}
+
+std::size_t EpochManager::retiredNum() const
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    return retired_.size();
+}
+
+std::size_t EpochManager::overflowNum() const
+{
+    boost::mutex::scoped_lock lock(overflowMutex_);
+    std::size_t num = 0;
+    for (std::map<uint64_t, std::size_t>::const_iterator it = overflow_.begin();
+         it != overflow_.end(); ++it)
+    {
+        num += it->second;
+    }
+    return num;
+}
+
+} }
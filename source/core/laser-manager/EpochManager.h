@@ -0,0 +1,111 @@
+#ifndef SF1R_LASER_EPOCH_MANAGER_H
+#define SF1R_LASER_EPOCH_MANAGER_H
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#include <util/singleton.h>
+#include <common/inttypes.h>
+#include <deque>
+#include <map>
+
+namespace sf1r { namespace laser {
+
+/*
+ * Epoch based reclamation for model data shared between the recommend
+ * threads and the update threads.
+ *
+ * Readers wrap every access in a ReadGuard, which pins the current epoch
+ * without taking any lock. Writers build the new object aside, publish it
+ * with an atomic pointer exchange and retire() the old one, which is only
+ * deleted when every reader that could still see it has left its guard.
+ *
+ * A reader pins its epoch in one of SLOT_NUM slots. When all of them are
+ * owned, by more concurrent readers or by nested guards, it pins the epoch
+ * in an overflow map under a mutex instead of waiting for a free slot.
+ */
+class EpochManager : boost::noncopyable
+{
+public:
+    class ReadGuard : boost::noncopyable
+    {
+    public:
+        explicit ReadGuard(EpochManager& manager)
+            : manager_(manager)
+            , epoch_(0)
+            , slot_(manager.enter(epoch_))
+        {
+        }
+
+        ~ReadGuard()
+        {
+            manager_.exit(slot_, epoch_);
+        }
+
+    private:
+        EpochManager& manager_;
+        uint64_t epoch_;
+        const std::size_t slot_;
+    };
+
+public:
+    const static std::size_t SLOT_NUM = 256;
+
+    EpochManager();
+    ~EpochManager();
+
+    static EpochManager* get()
+    {
+        return izenelib::util::Singleton<EpochManager>::get();
+    }
+
+public:
+    template <typename T> void retire(T* ptr)
+    {
+        if (NULL != ptr)
+        {
+            retire(boost::function<void()>(Deleter<T>(ptr)));
+        }
+    }
+
+    void retire(const boost::function<void()>& deleter);
+
+    // delete the retired objects no reader can reach any more
+    void reclaim();
+
+    std::size_t retiredNum() const;
+
+    // the number of readers pinned in the overflow map
+    std::size_t overflowNum() const;
+
+private:
+    template <typename T> struct Deleter
+    {
+        explicit Deleter(T* ptr) : ptr_(ptr) {}
+        void operator()() const { delete ptr_; }
+        T* ptr_;
+    };
+
+    // keep each slot in its own cache line
+    struct Slot
+    {
+        boost::atomic<uint64_t> epoch;
+        char padding[64 - sizeof(boost::atomic<uint64_t>)];
+    };
+
+    // returns the slot, or SLOT_NUM if @p epoch is pinned in the overflow map
+    std::size_t enter(uint64_t& epoch);
+    void exit(std::size_t slot, uint64_t epoch);
+
+private:
+    boost::atomic<uint64_t> epoch_;
+    Slot* slots_;
+    mutable boost::mutex mutex_;
+    std::deque<std::pair<uint64_t, boost::function<void()> > > retired_;
+    mutable boost::mutex overflowMutex_;
+    // epoch => reader number
+    std::map<uint64_t, std::size_t> overflow_;
+};
+
+} }
+#endif
@@ -0,0 +1,86 @@
+#ifndef SF1R_LASER_EPOCH_ROW_TABLE_H
+#define SF1R_LASER_EPOCH_ROW_TABLE_H
+#include "EpochManager.h"
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <vector>
+
+namespace sf1r { namespace laser {
+
+/*
+ * A fixed size table of model rows, updated one row at a time while the
+ * recommend threads read it.
+ *
+ * The loaded rows are never written after construction. update() builds
+ * the new row aside and publishes it with an atomic pointer exchange, the
+ * row it replaces is retired to the EpochManager, so a reader holding a
+ * ReadGuard always sees a whole row, either the old or the new one.
+ *
+ * To change the number of rows, copyTo() a vector, resize it and publish
+ * a new table as a whole.
+ */
+template <typename T>
+class EpochRowTable : boost::noncopyable
+{
+public:
+    // take over the content of rows
+    explicit EpochRowTable(std::vector<T>& rows)
+        : updated_(new boost::atomic<const T*>[rows.size()])
+    {
+        rows_.swap(rows);
+        for (std::size_t i = 0; i < rows_.size(); ++i)
+        {
+            updated_[i].store(NULL, boost::memory_order_relaxed);
+        }
+    }
+
+    ~EpochRowTable()
+    {
+        for (std::size_t i = 0; i < rows_.size(); ++i)
+        {
+            delete updated_[i].load(boost::memory_order_relaxed);
+        }
+    }
+
+public:
+    std::size_t size() const
+    {
+        return rows_.size();
+    }
+
+    bool empty() const
+    {
+        return rows_.empty();
+    }
+
+    const T& operator[](std::size_t i) const
+    {
+        const T* row = updated_[i].load(boost::memory_order_acquire);
+        return NULL != row ? *row : rows_[i];
+    }
+
+    void update(std::size_t i, const T& row)
+    {
+        const T* old = updated_[i].exchange(new T(row), boost::memory_order_acq_rel);
+        EpochManager::get()->retire(old);
+    }
+
+    void copyTo(std::vector<T>& rows) const
+    {
+        rows.clear();
+        rows.reserve(rows_.size());
+        for (std::size_t i = 0; i < rows_.size(); ++i)
+        {
+            rows.push_back((*this)[i]);
+        }
+    }
+
+private:
+    std::vector<T> rows_;
+    // the rows replaced since construction, NULL if not updated
+    boost::scoped_array<boost::atomic<const T*> > updated_;
+};
+
+} }
+#endif
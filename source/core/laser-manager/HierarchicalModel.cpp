@@ -1,6 +1,7 @@
 #include "HierarchicalModel.h"
 #include "LaserOnlineModel.h"
 #include "LaserOfflineModel.h"
+#include "LaserModelFile.h"
 #include "AdIndexManager.h"
 #include <util/functional.h>
 #include <algorithm>    // std::sort
@@ -32,17 +33,20 @@ HierarchicalModel::HierarchicalModel(const AdIndexManager& adIndexer,
 
     std::vector<float> vec(USER_FD_);
     LaserOnlineModel initModel(0.0, vec);
-    pClusteringDb_ = new std::vector<LaserOnlineModel>(clusteringDimension_, initModel);
+    std::vector<LaserOnlineModel> clusteringDb(clusteringDimension_, initModel);
     LOG(INFO)<<"clustering dimension = "<<clusteringDimension_;
-    if (boost::filesystem::exists(workdir_ + "per-clustering-online-model"))
+    if (boost::filesystem::exists(workdir_ + "/per-clustering-online-model.bin") ||
+        !legacyModelPath(workdir_, "per-clustering-online-model").empty())
     {
-        load();
+        load(clusteringDb);
+        pClusteringDb_ = new OnlineModelTable(clusteringDb);
     }
     else
     {
         LOG(INFO)<<"init per-item-online-model from OrigModel, since localized model doesn't exist. \
             This procedure may be slow, be patient";
-        localizeFromOrigModel();
+        localizeFromOrigModel(clusteringDb);
+        pClusteringDb_ = new OnlineModelTable(clusteringDb);
         LOG(INFO)<<"save model to local";
         save();
     }
@@ -60,7 +64,6 @@ HierarchicalModel::HierarchicalModel(const AdIndexManager& adIndexer,
         (*pClusteringDb_)[i] = onlineModel;
     }
     */
-    save();
 }
 
 HierarchicalModel::~HierarchicalModel()
@@ -84,10 +87,10 @@ bool HierarchicalModel::candidate(
     typedef std::priority_queue<std::pair<size_t, float>, std::vector<std::pair<std::size_t, float> >, greater_than> priority_queue;
     static const std::pair<docid_t, std::vector<std::pair<int, float> > > perAd;
     priority_queue queue;
-    std::vector<LaserOnlineModel>::const_iterator it = pClusteringDb_->begin();
-    for (std::size_t i = 0; it != pClusteringDb_->end(); ++it, ++i)
+    const OnlineModelTable& clusteringDb = *pClusteringDb_;
+    for (std::size_t i = 0; i < clusteringDb.size(); ++i)
     {
-        float score = it->score(text, context, perAd, (float)0.0);
+        float score = clusteringDb[i].score(text, context, perAd, (float)0.0);
         if (queue.size() < 1024)
         {
             queue.push(std::make_pair(i, score));
@@ -139,10 +142,10 @@ bool HierarchicalModel::candidate(
     typedef std::priority_queue<std::pair<size_t, float>, std::vector<std::pair<std::size_t, float> >, greater_than> priority_queue;
     static const std::pair<docid_t, std::vector<std::pair<int, float> > > perAd;
     priority_queue queue;
-    std::vector<LaserOnlineModel>::const_iterator it = pClusteringDb_->begin();
-    for (std::size_t i = 0; it != pClusteringDb_->end(); ++it, ++i)
+    const OnlineModelTable& clusteringDb = *pClusteringDb_;
+    for (std::size_t i = 0; i < clusteringDb.size(); ++i)
     {
-        float score = it->score(text, context, perAd, (float)0.0);
+        float score = clusteringDb[i].score(text, context, perAd, (float)0.0);
         if (queue.size() < 1024)
         {
             queue.push(std::make_pair(i, score));
@@ -215,55 +218,58 @@ void HierarchicalModel::updatepClusteringDb(msgpack::rpc::request& req)
     std::size_t clusteringId = 0;
     ss >> clusteringId;
     //LOG(INFO)<<clusteringId;
-    if (params.get<1>().eta().size() != USER_FD_)
+    if (params.get<1>().eta().size() != USER_FD_ ||
+        clusteringId >= pClusteringDb_->size())
     {
         LOG(ERROR)<<"Dimension Mismatch";
         req.result(false);
     }
     else
     {
-        (*pClusteringDb_)[clusteringId] =  params.get<1>();
+        // swap the row, recommend threads may still read the old one
+        pClusteringDb_->update(clusteringId, params.get<1>());
         req.result(true);
     }
 }
 
 void HierarchicalModel::save()
 {
-    std::ofstream ofs((workdir_ + "/per-clustering-online-model").c_str(), std::ofstream::binary | std::ofstream::trunc);
-    boost::archive::binary_oarchive oa(ofs);
-    try
+    std::vector<LaserOnlineModel> clusteringDb;
+    pClusteringDb_->copyTo(clusteringDb);
+    LaserModelFileWriter writer(workdir_ + "/per-clustering-online-model.bin");
+    writer.addSection(clusteringDb);
+    if (!writer.commit())
     {
-        oa << *pClusteringDb_;
+        LOG(ERROR)<<"save per-clustering-online-model failed";
     }
-    catch(std::exception& e)
-    {
-        LOG(INFO)<<e.what();
-    }
-    ofs.close();
 }
 
-void HierarchicalModel::load()
+void HierarchicalModel::load(std::vector<LaserOnlineModel>& clusteringDb)
 {
-    std::ifstream ifs((workdir_ + "/per-clustering-online-model").c_str(), std::ios::binary);
-    boost::archive::binary_iarchive ia(ifs);
-    try
+    LaserModelFileReader reader;
+    if (reader.open(workdir_ + "/per-clustering-online-model.bin") && reader.load(0, clusteringDb))
     {
-        ia >> *pClusteringDb_;
+        return;
     }
-    catch(std::exception& e)
+    // fall back to the boost::archive format of older versions
+    const std::string legacyPath = legacyModelPath(workdir_, "per-clustering-online-model");
+    if (legacyPath.empty())
     {
-        LOG(INFO)<<e.what();
+        return;
     }
-    ifs.close();
+    LOG(INFO)<<"load per-clustering-online-model from legacy archive "<<legacyPath;
+    loadLegacyModel(legacyPath, clusteringDb);
 }
     
 void HierarchicalModel::saveOrigModel()
 {
+    std::vector<LaserOnlineModel> clusteringDb;
+    pClusteringDb_->copyTo(clusteringDb);
     std::ofstream ofs((sysdir_ + "/orig-per-clustering-online-model").c_str(), std::ofstream::binary | std::ofstream::trunc);
     boost::archive::binary_oarchive oa(ofs);
     try
     {
-        oa << *pClusteringDb_;
+        oa << clusteringDb;
     }
     catch(std::exception& e)
     {
@@ -272,7 +278,7 @@ void HierarchicalModel::saveOrigModel()
     ofs.close();
 }
 
-void HierarchicalModel::localizeFromOrigModel()
+void HierarchicalModel::localizeFromOrigModel(std::vector<LaserOnlineModel>& clusteringDb)
 {
     const std::string orig = sysdir_ + "/orig-per-clustering-online-model";
     if (!boost::filesystem::exists(orig))
@@ -284,7 +290,7 @@ void HierarchicalModel::localizeFromOrigModel()
     boost::archive::binary_iarchive ia(ifs);
     try
     {
-        ia >> *pClusteringDb_;
+        ia >> clusteringDb;
     }
     catch(std::exception& e)
     {
@@ -32,19 +32,25 @@ public:
         std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
         std::vector<float>& score) const;
     
+    virtual bool isSharedCandidate() const
+    {
+        return false;
+    }
+
     virtual void dispatch(const std::string& method, msgpack::rpc::request& req);
 
 private:
     void updatepClusteringDb(msgpack::rpc::request& req);
     void save();
-    void load();
+    void load(std::vector<LaserOnlineModel>& clusteringDb);
     void saveOrigModel();
-    void localizeFromOrigModel();
+    void localizeFromOrigModel(std::vector<LaserOnlineModel>& clusteringDb);
 private:
     const std::string workdir_;
     const std::string sysdir_;
     const std::size_t clusteringDimension_;
-    std::vector<LaserOnlineModel>* pClusteringDb_;
+    // rows swapped on update, see EpochRowTable
+    OnlineModelTable* pClusteringDb_;
 };
 } }
 #endif
@@ -2,6 +2,7 @@
 #include "AdIndexManager.h"
 #include "LaserOnlineModel.h"
 #include "LaserOfflineModel.h"
+#include "EpochManager.h"
 #include <math.h>
 
 namespace sf1r { namespace laser {
@@ -43,19 +44,21 @@ LSHIndexModel::LSHIndexModel(const AdIndexManager& adIndexer,
     }
     else
     {
+        // an empty index finds no candidate until the next model update
         lsh_ = createLshIndex();
+        if (!adDb().empty())
+        {
+            buildLshIndex(lsh_);
+            save();
+        }
     }
-    //lsh_ = createLshIndex();
-    //buildLshIndex(lsh_);
-    //save();
 }
 
 LSHIndexModel::~LSHIndexModel()
 {
     if (NULL != lsh_)
     {
-        delete lsh_;
-        lsh_ = NULL;
+        delete lsh_.exchange(NULL);
     }
 }
 
@@ -98,14 +101,9 @@ bool LSHIndexModel::candidate(
         *thisRow = 0.5;
         ++thisRow;
     }
-    boost::shared_lock<boost::shared_mutex> sharedLock(mtx_, boost::try_to_lock);
-    if (!sharedLock)
-    {
-        delete query;
-        return false;
-    }
-    lsh_->query(query, scanner);
-    delete query;
+    // the caller holds an EpochManager::ReadGuard, lsh_ stays alive
+    lsh_.load(boost::memory_order_acquire)->query(query, scanner);
+    delete[] query;
     score.assign(ad.size(), 0);
     return true;
 }
@@ -117,11 +115,7 @@ void LSHIndexModel::dispatch(const std::string& method, msgpack::rpc::request& r
     {
         LshIndex* lsh = createLshIndex();
         buildLshIndex(lsh);
-        { 
-            boost::unique_lock<boost::shared_mutex> uniqueLock(mtx_);
-            std::swap(lsh_, lsh);
-        }
-        delete lsh;
+        EpochManager::get()->retire(lsh_.exchange(lsh));
         save();
     }
 
@@ -161,10 +155,10 @@ void LSHIndexModel::buildLshIndex(LshIndex* lsh)
 
 void LSHIndexModel::buildLshIndex(LshIndex* lsh, std::size_t threadId)
 {
-    const std::vector<LaserOnlineModel>* data = pAdDb_;
+    const OnlineModelTable* data = pAdDb_;
     const std::vector<float>* alpha = offlineModel_->alpha();
-    const std::vector<float>* betaStable = offlineModel_->betaStable();
-    const std::vector<std::vector<float> >* conjunctionStable = offlineModel_->conjunctionStable();
+    const EpochRowTable<float>* betaStable = offlineModel_->betaStable();
+    const EpochRowTable<std::vector<float> >* conjunctionStable = offlineModel_->conjunctionStable();
     if (NULL == data || data->empty())
         return;
 
@@ -198,20 +192,20 @@ void LSHIndexModel::buildLshIndex(LshIndex* lsh, std::size_t threadId)
         }
         lsh->insert(i, row);
     }
-    delete row;
+    delete[] row;
 }
 
 void LSHIndexModel::save()
 {
     std::ofstream ofs((workdir_ + "/lsh-index-model").c_str(), std::ofstream::binary | std::ofstream::trunc);
-    lsh_->save(ofs);
+    lsh_.load()->save(ofs);
     ofs.close();
 }
 
 void LSHIndexModel::load()
 {
     std::ifstream ifs((workdir_ + "/lsh-index-model").c_str(), std::ios::binary);
-    lsh_->load(ifs);
+    lsh_.load()->load(ifs);
     ifs.close();
 }
     
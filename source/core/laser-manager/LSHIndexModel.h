@@ -70,6 +70,11 @@ public:
         std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
         std::vector<float>& score) const;
     
+    virtual bool isSharedCandidate() const
+    {
+        return false;
+    }
+
     virtual void dispatch(const std::string& method, msgpack::rpc::request& req);
 
 private:
@@ -82,10 +87,9 @@ private:
     void localizeFromOrigModel();
 private:
     const std::string workdir_;
-    LshIndex* lsh_;
+    boost::atomic<LshIndex*> lsh_;
     const int LSH_DIM_;
     const int ALSH_DIM_;
-    mutable boost::shared_mutex mtx_;
 };
 } }
 #endif
@@ -1,7 +1,9 @@
 #include "LaserGenericModel.h"
 #include "LaserOnlineModel.h"
 #include "LaserOfflineModel.h"
+#include "LaserModelFile.h"
 #include "AdIndexManager.h"
+#include "EpochManager.h"
 #include "SparseVector.h"
 #include "context/KVClient.h"
 #include "context/MQClient.h"
@@ -70,23 +72,26 @@ LaserGenericModel::LaserGenericModel(const AdIndexManager& adIndexer,
     
     LOG(INFO)<<"open per-item-online-model...";
     LOG(INFO)<<"AD Feature Dimension = "<<AD_FD_<<", USER Feature Dimension = "<<USER_FD_;
-    if (boost::filesystem::exists(workdir_ + "/per-item-online-model"))
+    if (boost::filesystem::exists(workdir_ + "/per-item-online-model.bin") ||
+        !legacyModelPath(workdir_, "per-item-online-model").empty())
     {
-        pAdDb_ = new std::vector<LaserOnlineModel>();
-        load();
+        std::vector<LaserOnlineModel> adDb;
+        load(adDb);
+        pAdDb_ = new OnlineModelTable(adDb);
     }
     else
     {
         std::vector<float> vec(USER_FD_);
         LaserOnlineModel initModel(0.0, vec);
-        pAdDb_ = new std::vector<LaserOnlineModel>(adDimension_, initModel);
+        std::vector<LaserOnlineModel> adDb(adDimension_, initModel);
         LOG(INFO)<<"init per-item-online-model from OrigModel, since localized model doesn't exist. \
             This procedure may be slow, be patient";
-        localizeFromOrigModel();
+        localizeFromOrigModel(adDb);
+        pAdDb_ = new OnlineModelTable(adDb);
         LOG(INFO)<<"save model to local";
         save();
     }
-    LOG(INFO)<<"per-item-online-model size = "<<pAdDb_->size();
+    LOG(INFO)<<"per-item-online-model size = "<<adDb().size();
     /*
     std::vector<float> vec(USER_FD_);
     LaserOnlineModel initModel(0.0, vec);
@@ -109,7 +114,7 @@ LaserGenericModel::LaserGenericModel(const AdIndexManager& adIndexer,
     LOG(INFO)<<"open offline-model";
     offlineModel_ = new LaserOfflineModel(adIndexer_, workdir_ + "/offline-model", sysdir_, adDimension_, AD_FD_, USER_FD_);
     
-    kvclient_ = new context::KVClient(kvaddr, kvport);
+    kvclient_ = new context::KVClient(kvaddr, kvport, USER_FD_);
     mqclient_ = new context::MQClient(mqaddr, mqport);
 
 }
@@ -123,8 +128,7 @@ LaserGenericModel::~LaserGenericModel()
     }
     if (NULL != pAdDb_)
     {
-        delete pAdDb_;
-        pAdDb_ = NULL;
+        delete pAdDb_.exchange(NULL);
     }
     if (NULL != offlineModel_)
     {
@@ -147,9 +151,18 @@ LaserGenericModel::~LaserGenericModel()
     
 void LaserGenericModel::updateAdDimension(const std::size_t adDimension)
 {
+    // the offline model precomputes out of updateMutex_, so that the online
+    // updates go on meanwhile
+    boost::mutex::scoped_lock dimensionLock(dimensionMutex_);
+    offlineModel_->updateAdDimension(adDimension);
+
+    boost::mutex::scoped_lock lock(updateMutex_);
     adDimension_ = adDimension;
-    offlineModel_->updateAdDimension(adDimension_);
-    pAdDb_->resize(adDimension_);
+    // copy on write, recommend threads may still read the old one
+    std::vector<LaserOnlineModel> adDb;
+    this->adDb().copyTo(adDb);
+    adDb.resize(adDimension_);
+    EpochManager::get()->retire(pAdDb_.exchange(new OnlineModelTable(adDb)));
 }
     
 
@@ -219,12 +232,13 @@ float LaserGenericModel::score(
     const float score) const
 {
     float ret = score;
-    if (ad.first > adDimension_)
+    const OnlineModelTable& adDb = this->adDb();
+    if (ad.first >= adDb.size())
     {
         return ret;
     }
     static const std::pair<docid_t, std::vector<std::pair<int, float> > > perAd;
-    ret += (*pAdDb_)[ad.first].score(text, user, perAd, 0);
+    ret += adDb[ad.first].score(text, user, perAd, 0);
     {
         ret += offlineModel_->score(text, user, ad, 0);
     }
@@ -238,18 +252,122 @@ float LaserGenericModel::score(
     const float score) const
 {
     float ret = score;
-    if (ad.first > adDimension_)
+    const OnlineModelTable& adDb = this->adDb();
+    if (ad.first >= adDb.size())
     {
         return ret;
     }
     static const std::pair<docid_t, std::vector<std::pair<int, float> > > perAd;
-    ret += (*pAdDb_)[ad.first].score(text, user, perAd, 0);
+    ret += adDb[ad.first].score(text, user, perAd, 0);
     {
         ret += offlineModel_->score(text, user, ad, 0);
     }
     return ret;
 }
     
+void LaserGenericModel::score(
+    const std::vector<std::string>& text,
+    const std::vector<std::vector<float> >& context, 
+    const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+    const std::vector<std::size_t>& offset,
+    const std::vector<std::size_t>& user,
+    std::vector<float>& score) const
+{
+    const OnlineModelTable& adDb = this->adDb();
+    const std::vector<float>& alpha = *offlineModel_->alpha();
+    const EpochRowTable<float>& betaStable = *offlineModel_->betaStable();
+    const EpochRowTable<std::vector<float> >& conjunctionStable = *offlineModel_->conjunctionStable();
+
+    // x * alpha doesn't depend on the ad, once per user
+    std::vector<float> userScore(context.size(), 0);
+    for (std::size_t u = 0; u < context.size(); ++u)
+    {
+        if (!context[u].empty())
+        {
+            userScore[u] = dot(alpha, context[u]);
+        }
+    }
+
+    // each ad row is loaded once and scored against all its users
+    std::vector<float> weight;
+    for (std::size_t i = 0; i < ad.size(); ++i)
+    {
+        const docid_t adId = ad[i].first;
+        if (adId >= adDb.size())
+        {
+            continue;
+        }
+        const LaserOnlineModel& onlineModel = adDb[adId];
+        float adScore = onlineModel.delta();
+        const std::vector<float>* conjunction = NULL;
+        if (adId < betaStable.size())
+        {
+            adScore += betaStable[adId];
+            if (adId < conjunctionStable.size())
+            {
+                conjunction = &conjunctionStable[adId];
+            }
+        }
+        
+        // eta + A * c, one dot per user instead of two
+        const std::vector<float>* w = &onlineModel.eta();
+        if (NULL != conjunction && conjunction->size() == w->size() && offset[i + 1] - offset[i] > 1)
+        {
+            weight.resize(w->size());
+            for (std::size_t k = 0; k < weight.size(); ++k)
+            {
+                weight[k] = (*w)[k] + (*conjunction)[k];
+            }
+            w = &weight;
+            conjunction = NULL;
+        }
+        
+        // four users at a time, the ad row is read once per block
+        std::size_t k = offset[i];
+        for (; k + 4 <= offset[i + 1]; k += 4)
+        {
+            const float* x[4];
+            bool dense = true;
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                const std::vector<float>& ctx = context[user[k + j]];
+                dense = dense && ctx.size() == w->size();
+                x[j] = ctx.data();
+            }
+            if (!dense)
+            {
+                break;
+            }
+            float res[4];
+            dot4(w->data(), x, w->size(), res);
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                float ret = score[k + j] + adScore + userScore[user[k + j]] + res[j];
+                if (NULL != conjunction)
+                {
+                    ret += dot(*conjunction, context[user[k + j]]);
+                }
+                score[k + j] = ret;
+            }
+        }
+        for (; k < offset[i + 1]; ++k)
+        {
+            const std::vector<float>& x = context[user[k]];
+            if (x.empty())
+            {
+                score[k] = this->score(text[user[k]], x, ad[i], score[k]);
+                continue;
+            }
+            float ret = score[k] + adScore + userScore[user[k]] + dot(*w, x);
+            if (NULL != conjunction)
+            {
+                ret += dot(*conjunction, x);
+            }
+            score[k] = ret;
+        }
+    }
+}
+    
 void LaserGenericModel::dispatch(const std::string& method, msgpack::rpc::request& req)
 {
     if ("update_online_model" == method)
@@ -266,7 +384,7 @@ void LaserGenericModel::dispatch(const std::string& method, msgpack::rpc::reques
         AdFeature ad;
         ad.adId() = adIndex_;
 
-        std::vector<std::pair<int, float> > vec;
+        AdVectorView vec;
         docid_t docid = adIndex_;
         adIndexer_.get(docid, vec);
         std::vector<int>& index = ad.index();
@@ -316,50 +434,57 @@ void LaserGenericModel::updatepAdDb(msgpack::rpc::request& req)
     docid_t adid = 0;
     if (adIndexer_.convertDocId(DOCID, adid))
     {
-        (*pAdDb_)[adid] = model;
+        // swap the row, recommend threads may still read the old one
+        boost::mutex::scoped_lock lock(updateMutex_);
+        if (adid < adDb().size())
+        {
+            pAdDb_.load(boost::memory_order_acquire)->update(adid, model);
+        }
     }
     req.result(true);
 }
     
-void LaserGenericModel::load()
+void LaserGenericModel::load(std::vector<LaserOnlineModel>& adDb)
 {
-    std::ifstream ifs((workdir_ + "per-item-online-model").c_str(), std::ios::binary);
-    boost::archive::binary_iarchive ia(ifs);
-    try
+    LaserModelFileReader reader;
+    if (reader.open(workdir_ + "/per-item-online-model.bin") && reader.load(0, adDb))
     {
-        ia >> *pAdDb_;
+        return;
     }
-    catch(std::exception& e)
+    // fall back to the boost::archive format of older versions
+    const std::string legacyPath = legacyModelPath(workdir_, "per-item-online-model");
+    if (legacyPath.empty())
     {
-        LOG(INFO)<<e.what();
+        return;
     }
-    ifs.close();
+    LOG(INFO)<<"load per-item-online-model from legacy archive "<<legacyPath;
+    loadLegacyModel(legacyPath, adDb);
 }
 
 void LaserGenericModel::save()
 {
-    std::ofstream ofs((workdir_ + "per-item-online-model").c_str(), std::ofstream::binary | std::ofstream::trunc);
-    boost::archive::binary_oarchive oa(ofs);
-    try
+    std::vector<LaserOnlineModel> adDb;
     {
-        oa << *pAdDb_;
+        boost::mutex::scoped_lock lock(updateMutex_);
+        this->adDb().copyTo(adDb);
     }
-    catch(std::exception& e)
+    LaserModelFileWriter writer(workdir_ + "/per-item-online-model.bin");
+    writer.addSection(adDb);
+    if (!writer.commit())
     {
-        LOG(INFO)<<e.what();
+        LOG(ERROR)<<"save per-item-online-model failed";
     }
-    ofs.close();
 }
     
-void LaserGenericModel::localizeFromOrigModel()
+void LaserGenericModel::localizeFromOrigModel(std::vector<LaserOnlineModel>& adDb)
 {
     OrigOnlineDB::iterator it = origLaserModel_->begin();
     for (; it != origLaserModel_->end(); ++it)
     {
         docid_t id = 0;
-        if (adIndexer_.convertDocId(it->first, id))
+        if (adIndexer_.convertDocId(it->first, id) && id < adDb.size())
         {
-            (*pAdDb_)[id] = it->second;
+            adDb[id] = it->second;
         }
     }
 }
@@ -2,6 +2,9 @@
 #define SF1R_LASER_GENERIC_MODEL_H
 #include "LaserModel.h"
 #include "LaserModelDB.h"
+#include "EpochRowTable.h"
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 namespace sf1r { namespace laser {
 class AdIndexManager;
 class LaserOnlineModel;
@@ -17,6 +20,8 @@ class MQClient;
 class LaserGenericModel : public LaserModel
 {
 typedef LaserModelDB<std::string, LaserOnlineModel> OrigOnlineDB;
+protected:
+typedef EpochRowTable<LaserOnlineModel> OnlineModelTable;
 public:
     LaserGenericModel(const AdIndexManager& adIndexer,
         const std::string& kvaddr,
@@ -57,6 +62,14 @@ public:
         const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
         const float score) const;
     
+    virtual void score(
+        const std::vector<std::string>& text,
+        const std::vector<std::vector<float> >& context, 
+        const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        const std::vector<std::size_t>& offset,
+        const std::vector<std::size_t>& user,
+        std::vector<float>& score) const;
+    
     virtual bool context(const std::string& text, 
         std::vector<std::pair<int, float> >& context) const;
 
@@ -67,11 +80,23 @@ public:
 
     virtual void updateAdDimension(const std::size_t adDimension);
 
+    // every user gets all the ads
+    virtual bool isSharedCandidate() const
+    {
+        return true;
+    }
+
 private:
     void updatepAdDb(msgpack::rpc::request& req);
-    void load();
+    void load(std::vector<LaserOnlineModel>& adDb);
     void save();
-    void localizeFromOrigModel();
+    void localizeFromOrigModel(std::vector<LaserOnlineModel>& adDb);
+
+protected:
+    const OnlineModelTable& adDb() const
+    {
+        return *pAdDb_.load(boost::memory_order_acquire);
+    }
 
 protected:
     const AdIndexManager& adIndexer_;
@@ -80,7 +105,12 @@ protected:
     std::size_t adDimension_;
     const std::size_t AD_FD_;
     const std::size_t USER_FD_;
-    std::vector<LaserOnlineModel>* pAdDb_;
+    // rows swapped on update, replaced as a whole on dimension change
+    boost::atomic<OnlineModelTable*> pAdDb_;
+    // serialize the row updates with the dimension change
+    boost::mutex updateMutex_;
+    // serialize the dimension changes of the online and offline models
+    boost::mutex dimensionMutex_;
     LaserOfflineModel* offlineModel_;
     context::KVClient* kvclient_;
     context::MQClient* mqclient_;
@@ -18,34 +18,46 @@ public:
     {
     }
 public:
+    // called from several mining threads at once
     virtual bool buildDocument(docid_t docID, const Document& doc)
     {
-        {
-            boost::unique_lock<boost::shared_mutex> uniqueLock(mutex_);
-            if (docid_ < docID)
-            {
-                docid_ = docID;
-            }
-        }
         std::string title = "";
+        bool hasTitle = false;
         try
         {
             // throw exception
-            if (doc.getString("Title", title))
-            {
-                laserManager_->index(docID, title);
-            }
+            hasTitle = doc.getString("Title", title);
         }
         catch (std::exception& e)
         {
             LOG(INFO)<<e.what();
         }
+        std::vector<std::pair<docid_t, std::string> > batch;
+        {
+            boost::unique_lock<boost::shared_mutex> uniqueLock(mutex_);
+            if (docid_ < docID)
+            {
+                docid_ = docID;
+            }
+            if (hasTitle)
+            {
+                pending_.push_back(std::make_pair(docID, std::string()));
+                pending_.back().second.swap(title);
+            }
+            if (pending_.size() >= BATCH_SIZE)
+            {
+                batch.swap(pending_);
+                pending_.reserve(BATCH_SIZE);
+            }
+        }
+        // the full batch is indexed outside the lock, the other threads
+        // keep filling the next one
+        index_(batch);
         return true;
     }
 
     virtual bool preProcess(int64_t timestamp)
     {
-        laserManager_->indexManager_->preIndex();
         docid_ = laserManager_->indexManager_->getLastDocId();
         if (docid_ > laserManager_->documentManager_->getMaxDocId())
         {
@@ -56,9 +68,20 @@ public:
 
     virtual bool postProcess()
     {
-        boost::unique_lock<boost::shared_mutex> uniqueLock(mutex_);
-        docid_++;
-        laserManager_->indexManager_->setLastDocId(docid_);
+        std::vector<std::pair<docid_t, std::string> > batch;
+        {
+            boost::unique_lock<boost::shared_mutex> uniqueLock(mutex_);
+            batch.swap(pending_);
+        }
+        index_(batch);
+        docid_t lastDocId = 0;
+        {
+            boost::unique_lock<boost::shared_mutex> uniqueLock(mutex_);
+            lastDocId = ++docid_;
+        }
+        // saving and compacting the index takes long, getLastDocId() and
+        // buildDocument() do not wait for it
+        laserManager_->indexManager_->setLastDocId(lastDocId);
         laserManager_->indexManager_->postIndex();
         return true;
     }
@@ -70,9 +93,31 @@ public:
     }
 
 private:
+    void index_(const std::vector<std::pair<docid_t, std::string> >& batch)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        try
+        {
+            laserManager_->index(batch);
+        }
+        catch (std::exception& e)
+        {
+            LOG(INFO)<<e.what();
+        }
+    }
+
+private:
+    // titles tokenized in parallel and indexed under one lock per batch
+    const static std::size_t BATCH_SIZE = 1024;
+
     LaserManager* laserManager_;
     docid_t docid_;
+    // guards docid_ and pending_
     boost::shared_mutex mutex_;
+    std::vector<std::pair<docid_t, std::string> > pending_;
 };
 
 } }
@@ -5,17 +5,26 @@
 #include "clusteringmanager/clustering/PCARunner.h"
 #include "LaserIndexTask.h"
 #include "LaserRpcServer.h"
+#include "CentroidMatrix.h"
 #include <mining-manager/MiningManager.h>
 #include <query-manager/ActionItem.h>
 #include <ad-manager/AdSearchService.h>
 #include <glog/logging.h>
 #include <sys/time.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <ctime>
 
 using namespace sf1r::laser;
 namespace sf1r
 {
 
 const static std::size_t THREAD_NUM = 8;
+// distinct titles kept tokenized across requests
+const static std::size_t TOKENIZE_CACHE_SIZE = 200000;
+// smaller batches are not worth another thread
+const static std::size_t INDEX_DOCS_PER_THREAD = 64;
     
 laser::LaserRpcServer* LaserManager::rpcServer_ = NULL;
 boost::shared_mutex LaserManager::mutex_;
@@ -36,7 +45,9 @@ LaserManager::LaserManager(const boost::shared_ptr<AdSearchService>& adSearchSer
     , recommend_(NULL)
     , indexManager_(NULL)
     , tokenizer_(NULL)
+    , tokenizeCache_(NULL)
     , clusteringContainer_(NULL)
+    , clusteringMatrix_(NULL)
     , similarClustering_(NULL)
 {
     resdir_ = MiningManager::system_resource_path_ + "/laser_resource/";
@@ -54,6 +65,7 @@ LaserManager::LaserManager(const boost::shared_ptr<AdSearchService>& adSearchSer
     
     tokenizer_ = new Tokenizer(MiningManager::system_resource_path_ + "/dict/title_pca/",
         resdir_ + "/terms_dic.dat");
+    tokenizeCache_ = new TokenizeCache(TOKENIZE_CACHE_SIZE);
 
     bool isNeedClustering = isNeedClusteringKnowlege();
     if (isNeedClustering)
@@ -86,6 +98,14 @@ LaserManager::~LaserManager()
         delete recommend_;
         recommend_ = NULL;
     }
+    if (NULL != tokenizeCache_)
+    {
+        const TokenizeCache::Stats stats = tokenizeCache_->stats();
+        LOG(INFO)<<"tokenize cache hits = "<<stats.hits<<"\t misses = "<<stats.misses
+            <<"\t evictions = "<<stats.evictions<<"\t hit rate = "<<stats.hitRate();
+        delete tokenizeCache_;
+        tokenizeCache_ = NULL;
+    }
     if (NULL != tokenizer_)
     {
         delete tokenizer_;
@@ -96,6 +116,11 @@ LaserManager::~LaserManager()
         delete clusteringContainer_;
         clusteringContainer_ = NULL;
     }
+    if (NULL != clusteringMatrix_)
+    {
+        delete clusteringMatrix_;
+        clusteringMatrix_ = NULL;
+    }
     if (NULL != similarClustering_)
     {
         delete similarClustering_;
@@ -128,10 +153,48 @@ bool LaserManager::recommend(const LaserRecommendParam& param,
     return true;
 }
     
+bool LaserManager::recommend(const LaserBatchRecommendParam& param, 
+    const GetDocumentsByIdsActionItem& actionItem,
+    std::vector<RawTextResultFromAIA>& res) const 
+{
+    std::vector<std::vector<docid_t> > docIdList;
+    std::vector<std::vector<float> > itemScoreList;
+    res.resize(param.texts_.size());
+    if (!recommend_->recommend(param.texts_, docIdList, itemScoreList, param.topN_))
+    {
+        for (std::size_t i = 0; i < res.size(); ++i)
+        {
+            res[i].error_ = "Internal ERROR in Recommend Engine, no data for : " + param.texts_[i];
+        }
+        return false;
+    }
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    for (std::size_t i = 0; i < res.size(); ++i)
+    {
+        if (docIdList[i].empty())
+        {
+            res[i].error_ = "Internal ERROR in Recommend Engine, no data for : " + param.texts_[i];
+            continue;
+        }
+        GetDocumentsByIdsActionItem userActionItem(actionItem);
+        userActionItem.idList_.assign(docIdList[i].begin(), docIdList[i].end());
+        adSearchService_->getDocumentsByIds(userActionItem, res[i]);
+        res[i].score_.swap(itemScoreList[i]);
+    }
+    boost::posix_time::ptime etime = boost::posix_time::microsec_clock::local_time();
+    LOG(INFO)<<"get ad time = "<<(etime-stime).total_milliseconds()<<"\t user size = "<<res.size();
+    return true;
+}
+    
 void LaserManager::index(const docid_t& docid, const std::string& title)
 {
+    // titles are indexed once, keep them out of the recommend cache
+    if (NULL == tokenizeBuffer_.get())
+    {
+        tokenizeBuffer_.reset(new Tokenizer::Buffer());
+    }
     TokenSparseVector vec;
-    tokenizer_->tokenize(title, vec);
+    tokenizer_->tokenize(title, *tokenizeBuffer_, vec);
     
     if (NULL != clusteringContainer_)
     {
@@ -148,6 +211,71 @@ void LaserManager::index(const docid_t& docid, const std::string& title)
     }
 }
     
+void LaserManager::index(const std::vector<std::pair<docid_t, std::string> >& docs)
+{
+    if (docs.empty())
+    {
+        return;
+    }
+    std::vector<AdIndexManager::IndexItem> items(docs.size());
+    std::vector<char> failed(docs.size(), 0);
+    const std::size_t threadNum = std::min(THREAD_NUM, (docs.size() + INDEX_DOCS_PER_THREAD - 1) / INDEX_DOCS_PER_THREAD);
+    boost::thread_group threads;
+    for (std::size_t i = 1; i < threadNum; ++i)
+    {
+        threads.create_thread(boost::bind(&LaserManager::tokenizeBatch_, this,
+            boost::cref(docs), i, threadNum, boost::ref(items), boost::ref(failed)));
+    }
+    tokenizeBatch_(docs, 0, threadNum, items, failed);
+    threads.join_all();
+
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < items.size(); ++i)
+    {
+        if (failed[i])
+            continue;
+        if (k != i)
+            std::swap(items[k], items[i]);
+        ++k;
+    }
+    items.resize(k);
+    indexManager_->index(items);
+}
+
+void LaserManager::tokenizeBatch_(const std::vector<std::pair<docid_t, std::string> >& docs,
+    const std::size_t begin,
+    const std::size_t step,
+    std::vector<AdIndexManager::IndexItem>& items,
+    std::vector<char>& failed) const
+{
+    Tokenizer::Buffer buffer;
+    // rand() is shared by all the threads, each one draws from its own engine
+    boost::random::mt19937 engine(std::time(NULL) + begin);
+    for (std::size_t i = begin; i < docs.size(); i += step)
+    {
+        AdIndexManager::IndexItem& item = items[i];
+        item.docid = docs[i].first;
+        item.clusteringId = AdIndexManager::NO_CLUSTERING;
+        try
+        {
+            tokenizer_->tokenize(docs[i].second, buffer, item.vec);
+            if (NULL != clusteringContainer_)
+            {
+                item.clusteringId = assignClustering_(item.vec);
+                if ((std::size_t)-1 == item.clusteringId)
+                {
+                    item.clusteringId = engine() % clusteringContainer_->size();
+                }
+            }
+        }
+        catch (std::exception& e)
+        {
+            LOG(INFO)<<e.what();
+            failed[i] = 1;
+        }
+    }
+}
+    
 MiningTask* LaserManager::getLaserIndexTask()
 {
     return indexTask_;
@@ -155,42 +283,33 @@ MiningTask* LaserManager::getLaserIndexTask()
     
 const std::size_t LaserManager::getClustering(const std::string& title) const
 {
-    TokenSparseVector vec;
-    tokenizer_->tokenize(title, vec);
+    return assignClustering_(*tokenize(title));
+}
+
+const std::size_t LaserManager::getClustering(const TokenSparseVector& vec) const
+{
     return assignClustering_(vec);
 }
 
-std::size_t LaserManager::assignClustering_(const TokenSparseVector& v) const
+TokenizeCache::TokenVectorPtr LaserManager::tokenize(const std::string& title) const
 {
-    if (v.empty())
+    TokenizeCache::TokenVectorPtr res = tokenizeCache_->get(title);
+    if (NULL != res.get())
     {
-        return -1;
+        return res;
     }
-    std::size_t size = clusteringContainer_->size();
-    
-    float maxSim = 0.0;
-    std::size_t maxId = -1;
-    for (std::size_t i = 0; i < size; ++i)
+    if (NULL == tokenizeBuffer_.get())
     {
-        float sim = similarity_(v, (*clusteringContainer_)[i]);
-        if (sim > maxSim)
-        {
-            maxSim = sim;
-            maxId = i;
-        }
+        tokenizeBuffer_.reset(new Tokenizer::Buffer());
     }
-    return maxId;
+    TokenSparseVector vec;
+    tokenizer_->tokenize(title, *tokenizeBuffer_, vec);
+    return tokenizeCache_->insert(title, vec);
 }
-    
-float LaserManager::similarity_(const TokenSparseVector& lv, const TokenVector& rv) const
+
+std::size_t LaserManager::assignClustering_(const TokenSparseVector& v) const
 {
-    float sim = 0.0;
-    TokenSparseVector::const_iterator it = lv.begin(); 
-    for (; it != lv.end(); ++it)
-    {
-        sim += rv[it->first] * it->second;
-    }
-    return sim;
+    return clusteringMatrix_->assign(v);
 }
 
 bool LaserManager::convertDocId(
@@ -214,10 +333,10 @@ bool LaserManager::getAdInfoByDOCID(const std::string& DOCID,
     docid_t docid = 0;
     if (convertDocId(DOCID, docid))
     {
-        std::vector<std::pair<int, float> > vec;
+        laser::AdVectorView vec;
         if (indexManager_->get(docid, vec))
         {
-            std::vector<std::pair<int, float> >::const_iterator it = vec.begin();
+            laser::AdVectorView::const_iterator it = vec.begin();
             for (; it != vec.end(); ++it)
             {
                 index.push_back(it->first);
@@ -238,10 +357,11 @@ void LaserManager::tokenize(const std::string& text,
    std::vector<int>& index, 
    std::vector<float>& value) const
 {
-    std::vector<std::pair<int, float> > vec;
-    tokenizer_->tokenize(text, vec);
-    std::vector<std::pair<int, float> >::const_iterator it = vec.begin();
-    for (; it != vec.end(); ++it)
+    TokenizeCache::TokenVectorPtr vec = tokenize(text);
+    index.reserve(index.size() + vec->size());
+    value.reserve(value.size() + vec->size());
+    TokenSparseVector::const_iterator it = vec->begin();
+    for (; it != vec->end(); ++it)
     {
         index.push_back(it->first);
         value.push_back(it->second);
@@ -273,6 +393,8 @@ void LaserManager::loadClusteringKnowledge()
         tokenizer_->numeric(clusteringContainer[i], vec);
         (*clusteringContainer_)[i] = vec;
     }
+    clusteringMatrix_ = new CentroidMatrix(*clusteringContainer_, 
+        para_.coarseClusteringNum, para_.coarseClusteringProbe);
    
     similarClustering_ = new std::vector<std::vector<int> >(clusteringContainer_->size());
     {
@@ -1,6 +1,7 @@
 #ifndef SF1R_LASER_MANAGER_LASER_MANAGER_H
 #define SF1R_LASER_MANAGER_LASER_MANAGER_H
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/tss.hpp>
 #include <mining-manager/MiningManager.h>
 #include <mining-manager/MiningTask.h>
 #include <common/ResultType.h>
@@ -10,6 +11,7 @@
 #include "LaserRecommendParam.h"
 #include "AdIndexManager.h"
 #include "Tokenizer.h"
+#include "TokenizeCache.h"
 #include "TopNClusteringDB.h"
 #include "LaserOnlineModel.h"
 #include "LaserOfflineModel.h"
@@ -20,6 +22,7 @@ class LaserIndexTask;
 class LaserRpcServer;
 class LaserRecommend;
 class LaserModelFactory;
+class CentroidMatrix;
 } }
 namespace sf1r {
 
@@ -28,8 +31,9 @@ void closeLaserDependency();
 class LaserManager
 {
     typedef std::vector<float> TokenVector;
-    typedef std::vector<std::pair<int, float> > TokenSparseVector;
 public:
+    typedef std::vector<std::pair<int, float> > TokenSparseVector;
+
     LaserManager(const boost::shared_ptr<AdSearchService>& adSearchService, 
         const boost::shared_ptr<DocumentManager>& documentManager,
         izenelib::ir::idmanager::IDManager& idManager,
@@ -41,11 +45,21 @@ public:
     bool recommend(const laser::LaserRecommendParam& param, 
         GetDocumentsByIdsActionItem& actionItem,
         RawTextResultFromAIA& itemList) const;
+    bool recommend(const laser::LaserBatchRecommendParam& param, 
+        const GetDocumentsByIdsActionItem& actionItem,
+        std::vector<RawTextResultFromAIA>& itemList) const;
     void index(const docid_t& docid, const std::string& title);
+    // titles are tokenized and assigned in parallel, then applied to the
+    // index at once
+    void index(const std::vector<std::pair<docid_t, std::string> >& docs);
 
     MiningTask* getLaserIndexTask();
 
     const std::size_t getClustering(const std::string& title) const;
+    const std::size_t getClustering(const TokenSparseVector& vec) const;
+
+    // tokenized title, shared with the cache, never NULL
+    laser::TokenizeCache::TokenVectorPtr tokenize(const std::string& title) const;
 
     bool convertDocId(const std::string& docStr, docid_t& docId) const;
 
@@ -67,7 +81,11 @@ public:
     friend void closeLaserDependency();
 private:
     std::size_t assignClustering_(const TokenSparseVector& v) const;
-    float similarity_(const TokenSparseVector& lv, const TokenVector& rv) const;
+    void tokenizeBatch_(const std::vector<std::pair<docid_t, std::string> >& docs,
+        const std::size_t begin,
+        const std::size_t step,
+        std::vector<laser::AdIndexManager::IndexItem>& items,
+        std::vector<char>& failed) const;
 
     bool isNeedClusteringKnowlege() const;
     void loadClusteringKnowledge();
@@ -92,7 +110,10 @@ private:
     laser::LaserIndexTask* indexTask_;
     
     laser::Tokenizer* tokenizer_;
+    laser::TokenizeCache* tokenizeCache_;
+    mutable boost::thread_specific_ptr<laser::Tokenizer::Buffer> tokenizeBuffer_;
     std::vector<TokenVector>* clusteringContainer_;
+    laser::CentroidMatrix* clusteringMatrix_;
     std::vector<std::vector<int> >* similarClustering_;
     
     static laser::LaserRpcServer* rpcServer_;
@@ -35,15 +35,15 @@ public:
         const float* end = mdata + model.size();
         const float* adata = args.data();
         __m128 score = {0};
-        for (; mdata < end - 4; mdata+=4, adata +=4)
+        for (; mdata + 4 <= end; mdata+=4, adata +=4)
         {
             __m128 mul = _mm_mul_ps(_mm_loadu_ps(mdata), _mm_loadu_ps(adata));
             score = _mm_add_ps(score, mul);
         }
-        static float res[4];
+        float res[4];
         _mm_storeu_ps(res, score);
         float ret = res[0] + res[1] + res[2] + res[3];
-        if (mdata < end) for (; mdata < end; ++mdata)
+        for (; mdata < end; ++mdata, ++adata)
         {
             ret += (*mdata) * (*adata);
         }
@@ -57,21 +57,49 @@ public:
         const float* end = lv + size;
         const float* adata = rv;
         __m128 score = {0};
-        for (; mdata < end - 4; mdata+=4, adata +=4)
+        for (; mdata + 4 <= end; mdata+=4, adata +=4)
         {
             __m128 mul = _mm_mul_ps(_mm_loadu_ps(mdata), _mm_loadu_ps(adata));
             score = _mm_add_ps(score, mul);
         }
-        static float res[4];
+        float res[4];
         _mm_storeu_ps(res, score);
         float ret = res[0] + res[1] + res[2] + res[3];
-        if (mdata < end) for (; mdata < end; ++mdata)
+        for (; mdata < end; ++mdata, ++adata)
         {
             ret += (*mdata) * (*adata);
         }
         return ret;
     }
     
+    // w * x[0..3], a 1x4 block of an ads x users product
+    inline void dot4(const float* w, const float* const* x, 
+        const std::size_t size, float* res) const
+    {
+        __m128 s0 = _mm_setzero_ps();
+        __m128 s1 = _mm_setzero_ps();
+        __m128 s2 = _mm_setzero_ps();
+        __m128 s3 = _mm_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 4 <= size; i += 4)
+        {
+            const __m128 v = _mm_loadu_ps(w + i);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(v, _mm_loadu_ps(x[0] + i)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(v, _mm_loadu_ps(x[1] + i)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(v, _mm_loadu_ps(x[2] + i)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(v, _mm_loadu_ps(x[3] + i)));
+        }
+        // transpose, so that lane j holds the sum of user j
+        _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+        _mm_storeu_ps(res, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+        for (; i < size; ++i)
+        {
+            res[0] += w[i] * x[0][i];
+            res[1] += w[i] * x[1][i];
+            res[2] += w[i] * x[2][i];
+            res[3] += w[i] * x[3][i];
+        }
+    }
     
     virtual bool candidate(
         const std::string& text,
@@ -104,6 +132,36 @@ public:
 
     virtual bool context(const std::string& text, std::vector<float>& context) const = 0;
     
+    /*
+     * Score a batch of users against the union of their candidates. The
+     * users owning ad[i] are user[offset[i]] ... user[offset[i + 1] - 1],
+     * score[k] holds the candidate score of the k-th (ad, user) pair and
+     * is updated in place. It's the scope of one recommend, per-user state
+     * like a stored user model is resolved here once, not once per ad.
+     */
+    virtual void score(
+        const std::vector<std::string>& text,
+        const std::vector<std::vector<float> >& context, 
+        const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        const std::vector<std::size_t>& offset,
+        const std::vector<std::size_t>& user,
+        std::vector<float>& score) const
+    {
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            for (std::size_t k = offset[i]; k < offset[i + 1]; ++k)
+            {
+                score[k] = this->score(text[user[k]], context[user[k]], ad[i], score[k]);
+            }
+        }
+    }
+
+    // whether candidate() returns the same ads for every user
+    virtual bool isSharedCandidate() const
+    {
+        return false;
+    }
+    
     virtual void dispatch(const std::string& method, msgpack::rpc::request& req) = 0;
 
     virtual void updateAdDimension(const std::size_t adDimension)
@@ -0,0 +1,209 @@
+#ifndef SF1R_LASER_LASER_MODEL_CACHE_H
+#define SF1R_LASER_LASER_MODEL_CACHE_H
+#include "LaserModelDB.h"
+#include <list>
+#include <vector>
+#include <string.h>
+#include <common/inttypes.h>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace sf1r { namespace laser {
+
+/*
+ * Bounded LRU of decoded values in front of a LaserModelDB, or any DB with
+ * the same get(key, value) and update(key, value). get() reads through to
+ * the db on a miss, so a hot key is read and deserialized once instead of
+ * once per lookup. Values are handed out as shared pointers, an evicted or
+ * updated value stays valid for whoever still holds it.
+ *
+ * update() writes the db first and drops the cached value, the next get()
+ * reloads it. A miss which read the db before that write would cache the
+ * old value back, so update() also bumps the generation of the key, and a
+ * miss only caches its value if the generation is unchanged since it
+ * missed.
+ */
+template <typename K, typename V, typename DB = LaserModelDB<K, V> >
+class LaserModelCache : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<const V> ValuePtr;
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+
+        float hitRate() const
+        {
+            return 0 == hits + misses ? 0.0 : (float)hits / (hits + misses);
+        }
+    };
+
+private:
+    typedef std::list<std::pair<K, ValuePtr> > LRUList;
+    typedef boost::unordered_map<K, typename LRUList::iterator> Index;
+
+public:
+    LaserModelCache(DB& db, const std::size_t capacity)
+        : db_(db)
+        , capacity_(capacity)
+    {
+        memset(&stats_, 0, sizeof(stats_));
+        memset(generations_, 0, sizeof(generations_));
+    }
+
+public:
+    // NULL when the db has no value for key
+    ValuePtr get(const K& key)
+    {
+        uint64_t generation = 0;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            typename Index::iterator it = index_.find(key);
+            if (index_.end() != it)
+            {
+                ++stats_.hits;
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return it->second->second;
+            }
+            ++stats_.misses;
+            generation = generations_[generationSlot_(key)];
+        }
+
+        // decode outside the lock, a concurrent miss on the same key
+        // only costs one more read
+        boost::shared_ptr<V> value(new V());
+        if (!db_.get(key, *value))
+        {
+            return ValuePtr();
+        }
+        insert_(key, value, generation);
+        return value;
+    }
+
+    // values[i] is NULL when the db has no value for keys[i], the hits
+    // are served under one lock and only the misses go to the db
+    void get(const std::vector<K>& keys, std::vector<ValuePtr>& values)
+    {
+        values.assign(keys.size(), ValuePtr());
+        std::vector<std::size_t> missed;
+        std::vector<uint64_t> generations;
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            for (std::size_t i = 0; i < keys.size(); ++i)
+            {
+                typename Index::iterator it = index_.find(keys[i]);
+                if (index_.end() == it)
+                {
+                    missed.push_back(i);
+                    generations.push_back(generations_[generationSlot_(keys[i])]);
+                    continue;
+                }
+                lru_.splice(lru_.begin(), lru_, it->second);
+                values[i] = it->second->second;
+            }
+            stats_.hits += keys.size() - missed.size();
+            stats_.misses += missed.size();
+        }
+
+        for (std::size_t i = 0; i < missed.size(); ++i)
+        {
+            const K& key = keys[missed[i]];
+            boost::shared_ptr<V> value(new V());
+            if (db_.get(key, *value))
+            {
+                insert_(key, value, generations[i]);
+                values[missed[i]] = value;
+            }
+        }
+    }
+
+    bool update(const K& key, const V& value)
+    {
+        const bool res = db_.update(key, value);
+        erase(key);
+        return res;
+    }
+
+    void erase(const K& key)
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        ++generations_[generationSlot_(key)];
+        typename Index::iterator it = index_.find(key);
+        if (index_.end() != it)
+        {
+            lru_.erase(it->second);
+            index_.erase(it);
+        }
+    }
+
+    std::size_t size() const
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        return index_.size();
+    }
+
+    std::size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    Stats stats() const
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        return stats_;
+    }
+
+private:
+    void insert_(const K& key, const ValuePtr& value, uint64_t generation)
+    {
+        if (0 == capacity_)
+        {
+            return;
+        }
+        boost::mutex::scoped_lock lock(mutex_);
+        if (generations_[generationSlot_(key)] != generation)
+        {
+            // updated since the miss, value may be older than the db
+            return;
+        }
+        typename Index::iterator it = index_.find(key);
+        if (index_.end() != it)
+        {
+            // raced with another miss, keep the value already cached
+            return;
+        }
+        lru_.push_front(std::make_pair(key, value));
+        index_[key] = lru_.begin();
+        if (index_.size() > capacity_)
+        {
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+            ++stats_.evictions;
+        }
+    }
+
+    // keys share a generation by hash, a spurious bump only skips caching
+    static std::size_t generationSlot_(const K& key)
+    {
+        return boost::hash<K>()(key) % GENERATION_NUM;
+    }
+
+private:
+    const static std::size_t GENERATION_NUM = 256;
+    DB& db_;
+    const std::size_t capacity_;
+    LRUList lru_;
+    Index index_;
+    Stats stats_;
+    uint64_t generations_[GENERATION_NUM];
+    mutable boost::mutex mutex_;
+};
+
+} }
+#endif
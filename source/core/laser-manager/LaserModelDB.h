@@ -34,23 +34,36 @@ public:
     }
     ~LaserModelDB()
     {
-        db_->close();
-        delete db_;
-        db_ = NULL;
+        if (NULL != db_)
+        {
+            db_->close();
+            delete db_;
+            db_ = NULL;
+        }
     }
 public:        
+    // false if the leveldb failed to open, then it holds no value
+    bool isOpen() const
+    {
+        return NULL != db_;
+    }
+
     bool update(const K& key, const V& value)
     {
-        return db_->insert(key, value);
+        return NULL != db_ && db_->insert(key, value);
     }
     
     bool get(const K& key, V& value) const
     {
-        return db_->get(key, value);
+        return NULL != db_ && db_->get(key, value);
     }
 
     iterator begin() const
     {
+        if (NULL == db_)
+        {
+            return iterator();
+        }
         return iterator(*db_);
     }
 
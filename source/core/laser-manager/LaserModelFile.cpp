@@ -0,0 +1,317 @@
+#include "LaserModelFile.h"
+#include "LaserOnlineModel.h"
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sf1r { namespace laser {
+
+static std::size_t alignOffset(std::size_t offset)
+{
+    const std::size_t mask = LaserModelFile::ALIGNMENT - 1;
+    return (offset + mask) & ~mask;
+}
+
+LaserModelFileWriter::LaserModelFileWriter(const std::string& filename)
+    : filename_(filename)
+{
+}
+
+void LaserModelFileWriter::addSection(const std::vector<float>& vec)
+{
+    Section section = {1, vec.size(), &vec, NULL, NULL};
+    sections_.push_back(section);
+}
+
+void LaserModelFileWriter::addSection(const std::vector<std::vector<float> >& mat)
+{
+    std::size_t cols = 0;
+    for (std::size_t i = 0; i < mat.size(); ++i)
+    {
+        cols = std::max(cols, mat[i].size());
+    }
+    Section section = {mat.size(), cols, NULL, &mat, NULL};
+    sections_.push_back(section);
+}
+
+void LaserModelFileWriter::addSection(const std::vector<LaserOnlineModel>& models)
+{
+    std::size_t cols = 0;
+    for (std::size_t i = 0; i < models.size(); ++i)
+    {
+        cols = std::max(cols, models[i].eta().size() + 1);
+    }
+    Section section = {models.size(), cols, NULL, NULL, &models};
+    sections_.push_back(section);
+}
+
+void LaserModelFileWriter::row(const Section& section, std::size_t i, std::vector<float>& buf) const
+{
+    buf.assign(section.cols, 0.0);
+    if (NULL != section.vec)
+    {
+        std::copy(section.vec->begin(), section.vec->end(), buf.begin());
+    }
+    else if (NULL != section.mat)
+    {
+        const std::vector<float>& r = (*section.mat)[i];
+        std::copy(r.begin(), r.end(), buf.begin());
+    }
+    else
+    {
+        const LaserOnlineModel& model = (*section.models)[i];
+        buf[0] = model.delta();
+        std::copy(model.eta().begin(), model.eta().end(), buf.begin() + 1);
+    }
+}
+
+bool LaserModelFileWriter::commit()
+{
+    LaserModelFile::Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LaserModelFile::MAGIC;
+    header.version = LaserModelFile::VERSION;
+    header.sectionNum = sections_.size();
+
+    std::vector<LaserModelFile::SectionInfo> infos(sections_.size());
+    std::size_t offset = alignOffset(sizeof(header) +
+        sizeof(LaserModelFile::SectionInfo) * infos.size());
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+        infos[i].rows = sections_[i].rows;
+        infos[i].cols = sections_[i].cols;
+        infos[i].offset = offset;
+        offset = alignOffset(offset + sizeof(float) * infos[i].rows * infos[i].cols);
+    }
+    header.dataSize = offset - sizeof(header);
+
+    const std::string tmpfile = filename_ + ".tmp";
+    FILE* fp = fopen(tmpfile.c_str(), "wb");
+    if (NULL == fp)
+    {
+        LOG(ERROR)<<"open "<<tmpfile<<" failed";
+        return false;
+    }
+
+    boost::crc_32_type crc;
+    bool ret = true;
+    // header is rewritten with the checksum once all data is written
+    ret &= 1 == fwrite(&header, sizeof(header), 1, fp);
+    std::size_t pos = sizeof(header);
+    if (!infos.empty())
+    {
+        const std::size_t size = sizeof(LaserModelFile::SectionInfo) * infos.size();
+        ret &= 1 == fwrite(infos.data(), size, 1, fp);
+        crc.process_bytes(infos.data(), size);
+        pos += size;
+    }
+
+    static const char zero[LaserModelFile::ALIGNMENT] = {0};
+    std::vector<float> buf;
+    for (std::size_t i = 0; ret && i < sections_.size(); ++i)
+    {
+        const std::size_t pad = infos[i].offset - pos;
+        if (pad > 0)
+        {
+            ret &= 1 == fwrite(zero, pad, 1, fp);
+            crc.process_bytes(zero, pad);
+        }
+        pos = infos[i].offset;
+        for (std::size_t r = 0; ret && r < sections_[i].rows; ++r)
+        {
+            row(sections_[i], r, buf);
+            if (buf.empty())
+                continue;
+            const std::size_t size = sizeof(float) * buf.size();
+            ret &= 1 == fwrite(buf.data(), size, 1, fp);
+            crc.process_bytes(buf.data(), size);
+            pos += size;
+        }
+    }
+    if (ret && pos < offset)
+    {
+        const std::size_t pad = offset - pos;
+        ret &= 1 == fwrite(zero, pad, 1, fp);
+        crc.process_bytes(zero, pad);
+    }
+
+    header.checksum = crc.checksum();
+    ret &= 0 == fseek(fp, 0, SEEK_SET);
+    ret &= 1 == fwrite(&header, sizeof(header), 1, fp);
+    ret &= 0 == fflush(fp);
+    ret &= 0 == fsync(fileno(fp));
+    fclose(fp);
+
+    if (!ret)
+    {
+        LOG(ERROR)<<"write "<<tmpfile<<" failed";
+        boost::filesystem::remove(tmpfile);
+        return false;
+    }
+    if (0 != rename(tmpfile.c_str(), filename_.c_str()))
+    {
+        LOG(ERROR)<<"rename "<<tmpfile<<" to "<<filename_<<" failed";
+        return false;
+    }
+    return true;
+}
+
+LaserModelFileReader::LaserModelFileReader()
+    : addr_(NULL)
+    , size_(0)
+{
+}
+
+LaserModelFileReader::~LaserModelFileReader()
+{
+    close();
+}
+
+bool LaserModelFileReader::open(const std::string& filename)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || (std::size_t)st.st_size < sizeof(LaserModelFile::Header))
+    {
+        ::close(fd);
+        LOG(ERROR)<<filename<<" is truncated";
+        return false;
+    }
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (MAP_FAILED == addr)
+    {
+        LOG(ERROR)<<"mmap "<<filename<<" failed";
+        return false;
+    }
+    addr_ = static_cast<const char*>(addr);
+    size_ = st.st_size;
+
+    const LaserModelFile::Header* header = reinterpret_cast<const LaserModelFile::Header*>(addr_);
+    if (LaserModelFile::MAGIC != header->magic ||
+        LaserModelFile::VERSION != header->version ||
+        sizeof(*header) + header->dataSize != size_)
+    {
+        LOG(ERROR)<<filename<<" has unsupported version or bad size";
+        close();
+        return false;
+    }
+    const std::size_t infoSize = sizeof(LaserModelFile::SectionInfo) * header->sectionNum;
+    if (sizeof(*header) + infoSize > size_)
+    {
+        LOG(ERROR)<<filename<<" has bad section table";
+        close();
+        return false;
+    }
+
+    // sequential scan for the checksum also warms the page cache
+    madvise(const_cast<char*>(addr_), size_, MADV_SEQUENTIAL);
+    boost::crc_32_type crc;
+    crc.process_bytes(addr_ + sizeof(*header), header->dataSize);
+    if (crc.checksum() != header->checksum)
+    {
+        LOG(ERROR)<<filename<<" checksum mismatch";
+        close();
+        return false;
+    }
+    madvise(const_cast<char*>(addr_), size_, MADV_NORMAL);
+
+    const LaserModelFile::SectionInfo* infos =
+        reinterpret_cast<const LaserModelFile::SectionInfo*>(addr_ + sizeof(*header));
+    sections_.assign(infos, infos + header->sectionNum);
+    for (std::size_t i = 0; i < sections_.size(); ++i)
+    {
+        if (sections_[i].offset + sizeof(float) * sections_[i].rows * sections_[i].cols > size_)
+        {
+            LOG(ERROR)<<filename<<" section "<<i<<" out of range";
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void LaserModelFileReader::close()
+{
+    if (NULL != addr_)
+    {
+        munmap(const_cast<char*>(addr_), size_);
+        addr_ = NULL;
+        size_ = 0;
+    }
+    sections_.clear();
+}
+
+bool LaserModelFileReader::load(std::size_t section, std::vector<float>& vec) const
+{
+    if (section >= sections_.size() || 1 != rows(section))
+    {
+        return false;
+    }
+    const float* data = row(section, 0);
+    vec.assign(data, data + cols(section));
+    return true;
+}
+
+bool LaserModelFileReader::load(std::size_t section, std::vector<std::vector<float> >& mat) const
+{
+    if (section >= sections_.size())
+    {
+        return false;
+    }
+    const std::size_t n = rows(section);
+    const std::size_t c = cols(section);
+    mat.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const float* data = row(section, i);
+        mat[i].assign(data, data + c);
+    }
+    return true;
+}
+
+bool LaserModelFileReader::load(std::size_t section, std::vector<LaserOnlineModel>& models) const
+{
+    if (section >= sections_.size() || 0 == cols(section))
+    {
+        return false;
+    }
+    const std::size_t n = rows(section);
+    const std::size_t c = cols(section);
+    models.resize(n);
+    std::vector<float> eta;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const float* data = row(section, i);
+        eta.assign(data + 1, data + c);
+        models[i] = LaserOnlineModel(data[0], eta);
+    }
+    return true;
+}
+
+std::string legacyModelPath(const std::string& workdir, const std::string& name)
+{
+    const std::string path = workdir + "/" + name;
+    if (boost::filesystem::exists(path))
+    {
+        return path;
+    }
+    if (boost::filesystem::exists(workdir + name))
+    {
+        return workdir + name;
+    }
+    return std::string();
+}
+
+} }
@@ -0,0 +1,152 @@
+#ifndef SF1R_LASER_MODEL_FILE_H
+#define SF1R_LASER_MODEL_FILE_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include <common/inttypes.h>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <glog/logging.h>
+
+namespace sf1r { namespace laser {
+class LaserOnlineModel;
+
+/*
+ * On-disk layout of a laser model file:
+ *
+ *   Header        magic, version, section number, crc32 and data size
+ *   SectionInfo[] rows, cols and file offset of every section
+ *   float data    row-major, each section aligned to ALIGNMENT bytes
+ *
+ * The crc32 covers everything after the header. Files are written to
+ * "filename.tmp" and renamed over "filename", so readers either see the
+ * old model or the new one, never a partial write.
+ */
+class LaserModelFile
+{
+public:
+    const static uint32_t MAGIC = 0x4d52534c; // "LSRM"
+    const static uint32_t VERSION = 1;
+    const static std::size_t ALIGNMENT = 64;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sectionNum;
+        uint32_t checksum;
+        uint64_t dataSize;
+        char padding[40];
+    };
+
+    struct SectionInfo
+    {
+        uint64_t rows;
+        uint64_t cols;
+        uint64_t offset;
+    };
+};
+
+class LaserModelFileWriter
+{
+    struct Section
+    {
+        std::size_t rows;
+        std::size_t cols;
+        const std::vector<float>* vec;
+        const std::vector<std::vector<float> >* mat;
+        const std::vector<LaserOnlineModel>* models;
+    };
+public:
+    LaserModelFileWriter(const std::string& filename);
+
+public:
+    // sections only hold pointers, sources must stay alive until commit()
+    void addSection(const std::vector<float>& vec);
+    void addSection(const std::vector<std::vector<float> >& mat);
+    // one row per model, laid out as [delta, eta...]
+    void addSection(const std::vector<LaserOnlineModel>& models);
+
+    bool commit();
+
+private:
+    void row(const Section& section, std::size_t i, std::vector<float>& buf) const;
+
+private:
+    const std::string filename_;
+    std::vector<Section> sections_;
+};
+
+class LaserModelFileReader
+{
+public:
+    LaserModelFileReader();
+    ~LaserModelFileReader();
+
+public:
+    // map the file read-only, returns false on missing file, version
+    // mismatch or checksum failure.
+    bool open(const std::string& filename);
+    void close();
+
+    std::size_t sectionNum() const
+    {
+        return sections_.size();
+    }
+
+    std::size_t rows(std::size_t section) const
+    {
+        return sections_[section].rows;
+    }
+
+    std::size_t cols(std::size_t section) const
+    {
+        return sections_[section].cols;
+    }
+
+    const float* row(std::size_t section, std::size_t i) const
+    {
+        const LaserModelFile::SectionInfo& info = sections_[section];
+        return reinterpret_cast<const float*>(addr_ + info.offset) + i * info.cols;
+    }
+
+    bool load(std::size_t section, std::vector<float>& vec) const;
+    bool load(std::size_t section, std::vector<std::vector<float> >& mat) const;
+    bool load(std::size_t section, std::vector<LaserOnlineModel>& models) const;
+
+private:
+    const char* addr_;
+    std::size_t size_;
+    std::vector<LaserModelFile::SectionInfo> sections_;
+};
+
+// the model file of boost::archive format saved by older versions, some of
+// them saved it without the separator after workdir. Returns empty string
+// if neither exists.
+std::string legacyModelPath(const std::string& workdir, const std::string& name);
+
+// deserialize the model of boost::archive format, returns false on missing
+// file or archive error.
+template <typename Model>
+bool loadLegacyModel(const std::string& filename, Model& model)
+{
+    std::ifstream ifs(filename.c_str(), std::ios::binary);
+    if (!ifs)
+    {
+        return false;
+    }
+    try
+    {
+        boost::archive::binary_iarchive ia(ifs);
+        ia >> model;
+    }
+    catch(std::exception& e)
+    {
+        LOG(ERROR)<<"load legacy model "<<filename<<" failed: "<<e.what();
+        return false;
+    }
+    return true;
+}
+
+} }
+#endif
@@ -1,7 +1,10 @@
 #include "LaserModel.h"
 #include "LaserOfflineModel.h"
+#include "LaserModelFile.h"
 #include "AdIndexManager.h"
+#include "EpochManager.h"
 #include <boost/filesystem.hpp>
+#include <algorithm>
 #include <fstream>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -47,7 +50,6 @@ LaserOfflineModel::LaserOfflineModel(const AdIndexManager& adIndexer,
     , betaStable_(NULL)
     , conjunction_(NULL)
     , conjunctionStable_(NULL)
-    , threadGroup_(NULL)
     , origBetaStable_(NULL)
     , origConjunctionStable_(NULL)
 {
@@ -65,26 +67,31 @@ LaserOfflineModel::LaserOfflineModel(const AdIndexManager& adIndexer,
     }
     origConjunctionStable_ = new OrigConjunctionStableDB(conjunctionDB);
    
-    if (boost::filesystem::exists(filename_))
+    if (boost::filesystem::exists(filename_ + ".bin") ||
+        boost::filesystem::exists(filename_))
     {
         alpha_ = new std::vector<float>();
         beta_ = new std::vector<float>();
-        betaStable_ = new std::vector<float>();
         conjunction_ = new std::vector<std::vector<float> >();
-        conjunctionStable_ = new std::vector<std::vector<float> >();
-        load();
+        std::vector<float> betaStable;
+        std::vector<std::vector<float> > conjunctionStable;
+        load(betaStable, conjunctionStable);
+        betaStable_ = new EpochRowTable<float>(betaStable);
+        conjunctionStable_ = new EpochRowTable<std::vector<float> >(conjunctionStable);
     }
     else
     {
         alpha_ = new std::vector<float>(USER_FD_);
         beta_ = new std::vector<float>(AD_FD_);
-        betaStable_ = new std::vector<float>(adDimension_);
+        std::vector<float> betaStable(adDimension_);
         std::vector<float> adZero(USER_FD_);
         conjunction_ = new std::vector<std::vector<float> >(USER_FD, adZero);
-        conjunctionStable_ = new std::vector<std::vector<float> >(adDimension_, adZero);
+        std::vector<std::vector<float> > conjunctionStable(adDimension_, adZero);
         LOG(INFO)<<"init per-item-online-model from original model, since localized model doesn't exist. \
             This procedure may be slow, be patient";
-        localizeFromOrigModel();
+        localizeFromOrigModel(betaStable, conjunctionStable);
+        betaStable_ = new EpochRowTable<float>(betaStable);
+        conjunctionStable_ = new EpochRowTable<std::vector<float> >(conjunctionStable);
         LOG(INFO)<<"save model to local";
         save();
     }
@@ -131,15 +138,9 @@ LaserOfflineModel::LaserOfflineModel(const AdIndexManager& adIndexer,
 
 LaserOfflineModel::~LaserOfflineModel()
 {
-    if (NULL != threadGroup_)
-    {
-        threadGroup_->join_all();
-        delete threadGroup_;
-    }
     if (NULL != alpha_)
     {
-        delete alpha_;
-        alpha_ = NULL;
+        delete alpha_.exchange(NULL);
     }
     if (NULL != beta_)
     {
@@ -148,8 +149,7 @@ LaserOfflineModel::~LaserOfflineModel()
     }
     if (NULL != betaStable_)
     {
-        delete betaStable_;
-        betaStable_ = NULL;
+        delete betaStable_.exchange(NULL);
     }
     if (NULL != conjunction_)
     {
@@ -158,8 +158,7 @@ LaserOfflineModel::~LaserOfflineModel()
     }
     if (NULL != conjunctionStable_)
     {
-        delete conjunctionStable_;
-        conjunctionStable_ = NULL;
+        delete conjunctionStable_.exchange(NULL);
     }
     if (NULL != origBetaStable_)
     {
@@ -181,12 +180,13 @@ float LaserOfflineModel::score(
 {
     float ret = score; 
     // x * alpha
-    ret += dot(*alpha_, user);
+    ret += dot(*alpha(), user);
     
     // c * beta
-    if (ad.first < betaStable_->size())
+    const EpochRowTable<float>& betaStable = *betaStable_.load(boost::memory_order_acquire);
+    if (ad.first < betaStable.size())
     {
-        ret += (*betaStable_)[ad.first];
+        ret += betaStable[ad.first];
     }
     else
     {
@@ -194,9 +194,10 @@ float LaserOfflineModel::score(
     }
     
     // x * A * c
-    if (ad.first < conjunctionStable_->size())
+    const EpochRowTable<std::vector<float> >& conjunctionStable = *conjunctionStable_.load(boost::memory_order_acquire);
+    if (ad.first < conjunctionStable.size())
     {
-        ret += dot((*conjunctionStable_)[ad.first], user);
+        ret += dot(conjunctionStable[ad.first], user);
     }
     else
     {
@@ -212,13 +213,17 @@ float LaserOfflineModel::score(
     const float score) const
 {
     float ret = score; 
-    // x * alpha
-    ret += dot(*alpha_, user);
+    // x * alpha, zero without the user context like the sparse one
+    if (!user.empty())
+    {
+        ret += dot(*alpha(), user);
+    }
     
     // c * beta
-    if (ad.first < betaStable_->size())
+    const EpochRowTable<float>& betaStable = *betaStable_.load(boost::memory_order_acquire);
+    if (ad.first < betaStable.size())
     {
-        ret += (*betaStable_)[ad.first];
+        ret += betaStable[ad.first];
     }
     else
     {
@@ -226,9 +231,10 @@ float LaserOfflineModel::score(
     }
     
     // x * A * c
-    if (ad.first < conjunctionStable_->size())
+    const EpochRowTable<std::vector<float> >& conjunctionStable = *conjunctionStable_.load(boost::memory_order_acquire);
+    if (ad.first < conjunctionStable.size() && !user.empty())
     {
-        ret += dot((*conjunctionStable_)[ad.first], user);
+        ret += dot(conjunctionStable[ad.first], user);
     }
     else
     {
@@ -256,8 +262,16 @@ void LaserOfflineModel::dispatch(const std::string& method, msgpack::rpc::reques
         docid_t adid = 0;
         if (adIndexer_.convertDocId(DOCID, adid))
         {
-            (*betaStable_)[adid] = stable.betaStable();
-            (*conjunctionStable_)[adid] = stable.conjunctionStable();
+            // swap the rows, recommend threads may still read the old ones
+            boost::mutex::scoped_lock lock(updateMutex_);
+            EpochRowTable<float>* betaStable = betaStable_.load(boost::memory_order_acquire);
+            EpochRowTable<std::vector<float> >* conjunctionStable =
+                conjunctionStable_.load(boost::memory_order_acquire);
+            if (adid < betaStable->size() && adid < conjunctionStable->size())
+            {
+                betaStable->update(adid, stable.betaStable());
+                conjunctionStable->update(adid, stable.conjunctionStable());
+            }
         }
         req.result(true);
     }
@@ -266,34 +280,29 @@ void LaserOfflineModel::dispatch(const std::string& method, msgpack::rpc::reques
         LOG(INFO)<<"update OfflineModel ..."; 
         msgpack::type::tuple<std::vector<float>, std::vector<float>, std::vector<std::vector<float> > > params;
         req.params().convert(&params);
-        if (params.get<0>().size() != alpha_->size())
-        {
-            LOG(ERROR)<<"Dimension Mismatch";
-            req.result(false);
-            return;
-        }
-        *alpha_ = params.get<0>();
-        if (params.get<1>().size() != beta_->size())
-        {
-            LOG(ERROR)<<"Dimension Mismatch";
-            req.result(false);
-            return;
-        }
-        *beta_ = params.get<1>();
+        boost::mutex::scoped_lock lock(updateMutex_);
         const std::vector<std::vector<float> >& conjunction = params.get<2>();
-        if (conjunction.size() != conjunction_->size() ||
-            conjunction[0].size() != (*conjunction_)[0].size())
+        // check all of them before any is published, so that a rejected
+        // update leaves the whole old model
+        if (params.get<0>().size() != alpha()->size() ||
+            params.get<1>().size() != beta_->size() ||
+            conjunction.size() != conjunction_->size() ||
+            (!conjunction.empty() && conjunction[0].size() != (*conjunction_)[0].size()))
         {
             LOG(ERROR)<<"Dimension Mismatch";
             req.result(false);
             return;
         }
-        *conjunction_ = params.get<2>();
+        // copy on write, recommend threads may still read the old one
+        EpochManager::get()->retire(alpha_.exchange(new std::vector<float>(params.get<0>())));
+        *beta_ = params.get<1>();
+        *conjunction_ = conjunction;
         req.result(true);
     }
     else if ("finish_offline_model" == method)
     {
         LOG(INFO)<<"save offline model";
+        boost::mutex::scoped_lock lock(updateMutex_);
         save();
         saveOrigModel();
         req.result(true);
@@ -306,34 +315,65 @@ void LaserOfflineModel::dispatch(const std::string& method, msgpack::rpc::reques
 
 void LaserOfflineModel::save()
 {
-    std::ofstream ofs(filename_.c_str(), std::ofstream::binary | std::ofstream::trunc);
-    boost::archive::binary_oarchive oa(ofs);
-    try
-    {
-        oa << alpha_;
-        oa << beta_;
-        oa << betaStable_;
-        oa << conjunction_;
-        oa << conjunctionStable_;
-    }
-    catch(std::exception& e)
+    std::vector<float> betaStable;
+    betaStable_.load()->copyTo(betaStable);
+    std::vector<std::vector<float> > conjunctionStable;
+    conjunctionStable_.load()->copyTo(conjunctionStable);
+
+    LaserModelFileWriter writer(filename_ + ".bin");
+    writer.addSection(*alpha());
+    writer.addSection(*beta_);
+    writer.addSection(betaStable);
+    writer.addSection(*conjunction_);
+    writer.addSection(conjunctionStable);
+    if (!writer.commit())
     {
-        LOG(INFO)<<e.what();
+        LOG(ERROR)<<"save offline model failed";
     }
-    ofs.close();
 }
 
-void LaserOfflineModel::load()
+void LaserOfflineModel::load(std::vector<float>& betaStable,
+    std::vector<std::vector<float> >& conjunctionStable)
 {
+    LaserModelFileReader reader;
+    if (reader.open(filename_ + ".bin") && 5 == reader.sectionNum() &&
+        reader.load(0, *alpha_.load()) &&
+        reader.load(1, *beta_) &&
+        reader.load(2, betaStable) &&
+        reader.load(3, *conjunction_) &&
+        reader.load(4, conjunctionStable))
+    {
+        return;
+    }
+    // fall back to the boost::archive format of older versions
+    if (!boost::filesystem::exists(filename_))
+    {
+        return;
+    }
+    LOG(INFO)<<"load offline model from legacy archive";
     std::ifstream ifs(filename_.c_str(), std::ios::binary);
     boost::archive::binary_iarchive ia(ifs);
     try
     {
-        ia >> alpha_;
+        std::vector<float>* alpha = alpha_;
+        std::vector<float>* pBetaStable = &betaStable;
+        std::vector<std::vector<float> >* pConjunctionStable = &conjunctionStable;
+        ia >> alpha;
         ia >> beta_;
-        ia >> betaStable_;
+        ia >> pBetaStable;
         ia >> conjunction_;
-        ia >> conjunctionStable_;
+        ia >> pConjunctionStable;
+        alpha_ = alpha;
+        if (pBetaStable != &betaStable)
+        {
+            betaStable.swap(*pBetaStable);
+            delete pBetaStable;
+        }
+        if (pConjunctionStable != &conjunctionStable)
+        {
+            conjunctionStable.swap(*pConjunctionStable);
+            delete pConjunctionStable;
+        }
     }
     catch(std::exception& e)
     {
@@ -344,39 +384,74 @@ void LaserOfflineModel::load()
     
 void LaserOfflineModel::updateAdDimension(const std::size_t adDimension)
 {
-    betaStable_->resize(adDimension);
-    std::vector<float> adZero(AD_FD_);
-    conjunctionStable_->resize(adDimension, adZero);
-    if (NULL != threadGroup_)
+    // one dimension change at a time, the updates go on while precomputing
+    boost::mutex::scoped_lock dimensionLock(dimensionMutex_);
+    std::size_t startId = 0;
+    std::vector<float> beta;
+    std::vector<std::vector<float> > conjunction;
     {
-        LOG(INFO)<<"wait last time's pre-compute threads finish";
-        threadGroup_->join_all();
-        delete threadGroup_;
+        boost::mutex::scoped_lock lock(updateMutex_);
+        startId = std::min(adDimension_, adDimension);
+        beta = *beta_;
+        conjunction = *conjunction_;
     }
-    threadGroup_ = new boost::thread_group();
+
+    // the rows of the new ads, from startId
+    std::vector<float> newBetaStable(adDimension - startId);
+    std::vector<std::vector<float> > newConjunctionStable(adDimension - startId);
+    boost::thread_group threadGroup;
     for (int i = 0; i < THREAD_NUM; ++i)
     {
-        threadGroup_->create_thread(
+        threadGroup.create_thread(
             boost::bind(&LaserOfflineModel::precompute, this,
-                        adDimension_, adDimension, i));
+                        startId, adDimension, i,
+                        boost::cref(beta), boost::cref(conjunction),
+                        &newBetaStable, &newConjunctionStable));
     }
+    threadGroup.join_all();
+
+    boost::mutex::scoped_lock lock(updateMutex_);
+    // copy on write, recommend threads may still read the old ones, the
+    // rows of the existing ads are copied now to keep their updates
+    std::vector<float> betaStable;
+    betaStable_.load()->copyTo(betaStable);
+    betaStable.resize(adDimension);
+    std::copy(newBetaStable.begin(), newBetaStable.end(), betaStable.begin() + startId);
+    std::vector<std::vector<float> > conjunctionStable;
+    conjunctionStable_.load()->copyTo(conjunctionStable);
+    conjunctionStable.resize(adDimension);
+    for (std::size_t i = 0; i < newConjunctionStable.size(); ++i)
+    {
+        conjunctionStable[startId + i].swap(newConjunctionStable[i]);
+    }
+
+    EpochManager::get()->retire(betaStable_.exchange(
+        new EpochRowTable<float>(betaStable)));
+    EpochManager::get()->retire(conjunctionStable_.exchange(
+        new EpochRowTable<std::vector<float> >(conjunctionStable)));
     adDimension_ = adDimension;
 }
     
-void LaserOfflineModel::precompute(std::size_t startId, std::size_t endId, int threadId)
+void LaserOfflineModel::precompute(std::size_t startId, std::size_t endId, int threadId,
+    const std::vector<float>& beta,
+    const std::vector<std::vector<float> >& conjunction,
+    std::vector<float>* betaStable,
+    std::vector<std::vector<float> >* conjunctionStable) const
 {
     for (std::size_t adId = startId; adId < endId; ++adId)
     {
-        if (0 != adId % THREAD_NUM)
+        if ((std::size_t)threadId != adId % THREAD_NUM)
             continue;
 
         std::vector<std::pair<int, float> > vec;
         adIndexer_.get(adId, vec);
-        (*betaStable_)[adId] = dot(*beta_, vec);
+        (*betaStable)[adId - startId] = dot(beta, vec);
         
-        std::vector<float>& row = (*conjunctionStable_)[adId];
-        std::vector<std::vector<float> >::const_iterator it = conjunction_->begin();
-        for (; it != conjunction_->end(); ++it)
+        std::vector<float>& row = (*conjunctionStable)[adId - startId];
+        row.clear();
+        row.reserve(conjunction.size());
+        std::vector<std::vector<float> >::const_iterator it = conjunction.begin();
+        for (; it != conjunction.end(); ++it)
         {
             row.push_back(dot(*it, vec));
         }
@@ -389,7 +464,7 @@ void LaserOfflineModel::saveOrigModel()
     boost::archive::binary_oarchive oa(ofs);
     try
     {
-        oa << *alpha_;
+        oa << *alpha();
         oa << *beta_;
         oa << *conjunction_;
     }
@@ -400,16 +475,17 @@ void LaserOfflineModel::saveOrigModel()
     ofs.close();
 }
 
-void LaserOfflineModel::localizeFromOrigModel()
+void LaserOfflineModel::localizeFromOrigModel(std::vector<float>& betaStable,
+    std::vector<std::vector<float> >& conjunctionStable)
 {
     {
         OrigBetaStableDB::iterator it = origBetaStable_->begin();
         for (; it != origBetaStable_->end(); ++it)
         {
             docid_t id = 0;
-            if (adIndexer_.convertDocId(it->first, id))
+            if (adIndexer_.convertDocId(it->first, id) && id < betaStable.size())
             {
-                (*betaStable_)[id] = it->second;
+                betaStable[id] = it->second;
             }
         }
     }
@@ -419,9 +495,9 @@ void LaserOfflineModel::localizeFromOrigModel()
         for (; it != origConjunctionStable_->end(); ++it)
         {
             docid_t id = 0;
-            if (adIndexer_.convertDocId(it->first, id))
+            if (adIndexer_.convertDocId(it->first, id) && id < conjunctionStable.size())
             {
-                (*conjunctionStable_)[id] = it->second;
+                conjunctionStable[id] = it->second;
             }
         }
     }
@@ -437,7 +513,7 @@ void LaserOfflineModel::localizeFromOrigModel()
     boost::archive::binary_iarchive ia(ifs);
     try
     {
-        ia >> *alpha_;
+        ia >> *alpha_.load();
         ia >> *beta_;
         ia >> *conjunction_;
     }
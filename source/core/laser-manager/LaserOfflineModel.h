@@ -2,6 +2,9 @@
 #define LASER_OFFLINE_MODEL_H
 #include "LaserModel.h"
 #include "LaserModelDB.h"
+#include "EpochRowTable.h"
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 
 namespace sf1r { namespace laser {
 class AdIndexManager;
@@ -67,41 +70,52 @@ public:
     
     void setAlpha(std::vector<float>& alpha)
     {
-        alpha_->swap(alpha);
+        std::vector<float>* newAlpha = new std::vector<float>();
+        newAlpha->swap(alpha);
+        EpochManager::get()->retire(alpha_.exchange(newAlpha));
     }
 
     void setBeta(std::vector<float>& beta)
     {
+        boost::mutex::scoped_lock lock(updateMutex_);
         beta_->swap(beta);
     }
     
     void setConjunction(std::vector<std::vector<float> >& quadratic)
     {
+        boost::mutex::scoped_lock lock(updateMutex_);
         conjunction_->swap(quadratic);
     }
     
     void save();
-    void load();
 
-    void precompute(std::size_t startId, std::size_t endId, int threadId);
+    // fill the rows of the ads in [startId, endId) from startId
+    void precompute(std::size_t startId, std::size_t endId, int threadId,
+        const std::vector<float>& beta,
+        const std::vector<std::vector<float> >& conjunction,
+        std::vector<float>* betaStable,
+        std::vector<std::vector<float> >* conjunctionStable) const;
 
     const std::vector<float>* alpha() const
     {
-        return alpha_;
+        return alpha_.load(boost::memory_order_acquire);
     }
 
-    const std::vector<float>* betaStable() const
+    const EpochRowTable<float>* betaStable() const
     {
-        return betaStable_;
+        return betaStable_.load(boost::memory_order_acquire);
     }
 
-    const std::vector<std::vector<float> >* conjunctionStable() const
+    const EpochRowTable<std::vector<float> >* conjunctionStable() const
     {
-        return conjunctionStable_;
+        return conjunctionStable_.load(boost::memory_order_acquire);
     }
 private:
+    void load(std::vector<float>& betaStable,
+        std::vector<std::vector<float> >& conjunctionStable);
     void saveOrigModel();
-    void localizeFromOrigModel();
+    void localizeFromOrigModel(std::vector<float>& betaStable,
+        std::vector<std::vector<float> >& conjunctionStable);
 private:
     const AdIndexManager& adIndexer_;
     const std::string filename_;
@@ -109,12 +123,18 @@ private:
     std::size_t adDimension_;
     const std::size_t AD_FD_;
     const std::size_t USER_FD_;
-    std::vector<float>* alpha_;
+    // replaced as a whole on update, see EpochManager
+    boost::atomic<std::vector<float>*> alpha_;
+    // only read by the writers under updateMutex_
     std::vector<float>* beta_;
-    std::vector<float>* betaStable_;
+    // rows swapped on update, replaced as a whole on dimension change
+    boost::atomic<EpochRowTable<float>*> betaStable_;
     std::vector<std::vector<float> >* conjunction_;
-    std::vector<std::vector<float> >* conjunctionStable_;
-    boost::thread_group* threadGroup_;
+    boost::atomic<EpochRowTable<std::vector<float> >*> conjunctionStable_;
+    // serialize the updates with the dimension change
+    boost::mutex updateMutex_;
+    // serialize the dimension changes, which precompute out of updateMutex_
+    boost::mutex dimensionMutex_;
     OrigBetaStableDB* origBetaStable_;
     OrigConjunctionStableDB* origConjunctionStable_;
     const static int THREAD_NUM = 4;
@@ -2,8 +2,10 @@
 #include "LaserModel.h"
 #include "LaserModelFactory.h"
 #include "LaserManager.h"
+#include "EpochManager.h"
 #include <glog/logging.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/unordered_map.hpp>
 
 
 namespace sf1r { namespace laser {
@@ -12,10 +14,19 @@ LaserRecommend::LaserRecommend(const LaserManager* laserManager)
     : laserManager_(laserManager)
     , factory_(NULL)
     , model_(NULL)
+    , epoch_(EpochManager::get())
 {
     factory_ = new LaserModelFactory(*laserManager_);
-    model_ = factory_->createModel(laserManager_->para_, 
-        laserManager_->workdir_ + "/model/");
+    model_.store(factory_->createModel(laserManager_->para_, 
+        laserManager_->workdir_ + "/model/"));
+}
+
+LaserRecommend::LaserRecommend(LaserModel* model)
+    : laserManager_(NULL)
+    , factory_(NULL)
+    , model_(model)
+    , epoch_(EpochManager::get())
+{
 }
 
 LaserRecommend::~LaserRecommend()
@@ -25,26 +36,33 @@ LaserRecommend::~LaserRecommend()
         delete factory_;
         factory_ = NULL;
     }
-    if (NULL != model_)
+    LaserModel* model = model_.exchange(NULL);
+    if (NULL != model)
     {
-        delete model_;
-        model_ = NULL;
+        epoch_->retire(model);
     }
 }
     
-void LaserRecommend::preUpdateAdDimension()
-{
-    mutex_.lock();
-}
-
-void LaserRecommend::postUpdateAdDimension()
+void LaserRecommend::updateAdDimension(const std::size_t adDimension)
 {
-    mutex_.unlock();
+    // pin the model instead of taking updateMutex_, the model precomputes
+    // for a while and serializes with its updates by itself
+    EpochManager::ReadGuard guard(*epoch_);
+    LaserModel* model = model_.load(boost::memory_order_acquire);
+    if (NULL != model)
+    {
+        model->updateAdDimension(adDimension);
+    }
 }
 
-void LaserRecommend::updateAdDimension(const std::size_t adDimension)
+void LaserRecommend::swapModel(LaserModel* model)
 {
-    model_->updateAdDimension(adDimension);
+    boost::mutex::scoped_lock lock(updateMutex_);
+    LaserModel* old = model_.exchange(model);
+    if (NULL != old)
+    {
+        epoch_->retire(old);
+    }
 }
 
 bool LaserRecommend::recommend(const std::string& text, 
@@ -52,20 +70,22 @@ bool LaserRecommend::recommend(const std::string& text,
     std::vector<float>& itemScoreList, 
     const std::size_t num) const
 {
+    // pin the model, context, candidate and score all see the same one
+    EpochManager::ReadGuard guard(*epoch_);
+    const LaserModel* model = model_.load(boost::memory_order_acquire);
+    if (NULL == model)
     {
-        boost::shared_lock<boost::shared_mutex> sharedLock(mutex_, boost::try_to_lock);
-        if (!sharedLock)
-            return false;
+        return false;
     }
     std::vector<float> context;
-    if (!model_->context(text, context))
+    if (!model->context(text, context))
     {
         return false;
     }
     boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
     std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > > ad;
     std::vector<float> score;
-    if (!model_->candidate(text, 1000, context, ad, score))
+    if (!model->candidate(text, 1000, context, ad, score))
     {
         return false;
     }
@@ -74,25 +94,158 @@ bool LaserRecommend::recommend(const std::string& text,
    
     priority_queue queue;
     stime = boost::posix_time::microsec_clock::local_time();
+    {
+        // a batch of one user, the model resolves per-user state once
+        const std::vector<std::string> users(1, text);
+        const std::vector<std::vector<float> > contexts(1, context);
+        std::vector<std::size_t> offset(ad.size() + 1);
+        for (std::size_t i = 0; i <= ad.size(); ++i)
+        {
+            offset[i] = i;
+        }
+        const std::vector<std::size_t> owner(ad.size(), 0);
+        model->score(users, contexts, ad, offset, owner, score);
+    }
     for (std::size_t i = 0; i < ad.size(); ++i)
     {
-        topn(ad[i].first, model_->score(text, context,  ad[i], score[i]), num, queue);   
-        //model_->score(text, context,  ad[i], score[i]);   
+        topn(ad[i].first, score[i], num, queue);   
     }
     etime = boost::posix_time::microsec_clock::local_time();
     LOG(INFO)<<"score time = "<<(etime-stime).total_milliseconds();
+    output(queue, itemList, itemScoreList);
+    return true;
+}
+
+bool LaserRecommend::recommend(const std::vector<std::string>& text, 
+    std::vector<std::vector<docid_t> >& itemList, 
+    std::vector<std::vector<float> >& itemScoreList, 
+    const std::size_t num) const
+{
+    EpochManager::ReadGuard guard(*epoch_);
+    const LaserModel* model = model_.load(boost::memory_order_acquire);
+    if (NULL == model)
+    {
+        return false;
+    }
+    const std::size_t userNum = text.size();
+    itemList.assign(userNum, std::vector<docid_t>());
+    itemScoreList.assign(userNum, std::vector<float>());
+    
+    // users without context get an empty result, like a failed recommend
+    std::vector<std::vector<float> > context(userNum);
+    std::vector<std::size_t> users;
+    for (std::size_t u = 0; u < userNum; ++u)
+    {
+        if (model->context(text[u], context[u]))
+        {
+            users.push_back(u);
+        }
+    }
+    if (users.empty())
+    {
+        return false;
+    }
+    
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    // union of all candidates, the users owning ad[i] are 
+    // owner[offset[i]] ... owner[offset[i + 1] - 1]
+    std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > > ad;
+    std::vector<std::size_t> offset;
+    std::vector<std::size_t> owner;
+    std::vector<float> score;
+    if (model->isSharedCandidate())
+    {
+        std::vector<float> candidateScore;
+        if (!model->candidate(text[users[0]], 1000, context[users[0]], ad, candidateScore))
+        {
+            return false;
+        }
+        offset.reserve(ad.size() + 1);
+        owner.reserve(ad.size() * users.size());
+        score.reserve(ad.size() * users.size());
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            offset.push_back(owner.size());
+            owner.insert(owner.end(), users.begin(), users.end());
+            score.insert(score.end(), users.size(), candidateScore[i]);
+        }
+        offset.push_back(owner.size());
+    }
+    else
     {
-        while (!queue.empty())
+        // group the (ad, user) pairs by ad
+        boost::unordered_map<docid_t, std::size_t> adIndex;
+        std::vector<std::vector<std::pair<std::size_t, float> > > pairs;
+        for (std::size_t i = 0; i < users.size(); ++i)
+        {
+            std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > > userAd;
+            std::vector<float> userScore;
+            if (!model->candidate(text[users[i]], 1000, context[users[i]], userAd, userScore))
+            {
+                continue;
+            }
+            for (std::size_t k = 0; k < userAd.size(); ++k)
+            {
+                std::pair<boost::unordered_map<docid_t, std::size_t>::iterator, bool> it = 
+                    adIndex.insert(std::make_pair(userAd[k].first, ad.size()));
+                if (it.second)
+                {
+                    ad.push_back(std::pair<docid_t, std::vector<std::pair<int, float> > >());
+                    ad.back().first = userAd[k].first;
+                    ad.back().second.swap(userAd[k].second);
+                    pairs.push_back(std::vector<std::pair<std::size_t, float> >());
+                }
+                pairs[it.first->second].push_back(std::make_pair(users[i], userScore[k]));
+            }
+        }
+        offset.reserve(ad.size() + 1);
+        for (std::size_t i = 0; i < ad.size(); ++i)
         {
-           itemList.push_back(queue.top().first);
-           itemScoreList.push_back(1.0 / (1 + exp(-1 * queue.top().second)));
-           //itemScoreList.push_back(queue.top().second);
-           queue.pop();
+            offset.push_back(owner.size());
+            for (std::size_t k = 0; k < pairs[i].size(); ++k)
+            {
+                owner.push_back(pairs[i][k].first);
+                score.push_back(pairs[i][k].second);
+            }
         }
+        offset.push_back(owner.size());
+    }
+    boost::posix_time::ptime etime = boost::posix_time::microsec_clock::local_time();
+    LOG(INFO)<<"batch candidate time = "<<(etime-stime).total_milliseconds()<<"\t ad size = "<<ad.size()
+        <<"\t user size = "<<users.size();
+    
+    stime = boost::posix_time::microsec_clock::local_time();
+    model->score(text, context, ad, offset, owner, score);
+    std::vector<priority_queue> queue(userNum);
+    for (std::size_t i = 0; i < ad.size(); ++i)
+    {
+        for (std::size_t k = offset[i]; k < offset[i + 1]; ++k)
+        {
+            topn(ad[i].first, score[k], num, queue[owner[k]]);
+        }
+    }
+    etime = boost::posix_time::microsec_clock::local_time();
+    LOG(INFO)<<"batch score time = "<<(etime-stime).total_milliseconds();
+    for (std::size_t u = 0; u < userNum; ++u)
+    {
+        output(queue[u], itemList[u], itemScoreList[u]);
+    }
+    return true;
+}
+
+void LaserRecommend::output(priority_queue& queue, 
+    std::vector<docid_t>& itemList, 
+    std::vector<float>& itemScoreList) const
+{
+    while (!queue.empty())
+    {
+       itemList.push_back(queue.top().first);
+       itemScoreList.push_back(1.0 / (1 + exp(-1 * queue.top().second)));
+       //itemScoreList.push_back(queue.top().second);
+       queue.pop();
     }
     std::reverse(itemList.begin(), itemList.end());
     std::reverse(itemScoreList.begin(), itemScoreList.end());
-    return true;
 }
 
 void LaserRecommend::topn(const docid_t& docid, const float score, const std::size_t n, priority_queue& queue) const
@@ -113,7 +266,15 @@ void LaserRecommend::topn(const docid_t& docid, const float score, const std::si
 
 void LaserRecommend::dispatch(const std::string& method, msgpack::rpc::request& req)
 {
-    model_->dispatch(method, req);
+    // pin the model, it is not blocked by a dimension change
+    EpochManager::ReadGuard guard(*epoch_);
+    LaserModel* model = model_.load(boost::memory_order_acquire);
+    if (NULL == model)
+    {
+        req.error("Laser model unavailable");
+        return;
+    }
+    model->dispatch(method, req);
 }
     
 } }
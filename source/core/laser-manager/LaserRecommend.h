@@ -6,6 +6,8 @@
 #include <common/inttypes.h>
 #include <3rdparty/msgpack/msgpack.hpp>
 #include <3rdparty/msgpack/rpc/server.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 #include <queue>
 namespace sf1r {
 class LaserManager;
@@ -14,6 +16,7 @@ class LaserManager;
 namespace sf1r { namespace laser {
 class LaserModel;
 class LaserModelFactory;
+class EpochManager;
 
 class LaserRecommend
 {
@@ -22,6 +25,8 @@ typedef std::priority_queue<std::pair<docid_t, float>, std::vector<std::pair<doc
 
 public:
     LaserRecommend(const LaserManager* laserManager);
+    // serve a prebuilt model, takes the ownership
+    LaserRecommend(LaserModel* model);
     ~LaserRecommend();
 public:
     bool recommend(const std::string& text, 
@@ -29,19 +34,30 @@ public:
         std::vector<float>& itemScoreList, 
         const std::size_t num) const;
     
+    // recommend for several users at once, candidates and ad rows shared
+    // between the users are fetched and scored in one pass
+    bool recommend(const std::vector<std::string>& text, 
+        std::vector<std::vector<docid_t> >& itemList, 
+        std::vector<std::vector<float> >& itemScoreList, 
+        const std::size_t num) const;
+    
     void dispatch(const std::string& method, msgpack::rpc::request& req);
 
-    void preUpdateAdDimension();
-    void postUpdateAdDimension();
     void updateAdDimension(const std::size_t adDimension);
 
+    // publish a new model, the old one is deleted once no recommend uses it
+    void swapModel(LaserModel* model);
+
 private:
     void topn(const docid_t& docid, const float score, const std::size_t n, priority_queue& queue) const;
+    void output(priority_queue& queue, std::vector<docid_t>& itemList, std::vector<float>& itemScoreList) const;
 private:
     const LaserManager* laserManager_;
     const LaserModelFactory* factory_;
-    LaserModel* model_;
-    mutable boost::shared_mutex mutex_;
+    boost::atomic<LaserModel*> model_;
+    EpochManager* epoch_;
+    // serialize the model swaps, the others pin the model by EpochManager
+    boost::mutex updateMutex_;
 };
 
 } }
@@ -1,5 +1,7 @@
 #ifndef SF1R_LASER_RECOMMEND_PARAM_H
 #define SF1R_LASER_RECOMMEND_PARAM_H
+#include <string>
+#include <vector>
 
 namespace sf1r
 {
@@ -11,6 +13,13 @@ public:
     std::string text_;
     unsigned topN_;
 };
+
+class LaserBatchRecommendParam
+{
+public:
+    std::vector<std::string> texts_;
+    unsigned topN_;
+};
 }
 }
 #endif
@@ -147,6 +147,19 @@ void LaserRpcServer::dispatch(msgpack::rpc::request req)
             req.params().convert(&params);
             laserManager->getUserInfoByUrl(params.get<0>(), params.get<1>(), );
         }*/
+        else if ("batch_recommend" == method)
+        {
+            // (texts, topn) -> (docids of each text, scores of each text)
+            msgpack::type::tuple<std::vector<std::string>, uint32_t> params;
+            req.params().convert(&params);
+            msgpack::type::tuple<std::vector<std::vector<docid_t> >, std::vector<std::vector<float> > > res;
+            if (!laserManager->recommend_->recommend(params.get<0>(), res.get<0>(), res.get<1>(), params.get<1>()))
+            {
+                req.error("batch recommend failed");
+                return;
+            }
+            req.result(res);
+        }
         else if ("update_topn_clustering" == method ||
                  "ad_feature" == method || 
                  "ad_feature|size" == method || 
@@ -0,0 +1,126 @@
+#include "TokenizeCache.h"
+#include <util/hashFunction.h>
+#include <string.h>
+#include <algorithm>
+
+namespace sf1r { namespace laser {
+
+TokenizeCache::TokenizeCache(const std::size_t capacity, HashFunction hash)
+    : hash_(hash)
+    , shardCapacity_(0 == capacity ? 0 : std::max(capacity / SHARD_NUM, (std::size_t)1))
+    , shards_(NULL)
+{
+    shards_ = new Shard[SHARD_NUM];
+    for (std::size_t i = 0; i < SHARD_NUM; ++i)
+    {
+        memset(&shards_[i].stats, 0, sizeof(Stats));
+    }
+}
+
+TokenizeCache::~TokenizeCache()
+{
+    if (NULL != shards_)
+    {
+        delete[] shards_;
+        shards_ = NULL;
+    }
+}
+
+TokenizeCache::TokenVectorPtr TokenizeCache::get(const std::string& title)
+{
+    const uint64_t hash = hash_(title);
+    Shard& shard = shard_(hash);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    Index::iterator it = shard.index.find(hash);
+    if (shard.index.end() == it || it->second->title != title)
+    {
+        ++shard.stats.misses;
+        return TokenVectorPtr();
+    }
+    ++shard.stats.hits;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    return it->second->vec;
+}
+
+TokenizeCache::TokenVectorPtr TokenizeCache::insert(const std::string& title, TokenSparseVector& vec)
+{
+    boost::shared_ptr<TokenSparseVector> value(new TokenSparseVector());
+    value->swap(vec);
+    if (0 == shardCapacity_)
+    {
+        return value;
+    }
+
+    const uint64_t hash = hash_(title);
+    Shard& shard = shard_(hash);
+    boost::mutex::scoped_lock lock(shard.mutex);
+    Index::iterator it = shard.index.find(hash);
+    if (shard.index.end() != it)
+    {
+        if (it->second->title == title)
+        {
+            return it->second->vec;
+        }
+        // another title with the same hash, the newer one takes the slot
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+    shard.lru.push_front(Entry());
+    Entry& entry = shard.lru.front();
+    entry.hash = hash;
+    entry.title = title;
+    entry.vec = value;
+    shard.index[hash] = shard.lru.begin();
+    if (shard.index.size() > shardCapacity_)
+    {
+        shard.index.erase(shard.lru.back().hash);
+        shard.lru.pop_back();
+        ++shard.stats.evictions;
+    }
+    return value;
+}
+
+TokenizeCache::Stats TokenizeCache::stats() const
+{
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (std::size_t i = 0; i < SHARD_NUM; ++i)
+    {
+        boost::mutex::scoped_lock lock(shards_[i].mutex);
+        stats.hits += shards_[i].stats.hits;
+        stats.misses += shards_[i].stats.misses;
+        stats.evictions += shards_[i].stats.evictions;
+    }
+    return stats;
+}
+
+std::size_t TokenizeCache::size() const
+{
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < SHARD_NUM; ++i)
+    {
+        boost::mutex::scoped_lock lock(shards_[i].mutex);
+        size += shards_[i].index.size();
+    }
+    return size;
+}
+
+uint64_t TokenizeCache::hash64_(const std::string& title)
+{
+    return izenelib::util::HashFunction<std::string>::generateHash64(title);
+}
+
+TokenizeCache::Shard& TokenizeCache::shard_(const uint64_t hash) const
+{
+    // similar titles differ in a few bits only, mix them all into the
+    // shard number, the low bits still pick the bucket inside the shard
+    uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return shards_[(h >> 32) % SHARD_NUM];
+}
+
+} }
@@ -0,0 +1,87 @@
+#ifndef SF1R_LASER_TOKENIZE_CACHE_H
+#define SF1R_LASER_TOKENIZE_CACHE_H
+#include <string>
+#include <vector>
+#include <list>
+#include <common/inttypes.h>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace sf1r { namespace laser {
+
+/*
+ * Bounded LRU of tokenized titles keyed by the 64 bit hash of the title,
+ * split into shards with a lock each, so concurrent recommend threads
+ * rarely meet. A hit only copies a shared pointer and never allocates.
+ *
+ * Entries keep their title, a title whose hash collides with a cached one
+ * misses and replaces it on insert.
+ */
+class TokenizeCache : boost::noncopyable
+{
+public:
+    typedef std::vector<std::pair<int, float> > TokenSparseVector;
+    typedef boost::shared_ptr<const TokenSparseVector> TokenVectorPtr;
+    typedef uint64_t (*HashFunction)(const std::string& title);
+
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+
+        float hitRate() const
+        {
+            return 0 == hits + misses ? 0.0 : (float)hits / (hits + misses);
+        }
+    };
+
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        std::string title;
+        TokenVectorPtr vec;
+    };
+    typedef std::list<Entry> LRUList;
+    typedef boost::unordered_map<uint64_t, LRUList::iterator> Index;
+
+    struct Shard
+    {
+        boost::mutex mutex;
+        LRUList lru;
+        Index index;
+        Stats stats;
+    };
+
+public:
+    // hash is only replaced by tests, to make titles collide
+    TokenizeCache(const std::size_t capacity, HashFunction hash = &TokenizeCache::hash64_);
+    ~TokenizeCache();
+
+public:
+    // NULL on a miss
+    TokenVectorPtr get(const std::string& title);
+
+    // vec is swapped into the cache and left empty, a concurrent insert of
+    // the same title may win, the cached vector is returned either way
+    TokenVectorPtr insert(const std::string& title, TokenSparseVector& vec);
+
+    Stats stats() const;
+    std::size_t size() const;
+
+private:
+    static uint64_t hash64_(const std::string& title);
+    Shard& shard_(const uint64_t hash) const;
+
+private:
+    const static std::size_t SHARD_NUM = 16;
+    const HashFunction hash_;
+    std::size_t shardCapacity_;
+    Shard* shards_;
+};
+
+} }
+#endif
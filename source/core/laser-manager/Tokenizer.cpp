@@ -5,6 +5,11 @@ using namespace ilplib::knlp;
 
 namespace sf1r { namespace laser {
 
+static bool lessIndex(const std::pair<int, float>& lv, const std::pair<int, float>& rv)
+{
+    return lv.first < rv.first;
+}
+
 Tokenizer::Tokenizer(const std::string& pcaDict, const std::string& termDict)
     : tok(NULL)
     , termDict_(NULL)
@@ -155,12 +160,20 @@ void Tokenizer::tokenize(const std::string& title, std::map<int, float>& vec) co
     
 void Tokenizer::tokenize(const std::string& title, std::vector<std::pair<int, float> >& vec) const
 {
-    typedef std::pair<std::string, float> TermPair;
-    std::vector<TermPair> tks;
-    std::vector<TermPair> subtks;
-    std::string brand, mdt;
-    tok->pca(title, tks, brand, mdt, subtks, false);
+    Buffer buffer;
+    tokenize(title, buffer, vec);
+}
+
+void Tokenizer::tokenize(const std::string& title, Buffer& buffer, std::vector<std::pair<int, float> >& vec) const
+{
+    buffer.tks.clear();
+    buffer.subtks.clear();
+    buffer.brand.clear();
+    buffer.mdt.clear();
+    vec.clear();
+    tok->pca(title, buffer.tks, buffer.brand, buffer.mdt, buffer.subtks, false);
     
+    const std::vector<std::pair<std::string, float> >& tks = buffer.tks;
     float total = 0;
     for (size_t i = 0; i < tks.size(); ++i)
     {
@@ -178,7 +191,9 @@ void Tokenizer::tokenize(const std::string& title, std::vector<std::pair<int, fl
         {
             it->second /= total;
         }
-        std::sort(vec.begin(), vec.end());
+        // a repeated term keeps the token order, so its last weight is the
+        // one the map overloads keep
+        std::stable_sort(vec.begin(), vec.end(), lessIndex);
     }
     else
     {
@@ -8,6 +8,16 @@ namespace sf1r { namespace laser {
 
 class Tokenizer
 {
+public:
+    // scratch space of the pca, reused across calls by one thread
+    struct Buffer
+    {
+        std::vector<std::pair<std::string, float> > tks;
+        std::vector<std::pair<std::string, float> > subtks;
+        std::string brand;
+        std::string mdt;
+    };
+
 public:
     Tokenizer(const std::string& pcaDict, const std::string& termDict);
     Tokenizer(const std::string& termDict);
@@ -18,6 +28,8 @@ public:
     void tokenize(const std::string& title, boost::unordered_map<int, float>& vec) const;
     void tokenize(const std::string& title, std::map<int, float>& vec) const;
     void tokenize(const std::string& title, std::vector<std::pair<int, float> >& vec) const;
+    // vec is cleared first, nothing is allocated once buffer and vec are warm
+    void tokenize(const std::string& title, Buffer& buffer, std::vector<std::pair<int, float> >& vec) const;
 
     void numeric(const boost::unordered_map<std::string, float>& vec, boost::unordered_map<int, float>& res) const;
     void numeric(const boost::unordered_map<std::string, float>& vec, std::map<int, float>& res) const;
@@ -1,13 +1,16 @@
 #include "TopNClusteringDB.h"
 #include <am/range/AmIterator.h>
 #include <boost/filesystem.hpp>
+#include <glog/logging.h>
 
 using namespace izenelib::am;
 namespace sf1r { namespace laser {
 
 TopNClusteringDB::TopNClusteringDB(const std::string& topNClusteringPath,
     const std::size_t& maxClustering)
-    : topNClusteringPath_(topNClusteringPath)
+    : topNclusterLeveldb_(NULL)
+    , topNclusterCache_(NULL)
+    , topNClusteringPath_(topNClusteringPath)
     , maxClustering_(maxClustering)
 {
     if (!boost::filesystem::exists(topNClusteringPath_))
@@ -19,9 +22,16 @@ TopNClusteringDB::TopNClusteringDB(const std::string& topNClusteringPath,
 
 TopNClusteringDB::~TopNClusteringDB()
 {
+    if (NULL != topNclusterCache_)
+    {
+        TopNclusterCacheType::Stats stats = topNclusterCache_->stats();
+        LOG(INFO)<<"topn clustering cache hits: "<<stats.hits<<", misses: "<<stats.misses
+            <<", hit rate: "<<stats.hitRate();
+        delete topNclusterCache_;
+        topNclusterCache_ = NULL;
+    }
     if (NULL != topNclusterLeveldb_)
     {
-        topNclusterLeveldb_->close();
         delete topNclusterLeveldb_;
         topNclusterLeveldb_ = NULL;
     }
@@ -30,33 +40,71 @@ TopNClusteringDB::~TopNClusteringDB()
 bool TopNClusteringDB::load_()
 {
     topNclusterLeveldb_ = new TopNclusterLeveldbType(topNClusteringPath_);
-    if(topNclusterLeveldb_->open())
-    {
-        return true;
-    }
-    else
+    if (!topNclusterLeveldb_->isOpen())
     {
-        topNclusterLeveldb_->close();
+        LOG(ERROR)<<"open topn clustering db failed: "<<topNClusteringPath_;
         delete topNclusterLeveldb_;
         topNclusterLeveldb_ = NULL;
         return false;
     }
+    topNclusterCache_ = new TopNclusterCacheType(*topNclusterLeveldb_, CACHE_SIZE);
+    return true;
 }
 
 bool TopNClusteringDB::update(const std::string& user, const std::map<int, float>& clustering)
 {
-    return topNclusterLeveldb_->insert(user, clustering);
+    if (NULL == topNclusterCache_)
+    {
+        return false;
+    }
+    return topNclusterCache_->update(user, clustering);
 }
 
 bool TopNClusteringDB::get(const std::string& user, std::map<int, float>& clustering) const
 {
-    if (!topNclusterLeveldb_->get(user, clustering))
+    TopNclusterCacheType::ValuePtr cached;
+    if (NULL != topNclusterCache_)
+    {
+        cached = topNclusterCache_->get(user);
+    }
+    if (cached)
     {
-        for (std::size_t i = 0; i < TOP_N; i++)
+        clustering = *cached;
+    }
+    else
+    {
+        randomClustering_(clustering);
+    }
+    return true;
+}
+
+bool TopNClusteringDB::get(const std::vector<std::string>& user, std::vector<std::map<int, float> >& clustering) const
+{
+    std::vector<TopNclusterCacheType::ValuePtr> cached(user.size());
+    if (NULL != topNclusterCache_)
+    {
+        topNclusterCache_->get(user, cached);
+    }
+    clustering.resize(user.size());
+    for (std::size_t i = 0; i < user.size(); ++i)
+    {
+        if (cached[i])
         {
-            clustering[rand() % maxClustering_] = 1.0;
+            clustering[i] = *cached[i];
+        }
+        else
+        {
+            randomClustering_(clustering[i]);
         }
     }
     return true;
 }
+
+void TopNClusteringDB::randomClustering_(std::map<int, float>& clustering) const
+{
+    for (std::size_t i = 0; i < TOP_N; i++)
+    {
+        clustering[rand() % maxClustering_] = 1.0;
+    }
+}
 } }
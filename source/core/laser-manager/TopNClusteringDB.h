@@ -8,11 +8,14 @@
 #include <vector>
 #include <string>
 #include "TopNClustering.h"
+#include "LaserModelDB.h"
+#include "LaserModelCache.h"
 namespace sf1r { namespace laser {
 
 class TopNClusteringDB
 {
-    typedef izenelib::am::leveldb::Table<std::string, std::map<int, float> > TopNclusterLeveldbType;
+    typedef LaserModelDB<std::string, std::map<int, float> > TopNclusterLeveldbType;
+    typedef LaserModelCache<std::string, std::map<int, float> > TopNclusterCacheType;
 public:
     TopNClusteringDB(const std::string& topNClusteringPath,
         const std::size_t& maxClustering);
@@ -21,15 +24,31 @@ public:
 public:
     bool update(const std::string& user, const std::map<int, float>& clustering);
     bool get(const std::string& user, std::map<int, float>& clustering) const;
+    bool get(const std::vector<std::string>& user, std::vector<std::map<int, float> >& clustering) const;
+
+    TopNclusterCacheType::Stats cacheStats() const
+    {
+        if (NULL == topNclusterCache_)
+        {
+            TopNclusterCacheType::Stats stats = {0, 0, 0};
+            return stats;
+        }
+        return topNclusterCache_->stats();
+    }
 
 private:
     bool load_();
+    void randomClustering_(std::map<int, float>& clustering) const;
 
 private:
     TopNclusterLeveldbType* topNclusterLeveldb_;
+    // decoded hot users, unknown users are not cached, NULL if the db
+    // failed to open and every user gets random clusters
+    TopNclusterCacheType* topNclusterCache_;
     std::string topNClusteringPath_;
     const std::size_t maxClustering_;
     const static std::size_t TOP_N = 10;
+    const static std::size_t CACHE_SIZE = 100000;
 };
 } }
 
@@ -6,6 +6,17 @@
 #include "SparseVector.h"
 
 namespace sf1r { namespace laser {
+const static std::size_t USER_MODEL_CACHE_SIZE = 100000;
+const static std::size_t TOPN_CLUSTERING_CACHE_SIZE = 100000;
+
+template <typename Cache>
+static void logCacheStats(const std::string& name, const Cache& cache)
+{
+    typename Cache::Stats stats = cache.stats();
+    LOG(INFO)<<name<<" cache hits: "<<stats.hits<<", misses: "<<stats.misses
+        <<", evictions: "<<stats.evictions<<", hit rate: "<<stats.hitRate();
+}
+
 TopnClusteringModel::TopnClusteringModel(const AdIndexManager& adIndexer,
     const std::vector<std::vector<int> >& similarClustering,
     const std::string& workdir,
@@ -16,8 +27,10 @@ TopnClusteringModel::TopnClusteringModel(const AdIndexManager& adIndexer,
     , sysdir_(sysdir)
     , pUserDb_(NULL)
     , origUserDb_(NULL)
+    , userCache_(NULL)
     , topClusteringDb_(NULL)
     , origClusteringDb_(NULL)
+    , topClusteringCache_(NULL)
 {
     if (!boost::filesystem::exists(workdir_))
     {
@@ -43,10 +56,25 @@ TopnClusteringModel::TopnClusteringModel(const AdIndexManager& adIndexer,
     }
     topClusteringDb_ = new LaserModelDB<std::string, std::vector<std::pair<int, float> > >(cDB);
     localizeFromOrigDB(loadUserDB, loadCDB);
+    userCache_ = new LaserModelCache<std::string, LaserOnlineModel>(*pUserDb_, USER_MODEL_CACHE_SIZE);
+    topClusteringCache_ = new LaserModelCache<std::string, std::vector<std::pair<int, float> > >(
+        *topClusteringDb_, TOPN_CLUSTERING_CACHE_SIZE);
 }
 
 TopnClusteringModel::~TopnClusteringModel()
 {
+    if (NULL != topClusteringCache_)
+    {
+        logCacheStats("per-user-topn-clustering", *topClusteringCache_);
+        delete topClusteringCache_;
+        topClusteringCache_ = NULL;
+    }
+    if (NULL != userCache_)
+    {
+        logCacheStats("per-user-online-model", *userCache_);
+        delete userCache_;
+        userCache_ = NULL;
+    }
     if (NULL != pUserDb_)
     {
         delete pUserDb_;
@@ -79,11 +107,12 @@ bool TopnClusteringModel::candidate(
     ad.reserve(ncandidate);
     score.reserve(ncandidate);
 
-    std::vector<std::pair<int, float> > topn;
-    if (!topClusteringDb_->get(text, topn))
+    LaserModelCache<std::string, std::vector<std::pair<int, float> > >::ValuePtr cached = topClusteringCache_->get(text);
+    if (!cached)
     {
         return false;
     }
+    const std::vector<std::pair<int, float> >& topn = *cached;
     std::vector<std::pair<int, float> >::const_iterator it = topn.begin();
     std::size_t old = 0;
     for (; it != topn.end(); ++it)
@@ -122,11 +151,12 @@ bool TopnClusteringModel::candidate(
     ad.reserve(ncandidate);
     score.reserve(ncandidate);
 
-    std::vector<std::pair<int, float> > topn;
-    if (!topClusteringDb_->get(text, topn))
+    LaserModelCache<std::string, std::vector<std::pair<int, float> > >::ValuePtr cached = topClusteringCache_->get(text);
+    if (!cached)
     {
         return false;
     }
+    const std::vector<std::pair<int, float> >& topn = *cached;
     std::vector<std::pair<int, float> >::const_iterator it = topn.begin();
     std::size_t old = 0;
     for (; it != topn.end(); ++it)
@@ -188,16 +218,8 @@ float TopnClusteringModel::score(
     const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
     const float score) const
 {
-    float ret = score;
-    LaserOnlineModel onlineModel;
-    if (!pUserDb_->get(text, onlineModel))
-    {
-        return ret;
-    }
-    // per-user
-    static const std::vector<std::pair<int, float> > context; 
-    ret += onlineModel.score(text, context, ad, (float)0.0);
-    return ret;
+    LaserModelCache<std::string, LaserOnlineModel>::ValuePtr onlineModel = userCache_->get(text);
+    return this->score(onlineModel.get(), text, ad, score);
 }
 
 float TopnClusteringModel::score( 
@@ -205,16 +227,44 @@ float TopnClusteringModel::score(
     const std::vector<float>& user, 
     const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
     const float score) const
+{
+    LaserModelCache<std::string, LaserOnlineModel>::ValuePtr onlineModel = userCache_->get(text);
+    return this->score(onlineModel.get(), text, ad, score);
+}
+
+void TopnClusteringModel::score(
+    const std::vector<std::string>& text,
+    const std::vector<std::vector<float> >& context, 
+    const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+    const std::vector<std::size_t>& offset,
+    const std::vector<std::size_t>& user,
+    std::vector<float>& score) const
+{
+    // the scoring context of this request, one model per user
+    std::vector<LaserModelCache<std::string, LaserOnlineModel>::ValuePtr> onlineModel;
+    userCache_->get(text, onlineModel);
+    for (std::size_t i = 0; i < ad.size(); ++i)
+    {
+        for (std::size_t k = offset[i]; k < offset[i + 1]; ++k)
+        {
+            score[k] = this->score(onlineModel[user[k]].get(), text[user[k]], ad[i], score[k]);
+        }
+    }
+}
+
+float TopnClusteringModel::score(const LaserOnlineModel* onlineModel,
+    const std::string& text,
+    const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+    const float score) const
 {
     float ret = score;
-    LaserOnlineModel onlineModel;
-    if (!pUserDb_->get(text, onlineModel))
+    if (NULL == onlineModel)
     {
         return ret;
     }
     // per-user
     static const std::vector<std::pair<int, float> > context; 
-    ret += onlineModel.score(text, context, ad, (float)0.0);
+    ret += onlineModel->score(text, context, ad, (float)0.0);
     return ret;
 }
     
@@ -247,7 +297,7 @@ void TopnClusteringModel::updatepUserDb(msgpack::rpc::request& req)
     msgpack::type::tuple<std::string, LaserOnlineModel> params;
     req.params().convert(&params);
     const std::string uuid(params.get<0>());
-    bool res = pUserDb_->update(uuid, params.get<1>());
+    bool res = userCache_->update(uuid, params.get<1>());
     req.result(res);
 }
 
@@ -263,7 +313,7 @@ void TopnClusteringModel::updateTopClusteringDb(msgpack::rpc::request& req)
     {
         topn[i] = std::make_pair(index[i], value[i]);
     }
-    bool res = topClusteringDb_->update(params.get<0>(), topn);
+    bool res = topClusteringCache_->update(params.get<0>(), topn);
     req.result(res);
 }
     
@@ -3,6 +3,7 @@
 
 #include "LaserModel.h"
 #include "LaserModelDB.h"
+#include "LaserModelCache.h"
 
 namespace sf1r { namespace laser {
 class AdIndexManager;
@@ -44,18 +45,35 @@ public:
         const float score) const;
     
     
+    // resolve the per-user model once for all the candidates
+    virtual void score(
+        const std::vector<std::string>& text,
+        const std::vector<std::vector<float> >& context, 
+        const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        const std::vector<std::size_t>& offset,
+        const std::vector<std::size_t>& user,
+        std::vector<float>& score) const;
+    
+    // no user context, the per-user model is looked up by text in score()
     virtual bool context(const std::string& text, std::vector<std::pair<int, float> >& context) const
     {
-        return false;
+        context.clear();
+        return true;
     }
     
     virtual bool context(const std::string& text, std::vector<float>& context) const
     {
-        return false;
+        context.clear();
+        return true;
     }
     
     virtual void dispatch(const std::string& method, msgpack::rpc::request& req);
 private:
+    float score(const LaserOnlineModel* onlineModel,
+        const std::string& text,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const;
+
     bool getAD(const std::size_t& clusteringId, 
         std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad) const;
     bool getSimilarAd(const std::size_t& clusteringId, 
@@ -75,8 +93,12 @@ protected:
     const std::string sysdir_;
     LaserModelDB<std::string, LaserOnlineModel>* pUserDb_;
     LaserModelDB<std::string, LaserOnlineModel>* origUserDb_;
+    // hot users of pUserDb_
+    LaserModelCache<std::string, LaserOnlineModel>* userCache_;
     LaserModelDB<std::string, std::vector<std::pair<int, float> > >* topClusteringDb_;
     LaserModelDB<std::string, std::vector<std::pair<int, float> > >* origClusteringDb_;
+    // hot users of topClusteringDb_
+    LaserModelCache<std::string, std::vector<std::pair<int, float> > >* topClusteringCache_;
 };
 } }
 #endif
@@ -27,7 +27,8 @@ PCAProcess::PCAProcess(const std::string& workdir,
         const std::size_t minDocPerClustering, 
         const std::size_t maxDocPerClustering, 
         const std::size_t dictLimit, 
-        const std::size_t threadNum)
+        const std::size_t threadNum,
+        const std::size_t tokenizeThreadNum)
    : workdir_(workdir)
    , scddir_(scddir)
    , dictLimit_(dictLimit)
@@ -39,7 +40,7 @@ PCAProcess::PCAProcess(const std::string& workdir,
         create_directory(workdir_);
     }
    termDict_ = new TermDictionary(workdir_ + "/terms_dic.dat");
-   runner_ = new PCARunner(threadNum, *termDict_, pcaDictPath, threhold, maxDocPerClustering, minDocPerClustering);
+   runner_ = new PCARunner(threadNum, *termDict_, pcaDictPath, threhold, maxDocPerClustering, minDocPerClustering, tokenizeThreadNum);
 }
 
 PCAProcess::~PCAProcess()
@@ -98,38 +99,33 @@ bool PCAProcess::next(std::string& title, std::string& category)
     {
         fstream* stream = fstream_.front();
         string line = "";
-        string docid = ""; 
         while(std::getline(*stream, line) )
         {
             int len = line.length();
             if (len > 7 && line.substr(0, 7) == "<DOCID>")
             {
-                if (title.compare("") != 0 && docid.compare("") != 0
-                        && category.compare("") != 0)
+                // the previous document ends here
+                const bool complete = !docid_.empty() && !title_.empty() && !category_.empty();
+                if (complete)
                 {
-                    return true;
-                    //it's a complete
-                    //count++;
-                    //docid = line.substr(7);
-                    //if(count %1000 == 0)
-                    //{
-                    //    std::cout<<"Read:"<<count<<endl;
-                    //}
+                    title.swap(title_);
+                    category.swap(category_);
                 }
-                else
+                docid_ = line.substr(7);
+                title_.clear();
+                category_.clear();
+                if (complete)
                 {
-                    docid = line.substr(7);
-                    title = "";
-                    category = "";
+                    return true;
                 }
             }
             else if(len > 7 && line.substr(0, 7) == "<Title>")
             {
-                title = line.substr(7);
+                title_ = line.substr(7);
             }
             else if(len > 10 && line.substr(0, 10) == "<Category>")
             {
-                category = line.substr(10);
+                category_ = line.substr(10);
             }
             else
             {
@@ -137,15 +133,28 @@ bool PCAProcess::next(std::string& title, std::string& category)
             }
 
         }
-        // end of file
+        // end of file, the last document
         delete stream;
         fstream_.pop();
+        const bool complete = !docid_.empty() && !title_.empty() && !category_.empty();
+        docid_.clear();
+        if (complete)
+        {
+            title.swap(title_);
+            category.swap(category_);
+            title_.clear();
+            category_.clear();
+            return true;
+        }
     }
     return false;
 }
 
 void PCAProcess::initFstream()
 {
+    docid_.clear();
+    title_.clear();
+    category_.clear();
     path scddir(scddir_);
     if(exists(scddir))
     {
@@ -1,6 +1,8 @@
 #ifndef SF1R_LASER_PCA_PROCESS_H
 #define SF1R_LASER_PCA_PROCESS_H
 #include <string>
+#include <queue>
+#include <fstream>
 #include <knlp/title_pca.h>
 #include <am/sequence_file/ssfr.h>
 #include <boost/unordered_map.hpp>
@@ -18,7 +20,8 @@ public:
         const std::size_t minDocPerClustering = 10, 
         const std::size_t maxDocPerClustering = 1000, 
         const std::size_t dictLimit = 10000, 
-        const std::size_t threadNum = 3);
+        const std::size_t threadNum = 3,
+        const std::size_t tokenizeThreadNum = 0);
     ~PCAProcess();
 
 public:
@@ -35,6 +38,10 @@ private:
     type::TermDictionary* termDict_;
     PCARunner* runner_;
     std::queue<std::fstream*> fstream_;
+    // the document being parsed, it's complete on the next <DOCID> or end of file
+    std::string docid_;
+    std::string title_;
+    std::string category_;
 };
 } } }
 #endif
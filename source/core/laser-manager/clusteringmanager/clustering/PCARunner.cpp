@@ -1,201 +1,360 @@
 #include "PCARunner.h"
+#include <algorithm>
+#include <boost/bind.hpp>
 
 const std::size_t MAX_TOKEN = 4;
 namespace sf1r { namespace laser { namespace clustering {
 
-PCARunner::DocumentVecType::iterator  PCARunner::distribution_(DocumentVecType& docv, 
-    const std::size_t size, 
-    Dictionary& ccnt, 
-    Dictionary& dict)
+PCARunner::PCARunner(const std::size_t thread,
+    type::TermDictionary& t,
+    const std::string& pcapath,
+    float threshold,
+    const std::size_t maxDocPerClustering,
+    const std::size_t minDocPerClustering,
+    const std::size_t tokenizeThread,
+    const std::size_t queueSize)
+  : term_dictionary(t)
+  , tok(pcapath)
+  , context_(NULL)
+  , tokenizeThread_(NULL)
+  , assignThread_(NULL)
+  , tokenized_(NULL)
+  , documentQueue_(NULL)
+  , batch_(NULL)
+  , stage_(STATISTICS)
+  , read_(0)
+  , clusteringContainer_(NULL)
+  , THREAD_NUM_(std::max(thread, (std::size_t)1))
+  , TOKENIZE_THREAD_NUM_(0 == tokenizeThread ? THREAD_NUM_ : tokenizeThread)
+  , THRESHOLD_(threshold)
+  , MAX_DOC_PER_CLUSTERING_(maxDocPerClustering)
+  , MIN_DOC_PER_CLUSTERING_(minDocPerClustering)
 {
-    DocumentVecType::iterator iter = docv.begin();
-    for (std::size_t k = 0; k < size; ++k, ++iter)
+    const std::size_t size = std::max(queueSize, (std::size_t)1);
+    context_ = new std::vector<AssignContext*>(THREAD_NUM_);
+    for (std::size_t i = 0; i < THREAD_NUM_; ++i)
     {
-        std::vector<std::pair<std::string, float> > tks;
-        tokenize_(iter->title, tks);
-        if (tks.empty())
-            continue;
-        
-        std::string cateMerge = iter->category;
-        Dictionary::iterator it = ccnt.find(cateMerge);
-        if (ccnt.end() == it)
+        (*context_)[i] = new AssignContext(size);
+    }
+    documentQueue_ = new DocumentQueue(size);
+    tokenizeThread_ = new std::vector<boost::thread*>(TOKENIZE_THREAD_NUM_, NULL);
+    assignThread_ = new std::vector<boost::thread*>(THREAD_NUM_, NULL);
+    tokenized_ = new std::vector<std::size_t>(TOKENIZE_THREAD_NUM_, 0);
+    clusteringContainer_ = new std::vector<boost::unordered_map<std::string, float> >();
+    LOG(INFO)<<"pca runner, tokenize threads: "<<TOKENIZE_THREAD_NUM_
+        <<", assign threads: "<<THREAD_NUM_<<", queue size: "<<size<<" x "<<BATCH_SIZE;
+}
+
+PCARunner::~PCARunner()
+{
+    if (NULL != context_)
+    {
+        for (std::size_t i = 0; i < context_->size(); ++i)
         {
-            ccnt[cateMerge] = 1;
+            delete (*context_)[i];
         }
-        else
+        delete context_;
+        context_ = NULL;
+    }
+    if (NULL != tokenizeThread_)
+    {
+        delete tokenizeThread_;
+        tokenizeThread_ = NULL;
+    }
+    if (NULL != assignThread_)
+    {
+        delete assignThread_;
+        assignThread_ = NULL;
+    }
+    if (NULL != tokenized_)
+    {
+        delete tokenized_;
+        tokenized_ = NULL;
+    }
+    if (NULL != documentQueue_)
+    {
+        delete documentQueue_;
+        documentQueue_ = NULL;
+    }
+    if (NULL != batch_)
+    {
+        delete batch_;
+        batch_ = NULL;
+    }
+    if (NULL != clusteringContainer_)
+    {
+        delete clusteringContainer_;
+        clusteringContainer_ = NULL;
+    }
+}
+
+void PCARunner::push_back(const Document& doc)
+{
+    if (NULL == batch_)
+    {
+        batch_ = new DocumentBatch();
+        batch_->reserve(BATCH_SIZE);
+    }
+    batch_->push_back(doc);
+    ++read_;
+    if (batch_->size() >= BATCH_SIZE)
+    {
+        // blocks while the tokenize stage is behind
+        documentQueue_->push(batch_);
+        batch_ = NULL;
+    }
+}
+
+void PCARunner::start_(const Stage stage)
+{
+    stage_ = stage;
+    read_ = 0;
+    startTime_ = boost::posix_time::microsec_clock::local_time();
+    for (std::size_t i = 0; i < THREAD_NUM_; ++i)
+    {
+        (*assignThread_)[i] = new boost::thread(boost::bind(&PCARunner::assignStage_, this, (*context_)[i]));
+    }
+    for (std::size_t i = 0; i < TOKENIZE_THREAD_NUM_; ++i)
+    {
+        (*tokenized_)[i] = 0;
+        (*tokenizeThread_)[i] = new boost::thread(boost::bind(&PCARunner::tokenizeStage_, this, &(*tokenized_)[i]));
+    }
+}
+
+void PCARunner::stop_()
+{
+    if (NULL != batch_)
+    {
+        documentQueue_->push(batch_);
+        batch_ = NULL;
+    }
+    // drain the stages in order, every thread exits on its own NULL
+    for (std::size_t i = 0; i < TOKENIZE_THREAD_NUM_; ++i)
+    {
+        documentQueue_->push(NULL);
+    }
+    std::size_t tokenized = 0;
+    for (std::size_t i = 0; i < TOKENIZE_THREAD_NUM_; ++i)
+    {
+        boost::thread* thread = (*tokenizeThread_)[i];
+        thread->join();
+        delete thread;
+        (*tokenizeThread_)[i] = NULL;
+        tokenized += (*tokenized_)[i];
+    }
+    for (std::size_t i = 0; i < THREAD_NUM_; ++i)
+    {
+        (*context_)[i]->queue_->push(NULL);
+    }
+    for (std::size_t i = 0; i < THREAD_NUM_; ++i)
+    {
+        boost::thread* thread = (*assignThread_)[i];
+        thread->join();
+        delete thread;
+        (*assignThread_)[i] = NULL;
+    }
+    const long elapsed = (boost::posix_time::microsec_clock::local_time() - startTime_).total_milliseconds();
+    LOG(INFO)<<(STATISTICS == stage_ ? "statistics" : "clustering")<<" pipeline, read: "<<read_
+        <<", tokenized: "<<tokenized<<", elapsed: "<<elapsed<<"ms, "
+        <<(0 == elapsed ? 0 : read_ * 1000 / elapsed)<<" docs/s";
+}
+
+void PCARunner::tokenizeStage_(std::size_t* tokenized)
+{
+    std::vector<TokenizedBatch*> out(THREAD_NUM_, NULL);
+    while (true)
+    {
+        DocumentBatch* batch = NULL;
+        documentQueue_->pop(batch);
+        if (NULL == batch)
         {
-            it->second++;
+            break;
         }
-        
-        for (std::size_t i = 0; i < tks.size(); ++i)
+        for (DocumentBatch::iterator it = batch->begin(); it != batch->end(); ++it)
         {
-            if(dict.find(tks[i].first) == dict.end())
+            Tokens tks;
+            tokenize_(it->title, tks);
+            if (tks.empty())
+                continue;
+
+            const std::size_t index = Hash_(it->category) % THREAD_NUM_;
+            if (NULL == out[index])
             {
-                dict[tks[i].first] = 1;
+                out[index] = new TokenizedBatch();
             }
-            else
+            out[index]->push_back(TokenizedDocument());
+            out[index]->back().category.swap(it->category);
+            out[index]->back().tks.swap(tks);
+            ++(*tokenized);
+        }
+        delete batch;
+
+        for (std::size_t i = 0; i < THREAD_NUM_; ++i)
+        {
+            if (NULL != out[i])
             {
-                dict[tks[i].first]++;
+                (*context_)[i]->queue_->push(out[i]);
+                out[i] = NULL;
             }
-            
-            cateMerge += tks[i].first;
-            Dictionary::iterator it = ccnt.find(cateMerge);
-            if (ccnt.end() == it)
+        }
+    }
+}
+
+void PCARunner::assignStage_(AssignContext* context)
+{
+    while (true)
+    {
+        TokenizedBatch* batch = NULL;
+        context->queue_->pop(batch);
+        if (NULL == batch)
+        {
+            break;
+        }
+        for (TokenizedBatch::const_iterator it = batch->begin(); it != batch->end(); ++it)
+        {
+            if (STATISTICS == stage_)
             {
-                ccnt[cateMerge] = 1;
+                distribution_(*it, *context->cat_, *context->terms_);
             }
             else
             {
-                it->second++;
-            }
-            if (i > MAX_TOKEN)
-            {
-                break;
+                doClustering_(*it, *context->cat_, term_dictionary, *context->clusteringContainer_);
             }
         }
+        delete batch;
     }
-    return iter;
 }
 
-void PCARunner::statistics_(ThreadContext* context)
+void PCARunner::distribution_(const TokenizedDocument& doc,
+    Dictionary& ccnt,
+    Dictionary& dict)
 {
-    boost::shared_mutex* mutex = context->mutex_;
-    DocumentVecType* docs = context->docs_;
-    Dictionary* cat = context->cat_;
-    Dictionary* terms = context->terms_;
-    while(true)
+    const Tokens& tks = doc.tks;
+    std::string cateMerge = doc.category;
+    ++ccnt[cateMerge];
+
+    for (std::size_t i = 0; i < tks.size(); ++i)
     {
-        std::size_t size = 0;
-        {
-            boost::unique_lock<boost::shared_mutex> uniqueLock(*mutex);    
-            size = docs->size();
-        }
-        if (0 == size)
-        {
-            if (isExit_())
-                break;
-            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
-        }
-        else
+        ++dict[tks[i].first];
+
+        cateMerge += tks[i].first;
+        ++ccnt[cateMerge];
+        if (i > MAX_TOKEN)
         {
-           DocumentVecType::iterator end = distribution_(*docs, size, *cat, *terms);
-            boost::unique_lock<boost::shared_mutex> uniqueLock(*mutex);
-            docs->erase(docs->begin(), end);
+            break;
         }
     }
 }
 
-PCARunner::DocumentVecType::iterator PCARunner::doClustering_(DocumentVecType& docv, 
-    const std::size_t size, 
-    const Dictionary& ccnt, 
-    const type::TermDictionary& dict, 
+void PCARunner::doClustering_(const TokenizedDocument& doc,
+    const Dictionary& ccnt,
+    const type::TermDictionary& dict,
     ClusteringContainer& clusteringContainer)
 {
-    DocumentVecType::iterator iter = docv.begin();
-    for (std::size_t k = 0; k < size; ++k, ++iter)
+    const Tokens& tks = doc.tks;
+    const std::size_t size = tks.size();
+    std::string cateMerge = doc.category;
     {
-        std::vector<std::pair<std::string, float> > tks;
-        tokenize_(iter->title, tks);
-        if (tks.empty())
-            continue;
-        
-        const std::size_t size = tks.size();
-        std::string cateMerge = iter->category;
+        Dictionary::const_iterator it = ccnt.find(cateMerge);
+        if (ccnt.end() == it || it->second < MIN_DOC_PER_CLUSTERING_)
         {
-            Dictionary::const_iterator it = ccnt.find(cateMerge);
-            if (it->second < MIN_DOC_PER_CLUSTERING_)
-            {
-                continue;
-            }
-            if (it->second < MAX_DOC_PER_CLUSTERING_)
-            {
-                pushClustering_(cateMerge, tks, dict, clusteringContainer); 
-                continue;
-            }
+            return;
         }
+        if (it->second < MAX_DOC_PER_CLUSTERING_)
+        {
+            pushClustering_(cateMerge, tks, dict, clusteringContainer);
+            return;
+        }
+    }
 
-        for (std::size_t i = 0; i < size; ++i)
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        cateMerge += tks[i].first;
+        Dictionary::const_iterator it = ccnt.find(cateMerge);
+        if (ccnt.end() == it)
         {
-            cateMerge += tks[i].first;
-            Dictionary::const_iterator it = ccnt.find(cateMerge);
-            if (ccnt.end() == it)
-            {
-                break;
-            }
-            // to many, move to child
-            else if (it->second > MAX_DOC_PER_CLUSTERING_)
+            break;
+        }
+        // to many, move to child
+        else if (it->second > MAX_DOC_PER_CLUSTERING_)
+        {
+            if ( i + 1 < size)
             {
-                if ( i + 1 < size) 
+                Dictionary::const_iterator next = ccnt.find(cateMerge + tks[i + 1].first);
+                // no child
+                if (next == ccnt.end())
                 {
-                    Dictionary::const_iterator next = ccnt.find(cateMerge + tks[i + 1].first);
-                    // no child 
-                    if (next == ccnt.end())
-                    {
-                        pushClustering_(cateMerge, tks, dict, clusteringContainer); 
-                        break;
-                    }
-                    // child, too little
-                    if (next->second < MIN_DOC_PER_CLUSTERING_)
-                    {
-                        pushClustering_(cateMerge, tks, dict, clusteringContainer); 
-                        break;
-                    }
-                    continue;
+                    pushClustering_(cateMerge, tks, dict, clusteringContainer);
+                    break;
                 }
-                // last token
-                else
+                // child, too little
+                if (next->second < MIN_DOC_PER_CLUSTERING_)
                 {
-                    pushClustering_(cateMerge, tks, dict, clusteringContainer); 
+                    pushClustering_(cateMerge, tks, dict, clusteringContainer);
                     break;
                 }
+                continue;
             }
-            // 
-            else if (it->second > MIN_DOC_PER_CLUSTERING_)
-            {
-                pushClustering_(cateMerge, tks, dict, clusteringContainer); 
-                break;
-            }
-            // too little, discard
+            // last token
             else
             {
-               break;
+                pushClustering_(cateMerge, tks, dict, clusteringContainer);
+                break;
             }
         }
-        
+        //
+        else if (it->second > MIN_DOC_PER_CLUSTERING_)
+        {
+            pushClustering_(cateMerge, tks, dict, clusteringContainer);
+            break;
+        }
+        // too little, discard
+        else
+        {
+           break;
+        }
     }
-    return iter;
 }
 
-void PCARunner::clustering_(ThreadContext* context)
+void PCARunner::mergeTerm_()
 {
-    boost::shared_mutex* mutex = context->mutex_;
-    DocumentVecType* docs = context->docs_;
-    const Dictionary* cat = context->cat_;
-    const type::TermDictionary& dict = term_dictionary;
-    ClusteringContainer* clusteringContainer = context->clusteringContainer_;
-    while(true)
+    LOG(INFO)<<"merge terms...";
+    for (std::size_t i = 0; i < THREAD_NUM_; ++i)
     {
-        std::size_t size = 0;
+        Dictionary* terms = (*context_)[i]->terms_;
+        for (Dictionary::const_iterator it = terms->begin(); it != terms->end(); ++it)
         {
-            boost::unique_lock<boost::shared_mutex> uniqueLock(*mutex);    
-            size = docs->size();
+            term_dictionary.set(it->first, it->second);
         }
-        if (0 == size)
-        {
-            if (isExit_())
-                break;
-            boost::this_thread::sleep(boost::posix_time::milliseconds(2000));
-        }
-        else
+        Dictionary().swap(*terms);
+    }
+}
+
+void PCARunner::mergeClustering_()
+{
+    LOG(INFO)<<"merge clustering...";
+    for (std::size_t i = 0; i < THREAD_NUM_; ++i)
+    {
+        ClusteringContainer* container = (*context_)[i]->clusteringContainer_;
+        ClusteringContainer::const_iterator it = container->begin();
+        for (; it != container->end(); ++it)
         {
-            DocumentVecType::iterator end = doClustering_(*docs, size, *cat, dict, *clusteringContainer);
-            boost::unique_lock<boost::shared_mutex> uniqueLock(*mutex);
-            docs->erase(docs->begin(), end);
+            clusteringContainer_->push_back(boost::unordered_map<std::string, float>());
+            boost::unordered_map<std::string, float>& vec = clusteringContainer_->back();
+            // normalize
+            boost::unordered_map<std::string, float>::const_iterator tokenIterator = it->second.second.begin();
+            for (; tokenIterator != it->second.second.end(); ++tokenIterator)
+            {
+                vec[tokenIterator->first] = tokenIterator->second / it->second.first;
+            }
         }
+        // the partition is done, release it before normalizing the next
+        ClusteringContainer().swap(*container);
+        Dictionary().swap(*(*context_)[i]->cat_);
     }
 }
 
-void PCARunner::tokenize_(const std::string title, std::vector<std::pair<std::string, float> >& tks)
+void PCARunner::tokenize_(const std::string& title, Tokens& tks)
 {
     typedef izenelib::util::second_greater<std::pair<std::string, float> > greater_than;
     std::vector<std::pair<std::string, float> > subtks;
@@ -235,7 +394,7 @@ void PCARunner::tokenize_(const std::string title, std::vector<std::pair<std::st
 }
 
 void PCARunner::pushClustering_(const std::string& cateMerge, 
-    const std::vector<std::pair<std::string, float> >& tks,
+    const Tokens& tks,
     const type::TermDictionary& dict,
     ClusteringContainer& clusteringContainer) const
 {
@@ -249,9 +408,10 @@ void PCARunner::pushClustering_(const std::string& cateMerge,
         for (std::size_t i = 0; i < size; ++i)
         {
             // remove tokens not in dictionary
+            // a title may repeat a token, add up like the later documents
             if (dict.find(tks[i].first))
             {
-                clustering.second[tks[i].first] = tks[i].second;
+                clustering.second[tks[i].first] += tks[i].second;
             }
         }
         clusteringContainer[cateMerge] = clustering;
@@ -1,14 +1,13 @@
 #ifndef SF1R_LASER_PCA_RUNNER_H
-#define SF1R_LASER_PCA_RUUNER_H
+#define SF1R_LASER_PCA_RUNNER_H
 
-#include <queue>
-#include <list>
+#include <vector>
 #include <string>
 #include <boost/thread/thread.hpp>
-#include <boost/thread/mutex.hpp>
-#include <am/sequence_file/ssfr.h>
-#include <util/functional.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/unordered_map.hpp>
+#include <util/concurrent_queue.h>
+#include <util/functional.h>
 #include <knlp/title_pca.h>
 #include "laser-manager/clusteringmanager/type/TermDictionary.h"
 #include "laser-manager/clusteringmanager/common/utils.h"
@@ -22,6 +21,19 @@ public:
     std::string category;
 };
 
+/*
+ * Documents flow through a bounded pipeline:
+ *
+ *   read (caller, push_back) -> tokenize (tokenizeThread) -> assign (thread)
+ *
+ * The reader groups documents into batches, the tokenize threads turn a
+ * batch into weighted tokens and split it by category hash, so every
+ * category always lands on the same assign thread which owns its
+ * statistics or clusters without locking. Every queue holds at most
+ * queueSize batches, so a fast reader blocks instead of buffering the
+ * corpus. The write stage normalizes the clusters of one assign thread
+ * after another and releases them as it goes.
+ */
 class PCARunner
 {
     friend class PCAProcess;
@@ -29,40 +41,50 @@ class PCARunner
     typedef boost::unordered_map<std::string, unsigned> Dictionary;
     typedef std::pair<int, boost::unordered_map<std::string, float> > Clustering;
     typedef boost::unordered_map<std::string, Clustering> ClusteringContainer;
-    typedef std::list<Document> DocumentVecType;
-    
-    class ThreadContext
+    typedef std::vector<std::pair<std::string, float> > Tokens;
+
+    class TokenizedDocument
     {
     public:
-        ThreadContext()
+        std::string category;
+        Tokens tks;
+    };
+    typedef std::vector<Document> DocumentBatch;
+    typedef std::vector<TokenizedDocument> TokenizedBatch;
+    // NULL batch tells the stage to exit
+    typedef izenelib::util::concurrent_queue<DocumentBatch*> DocumentQueue;
+    typedef izenelib::util::concurrent_queue<TokenizedBatch*> TokenizedQueue;
+
+    enum Stage
+    {
+        STATISTICS,
+        CLUSTERING
+    };
+
+    // state of one assign thread, only touched by that thread until join
+    class AssignContext
+    {
+    public:
+        AssignContext(const std::size_t queueSize)
         {
-            mutex_ = new boost::shared_mutex();
-            docs_ = new DocumentVecType();
+            queue_ = new TokenizedQueue(queueSize);
             cat_ = new Dictionary();
             terms_ = new Dictionary();
             clusteringContainer_ = new ClusteringContainer();
         }
-        
-        ~ThreadContext()
-        {
-            if (NULL != mutex_)
-            {
-                delete mutex_;
-                mutex_ = NULL;
-            }
 
-            if (NULL != docs_)
+        ~AssignContext()
+        {
+            if (NULL != queue_)
             {
-                delete docs_;
-                docs_ = NULL;
+                delete queue_;
+                queue_ = NULL;
             }
-
             if (NULL != cat_)
             {
                 delete cat_;
                 cat_ = NULL;
             }
-            
             if (NULL != terms_)
             {
                 delete terms_;
@@ -75,106 +97,43 @@ class PCARunner
             }
         }
     public:
-        boost::shared_mutex* mutex_;
-        DocumentVecType* docs_;
+        TokenizedQueue* queue_;
         Dictionary* cat_;
         Dictionary* terms_;
         ClusteringContainer* clusteringContainer_;
     };
 
-public: 
-    
-    PCARunner(const std::size_t thread, 
-        type::TermDictionary& t, 
-        const std::string& pcapath, 
-        float threshold, 
-        const std::size_t maxDocPerClustering, 
-        const std::size_t minDocPerClustering )
-      : term_dictionary(t)
-      , tok(pcapath)
-      , context_(NULL)
-      , thread_(NULL)
-      , exit_(false)
-      , THREAD_NUM_(thread)
-      , THRESHOLD_(threshold)
-      , MAX_DOC_PER_CLUSTERING_(maxDocPerClustering)
-      , MIN_DOC_PER_CLUSTERING_(minDocPerClustering)
-    {
-        context_ = new std::vector<ThreadContext*>(THREAD_NUM_);
-        for (std::size_t i =0; i < THREAD_NUM_; ++i)
-        {
-            ThreadContext* context = new ThreadContext();
-            (*context_)[i] = context;
-        }
-        thread_ = new std::vector<boost::thread*>(THREAD_NUM_);
-        clusteringContainer_ = new std::vector<boost::unordered_map<std::string, float> >();
-    }
-
-    ~PCARunner()
-    {
-        if (NULL != context_)
-        {
-            delete context_;
-            context_ = NULL;
-        }
+public:
+    PCARunner(const std::size_t thread,
+        type::TermDictionary& t,
+        const std::string& pcapath,
+        float threshold,
+        const std::size_t maxDocPerClustering,
+        const std::size_t minDocPerClustering,
+        const std::size_t tokenizeThread = 0,
+        const std::size_t queueSize = DEFAULT_QUEUE_SIZE);
 
-        if (NULL != thread_)
-        {
-            delete thread_;
-            thread_ = NULL;
-        }
-
-        if (NULL != clusteringContainer_)
-        {
-            delete clusteringContainer_;
-            clusteringContainer_ = NULL;
-        }
-    }
+    ~PCARunner();
 
 public:
-    void push_back(Document& doc)
-    {
-        boost::unordered_map<std::string, std::list<Document> >::iterator it = cache_.find(doc.category);
-        if (cache_.end() != it)
-        {
-            it->second.push_back(doc);
-            if (it->second.size() > CACHE_THRESHOLD)
-            {
-                push_back(it);
-                it->second.clear();
-            }
-        }
-        else
-        {
-            cache_[doc.category].push_back(doc);
-        }
-    }
-    
-    
+    void push_back(const Document& doc);
+
     void startStatistics()
     {
-        for (std::size_t i = 0; i < THREAD_NUM_; ++i)
-        {
-            (*thread_)[i] = new boost::thread(boost::bind(&PCARunner::statistics_, this, (*context_)[i]));
-        }
+        start_(STATISTICS);
     }
-    
+
     void stopStatistics()
     {
         stop_();
         mergeTerm_();
     }
 
-
     void startClustering()
     {
-        exit_ = false;
-        for (std::size_t i = 0; i < THREAD_NUM_; ++i)
-        {
-            (*thread_)[i] = new boost::thread(boost::bind(&PCARunner::clustering_, this, (*context_)[i]));
-        }
+        start_(CLUSTERING);
     }
-    
+
     void stopClustering()
     {
         stop_();
@@ -185,140 +144,57 @@ public:
     {
         return *clusteringContainer_;
     }
+
 private:
-    void statistics_(ThreadContext* context);
-    DocumentVecType::iterator distribution_(DocumentVecType& docv, 
-        const std::size_t size, 
-        Dictionary& ccnt, 
+    void start_(const Stage stage);
+    void stop_();
+
+    void tokenizeStage_(std::size_t* tokenized);
+    void assignStage_(AssignContext* context);
+
+    void distribution_(const TokenizedDocument& doc,
+        Dictionary& ccnt,
         Dictionary& termList);
 
-    void clustering_(ThreadContext* context);
-    DocumentVecType::iterator doClustering_(DocumentVecType& docv, 
-        const std::size_t size, 
-        const Dictionary& ccnt, 
-        const type::TermDictionary& dict, 
+    void doClustering_(const TokenizedDocument& doc,
+        const Dictionary& ccnt,
+        const type::TermDictionary& dict,
         ClusteringContainer& clusteringContainer);
 
-    void push_back(boost::unordered_map<std::string, std::list<Document> >::iterator cache)
-    {
-        const std::string cat = cache->first;
-        int index = Hash_(cat) % THREAD_NUM_;
-        boost::shared_mutex* mutex = (*context_)[index]->mutex_;
-        DocumentVecType* docs = (*context_)[index]->docs_;
-        while (true)
-        {
-            std::size_t size = 0;
-            {
-                boost::shared_lock<boost::shared_mutex> sharedLock(*mutex);
-                size = docs->size();
-            }
-            if (size >= MAX_BUFFER_SIZE)
-            {
-                boost::this_thread::sleep(boost::posix_time::milliseconds(1));
-                continue;
-            }
-            break;
-        }
-        {
-            boost::unique_lock<boost::shared_mutex> uniqueLock(*mutex);
-            std::list<Document>::iterator it = cache->second.begin();
-            for (; it != cache->second.end(); ++it)
-            {
-                docs->push_back(*it);
-            }
-        }
-    }
-    
-    bool isExit_()
-    {
-        boost::shared_lock<boost::shared_mutex> sharedLock(mutex_);
-        return exit_;
-    }
-    
-    
-    void mergeTerm_()
-    {
-        LOG(INFO)<<"merge terms...";
-        for (std::size_t i = 0; i < THREAD_NUM_; ++i)
-        {
-            Dictionary* terms = (*context_)[i]->terms_;
-            for (Dictionary::const_iterator it = terms->begin(); it != terms->end(); ++it)
-            {
-                term_dictionary.set(it->first, it->second);
-            }
-        }
-    }
-    
-    void mergeClustering_()
-    {
-        LOG(INFO)<<"merge clustering...";
-        for (std::size_t i = 0; i < THREAD_NUM_; ++i)
-        {
-            const ClusteringContainer* container = (*context_)[i]->clusteringContainer_;
-            ClusteringContainer::const_iterator it = container->begin();
-            for (; it != container->end(); ++it)
-            {
-                boost::unordered_map<std::string, float> vec;
-                // normalize
-                boost::unordered_map<std::string, float>::const_iterator tokenIterator = it->second.second.begin();
-                for (; tokenIterator != it->second.second.end(); ++tokenIterator)
-                {
-                    vec[tokenIterator->first] = tokenIterator->second / it->second.first;
-                }
-                clusteringContainer_->push_back(vec);
-            }
-        }
-    }
+    void mergeTerm_();
+    void mergeClustering_();
 
-    void tokenize_(const std::string title, std::vector<std::pair<std::string, float> >& tks);
-   
-    void stop_()
-    {
-        {
-            boost::unordered_map<std::string, std::list<Document> >::iterator it = cache_.begin();
-            for (; it != cache_.end(); ++it)
-            {
-                push_back(it);
-            }
-            cache_.clear();
-        }
-        {
-            boost::unique_lock<boost::shared_mutex> uniqueLock(mutex_);
-            exit_ = true;
-        }
-        
-        for (std::size_t i = 0; i < THREAD_NUM_; ++i)
-        {
-            boost::thread* thread = (*thread_)[i];
-            thread->join();
-            delete thread;
-        }
-    }
+    void tokenize_(const std::string& title, Tokens& tks);
 
-    void pushClustering_(const std::string& cateMerge, 
-        const std::vector<std::pair<std::string, float> >& tks,
+    void pushClustering_(const std::string& cateMerge,
+        const Tokens& tks,
         const type::TermDictionary& dict,
         ClusteringContainer& clusteringContainer) const;
 
 private:
     type::TermDictionary& term_dictionary;
     ilplib::knlp::TitlePCA tok;
-    std::vector<ThreadContext*>* context_;
-    std::vector<boost::thread*>* thread_;
-    boost::unordered_map<std::string, std::list<Document> > cache_;
-    boost::shared_mutex mutex_;
-    bool exit_;
+    std::vector<AssignContext*>* context_;
+    std::vector<boost::thread*>* tokenizeThread_;
+    std::vector<boost::thread*>* assignThread_;
+    std::vector<std::size_t>* tokenized_;
+    DocumentQueue* documentQueue_;
+    DocumentBatch* batch_;
+    Stage stage_;
+    std::size_t read_;
+    boost::posix_time::ptime startTime_;
 
     std::vector<boost::unordered_map<std::string, float> >* clusteringContainer_;
     const std::size_t THREAD_NUM_;
+    const std::size_t TOKENIZE_THREAD_NUM_;
     const float THRESHOLD_;
     const std::size_t MAX_DOC_PER_CLUSTERING_;
     const std::size_t MIN_DOC_PER_CLUSTERING_;
-    const static std::size_t CACHE_THRESHOLD = 1024;
-    const static std::size_t MAX_BUFFER_SIZE = 1024*1024*1024;
+    const static std::size_t BATCH_SIZE = 256;
+    const static std::size_t DEFAULT_QUEUE_SIZE = 64;
 };
 
 void saveClusteringResult(const std::vector<boost::unordered_map<std::string, float> >& container, const std::string& filename);
 void loadClusteringResult(std::vector<boost::unordered_map<std::string, float> >& container, const std::string& filename);
 } } }
-#endif /* SEGMENTTOOL_H_ */
+#endif /* SF1R_LASER_PCA_RUNNER_H */
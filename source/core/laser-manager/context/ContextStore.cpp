@@ -0,0 +1,701 @@
+#include "ContextStore.h"
+#include <algorithm>
+#include <fstream>
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace sf1r { namespace laser { namespace context {
+
+static const std::size_t RECORD_ALIGNMENT = 8;
+
+static std::size_t align(std::size_t offset, std::size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+// round to nearest even, overflow goes to infinity
+static uint16_t toHalf(const float f)
+{
+    uint32_t x = 0;
+    memcpy(&x, &f, sizeof(x));
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const int32_t exp = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mant = x & 0x7fffff;
+    if (0xff == ((x >> 23) & 0xff))
+    {
+        return sign | 0x7c00 | (0 == mant ? 0 : 0x200);
+    }
+    if (exp >= 31)
+    {
+        return sign | 0x7c00;
+    }
+    if (exp <= 0)
+    {
+        if (exp < -10)
+        {
+            return sign;
+        }
+        mant |= 0x800000;
+        const uint32_t shift = 14 - exp;
+        uint32_t h = mant >> shift;
+        const uint32_t rem = mant & ((1U << shift) - 1);
+        const uint32_t half = 1U << (shift - 1);
+        if (rem > half || (rem == half && (h & 1)))
+        {
+            ++h;
+        }
+        return sign | h;
+    }
+    // a carry out of the mantissa rounds up into the exponent
+    uint32_t h = ((uint32_t)exp << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+    {
+        ++h;
+    }
+    return sign | h;
+}
+
+static float fromHalf(const uint16_t h)
+{
+    const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    const uint32_t exp = (h >> 10) & 0x1f;
+    const uint32_t mant = h & 0x3ff;
+    uint32_t x = 0;
+    if (0 == exp)
+    {
+        const float f = mant * (1.0f / 16777216.0f);
+        return sign ? -f : f;
+    }
+    else if (31 == exp)
+    {
+        x = sign | 0x7f800000 | (mant << 13);
+    }
+    else
+    {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+    float f = 0;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+// every half float decoded once, 256KB, stays in cache while decoding
+class HalfTable
+{
+public:
+    HalfTable()
+        : table_(1 << 16)
+    {
+        for (std::size_t i = 0; i < table_.size(); ++i)
+        {
+            table_[i] = fromHalf(i);
+        }
+    }
+
+    float operator[](const uint16_t h) const
+    {
+        return table_[h];
+    }
+
+private:
+    std::vector<float> table_;
+};
+
+static const HalfTable halfTable;
+
+static std::size_t payloadSize(const ContextStore::Encoding encoding, const std::size_t n)
+{
+    switch (encoding)
+    {
+    case ContextStore::DENSE_FLOAT:
+        return n * sizeof(float);
+    case ContextStore::DENSE_HALF:
+        return n * sizeof(uint16_t);
+    case ContextStore::SPARSE_FLOAT:
+        return n * (sizeof(uint32_t) + sizeof(float));
+    case ContextStore::SPARSE_HALF:
+        return n * (sizeof(uint32_t) + sizeof(uint16_t));
+    }
+    return 0;
+}
+
+static const char* payload(const ContextStore::Record* record)
+{
+    return reinterpret_cast<const char*>(record + 1) + align(record->keyLen, sizeof(uint32_t));
+}
+
+ContextStore::ContextStore()
+    : addr_(NULL)
+    , mapSize_(0)
+    , header_(NULL)
+    , buckets_(NULL)
+    , mask_(0)
+{
+}
+
+ContextStore::~ContextStore()
+{
+    close();
+}
+
+uint64_t ContextStore::hash(const std::string& user)
+{
+    // fnv-1a, then a murmur finalizer so the low bits are usable as the bucket
+    uint64_t h = 1469598103934665603ULL;
+    for (std::size_t i = 0; i < user.size(); ++i)
+    {
+        h ^= (unsigned char)user[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return 0 == h ? 1 : h;
+}
+
+bool ContextStore::open(const std::string& filename)
+{
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        LOG(ERROR)<<"open "<<filename<<" failed";
+        return false;
+    }
+    struct stat st;
+    if (0 != fstat(fd, &st) || (std::size_t)st.st_size < sizeof(Header))
+    {
+        ::close(fd);
+        LOG(ERROR)<<filename<<" is truncated";
+        return false;
+    }
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (MAP_FAILED == addr)
+    {
+        LOG(ERROR)<<"mmap "<<filename<<" failed";
+        return false;
+    }
+    const char* base = static_cast<const char*>(addr);
+    const std::size_t size = st.st_size;
+
+    const Header* header = reinterpret_cast<const Header*>(base);
+    const std::size_t tableEnd = sizeof(*header) + sizeof(Bucket) * header->bucketNum;
+    bool ret = MAGIC == header->magic && VERSION == header->version &&
+        sizeof(*header) + header->dataSize == size &&
+        0 != header->bucketNum && 0 == (header->bucketNum & (header->bucketNum - 1)) &&
+        header->userNum < header->bucketNum && tableEnd <= size;
+    if (!ret)
+    {
+        LOG(ERROR)<<filename<<" has unsupported version or bad size";
+    }
+    else
+    {
+        madvise(addr, size, MADV_SEQUENTIAL);
+        boost::crc_32_type crc;
+        crc.process_bytes(base + sizeof(*header), header->dataSize);
+        madvise(addr, size, MADV_RANDOM);
+        ret = crc.checksum() == header->checksum;
+        if (!ret)
+        {
+            LOG(ERROR)<<filename<<" checksum mismatch";
+        }
+    }
+    // every record a lookup can reach lies inside the file
+    const Bucket* buckets = reinterpret_cast<const Bucket*>(base + sizeof(*header));
+    std::size_t userNum = 0;
+    for (std::size_t i = 0; ret && i < header->bucketNum; ++i)
+    {
+        if (0 == buckets[i].hash)
+            continue;
+        ++userNum;
+        const uint64_t offset = buckets[i].offset;
+        ret = offset >= tableEnd && 0 == offset % RECORD_ALIGNMENT && offset + sizeof(Record) <= size;
+        if (ret)
+        {
+            const Record* record = reinterpret_cast<const Record*>(base + offset);
+            ret = record->encoding <= SPARSE_HALF &&
+                (std::size_t)(payload(record) - base) + payloadSize((Encoding)record->encoding, record->n) <= size;
+        }
+        // the dense decoding writes up to dimension, so do the sparse indices
+        if (ret)
+        {
+            const Record* record = reinterpret_cast<const Record*>(base + offset);
+            if (DENSE_FLOAT == record->encoding || DENSE_HALF == record->encoding)
+            {
+                ret = record->n == header->dimension;
+            }
+            else
+            {
+                const uint32_t* index = reinterpret_cast<const uint32_t*>(payload(record));
+                for (std::size_t k = 0; ret && k < record->n; ++k)
+                {
+                    ret = index[k] < header->dimension;
+                }
+            }
+        }
+        if (!ret)
+        {
+            LOG(ERROR)<<filename<<" has a bad record at bucket "<<i;
+        }
+    }
+    if (ret && userNum != header->userNum)
+    {
+        LOG(ERROR)<<filename<<" has "<<userNum<<" users in the table, expect "<<header->userNum;
+        ret = false;
+    }
+    if (!ret)
+    {
+        munmap(addr, size);
+        return false;
+    }
+
+    addr_ = base;
+    mapSize_ = size;
+    header_ = header;
+    buckets_ = buckets;
+    mask_ = header->bucketNum - 1;
+    return true;
+}
+
+void ContextStore::close()
+{
+    if (NULL != addr_)
+    {
+        munmap(const_cast<char*>(addr_), mapSize_);
+        addr_ = NULL;
+        mapSize_ = 0;
+    }
+    header_ = NULL;
+    buckets_ = NULL;
+    mask_ = 0;
+}
+
+std::size_t ContextStore::size() const
+{
+    return NULL == header_ ? 0 : header_->userNum;
+}
+
+std::size_t ContextStore::dimension() const
+{
+    return NULL == header_ ? 0 : header_->dimension;
+}
+
+const ContextStore::Record* ContextStore::find(const std::string& user) const
+{
+    if (NULL == addr_)
+    {
+        return NULL;
+    }
+    const uint64_t h = hash(user);
+    // the table is at most half full, there is always an empty bucket
+    for (uint64_t b = h & mask_; ; b = (b + 1) & mask_)
+    {
+        const Bucket& bucket = buckets_[b];
+        if (0 == bucket.hash)
+        {
+            return NULL;
+        }
+        if (h == bucket.hash)
+        {
+            const Record* record = reinterpret_cast<const Record*>(addr_ + bucket.offset);
+            if (record->keyLen == user.size() &&
+                0 == memcmp(record + 1, user.data(), user.size()))
+            {
+                return record;
+            }
+        }
+    }
+    return NULL;
+}
+
+bool ContextStore::context(const std::string& user, std::vector<std::pair<int, float> >& context) const
+{
+    context.clear();
+    const Record* record = find(user);
+    if (NULL == record)
+    {
+        return false;
+    }
+    const char* data = payload(record);
+    const std::size_t n = record->n;
+    switch (record->encoding)
+    {
+    case DENSE_FLOAT:
+    {
+        const float* value = reinterpret_cast<const float*>(data);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (0 != value[i])
+                context.push_back(std::make_pair((int)i, value[i]));
+        }
+        break;
+    }
+    case DENSE_HALF:
+    {
+        const uint16_t* value = reinterpret_cast<const uint16_t*>(data);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (0 != (value[i] & 0x7fff))
+                context.push_back(std::make_pair((int)i, halfTable[value[i]]));
+        }
+        break;
+    }
+    case SPARSE_FLOAT:
+    {
+        const uint32_t* index = reinterpret_cast<const uint32_t*>(data);
+        const float* value = reinterpret_cast<const float*>(index + n);
+        context.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            context[i] = std::make_pair((int)index[i], value[i]);
+        }
+        break;
+    }
+    case SPARSE_HALF:
+    {
+        const uint32_t* index = reinterpret_cast<const uint32_t*>(data);
+        const uint16_t* value = reinterpret_cast<const uint16_t*>(index + n);
+        context.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            context[i] = std::make_pair((int)index[i], halfTable[value[i]]);
+        }
+        break;
+    }
+    }
+    return true;
+}
+
+bool ContextStore::context(const std::string& user, std::vector<float>& context) const
+{
+    context.clear();
+    const Record* record = find(user);
+    if (NULL == record)
+    {
+        return false;
+    }
+    const char* data = payload(record);
+    const std::size_t n = record->n;
+    switch (record->encoding)
+    {
+    case DENSE_FLOAT:
+    {
+        const float* value = reinterpret_cast<const float*>(data);
+        context.assign(value, value + n);
+        break;
+    }
+    case DENSE_HALF:
+    {
+        const uint16_t* value = reinterpret_cast<const uint16_t*>(data);
+        context.resize(n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            context[i] = halfTable[value[i]];
+        }
+        break;
+    }
+    case SPARSE_FLOAT:
+    {
+        const uint32_t* index = reinterpret_cast<const uint32_t*>(data);
+        const float* value = reinterpret_cast<const float*>(index + n);
+        context.assign(header_->dimension, 0.0);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            context[index[i]] = value[i];
+        }
+        break;
+    }
+    case SPARSE_HALF:
+    {
+        const uint32_t* index = reinterpret_cast<const uint32_t*>(data);
+        const uint16_t* value = reinterpret_cast<const uint16_t*>(index + n);
+        context.assign(header_->dimension, 0.0);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            context[index[i]] = halfTable[value[i]];
+        }
+        break;
+    }
+    }
+    return true;
+}
+
+bool ContextStore::build(const std::string& textfile,
+    const std::string& storefile,
+    const std::size_t dimension,
+    const bool compact)
+{
+    ContextStoreBuilder builder(dimension, compact);
+    if (!builder.loadText(textfile))
+    {
+        return false;
+    }
+    LOG(INFO)<<"build context store "<<storefile<<" of "<<builder.size()<<" users from "<<textfile;
+    return builder.save(storefile);
+}
+
+ContextStoreBuilder::ContextStoreBuilder(const std::size_t dimension, const bool compact)
+    : dimension_(dimension)
+    , compact_(compact)
+{
+}
+
+bool ContextStoreBuilder::add(const std::string& user, const std::vector<float>& context)
+{
+    if (context.size() != dimension_)
+    {
+        LOG(ERROR)<<"context of "<<user<<" has dimension "<<context.size()<<", expect "<<dimension_;
+        return false;
+    }
+    nonzero_.clear();
+    for (std::size_t i = 0; i < context.size(); ++i)
+    {
+        if (0 != context[i])
+            nonzero_.push_back(std::make_pair((int)i, context[i]));
+    }
+    encode(user);
+    return true;
+}
+
+bool ContextStoreBuilder::add(const std::string& user, const std::vector<std::pair<int, float> >& context)
+{
+    nonzero_.clear();
+    for (std::size_t i = 0; i < context.size(); ++i)
+    {
+        if (context[i].first < 0 || (std::size_t)context[i].first >= dimension_)
+        {
+            LOG(ERROR)<<"context of "<<user<<" has index "<<context[i].first<<" out of dimension "<<dimension_;
+            return false;
+        }
+        if (0 != context[i].second)
+            nonzero_.push_back(context[i]);
+    }
+    std::sort(nonzero_.begin(), nonzero_.end());
+    // repeated indices add up
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < nonzero_.size(); ++i)
+    {
+        if (0 != k && nonzero_[k - 1].first == nonzero_[i].first)
+            nonzero_[k - 1].second += nonzero_[i].second;
+        else
+            nonzero_[k++] = nonzero_[i];
+    }
+    nonzero_.resize(k);
+    encode(user);
+    return true;
+}
+
+void ContextStoreBuilder::encode(const std::string& user)
+{
+    const ContextStore::Encoding dense = compact_ ? ContextStore::DENSE_HALF : ContextStore::DENSE_FLOAT;
+    const ContextStore::Encoding sparse = compact_ ? ContextStore::SPARSE_HALF : ContextStore::SPARSE_FLOAT;
+    const std::size_t nnz = nonzero_.size();
+    const bool isSparse = payloadSize(sparse, nnz) < payloadSize(dense, dimension_);
+    const ContextStore::Encoding encoding = isSparse ? sparse : dense;
+    const std::size_t n = isSparse ? nnz : dimension_;
+
+    payload_.assign(payloadSize(encoding, n), 0);
+    char* data = payload_.data();
+    uint32_t* index = reinterpret_cast<uint32_t*>(data);
+    // sparse values follow the indices, dense values start at the payload
+    char* value = isSparse ? reinterpret_cast<char*>(index + n) : data;
+    for (std::size_t k = 0; k < nnz; ++k)
+    {
+        const std::size_t pos = isSparse ? k : nonzero_[k].first;
+        if (isSparse)
+            index[k] = nonzero_[k].first;
+        if (compact_)
+            reinterpret_cast<uint16_t*>(value)[pos] = toHalf(nonzero_[k].second);
+        else
+            reinterpret_cast<float*>(value)[pos] = nonzero_[k].second;
+    }
+    append(user, encoding, n, data, payload_.size());
+}
+
+void ContextStoreBuilder::append(const std::string& user, const ContextStore::Encoding encoding,
+    const std::size_t n, const char* payload, const std::size_t payloadSize)
+{
+    const std::size_t offset = data_.size();
+    const std::size_t keySize = align(user.size(), sizeof(uint32_t));
+    const std::size_t size = align(sizeof(ContextStore::Record) + keySize + payloadSize, RECORD_ALIGNMENT);
+    data_.resize(offset + size, 0);
+
+    ContextStore::Record record;
+    memset(&record, 0, sizeof(record));
+    record.keyLen = user.size();
+    record.encoding = encoding;
+    record.n = n;
+    char* p = data_.data() + offset;
+    memcpy(p, &record, sizeof(record));
+    memcpy(p + sizeof(record), user.data(), user.size());
+    memcpy(p + sizeof(record) + keySize, payload, payloadSize);
+    users_.push_back(std::make_pair(ContextStore::hash(user), offset));
+}
+
+bool ContextStoreBuilder::loadText(const std::string& filename)
+{
+    std::ifstream ifs(filename.c_str());
+    if (!ifs)
+    {
+        LOG(ERROR)<<"open "<<filename<<" failed";
+        return false;
+    }
+    std::string line;
+    std::vector<float> dense;
+    std::vector<std::pair<int, float> > sparse;
+    std::size_t lineNum = 0;
+    std::size_t skipped = 0;
+    while (std::getline(ifs, line))
+    {
+        ++lineNum;
+        const std::size_t tab = line.find('\t');
+        if (std::string::npos == tab || 0 == tab)
+        {
+            if (!line.empty())
+                ++skipped;
+            continue;
+        }
+        const std::string user = line.substr(0, tab);
+        const char* p = line.c_str() + tab + 1;
+        const bool isSparse = NULL != strchr(p, ':');
+        dense.clear();
+        sparse.clear();
+        bool ok = true;
+        while (ok)
+        {
+            while (' ' == *p || '\t' == *p || '\r' == *p)
+                ++p;
+            if ('\0' == *p)
+                break;
+            char* end = NULL;
+            if (isSparse)
+            {
+                const long index = strtol(p, &end, 10);
+                ok = end != p && ':' == *end;
+                if (ok)
+                {
+                    p = end + 1;
+                    const float value = strtof(p, &end);
+                    ok = end != p;
+                    sparse.push_back(std::make_pair((int)index, value));
+                }
+            }
+            else
+            {
+                const float value = strtof(p, &end);
+                ok = end != p;
+                dense.push_back(value);
+            }
+            p = end;
+        }
+        if (ok)
+        {
+            ok = isSparse ? add(user, sparse) : add(user, dense);
+        }
+        if (!ok)
+        {
+            LOG(WARNING)<<filename<<":"<<lineNum<<" bad context, skipped";
+            ++skipped;
+        }
+    }
+    if (0 != skipped)
+    {
+        LOG(WARNING)<<skipped<<" lines skipped in "<<filename;
+    }
+    return true;
+}
+
+bool ContextStoreBuilder::save(const std::string& filename) const
+{
+    std::size_t bucketNum = 16;
+    while (bucketNum < 2 * users_.size())
+    {
+        bucketNum <<= 1;
+    }
+    const uint64_t mask = bucketNum - 1;
+    const std::size_t recordBase = sizeof(ContextStore::Header) + sizeof(ContextStore::Bucket) * bucketNum;
+
+    std::vector<ContextStore::Bucket> buckets(bucketNum);
+    memset(buckets.data(), 0, sizeof(ContextStore::Bucket) * bucketNum);
+    std::size_t userNum = 0;
+    for (std::size_t i = 0; i < users_.size(); ++i)
+    {
+        const uint64_t h = users_[i].first;
+        const ContextStore::Record* record = reinterpret_cast<const ContextStore::Record*>(data_.data() + users_[i].second);
+        uint64_t b = h & mask;
+        for (; 0 != buckets[b].hash; b = (b + 1) & mask)
+        {
+            if (h != buckets[b].hash)
+                continue;
+            const ContextStore::Record* other = reinterpret_cast<const ContextStore::Record*>(
+                data_.data() + buckets[b].offset - recordBase);
+            if (other->keyLen == record->keyLen && 0 == memcmp(other + 1, record + 1, record->keyLen))
+                break;
+        }
+        if (0 == buckets[b].hash)
+        {
+            ++userNum;
+        }
+        buckets[b].hash = h;
+        buckets[b].offset = recordBase + users_[i].second;
+    }
+
+    ContextStore::Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = ContextStore::MAGIC;
+    header.version = ContextStore::VERSION;
+    header.dimension = dimension_;
+    header.userNum = userNum;
+    header.bucketNum = bucketNum;
+    header.dataSize = recordBase - sizeof(header) + data_.size();
+
+    boost::crc_32_type crc;
+    crc.process_bytes(buckets.data(), sizeof(ContextStore::Bucket) * bucketNum);
+    crc.process_bytes(data_.data(), data_.size());
+    header.checksum = crc.checksum();
+
+    const std::string tmpfile = filename + ".tmp";
+    FILE* fp = fopen(tmpfile.c_str(), "wb");
+    if (NULL == fp)
+    {
+        LOG(ERROR)<<"open "<<tmpfile<<" failed";
+        return false;
+    }
+    bool ret = true;
+    ret &= 1 == fwrite(&header, sizeof(header), 1, fp);
+    ret &= 1 == fwrite(buckets.data(), sizeof(ContextStore::Bucket) * bucketNum, 1, fp);
+    if (!data_.empty())
+    {
+        ret &= 1 == fwrite(data_.data(), data_.size(), 1, fp);
+    }
+    ret &= 0 == fflush(fp);
+    ret &= 0 == fsync(fileno(fp));
+    fclose(fp);
+
+    if (!ret)
+    {
+        LOG(ERROR)<<"write "<<tmpfile<<" failed";
+        boost::filesystem::remove(tmpfile);
+        return false;
+    }
+    if (0 != rename(tmpfile.c_str(), filename.c_str()))
+    {
+        LOG(ERROR)<<"rename "<<tmpfile<<" to "<<filename<<" failed";
+        return false;
+    }
+    return true;
+}
+
+} } }
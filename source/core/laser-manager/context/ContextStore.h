@@ -0,0 +1,143 @@
+#ifndef SF1R_LASER_CONTEXT_CONTEXT_STORE_H
+#define SF1R_LASER_CONTEXT_CONTEXT_STORE_H
+#include <string>
+#include <vector>
+#include <common/inttypes.h>
+#include <boost/noncopyable.hpp>
+
+namespace sf1r { namespace laser { namespace context {
+
+/*
+ * Read only user context store, one mmapped file:
+ *
+ *   Header | Bucket[bucketNum] | Record ...
+ *
+ * Buckets are an open addressing table of (key hash, record offset), the
+ * table is at most half full, so a lookup is one hash and a probe or two.
+ * Each record holds the user key and the context in one of the encodings
+ * below, the builder picks the smaller of dense and sparse. Contexts are
+ * exact floats unless built with compact = true, half floats keep only 3
+ * significant digits and so change the scores slightly.
+ */
+class ContextStore : boost::noncopyable
+{
+public:
+    enum Encoding
+    {
+        DENSE_FLOAT = 0,
+        DENSE_HALF = 1,
+        SPARSE_FLOAT = 2,
+        SPARSE_HALF = 3
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t checksum;
+        uint32_t reserved;
+        uint64_t dimension;
+        uint64_t userNum;
+        uint64_t bucketNum;
+        // bytes after the header
+        uint64_t dataSize;
+        char padding[16];
+    };
+
+    struct Bucket
+    {
+        // 0 marks an empty bucket
+        uint64_t hash;
+        uint64_t offset;
+    };
+
+    struct Record
+    {
+        uint32_t keyLen;
+        uint16_t encoding;
+        uint16_t reserved;
+        // dense: dimension, sparse: number of nonzeros
+        uint32_t n;
+        uint32_t reserved2;
+    };
+
+    const static uint32_t MAGIC = 0x5854434c;
+    const static uint32_t VERSION = 1;
+
+public:
+    ContextStore();
+    ~ContextStore();
+
+public:
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const
+    {
+        return NULL != addr_;
+    }
+
+    // false if the user is unknown, context is cleared either way
+    bool context(const std::string& user, std::vector<std::pair<int, float> >& context) const;
+    bool context(const std::string& user, std::vector<float>& context) const;
+
+    std::size_t size() const;
+    std::size_t dimension() const;
+
+    static uint64_t hash(const std::string& user);
+
+    // text dump to store, see ContextStoreBuilder::loadText
+    static bool build(const std::string& textfile,
+        const std::string& storefile,
+        const std::size_t dimension,
+        const bool compact = false);
+
+private:
+    const Record* find(const std::string& user) const;
+
+private:
+    const char* addr_;
+    std::size_t mapSize_;
+    const Header* header_;
+    const Bucket* buckets_;
+    uint64_t mask_;
+};
+
+class ContextStoreBuilder : boost::noncopyable
+{
+public:
+    ContextStoreBuilder(const std::size_t dimension, const bool compact = false);
+
+public:
+    // a user added twice keeps the last context
+    bool add(const std::string& user, const std::vector<float>& context);
+    bool add(const std::string& user, const std::vector<std::pair<int, float> >& context);
+
+    // one user per line, "user\tv0 v1 ... v(d-1)" or "user\ti:v i:v ...",
+    // lines that do not parse are logged and skipped
+    bool loadText(const std::string& filename);
+
+    bool save(const std::string& filename) const;
+
+    std::size_t size() const
+    {
+        return users_.size();
+    }
+
+private:
+    // nonzero_ sorted by index to the smallest encoding
+    void encode(const std::string& user);
+    void append(const std::string& user, const ContextStore::Encoding encoding,
+        const std::size_t n, const char* payload, const std::size_t payloadSize);
+
+private:
+    const std::size_t dimension_;
+    const bool compact_;
+    // (hash, offset of the record in data_)
+    std::vector<std::pair<uint64_t, uint64_t> > users_;
+    std::vector<char> data_;
+    std::vector<char> payload_;
+    std::vector<std::pair<int, float> > nonzero_;
+};
+
+} } }
+#endif
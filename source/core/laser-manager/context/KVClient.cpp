@@ -0,0 +1,89 @@
+#include "KVClient.h"
+#include "ContextStore.h"
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+
+namespace sf1r { namespace laser { namespace context {
+
+static const std::string STORE_SUFFIX = ".store";
+
+KVClient::KVClient(const std::string& addr, const int port, const std::size_t dimension)
+    : store_(NULL)
+{
+    store_ = new ContextStore();
+    if (!open(addr, port, dimension))
+    {
+        LOG(WARNING)<<"no user context store at \""<<addr<<"\", every user misses";
+    }
+}
+
+KVClient::~KVClient()
+{
+    if (NULL != store_)
+    {
+        delete store_;
+        store_ = NULL;
+    }
+}
+
+bool KVClient::open(const std::string& addr, const int port, const std::size_t dimension)
+{
+    if (addr.empty())
+    {
+        return false;
+    }
+    if (!boost::filesystem::is_regular_file(addr))
+    {
+        LOG(ERROR)<<"kvaddr \""<<addr<<"\" (kvport "<<port<<") is not a local file, remote kv servers are "
+            <<"not supported, kvaddr must name a context store or its text dump";
+        return false;
+    }
+    if (0 != port)
+    {
+        LOG(WARNING)<<"kvaddr \""<<addr<<"\" is a local file, kvport "<<port<<" is ignored";
+    }
+    std::string storefile = addr;
+    const bool isStore = addr.size() > STORE_SUFFIX.size() &&
+        0 == addr.compare(addr.size() - STORE_SUFFIX.size(), STORE_SUFFIX.size(), STORE_SUFFIX);
+    if (!isStore)
+    {
+        storefile = addr + STORE_SUFFIX;
+        if (!boost::filesystem::exists(storefile) ||
+            boost::filesystem::last_write_time(storefile) < boost::filesystem::last_write_time(addr))
+        {
+            if (!ContextStore::build(addr, storefile, dimension))
+            {
+                return false;
+            }
+        }
+    }
+    if (!store_->open(storefile))
+    {
+        return false;
+    }
+    if (store_->dimension() != dimension)
+    {
+        LOG(ERROR)<<storefile<<" has dimension "<<store_->dimension()<<", expect "<<dimension;
+        store_->close();
+        return false;
+    }
+    LOG(INFO)<<"open user context store "<<storefile<<", user size = "<<store_->size();
+    return true;
+}
+
+bool KVClient::context(const std::string& text, std::vector<std::pair<int, float> >& context) const
+{
+    return store_->context(text, context);
+}
+
+bool KVClient::context(const std::string& text, std::vector<float>& context) const
+{
+    return store_->context(text, context);
+}
+
+void KVClient::shutdown()
+{
+    store_->close();
+}
+
+} } }
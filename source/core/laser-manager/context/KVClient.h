@@ -1,37 +1,36 @@
 #ifndef SF1R_LASER_CONTEXT_KV_CLIENT_H
 #define SF1R_LASER_CONTEXT_KV_CLIENT_H
+#include <string>
+#include <vector>
 
 namespace sf1r { namespace laser { namespace context {
+class ContextStore;
+
+/*
+ * User context from the embedded ContextStore. addr is a local path, either
+ * a built store ending with ".store", or a text dump that is built into
+ * addr + ".store" on first use and again whenever the dump is newer.
+ * There is no remote kv server client, an addr that is not a local file is
+ * rejected with an error. Without a store every user misses.
+ */
 class KVClient
 {
 public:
-    KVClient(const std::string& addr, const int port)
-    {
-    }
-
+    KVClient(const std::string& addr, const int port, const std::size_t dimension);
+    ~KVClient();
 
 public:
-    bool context(const std::string& text, std::vector<std::pair<int, float> >& context) const
-    {
-        for (std::size_t i = 0; i < 200; ++i)
-        {
-            context.push_back(std::make_pair(i, (rand() % 100) / 100.0));
-        }
-        return true;
-    }
+    bool context(const std::string& text, std::vector<std::pair<int, float> >& context) const;
     
-    bool context(const std::string& text, std::vector<float>& context) const
-    {
-        for (std::size_t i = 0; i < 200; ++i)
-        {
-            context.push_back((rand() % 100) / 100.0);
-        }
-        return true;
-    }
+    bool context(const std::string& text, std::vector<float>& context) const;
+
+    void shutdown();
+
+private:
+    bool open(const std::string& addr, const int port, const std::size_t dimension);
 
-    void shutdown()
-    {
-    }
+private:
+    ContextStore* store_;
 };
 } } }
 
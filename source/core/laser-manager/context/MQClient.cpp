@@ -1,21 +1,29 @@
 #include "MQClient.h"
 #include <sf1r-net/RpcServerConnectionConfig.h>
+#include <boost/bind.hpp>
 
 namespace sf1r { namespace laser { namespace context {
 
-MQClient::MQClient(const std::string& addr, const int port)
+MQClient::MQClient(const std::string& addr, const int port, const MQProducer::Options& options)
     : addr_(addr)
     , port_(port)
     , conn_(NULL)
+    , producer_(NULL)
 {
     RpcServerConnectionConfig config(addr_, port_, 2);
     conn_ = new RpcServerConnection();
     conn_->init(config);
+    producer_ = new MQProducer(boost::bind(&MQClient::send, this, _1), options);
 }
 
 MQClient::~MQClient()
 {
     shutdown();
+    if (NULL != producer_)
+    {
+        delete producer_;
+        producer_ = NULL;
+    }
     if (NULL != conn_)
     {
         conn_->flushRequests();
@@ -26,12 +34,48 @@ MQClient::~MQClient()
 
 void MQClient::publish(const std::string& topic)
 {
-    bool res = false;
-    conn_->syncRequest("publish", topic, res);
+    producer_->push("publish", topic);
+}
+
+MQProducer::Counters MQClient::counters() const
+{
+    return producer_->counters();
+}
+
+bool MQClient::send(const std::vector<MQMessage>& batch)
+{
+    try
+    {
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            const MQMessage& msg = batch[i];
+            if (msg.data.empty())
+            {
+                conn_->asynRequest(msg.method, msg.topic);
+                continue;
+            }
+            msgpack::unpacked unpacked;
+            msgpack::unpack(&unpacked, msg.data.data(), msg.data.size());
+            ReqData<msgpack::object> req(msg.topic, unpacked.get());
+            conn_->asynRequest(msg.method, req);
+        }
+        conn_->flushRequests();
+    }
+    catch (const std::exception& e)
+    {
+        LOG(ERROR)<<"send "<<batch.size()<<" messages to "<<addr_<<":"<<port_<<" failed: "<<e.what();
+        return false;
+    }
+    return true;
 }
 
 void MQClient::shutdown()
 {
+    // delivers what is queued, the connection stays until the destructor
+    if (NULL != producer_)
+    {
+        producer_->shutdown();
+    }
 }
 
 } } }
@@ -3,6 +3,7 @@
 #include <sf1r-net/RpcServerConnection.h>
 #include <3rdparty/msgpack/rpc/server.h>
 #include <glog/logging.h>
+#include "MQProducer.h"
 
 namespace sf1r { namespace laser { namespace context {
 
@@ -22,27 +23,42 @@ private:
     const T val_;
 };
 
+/*
+ * publish() and produce() only enqueue, the MQProducer thread sends the
+ * messages as rpc notifications and flushes the connection once a batch.
+ * Notifications get no reply, so counters() tells what was flushed to the
+ * connection, not what the broker received.
+ */
 class MQClient
 {
 public:
-    MQClient(const std::string& addr, const int port);
+    MQClient(const std::string& addr, const int port, 
+        const MQProducer::Options& options = MQProducer::Options());
     ~MQClient();
 
 public:
     void shutdown();
     void publish(const std::string& topic);
     template <typename T> bool produce(const std::string& topic, const T& val);
+
+    MQProducer::Counters counters() const;
+
+private:
+    bool send(const std::vector<MQMessage>& batch);
+
 private:
     const std::string addr_;
     const int port_;
     RpcServerConnection* conn_;
+    MQProducer* producer_;
 };
     
 template <typename T> bool MQClient::produce(const std::string& topic, const T& val)
 {
-    ReqData<T> req(topic, val);
-    conn_->asynRequest("produce", req);
-    return true;
+    // packed on the calling thread, the producer does not know T
+    msgpack::sbuffer sbuf;
+    msgpack::pack(sbuf, val);
+    return producer_->push("produce", topic, sbuf.data(), sbuf.size());
 }
 
 } } } 
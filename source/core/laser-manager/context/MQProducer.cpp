@@ -0,0 +1,176 @@
+#include "MQProducer.h"
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <glog/logging.h>
+
+namespace sf1r { namespace laser { namespace context {
+
+MQProducer::MQProducer(const Sender& sender, const Options& options)
+    : sender_(sender)
+    , options_(options)
+    , ring_(std::max(options.capacity, (std::size_t)1))
+    , head_(0)
+    , size_(0)
+    , inFlight_(0)
+    , flushWaiters_(0)
+    , stop_(false)
+    , enqueued_(0)
+    , dropped_(0)
+    , flushed_(0)
+    , unsent_(0)
+    , batches_(0)
+    , thread_(NULL)
+{
+    thread_ = new boost::thread(boost::bind(&MQProducer::run, this));
+}
+
+MQProducer::~MQProducer()
+{
+    shutdown();
+}
+
+bool MQProducer::push(const std::string& method,
+    const std::string& topic,
+    const char* data,
+    const std::size_t size)
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    if (BLOCK == options_.policy)
+    {
+        while (size_ == ring_.size() && !stop_)
+        {
+            notFull_.wait(lock);
+        }
+    }
+    if (size_ == ring_.size() || stop_)
+    {
+        ++dropped_;
+        return false;
+    }
+    MQMessage& msg = ring_[(head_ + size_) % ring_.size()];
+    msg.method.assign(method);
+    msg.topic.assign(topic);
+    msg.data.assign(data, size);
+    ++size_;
+    ++enqueued_;
+    // the producer only sleeps on an empty ring, or lingers on a partial batch
+    if (1 == size_ || options_.batchSize == size_)
+    {
+        notEmpty_.notify_one();
+    }
+    return true;
+}
+
+void MQProducer::flush()
+{
+    boost::mutex::scoped_lock lock(mutex_);
+    ++flushWaiters_;
+    notEmpty_.notify_one();
+    while (0 != size_ || 0 != inFlight_)
+    {
+        idle_.wait(lock);
+    }
+    --flushWaiters_;
+}
+
+void MQProducer::shutdown()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        stop_ = true;
+        notEmpty_.notify_one();
+        notFull_.notify_all();
+    }
+    if (NULL != thread_)
+    {
+        thread_->join();
+        delete thread_;
+        thread_ = NULL;
+        const Counters c = counters();
+        LOG(INFO)<<"mq producer enqueued = "<<c.enqueued<<"\t dropped = "<<c.dropped
+            <<"\t flushed = "<<c.flushed<<"\t unsent = "<<c.unsent<<"\t batches = "<<c.batches;
+    }
+}
+
+MQProducer::Counters MQProducer::counters() const
+{
+    Counters c;
+    c.enqueued = enqueued_.load();
+    c.dropped = dropped_.load();
+    c.flushed = flushed_.load();
+    c.unsent = unsent_.load();
+    c.batches = batches_.load();
+    return c;
+}
+
+void MQProducer::run()
+{
+    const std::size_t batchSize = std::max(options_.batchSize, (std::size_t)1);
+    std::vector<MQMessage> batch;
+    batch.reserve(batchSize);
+    while (true)
+    {
+        {
+            boost::mutex::scoped_lock lock(mutex_);
+            while (0 == size_ && !stop_)
+            {
+                notEmpty_.wait(lock);
+            }
+            if (0 == size_)
+            {
+                break;
+            }
+            // give a partial batch lingerMs to fill up
+            const boost::system_time deadline = boost::get_system_time() +
+                boost::posix_time::milliseconds(options_.lingerMs);
+            while (size_ < batchSize && !stop_ && 0 == flushWaiters_)
+            {
+                if (!notEmpty_.timed_wait(lock, deadline))
+                    break;
+            }
+            const std::size_t n = std::min(size_, batchSize);
+            batch.resize(n);
+            // swap, the ring gets the buffers of the previous batch back
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                MQMessage& msg = ring_[head_];
+                batch[i].method.swap(msg.method);
+                batch[i].topic.swap(msg.topic);
+                batch[i].data.swap(msg.data);
+                head_ = (head_ + 1) % ring_.size();
+            }
+            size_ -= n;
+            inFlight_ = n;
+            notFull_.notify_all();
+        }
+
+        bool ret = false;
+        try
+        {
+            ret = sender_(batch);
+        }
+        catch (const std::exception& e)
+        {
+            LOG(ERROR)<<"mq producer send failed: "<<e.what();
+        }
+        if (ret)
+        {
+            flushed_ += batch.size();
+        }
+        else
+        {
+            // events are best effort, a lost batch is counted, not retried
+            unsent_ += batch.size();
+        }
+        ++batches_;
+
+        boost::mutex::scoped_lock lock(mutex_);
+        inFlight_ = 0;
+        idle_.notify_all();
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    idle_.notify_all();
+}
+
+} } }
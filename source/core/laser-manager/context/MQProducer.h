@@ -0,0 +1,118 @@
+#ifndef SF1R_LASER_CONTEXT_MQ_PRODUCER_H
+#define SF1R_LASER_CONTEXT_MQ_PRODUCER_H
+#include <string>
+#include <vector>
+#include <common/inttypes.h>
+#include <boost/noncopyable.hpp>
+#include <boost/function.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace sf1r { namespace laser { namespace context {
+
+struct MQMessage
+{
+    std::string method;
+    std::string topic;
+    // packed value, empty for a bare publish
+    std::string data;
+};
+
+/*
+ * Background producer, push() copies the message into a bounded ring and
+ * returns, one thread drains the ring in batches of up to batchSize, or
+ * whatever is there after lingerMs, and hands every batch to the sender.
+ * Ring slots keep their string buffers, so steady state pushes do not
+ * allocate.
+ */
+class MQProducer : boost::noncopyable
+{
+public:
+    enum OverflowPolicy
+    {
+        // a push to a full ring fails and is counted as dropped
+        DROP,
+        // a push to a full ring waits for room
+        BLOCK
+    };
+
+    struct Options
+    {
+        std::size_t capacity;
+        std::size_t batchSize;
+        std::size_t lingerMs;
+        OverflowPolicy policy;
+
+        Options()
+            : capacity(8192)
+            , batchSize(256)
+            , lingerMs(5)
+            , policy(DROP)
+        {
+        }
+    };
+
+    struct Counters
+    {
+        uint64_t enqueued;
+        uint64_t dropped;
+        // handed to the sender and flushed, the broker does not acknowledge
+        // notifications, so a message lost after the flush is not seen here
+        uint64_t flushed;
+        // in a batch the sender could not write out
+        uint64_t unsent;
+        uint64_t batches;
+    };
+
+    // false if the batch is lost, every message in it counts as unsent
+    typedef boost::function<bool (const std::vector<MQMessage>&)> Sender;
+
+public:
+    MQProducer(const Sender& sender, const Options& options = Options());
+    ~MQProducer();
+
+public:
+    bool push(const std::string& method,
+        const std::string& topic,
+        const char* data = NULL,
+        const std::size_t size = 0);
+
+    // wait until everything pushed so far has been handed to the sender
+    void flush();
+
+    // deliver what is left and stop, later pushes are dropped
+    void shutdown();
+
+    Counters counters() const;
+
+private:
+    void run();
+
+private:
+    const Sender sender_;
+    const Options options_;
+
+    std::vector<MQMessage> ring_;
+    std::size_t head_;
+    std::size_t size_;
+    std::size_t inFlight_;
+    std::size_t flushWaiters_;
+    bool stop_;
+    boost::mutex mutex_;
+    boost::condition_variable notEmpty_;
+    boost::condition_variable notFull_;
+    boost::condition_variable idle_;
+
+    boost::atomic<uint64_t> enqueued_;
+    boost::atomic<uint64_t> dropped_;
+    boost::atomic<uint64_t> flushed_;
+    boost::atomic<uint64_t> unsent_;
+    boost::atomic<uint64_t> batches_;
+
+    boost::thread* thread_;
+};
+
+} } }
+#endif
@@ -13,6 +13,8 @@ namespace laser
 namespace predict
 {
     TopNClusterContainer::TopNClusterContainer()
+        : topNclusterLeveldb_(NULL)
+        , topNclusterCache_(NULL)
     {
     }
 
@@ -23,11 +25,11 @@ namespace predict
 
     void TopNClusterContainer::output()
     {
-        if(topNclusterLeveldb_!= NULL && topNclusterLeveldb_->open())
+        if(topNclusterLeveldb_!= NULL)
         {
-            typedef AMIterator<TopNclusterLeveldbType > AMIteratorType;
-            AMIteratorType iter(*topNclusterLeveldb_);
-            AMIteratorType end;
+            typedef TopNclusterLeveldbType::iterator AMIteratorType;
+            AMIteratorType iter = topNclusterLeveldb_->begin();
+            AMIteratorType end = topNclusterLeveldb_->end();
             int iterStep = 0;
             for(; iter != end; ++iter)
             {
@@ -49,23 +51,31 @@ namespace predict
             boost::filesystem::create_directory(topNClusterPath_);
         }
 
+        release();
         topNclusterLeveldb_ = new TopNclusterLeveldbType(topNClusterPath_);
-        if(topNclusterLeveldb_->open())
-        {
-            return true;
-        }
-        else
+        if (!topNclusterLeveldb_->isOpen())
         {
-            release();
+            LOG(ERROR)<<"open TopNClusterContainer db failed: "<<topNClusterPath_;
+            delete topNclusterLeveldb_;
+            topNclusterLeveldb_ = NULL;
             return false;
         }
+        topNclusterCache_ = new TopNclusterCacheType(*topNclusterLeveldb_, CACHE_SIZE);
+        return true;
     }
 
     bool TopNClusterContainer::release()
     {
+        if (NULL != topNclusterCache_)
+        {
+            TopNclusterCacheType::Stats stats = topNclusterCache_->stats();
+            LOG(INFO)<<"TopNClusterContainer cache hits: "<<stats.hits<<", misses: "<<stats.misses
+                <<", hit rate: "<<stats.hitRate();
+            delete topNclusterCache_;
+            topNclusterCache_ = NULL;
+        }
         if (NULL != topNclusterLeveldb_)
         {
-            topNclusterLeveldb_->close();
             delete topNclusterLeveldb_;
             topNclusterLeveldb_ = NULL;
         }
@@ -74,9 +84,9 @@ namespace predict
 
     bool TopNClusterContainer::update(const TopNCluster& cluster)
     {
-        if(cluster.getUserName().compare("")!=0)
+        if(NULL != topNclusterCache_ && cluster.getUserName().compare("")!=0)
         {
-            return topNclusterLeveldb_->insert(cluster.getUserName(), cluster.getTopNCluster());
+            return topNclusterCache_->update(cluster.getUserName(), cluster.getTopNCluster());
         }
         return false;
 
@@ -84,8 +94,38 @@ namespace predict
 
     bool TopNClusterContainer::get(const std::string& user, ClusterContainer& cluster)
     {
-        bool res = topNclusterLeveldb_->get(user, cluster);
-        return res;
+        if (NULL == topNclusterCache_)
+        {
+            return false;
+        }
+        TopNclusterCacheType::ValuePtr cached = topNclusterCache_->get(user);
+        if (!cached)
+        {
+            return false;
+        }
+        cluster = *cached;
+        return true;
+    }
+
+    void TopNClusterContainer::get(const std::vector<std::string>& user,
+        std::vector<ClusterContainer>& cluster,
+        std::vector<bool>& found)
+    {
+        std::vector<TopNclusterCacheType::ValuePtr> cached(user.size());
+        if (NULL != topNclusterCache_)
+        {
+            topNclusterCache_->get(user, cached);
+        }
+        cluster.resize(user.size());
+        found.assign(user.size(), false);
+        for (std::size_t i = 0; i < user.size(); ++i)
+        {
+            if (cached[i])
+            {
+                cluster[i] = *cached[i];
+                found[i] = true;
+            }
+        }
     }
 }
 }
@@ -8,6 +8,8 @@
 #include <vector>
 #include <string>
 #include "TopNCluster.h"
+#include "laser-manager/LaserModelDB.h"
+#include "laser-manager/LaserModelCache.h"
 namespace sf1r
 {
 namespace laser
@@ -16,7 +18,8 @@ namespace predict
 {
     class TopNClusterContainer
     {
-        typedef izenelib::am::leveldb::Table<std::string, ClusterContainer> TopNclusterLeveldbType;
+        typedef LaserModelDB<std::string, ClusterContainer> TopNclusterLeveldbType;
+        typedef LaserModelCache<std::string, ClusterContainer> TopNclusterCacheType;
         //typedef boost::unordered_map<std::string, ClusterContainer> unordered_map;
     //private:
         //typedef unordered_map::const_iterator const_iterator;
@@ -34,9 +37,26 @@ namespace predict
     public:
         bool update(const TopNCluster& cluster);
         bool get(const std::string& user, ClusterContainer& cluster) ;
+        // found[i] tells whether cluster[i] was loaded
+        void get(const std::vector<std::string>& user,
+            std::vector<ClusterContainer>& cluster,
+            std::vector<bool>& found);
+        TopNclusterCacheType::Stats cacheStats() const
+        {
+            if (NULL == topNclusterCache_)
+            {
+                TopNclusterCacheType::Stats stats = {0, 0, 0};
+                return stats;
+            }
+            return topNclusterCache_->stats();
+        }
     private:
         TopNclusterLeveldbType* topNclusterLeveldb_;
+        // decoded hot users, update() writes through it, NULL if the db
+        // failed to open
+        TopNclusterCacheType* topNclusterCache_;
         std::string topNClusterPath_;
+        const static std::size_t CACHE_SIZE = 100000;
     };
 }
 }
@@ -1,5 +1,4 @@
 #include "AttrScoreCounter.h"
-#include "../group-manager/PropValueTable.h"
 #include "../util/convert_ustr.h"
 #include <la-manager/AttrTokenizeWrapper.h>
 
@@ -23,8 +22,7 @@ AttrScoreCounter::AttrScoreCounter(
 
 void AttrScoreCounter::addDoc(docid_t doc)
 {
-    std::string categoryStr;
-    categoryStr_(doc, categoryStr);
+    const category_id_t cateId = categoryId_(doc);
 
     std::set<AttrTable::nid_t> nameIdSet;
     AttrTable::ValueIdList valueIdList;
@@ -33,22 +31,13 @@ void AttrScoreCounter::addDoc(docid_t doc)
     for (std::size_t i = 0; i < valueIdList.size(); ++i)
     {
         AttrTable::vid_t vId = valueIdList[i];
-
         AttrTable::nid_t nameId = attrTable_.valueId2NameId(vId);
-        std::string nameStr;
-        nameStr_(nameId, nameStr);
 
-        double nameScore = attrTokenizeWrapper_.att_name_weight(nameStr,
-                                                                categoryStr);
+        double nameScore = nameWeight_(nameId, cateId);
         if (nameScore < kMinNameScore)
             continue;
 
-        std::string valueStr;
-        valueStr_(vId, valueStr);
-
-        double valueScore = attrTokenizeWrapper_.att_value_weight(nameStr,
-                                                                  valueStr,
-                                                                  categoryStr);
+        double valueScore = valueWeight_(nameId, vId, cateId);
         if (valueScore < kMinValueScore)
             continue;
 
@@ -73,30 +62,82 @@ double AttrScoreCounter::getValueScore_(AttrTable::vid_t valueId)
     return valueScoreTable_[valueId];
 }
 
-void AttrScoreCounter::nameStr_(AttrTable::nid_t nameId, std::string& nameStr) const
+double AttrScoreCounter::nameWeight_(
+    AttrTable::nid_t nameId,
+    category_id_t cateId)
 {
-    const izenelib::util::UString& ustr = attrTable_.nameStr(nameId);
-    convert_to_str(ustr, nameStr);
+    const CateNameId key(cateId, nameId);
+    boost::unordered_map<CateNameId, double>::const_iterator it =
+        nameWeightCache_.find(key);
+
+    if (it != nameWeightCache_.end())
+        return it->second;
+
+    double weight = attrTokenizeWrapper_.att_name_weight(nameStr_(nameId),
+                                                         categoryStr_(cateId));
+    nameWeightCache_[key] = weight;
+    return weight;
 }
 
-void AttrScoreCounter::valueStr_(AttrTable::vid_t valueId, std::string& valueStr) const
+double AttrScoreCounter::valueWeight_(
+    AttrTable::nid_t nameId,
+    AttrTable::vid_t valueId,
+    category_id_t cateId)
 {
-    const izenelib::util::UString& ustr = attrTable_.valueStr(valueId);
-    convert_to_str(ustr, valueStr);
+    const CateValueId key(cateId, valueId);
+    boost::unordered_map<CateValueId, double>::const_iterator it =
+        valueWeightCache_.find(key);
+
+    if (it != valueWeightCache_.end())
+        return it->second;
+
+    std::string valueStr;
+    convert_to_str(attrTable_.valueStr(valueId), valueStr);
+
+    double weight = attrTokenizeWrapper_.att_value_weight(nameStr_(nameId),
+                                                          valueStr,
+                                                          categoryStr_(cateId));
+    valueWeightCache_[key] = weight;
+    return weight;
+}
+
+const std::string& AttrScoreCounter::nameStr_(AttrTable::nid_t nameId)
+{
+    std::pair<boost::unordered_map<AttrTable::nid_t, std::string>::iterator, bool>
+        result = nameStrCache_.insert(std::make_pair(nameId, std::string()));
+
+    if (result.second)
+    {
+        convert_to_str(attrTable_.nameStr(nameId), result.first->second);
+    }
+
+    return result.first->second;
+}
+
+const std::string& AttrScoreCounter::categoryStr_(category_id_t cateId)
+{
+    std::pair<boost::unordered_map<category_id_t, std::string>::iterator, bool>
+        result = categoryStrCache_.insert(std::make_pair(cateId, std::string()));
+
+    if (result.second && cateId)
+    {
+        izenelib::util::UString ustr;
+        categoryValueTable_.propValueStr(cateId, ustr, false);
+        convert_to_str(ustr, result.first->second);
+    }
+
+    return result.first->second;
 }
 
-void AttrScoreCounter::categoryStr_(docid_t doc, std::string& categoryStr) const
+AttrScoreCounter::category_id_t AttrScoreCounter::categoryId_(docid_t doc) const
 {
     PropValueTable::PropIdList cateIdList;
     categoryValueTable_.getPropIdList(doc, cateIdList);
 
     if (cateIdList.empty())
-        return;
+        return 0;
 
-    PropValueTable::pvid_t cateId = cateIdList[0];
-    izenelib::util::UString ustr;
-    categoryValueTable_.propValueStr(cateId, ustr, false);
-    convert_to_str(ustr, categoryStr);
+    return cateIdList[0];
 }
 
 NS_FACETED_END
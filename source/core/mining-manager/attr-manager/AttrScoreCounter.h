@@ -7,6 +7,10 @@
 #define SF1R_ATTR_SCORE_COUNTER_H
 
 #include "AttrCounter.h"
+#include "../group-manager/PropValueTable.h"
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <utility>
 
 namespace sf1r
 {
@@ -15,8 +19,6 @@ class AttrTokenizeWrapper;
 
 NS_FACETED_BEGIN
 
-class PropValueTable;
-
 class AttrScoreCounter : public AttrCounter
 {
 public:
@@ -32,17 +34,41 @@ protected:
     virtual double getValueScore_(AttrTable::vid_t valueId);
 
 private:
-    void nameStr_(AttrTable::nid_t nameId, std::string& nameStr) const;
+    typedef PropValueTable::pvid_t category_id_t;
+
+    double nameWeight_(AttrTable::nid_t nameId, category_id_t cateId);
+
+    double valueWeight_(
+        AttrTable::nid_t nameId,
+        AttrTable::vid_t valueId,
+        category_id_t cateId);
+
+    const std::string& nameStr_(AttrTable::nid_t nameId);
 
-    void valueStr_(AttrTable::vid_t valueId, std::string& valueStr) const;
+    const std::string& categoryStr_(category_id_t cateId);
 
-    void categoryStr_(docid_t doc, std::string& categoryStr) const;
+    category_id_t categoryId_(docid_t doc) const;
 
 private:
     const PropValueTable& categoryValueTable_;
 
     AttrTokenizeWrapper& attrTokenizeWrapper_;
 
+    /**
+     * the top docs share a few categories and attribute names, so the
+     * weights and strings are cached for each category, instead of being
+     * looked up for each doc.
+     */
+    typedef std::pair<category_id_t, AttrTable::nid_t> CateNameId;
+    boost::unordered_map<CateNameId, double> nameWeightCache_;
+
+    typedef std::pair<category_id_t, AttrTable::vid_t> CateValueId;
+    boost::unordered_map<CateValueId, double> valueWeightCache_;
+
+    boost::unordered_map<AttrTable::nid_t, std::string> nameStrCache_;
+
+    boost::unordered_map<category_id_t, std::string> categoryStrCache_;
+
     /** map from name id to score */
     std::map<AttrTable::nid_t, double> nameScoreTable_;
 
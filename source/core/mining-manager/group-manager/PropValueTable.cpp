@@ -119,6 +119,7 @@ PropValueTable& PropValueTable::operator=(const PropValueTable& other)
         valueIdTable_ = other.valueIdTable_;
         saveIndexNum_ = other.saveIndexNum_;
         saveValueNum_ = other.saveValueNum_;
+        clearPathStrCache_();
     }
 
     return *this;
@@ -142,6 +143,8 @@ void PropValueTable::swap(PropValueTable& other)
     valueIdTable_.swap(other.valueIdTable_);
     std::swap(saveIndexNum_, other.saveIndexNum_);
     std::swap(saveValueNum_, other.saveValueNum_);
+    clearPathStrCache_();
+    other.clearPathStrCache_();
 }
 
 void PropValueTable::resize(std::size_t num)
@@ -250,6 +253,8 @@ bool PropValueTable::open()
         return false;
     }
 
+    clearPathStrCache_();
+
     const unsigned int valueNum = propStrVec_.size();
     if (valueNum != parentIdVec_.size())
     {
@@ -297,6 +302,13 @@ void PropValueTable::clear()
     valueIdTable_.clear();
     saveIndexNum_ = 0;
     saveValueNum_ = 0;
+
+    clearPathStrCache_();
+}
+
+void PropValueTable::clearPathStrCache_()
+{
+    std::vector<std::vector<std::string> >().swap(pathStrCache_);
 }
 
 bool PropValueTable::saveParentId_(const std::string& dirPath, const std::string& fileName) const
@@ -340,10 +352,20 @@ bool PropValueTable::saveParentId_(const std::string& dirPath, const std::string
 
 bool PropValueTable::testDoc(docid_t docId, pvid_t labelId) const
 {
-    std::set<pvid_t> parentSet;
-    parentIdSet(docId, parentSet);
+    PropIdList propIdList;
+    getPropIdList(docId, propIdList);
+
+    const std::size_t idNum = propIdList.size();
+    for (std::size_t i = 0; i < idNum; ++i)
+    {
+        for (pvid_t pvId = propIdList[i]; pvId; pvId = parentIdVec_[pvId])
+        {
+            if (pvId == labelId)
+                return true;
+        }
+    }
 
-    return parentSet.find(labelId) != parentSet.end();
+    return false;
 }
 
 void PropValueTable::propValuePath(
@@ -363,6 +385,40 @@ void PropValueTable::propValuePath(
     std::reverse(path.begin(), path.end());
 }
 
+void PropValueTable::propValuePath(
+    pvid_t pvId,
+    std::vector<std::string>& path,
+    bool isLock) const
+{
+    ScopedReadBoolLock lock(mutex_, isLock);
+    boost::mutex::scoped_lock cacheLock(pathStrMutex_);
+
+    path.clear();
+    if (pvId >= propStrVec_.size())
+        return;
+
+    if (pvId >= pathStrCache_.size())
+    {
+        pathStrCache_.resize(propStrVec_.size());
+    }
+
+    std::vector<std::string>& pathStr = pathStrCache_[pvId];
+    if (pathStr.empty())
+    {
+        // from leaf to root
+        for (pvid_t id = pvId; id; id = parentIdVec_[id])
+        {
+            pathStr.push_back(std::string());
+            propStrVec_[id].convertString(pathStr.back(), ENCODING_TYPE);
+        }
+
+        // from root to leaf
+        std::reverse(pathStr.begin(), pathStr.end());
+    }
+
+    path = pathStr;
+}
+
 PropValueTable::pvid_t PropValueTable::getFirstValueId(docid_t docId) const
 {
     PropIdList propIdList;
@@ -18,6 +18,7 @@
 #include <util/ustring/UString.h>
 
 #include <3rdparty/am/btree/btree_set.h>
+#include <boost/thread/mutex.hpp>
 #include <vector>
 #include <string>
 #include <map>
@@ -114,6 +115,16 @@ public:
         std::vector<izenelib::util::UString>& path,
         bool isLock = true) const;
 
+    /**
+     * Given value id @p pvId, get its path in UTF-8 strings.
+     * The paths are converted only at the first time, and cached in the
+     * table until it is cleared or reloaded.
+     */
+    void propValuePath(
+        pvid_t pvId,
+        std::vector<std::string>& path,
+        bool isLock = true) const;
+
     /**
      * @attention before calling below public functions,
      * you must call this statement for safe concurrent access:
@@ -180,6 +191,12 @@ private:
      */
     bool saveParentId_(const std::string& dirPath, const std::string& fileName) const;
 
+    /**
+     * Clear @c pathStrCache_, the write lock of @c mutex_ must be held
+     * by the caller.
+     */
+    void clearPathStrCache_();
+
 private:
     /** directory path */
     std::string dirPath_;
@@ -206,6 +223,14 @@ private:
     unsigned int saveIndexNum_;
     /** the number of elements in @c valueIdTable_.multiValueTable_ saved in file */
     unsigned int saveValueNum_;
+
+    /**
+     * mapping from value id to its path in UTF-8 strings, an empty path
+     * means it is not converted yet.
+     */
+    mutable std::vector<std::vector<std::string> > pathStrCache_;
+    /** the readers of @c mutex_ fill @c pathStrCache_ under this lock */
+    mutable boost::mutex pathStrMutex_;
 };
 
 template<typename SetType>
@@ -34,6 +34,18 @@ score_t ProductScoreSum::score(docid_t docId)
     return sum;
 }
 
+bool ProductScoreSum::isDocIteratorBound() const
+{
+    for (Scorers::const_iterator it = scorers_.begin();
+         it != scorers_.end(); ++it)
+    {
+        if ((*it)->isDocIteratorBound())
+            return true;
+    }
+
+    return false;
+}
+
 std::size_t ProductScoreSum::scorerNum_() const
 {
     return scorers_.size();
@@ -31,6 +31,8 @@ public:
 
     virtual score_t score(docid_t docId);
 
+    virtual bool isDocIteratorBound() const;
+
 protected:
     std::size_t scorerNum_() const;
 
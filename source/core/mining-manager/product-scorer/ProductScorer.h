@@ -33,6 +33,12 @@ public:
 
     virtual score_t score(docid_t docId) = 0;
 
+    /**
+     * @return true if @c score() reads the doc iterator of the search,
+     * so a doc could only be scored while the iterator is at it.
+     */
+    virtual bool isDocIteratorBound() const { return false; }
+
 protected:
     score_t weight_;
 };
@@ -32,6 +32,8 @@ public:
 
     virtual score_t score(docid_t docId);
 
+    virtual bool isDocIteratorBound() const { return true; }
+
 private:
     DocumentIterator& scoreDocIterator_;
 
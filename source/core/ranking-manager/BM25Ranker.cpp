@@ -55,24 +55,40 @@ void BM25Ranker::calculateTermUBs(const RankQueryProperty& queryProperty, ID_FRE
 
     for (std::size_t i = 0; i != queryProperty.size(); ++i)
     {
-        float maxtf = queryProperty.maxTermFreqAt(i);
-        float tfInQuery = queryProperty.termFreqAt(i);
+        calculateTermUB(queryProperty, i, queryProperty.maxTermFreqAt(i), ub[i]);
+    }
+}
 
-        // If the term exists
-        if(tfInQuery > 0.0F && maxtf > 0.0F)
-        {
-            float avgPropLength = queryProperty.getAveragePropertyLength();
-            float denominatorTF_LN = k1_ * (b_ * maxtf / avgPropLength + (1 - b_)) + maxtf;
+bool BM25Ranker::calculateTermUB(
+    const RankQueryProperty& queryProperty,
+    unsigned int termIndex,
+    float tf,
+    float& ub
+) const
+{
+    if (0 == queryProperty.getTotalPropertyLength() ||
+        termIndex >= idfParts_.size())
+    {
+        return false;
+    }
 
-            float tf_LNPart = (k1_ + 1) * maxtf / denominatorTF_LN;
-            float qtfPart = (k3_ + 1) * tfInQuery / (k3_ + tfInQuery);
-            ub[i] = idfParts_[i] * qtfPart * tf_LNPart;
-        }
-        else //ub = 0 make contribution also.
-        {
-            ub[i] = 0.0;
-        }
+    float tfInQuery = queryProperty.termFreqAt(termIndex);
+
+    // If the term exists
+    if(tfInQuery > 0.0F && tf > 0.0F)
+    {
+        float avgPropLength = queryProperty.getAveragePropertyLength();
+        float denominatorTF_LN = k1_ * (b_ * tf / avgPropLength + (1 - b_)) + tf;
+
+        float tf_LNPart = (k1_ + 1) * tf / denominatorTF_LN;
+        float qtfPart = (k3_ + 1) * tfInQuery / (k3_ + tfInQuery);
+        ub = idfParts_[termIndex] * qtfPart * tf_LNPart;
+    }
+    else //ub = 0 make contribution also.
+    {
+        ub = 0.0;
     }
+    return true;
 }
 
 float BM25Ranker::getScore(
@@ -45,6 +45,13 @@ public:
 
     void calculateTermUBs(const RankQueryProperty& queryProperty, ID_FREQ_MAP_T& ub);
 
+    bool calculateTermUB(
+        const RankQueryProperty& queryProperty,
+        unsigned int termIndex,
+        float tf,
+        float& ub
+    ) const;
+
     float getScore(
         const RankQueryProperty& queryProperty,
         const RankDocumentProperty& documentProperty
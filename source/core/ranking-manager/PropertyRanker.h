@@ -26,6 +26,21 @@ public:
 
     virtual void calculateTermUBs(const RankQueryProperty& queryProperty, ID_FREQ_MAP_T& ub) {}
 
+    /**
+     * @brief calculate the upper bound of the term at @p termIndex in a doc
+     * whose term frequency is @p tf.
+     * @return false if it is not supported, default is not.
+     */
+    virtual bool calculateTermUB(
+        const RankQueryProperty& queryProperty,
+        unsigned int termIndex,
+        float tf,
+        float& ub
+    ) const
+    {
+        return false;
+    }
+
     virtual float getTermUB(unsigned int termIndex) const
     {
         return 0;
@@ -74,6 +74,15 @@ void ANDDocumentIterator:: setUB(bool useOriginalQuery, UpperBoundInProperties&
     //LOG(INFO)<<"====AND::getUB===>>"<<getUB();
 }
 
+void ANDDocumentIterator::setBlockUB(const TermUBCalculator& ubCalculator)
+{
+    std::list<DocumentIterator*>::iterator it = docIterList_.begin();
+    for (; it != docIterList_.end(); it++)
+    {
+        (*it)->setBlockUB(ubCalculator);
+    }
+}
+
 float ANDDocumentIterator::getUB()
 {
     float sumUB = 0.0;
@@ -88,6 +88,8 @@ public:
     void print(int level = 0);
     
     void setUB( bool useOriginalQuery, UpperBoundInProperties& ubmap);
+
+    void setBlockUB(const TermUBCalculator& ubCalculator);
     
     float getUB();
 
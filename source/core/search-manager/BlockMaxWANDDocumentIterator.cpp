@@ -0,0 +1,275 @@
+#include "BlockMaxWANDDocumentIterator.h"
+#include <algorithm>
+
+namespace
+{
+
+template <typename CursorPtr>
+bool lessCursorDoc(CursorPtr x, CursorPtr y)
+{
+    return x->doc < y->doc;
+}
+
+}
+
+namespace sf1r
+{
+
+BlockMaxWANDDocumentIterator::BlockMaxWANDDocumentIterator(
+    PostingBlockMaxCache* blockMaxCache,
+    uint64_t indexGeneration)
+    : blockMaxCache_(blockMaxCache)
+    , indexGeneration_(indexGeneration)
+    , isCursorInited_(false)
+{
+}
+
+void BlockMaxWANDDocumentIterator::setBlockUB(const TermUBCalculator& ubCalculator)
+{
+    blockUBs_.clear();
+    blockUBs_.resize(docIteratorList_.size());
+
+    for (std::size_t i = 0; i < docIteratorList_.size(); ++i)
+    {
+        DocumentIterator* pEntry = docIteratorList_[i];
+        if (pEntry)
+        {
+            pEntry->getBlockUB(ubCalculator, blockMaxCache_, indexGeneration_,
+                               blockUBs_[i]);
+        }
+    }
+}
+
+void BlockMaxWANDDocumentIterator::initCursors()
+{
+    cursors_.clear();
+    for (std::size_t i = 0; i < docIteratorList_.size(); ++i)
+    {
+        DocumentIterator* pEntry = docIteratorList_[i];
+        if (!pEntry)
+            continue;
+
+        pEntry->setCurrent(false);
+
+        Cursor cursor;
+        cursor.iter = pEntry;
+        cursor.doc = pEntry->next() ? pEntry->doc() : MAX_DOC_ID;
+        cursor.ub = pEntry->getUB();
+        cursor.blockUB = NULL;
+        cursor.block = 0;
+
+        if (i < blockUBs_.size() && !blockUBs_[i].empty())
+        {
+            cursor.blockUB = &blockUBs_[i];
+        }
+        cursors_.push_back(cursor);
+    }
+
+    sortedCursors_.clear();
+    for (std::size_t i = 0; i < cursors_.size(); ++i)
+    {
+        sortedCursors_.push_back(&cursors_[i]);
+    }
+
+    isCursorInited_ = true;
+}
+
+void BlockMaxWANDDocumentIterator::nextCursor(Cursor& cursor)
+{
+    if (cursor.doc == MAX_DOC_ID)
+        return;
+
+    cursor.doc = cursor.iter->next() ? cursor.iter->doc() : MAX_DOC_ID;
+}
+
+void BlockMaxWANDDocumentIterator::skipCursor(Cursor& cursor, docid_t target)
+{
+    if (cursor.doc >= target)
+        return;
+
+    if (target == MAX_DOC_ID)
+    {
+        cursor.doc = MAX_DOC_ID;
+        return;
+    }
+
+    docid_t foundDoc = cursor.iter->skipTo(target);
+    if (foundDoc == MAX_DOC_ID || foundDoc < target)
+    {
+        foundDoc = MAX_DOC_ID;
+    }
+    cursor.doc = foundDoc;
+}
+
+float BlockMaxWANDDocumentIterator::moveBlock(
+    Cursor& cursor,
+    docid_t target,
+    docid_t& lastDoc)
+{
+    lastDoc = MAX_DOC_ID;
+    if (!cursor.blockUB)
+        return cursor.ub;
+
+    const std::vector<PostingBlock>& blocks = cursor.blockUB->blockMax().blocks();
+    cursor.block = cursor.blockUB->blockMax().findBlock(target, cursor.block);
+
+    // the postings appended after the blocks are built
+    if (cursor.block == blocks.size())
+        return cursor.ub;
+
+    lastDoc = blocks[cursor.block].lastDoc;
+    return cursor.blockUB->blockUB(cursor.block);
+}
+
+float BlockMaxWANDDocumentIterator::docUB(Cursor& cursor)
+{
+    if (!cursor.blockUB)
+        return cursor.ub;
+
+    float blockUB = cursor.ub;
+    if (cursor.block < cursor.blockUB->blockMax().blocks().size())
+    {
+        blockUB = cursor.blockUB->blockUB(cursor.block);
+    }
+    return cursor.blockUB->tfUB(cursor.iter->tf(), blockUB);
+}
+
+bool BlockMaxWANDDocumentIterator::findBlockPivot(std::size_t& pivot)
+{
+    const std::size_t cursorNum = sortedCursors_.size();
+    float sumUB = 0.0F;
+
+    for (std::size_t i = 0; i < cursorNum; ++i)
+    {
+        const docid_t doc = sortedCursors_[i]->doc;
+        if (doc == MAX_DOC_ID)
+            return false;
+
+        sumUB += sortedCursors_[i]->ub;
+        if (sumUB > currThreshold_)
+        {
+            // the following cursors at the pivot doc also contribute
+            pivot = i;
+            while (pivot + 1 < cursorNum && sortedCursors_[pivot + 1]->doc == doc)
+            {
+                ++pivot;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BlockMaxWANDDocumentIterator::findNextDoc()
+{
+    while (true)
+    {
+        std::sort(sortedCursors_.begin(), sortedCursors_.end(),
+                  lessCursorDoc<Cursor*>);
+
+        std::size_t pivot = 0;
+        if (!findBlockPivot(pivot))
+            return false;
+
+        const docid_t pivotDoc = sortedCursors_[pivot]->doc;
+        docid_t nextDoc = pivot + 1 < sortedCursors_.size() ?
+                          sortedCursors_[pivot + 1]->doc : MAX_DOC_ID;
+
+        float sumBlockUB = 0.0F;
+        for (std::size_t i = 0; i <= pivot; ++i)
+        {
+            docid_t lastDoc = MAX_DOC_ID;
+            sumBlockUB += moveBlock(*sortedCursors_[i], pivotDoc, lastDoc);
+
+            if (lastDoc < nextDoc - 1)
+            {
+                nextDoc = lastDoc + 1;
+            }
+        }
+
+        if (sumBlockUB <= currThreshold_)
+        {
+            // no doc before nextDoc could exceed the threshold
+            for (std::size_t i = 0; i <= pivot; ++i)
+            {
+                skipCursor(*sortedCursors_[i], nextDoc);
+            }
+            continue;
+        }
+
+        if (sortedCursors_[0]->doc != pivotDoc)
+        {
+            for (std::size_t i = 0; sortedCursors_[i]->doc < pivotDoc; ++i)
+            {
+                skipCursor(*sortedCursors_[i], pivotDoc);
+            }
+            continue;
+        }
+
+        float sumDocUB = 0.0F;
+        for (std::size_t i = 0; i <= pivot; ++i)
+        {
+            sumDocUB += docUB(*sortedCursors_[i]);
+        }
+
+        if (sumDocUB > currThreshold_)
+        {
+            currDoc_ = pivotDoc;
+            for (std::size_t i = 0; i < cursors_.size(); ++i)
+            {
+                cursors_[i].iter->setCurrent(cursors_[i].doc == currDoc_);
+            }
+            return true;
+        }
+
+        for (std::size_t i = 0; i <= pivot; ++i)
+        {
+            nextCursor(*sortedCursors_[i]);
+        }
+    }
+}
+
+bool BlockMaxWANDDocumentIterator::next()
+{
+    if (!isCursorInited_)
+    {
+        initCursors();
+    }
+    else
+    {
+        for (std::size_t i = 0; i < cursors_.size(); ++i)
+        {
+            if (cursors_[i].iter->isCurrent())
+            {
+                cursors_[i].iter->setCurrent(false);
+                nextCursor(cursors_[i]);
+            }
+        }
+    }
+
+    return findNextDoc();
+}
+
+#if SKIP_ENABLED
+docid_t BlockMaxWANDDocumentIterator::skipTo(docid_t target)
+{
+    if (!isCursorInited_)
+    {
+        initCursors();
+    }
+
+    for (std::size_t i = 0; i < cursors_.size(); ++i)
+    {
+        cursors_[i].iter->setCurrent(false);
+        skipCursor(cursors_[i], target);
+    }
+
+    if (findNextDoc())
+        return currDoc_;
+
+    currDoc_ = MAX_DOC_ID;
+    return MAX_DOC_ID;
+}
+#endif
+
+}
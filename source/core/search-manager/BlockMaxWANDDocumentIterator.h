@@ -0,0 +1,119 @@
+/**
+ * @file BlockMaxWANDDocumentIterator.h
+ * @brief the WAND iterator which bounds the term scores by the posting
+ * blocks, to skip the blocks which could not exceed the threshold.
+ */
+
+#ifndef SF1R_BLOCK_MAX_WAND_DOCUMENT_ITERATOR_H
+#define SF1R_BLOCK_MAX_WAND_DOCUMENT_ITERATOR_H
+
+#include "WANDDocumentIterator.h"
+#include "PostingBlockMax.h"
+
+#include <vector>
+
+namespace sf1r
+{
+
+class PostingBlockMaxCache;
+
+/**
+ * A doc is returned if the sum of the term upper bounds in this doc, each
+ * calculated by the term frequency in this doc, exceeds the threshold.
+ * WANDDocumentIterator also returns the docs whose terms only exceed the
+ * threshold by the upper bounds of their whole postings, so this iterator
+ * returns a subset of WAND, and the total count of the query is less. It is
+ * used by the WAND query only if @c enable_block_max_wand is configured.
+ *
+ * Like WAND, the pivot is selected by the upper bounds of the whole
+ * postings, then the cursors before the pivot are moved shallowly to the
+ * blocks containing the pivot, without decoding the postings. If the sum
+ * of these block upper bounds could not exceed the threshold, all docs
+ * up to the nearest block end are skipped.
+ *
+ * For the terms without the block upper bounds, such as the ranker does
+ * not support the upper bound by term frequency, the upper bound of the
+ * whole postings is used instead, so if no @c setBlockUB() is called,
+ * it returns the same docs as @c WANDDocumentIterator.
+ */
+class BlockMaxWANDDocumentIterator : public WANDDocumentIterator
+{
+public:
+    /**
+     * @param blockMaxCache the cache of the block max metadata, it could
+     *        be NULL to build the metadata for each query
+     * @param indexGeneration InvertedIndexManager::getIndexGeneration()
+     *        when the query starts
+     */
+    explicit BlockMaxWANDDocumentIterator(
+        PostingBlockMaxCache* blockMaxCache = NULL,
+        uint64_t indexGeneration = 0);
+
+    void setBlockUB(const TermUBCalculator& ubCalculator);
+
+    bool next();
+
+#if SKIP_ENABLED
+    docid_t skipTo(docid_t target);
+#endif
+
+private:
+    struct Cursor
+    {
+        DocumentIterator* iter;
+
+        /// MAX_DOC_ID if the postings are exhausted
+        docid_t doc;
+
+        /// the upper bound of the whole postings
+        float ub;
+
+        const PostingBlockUB* blockUB;
+
+        /// the block containing @c doc
+        std::size_t block;
+    };
+
+    void initCursors();
+
+    void nextCursor(Cursor& cursor);
+
+    void skipCursor(Cursor& cursor, docid_t target);
+
+    /**
+     * move @p cursor to the block which may contain @p target.
+     * @param lastDoc the last doc of that block
+     * @return the upper bound of that block
+     */
+    float moveBlock(Cursor& cursor, docid_t target, docid_t& lastDoc);
+
+    /// the upper bound of the doc at @p cursor
+    float docUB(Cursor& cursor);
+
+    /**
+     * @param pivot the last cursor at the pivot doc
+     * @return false if no doc could exceed the threshold
+     */
+    bool findBlockPivot(std::size_t& pivot);
+
+    bool findNextDoc();
+
+private:
+    PostingBlockMaxCache* blockMaxCache_;
+
+    const uint64_t indexGeneration_;
+
+    /// the block upper bounds of each iterator in @c docIteratorList_
+    std::vector<PostingBlockUB> blockUBs_;
+
+    std::vector<Cursor> cursors_;
+
+    /// the cursors in doc order
+    std::vector<Cursor*> sortedCursors_;
+
+    bool isCursorInited_;
+};
+
+}
+
+#endif // SF1R_BLOCK_MAX_WAND_DOCUMENT_ITERATOR_H
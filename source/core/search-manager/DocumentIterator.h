@@ -24,6 +24,10 @@ namespace sf1r
 {
 
 class VirtualPropertyTermDocumentIterator;
+class TermUBCalculator;
+class PostingBlockMaxCache;
+class PostingBlockUB;
+
 class DocumentIterator
 {
 public:
@@ -100,6 +104,22 @@ public:
         return 0.0;
     }
 
+    ///set the upper bounds of the terms by block, for block-max WAND
+    virtual void setBlockUB(const TermUBCalculator& ubCalculator)
+    {
+        return;
+    }
+
+    ///@return false if the upper bounds by block is not supported
+    virtual bool getBlockUB(
+        const TermUBCalculator& ubCalculator,
+        PostingBlockMaxCache* blockMaxCache,
+        uint64_t indexGeneration,
+        PostingBlockUB& blockUB)
+    {
+        return false;
+    }
+
     virtual const char* getProperty()
     {
         return NULL;
@@ -0,0 +1,19 @@
+#include "FilterBitsetCache.h"
+#include <3rdparty/msgpack/msgpack.hpp>
+
+namespace sf1r
+{
+
+FilterBitsetCache::FilterBitsetCache(std::size_t maxBytes)
+    : SizedLRUCache<value_type>("filter bitset", maxBytes)
+{
+}
+
+FilterBitsetCache::key_type FilterBitsetCache::getKey(const ConditionsNode& filterTree)
+{
+    msgpack::sbuffer buffer;
+    msgpack::pack(buffer, filterTree);
+    return key_type(buffer.data(), buffer.size());
+}
+
+} // namespace sf1r
@@ -0,0 +1,33 @@
+/**
+ * @file FilterBitsetCache.h
+ * @brief the decompressed bitsets of the filter trees, shared by the queries.
+ */
+
+#ifndef SF1R_FILTER_BITSET_CACHE_H
+#define SF1R_FILTER_BITSET_CACHE_H
+
+#include "SizedLRUCache.h"
+
+#include <common/parsers/ConditionsTree.h>
+#include <ir/index_manager/utility/Bitset.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace sf1r
+{
+
+typedef SizedLRUCacheStats FilterBitsetCacheStats;
+
+class FilterBitsetCache
+    : public SizedLRUCache<boost::shared_ptr<const izenelib::ir::indexmanager::Bitset> >
+{
+public:
+    explicit FilterBitsetCache(std::size_t maxBytes);
+
+    /// the key of the whole filter tree
+    static key_type getKey(const ConditionsNode& filterTree);
+};
+
+} // namespace sf1r
+
+#endif // SF1R_FILTER_BITSET_CACHE_H
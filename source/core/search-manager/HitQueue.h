@@ -13,6 +13,8 @@
 #include "Sorter.h"
 #include <util/PriorityQueue.h>
 
+#include <vector>
+
 
 namespace sf1r
 {
@@ -28,6 +30,8 @@ public:
     virtual ScoreDoc getAt(size_t pos) = 0;
     virtual size_t size() = 0;
     virtual void clear() = 0;
+    /// whether @p o1 ranks lower than @p o2 in this queue
+    virtual bool lessThan(const ScoreDoc& o1, const ScoreDoc& o2) = 0;
 };
 
 class ScoreSortedHitQueue : public HitQueue
@@ -39,6 +43,10 @@ class ScoreSortedHitQueue : public HitQueue
         {
             initialize(size);
         }
+        bool less(const ScoreDoc& o1, const ScoreDoc& o2) const
+        {
+            return lessThan(o1, o2);
+        }
     protected:
         bool lessThan(const ScoreDoc& o1, const ScoreDoc& o2) const
         {
@@ -83,6 +91,10 @@ public:
         return queue_.size();
     }
     void clear() {}
+    bool lessThan(const ScoreDoc& o1, const ScoreDoc& o2)
+    {
+        return queue_.less(o1, o2);
+    }
 
 private:
     Queue_ queue_;
@@ -90,6 +102,158 @@ private:
 
 class PropSharedLockSet;
 
+/**
+ * A heap of the docs with their ScoreDoc::sortKeys filled, it compares
+ * @c KeyNum keys then the docid inline, without any virtual call.
+ * It keeps the lowest doc on top like izenelib::util::PriorityQueue.
+ */
+template <std::size_t KeyNum>
+class SortKeyQueue
+{
+public:
+    explicit SortKeyQueue(std::size_t maxSize)
+        : maxSize_(maxSize)
+    {
+        heap_.reserve(maxSize);
+    }
+
+    static bool lessThan(const ScoreDoc& o1, const ScoreDoc& o2)
+    {
+        for (std::size_t i = 0; i < KeyNum; ++i)
+        {
+            if (o1.sortKeys[i] != o2.sortKeys[i])
+                return o1.sortKeys[i] < o2.sortKeys[i];
+        }
+        return o1.docId < o2.docId;
+    }
+
+    bool insert(const ScoreDoc& doc)
+    {
+        if (heap_.size() < maxSize_)
+        {
+            heap_.push_back(doc);
+            upHeap_(heap_.size() - 1);
+            return true;
+        }
+
+        if (!heap_.empty() && !lessThan(doc, heap_[0]))
+        {
+            heap_[0] = doc;
+            downHeap_();
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Like insert(), but the keys of @p doc are filled by @p sorter only as
+     * far as needed to reject it against the top of a full heap, most docs
+     * of a search are rejected by the first key.
+     */
+    bool insert(ScoreDoc doc, const Sorter& sorter)
+    {
+        std::size_t i = 0;
+        if (heap_.size() >= maxSize_)
+        {
+            if (heap_.empty())
+                return false;
+
+            const ScoreDoc& lowest = heap_[0];
+            for (; i < KeyNum; ++i)
+            {
+                doc.sortKeys[i] = sorter.getSortKey(doc, i);
+                if (doc.sortKeys[i] != lowest.sortKeys[i])
+                    break;
+            }
+            if (i == KeyNum ? doc.docId < lowest.docId
+                            : doc.sortKeys[i] < lowest.sortKeys[i])
+                return false;
+        }
+
+        for (; i < KeyNum; ++i)
+        {
+            doc.sortKeys[i] = sorter.getSortKey(doc, i);
+        }
+        return insert(doc);
+    }
+
+    ScoreDoc top() const
+    {
+        return heap_.empty() ? ScoreDoc() : heap_[0];
+    }
+
+    ScoreDoc pop()
+    {
+        if (heap_.empty())
+            return ScoreDoc();
+
+        ScoreDoc result = heap_[0];
+        heap_[0] = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty())
+        {
+            downHeap_();
+        }
+        return result;
+    }
+
+    ScoreDoc getAt(std::size_t pos) const
+    {
+        return heap_[pos];
+    }
+
+    std::size_t size() const
+    {
+        return heap_.size();
+    }
+
+private:
+    void upHeap_(std::size_t i)
+    {
+        const ScoreDoc node = heap_[i];
+        while (i > 0)
+        {
+            const std::size_t parent = (i - 1) >> 1;
+            if (!lessThan(node, heap_[parent]))
+                break;
+
+            heap_[i] = heap_[parent];
+            i = parent;
+        }
+        heap_[i] = node;
+    }
+
+    void downHeap_()
+    {
+        const std::size_t size = heap_.size();
+        const ScoreDoc node = heap_[0];
+        std::size_t i = 0;
+        std::size_t child = 1;
+        while (child < size)
+        {
+            if (child + 1 < size && lessThan(heap_[child + 1], heap_[child]))
+            {
+                ++child;
+            }
+            if (!lessThan(heap_[child], node))
+                break;
+
+            heap_[i] = heap_[child];
+            i = child;
+            child = (i << 1) + 1;
+        }
+        heap_[i] = node;
+    }
+
+private:
+    const std::size_t maxSize_;
+    std::vector<ScoreDoc> heap_;
+};
+
+/**
+ * With the sort keys in ScoreDoc (one or two sort properties), the docs
+ * go to a SortKeyQueue, otherwise they are compared by Sorter::lessThan().
+ */
 class PropertySortedHitQueue : public HitQueue
 {
     class Queue_ : public izenelib::util::PriorityQueue<ScoreDoc>
@@ -97,14 +261,15 @@ class PropertySortedHitQueue : public HitQueue
     public:
         Queue_(
             boost::shared_ptr<Sorter>& pSorter,
-            size_t size,
-            PropSharedLockSet& propSharedLockSet)
+            size_t size)
             : pSorter_(pSorter)
         {
-            if(pSorter)
-                pSorter->createComparators(propSharedLockSet);
             initialize(size);
         }
+        bool less(const ScoreDoc& o1, const ScoreDoc& o2) const
+        {
+            return lessThan(o1, o2);
+        }
     protected:
         bool lessThan(const ScoreDoc& o1, const ScoreDoc& o2) const
         {
@@ -114,12 +279,27 @@ class PropertySortedHitQueue : public HitQueue
         boost::shared_ptr<Sorter> pSorter_;
     };
 
+    static std::size_t createComparators_(
+        boost::shared_ptr<Sorter>& pSorter,
+        PropSharedLockSet& propSharedLockSet)
+    {
+        if (!pSorter)
+            return 0;
+
+        pSorter->createComparators(propSharedLockSet);
+        return pSorter->sortKeyNum();
+    }
+
 public:
     PropertySortedHitQueue(
         boost::shared_ptr<Sorter>& pSorter,
         size_t size,
         PropSharedLockSet& propSharedLockSet)
-        : queue_(pSorter, size, propSharedLockSet)
+        : pSorter_(pSorter)
+        , sortKeyNum_(createComparators_(pSorter, propSharedLockSet))
+        , queue_(pSorter, sortKeyNum_ == 0 ? size : 0)
+        , oneKeyQueue_(sortKeyNum_ == 1 ? size : 0)
+        , twoKeyQueue_(sortKeyNum_ == 2 ? size : 0)
     {
     }
 
@@ -127,33 +307,89 @@ public:
 
     bool insert(ScoreDoc doc)
     {
-        return queue_.insert(doc);
+        switch (sortKeyNum_)
+        {
+        case 1:
+            return oneKeyQueue_.insert(doc, *pSorter_);
+        case 2:
+            return twoKeyQueue_.insert(doc, *pSorter_);
+        default:
+            return queue_.insert(doc);
+        }
     }
 
     ScoreDoc pop()
     {
-        return queue_.pop();
+        switch (sortKeyNum_)
+        {
+        case 1:
+            return oneKeyQueue_.pop();
+        case 2:
+            return twoKeyQueue_.pop();
+        default:
+            return queue_.pop();
+        }
     }
     ScoreDoc top()
     {
-        return queue_.top();
+        switch (sortKeyNum_)
+        {
+        case 1:
+            return oneKeyQueue_.top();
+        case 2:
+            return twoKeyQueue_.top();
+        default:
+            return queue_.top();
+        }
     }
     ScoreDoc operator[](size_t pos)
     {
-        return queue_[pos];
+        return getAt(pos);
     }
     ScoreDoc getAt(size_t pos)
     {
-        return queue_.getAt(pos);
+        switch (sortKeyNum_)
+        {
+        case 1:
+            return oneKeyQueue_.getAt(pos);
+        case 2:
+            return twoKeyQueue_.getAt(pos);
+        default:
+            return queue_.getAt(pos);
+        }
     }
     size_t size()
     {
-        return queue_.size();
+        switch (sortKeyNum_)
+        {
+        case 1:
+            return oneKeyQueue_.size();
+        case 2:
+            return twoKeyQueue_.size();
+        default:
+            return queue_.size();
+        }
     }
     void clear() {}
+    bool lessThan(const ScoreDoc& o1, const ScoreDoc& o2)
+    {
+        switch (sortKeyNum_)
+        {
+        case 1:
+            return SortKeyQueue<1>::lessThan(o1, o2);
+        case 2:
+            return SortKeyQueue<2>::lessThan(o1, o2);
+        default:
+            return queue_.less(o1, o2);
+        }
+    }
 
 private:
+    boost::shared_ptr<Sorter> pSorter_;
+    const std::size_t sortKeyNum_;
     Queue_ queue_;
+    SortKeyQueue<1> oneKeyQueue_;
+    SortKeyQueue<2> twoKeyQueue_;
 };
 
 }
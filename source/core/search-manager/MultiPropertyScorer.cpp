@@ -83,6 +83,19 @@ void MultiPropertyScorer::setUB(bool useOriginalQuery, UpperBoundInProperties& u
     }
 }
 
+void MultiPropertyScorer::setBlockUB(const TermUBCalculator& ubCalculator)
+{
+    std::vector<DocumentIterator*>::iterator iter = docIteratorList_.begin();
+    for( ; iter != docIteratorList_.end(); ++iter )
+    {
+        DocumentIterator* pEntry = (*iter);
+        if (pEntry)
+        {
+            pEntry->setBlockUB(ubCalculator);
+        }
+    }
+}
+
 void MultiPropertyScorer::initThreshold(float threshold)
 {
     std::vector<DocumentIterator*>::iterator iter = docIteratorList_.begin();
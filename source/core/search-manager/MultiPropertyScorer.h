@@ -82,6 +82,8 @@ public:
 
     void setUB(bool useOriginalQuery, UpperBoundInProperties& ubmap);
 
+    void setBlockUB(const TermUBCalculator& ubCalculator);
+
     void initThreshold(float threshold);
 
     /**
@@ -317,6 +317,15 @@ void ORDocumentIterator:: setUB(bool useOriginalQuery, UpperBoundInProperties& u
     //LOG(INFO)<<"====OR::getUB===>>"<<getUB();
 }
 
+void ORDocumentIterator::setBlockUB(const TermUBCalculator& ubCalculator)
+{
+    std::vector<DocumentIterator*>::iterator it = docIteratorList_.begin();
+    for (; it != docIteratorList_.end(); it++)
+    {
+        (*it)->setBlockUB(ubCalculator);
+    }
+}
+
 float ORDocumentIterator::getUB()
 {
     float minUB = std::numeric_limits<float>::max();
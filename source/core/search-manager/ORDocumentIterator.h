@@ -81,6 +81,8 @@ public:
     }
     
     void setUB(bool useOriginalQuery, UpperBoundInProperties& ubmap);
+
+    void setBlockUB(const TermUBCalculator& ubCalculator);
     
     float getUB();
 
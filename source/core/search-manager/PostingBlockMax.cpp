@@ -0,0 +1,48 @@
+#include "PostingBlockMax.h"
+
+namespace
+{
+
+bool lessBlockLastDoc(const sf1r::PostingBlock& block, sf1r::docid_t target)
+{
+    return block.lastDoc < target;
+}
+
+}
+
+namespace sf1r
+{
+
+PostingBlockMax::PostingBlockMax()
+    : docNum_(0)
+    , maxTf_(0)
+{
+}
+
+std::size_t PostingBlockMax::bytes() const
+{
+    return sizeof(*this) + blocks_.capacity() * sizeof(PostingBlock);
+}
+
+std::size_t PostingBlockMax::findBlock(docid_t target, std::size_t from) const
+{
+    if (from >= blocks_.size())
+        return blocks_.size();
+
+    // in most cases the target is in the current or the next block
+    if (blocks_[from].lastDoc >= target)
+        return from;
+
+    std::vector<PostingBlock>::const_iterator it =
+        std::lower_bound(blocks_.begin() + from + 1, blocks_.end(),
+                         target, lessBlockLastDoc);
+    return it - blocks_.begin();
+}
+
+void PostingBlockMax::addBlock_(const PostingBlock& block)
+{
+    blocks_.push_back(block);
+    maxTf_ = std::max(maxTf_, block.maxTf);
+}
+
+} // namespace sf1r
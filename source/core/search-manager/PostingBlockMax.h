@@ -0,0 +1,182 @@
+/**
+ * @file PostingBlockMax.h
+ * @brief the max term frequency in each block of a posting list, so that
+ * the score of a term could be bounded by block instead of by the whole
+ * posting list.
+ */
+
+#ifndef SF1R_POSTING_BLOCK_MAX_H
+#define SF1R_POSTING_BLOCK_MAX_H
+
+#include <common/inttypes.h>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace sf1r
+{
+
+struct PostingBlock
+{
+    /// the last doc in this block
+    docid_t lastDoc;
+
+    /// the max term frequency in this block
+    count_t maxTf;
+};
+
+/**
+ * The postings are split into blocks of @c BLOCK_SIZE postings in docid
+ * order, each block keeps its last doc and its max term frequency.
+ */
+class PostingBlockMax
+{
+public:
+    enum { BLOCK_SIZE = 128 };
+
+    PostingBlockMax();
+
+    /**
+     * Build the blocks by iterating all postings in @p termDocs.
+     * @param termDocs it is positioned before the first posting, and
+     *        provides next(), doc() and freq() like @c TermDocFreqs
+     */
+    template <typename TermDocs>
+    void build(TermDocs& termDocs);
+
+    const std::vector<PostingBlock>& blocks() const { return blocks_; }
+
+    std::size_t docNum() const { return docNum_; }
+
+    /// the max term frequency in all blocks
+    count_t maxTf() const { return maxTf_; }
+
+    /// the memory taken
+    std::size_t bytes() const;
+
+    /**
+     * Find the block which may contain @p target.
+     * @param from the block to search from, as the blocks are always
+     *        visited in docid order
+     * @return the index of the first block at or after @p from whose last
+     *         doc is not less than @p target, or blocks().size() if none
+     */
+    std::size_t findBlock(docid_t target, std::size_t from) const;
+
+private:
+    void addBlock_(const PostingBlock& block);
+
+private:
+    std::vector<PostingBlock> blocks_;
+
+    std::size_t docNum_;
+
+    count_t maxTf_;
+};
+
+template <typename TermDocs>
+void PostingBlockMax::build(TermDocs& termDocs)
+{
+    blocks_.clear();
+    docNum_ = 0;
+    maxTf_ = 0;
+
+    PostingBlock block = {0, 0};
+    while (termDocs.next())
+    {
+        block.lastDoc = termDocs.doc();
+        block.maxTf = std::max<count_t>(block.maxTf, termDocs.freq());
+
+        if (++docNum_ % BLOCK_SIZE == 0)
+        {
+            addBlock_(block);
+            block.maxTf = 0;
+        }
+    }
+
+    if (docNum_ % BLOCK_SIZE != 0)
+    {
+        addBlock_(block);
+    }
+}
+
+/**
+ * The upper bounds of a query term, by block and by term frequency, they
+ * are calculated for each query as they depend on the query statistics.
+ */
+class PostingBlockUB
+{
+public:
+    /// the number of term frequencies whose upper bounds are kept
+    enum { TF_UB_NUM = 256 };
+
+    /**
+     * @param getUB it is called as @c getUB(float tf, float& ub) to get
+     *        the upper bound of a doc with term frequency @c tf, and
+     *        returns false if not supported
+     * @return false if @p getUB fails
+     */
+    template <typename UBFunction>
+    bool init(const boost::shared_ptr<const PostingBlockMax>& blockMax,
+              UBFunction getUB);
+
+    bool empty() const { return !blockMax_; }
+
+    const PostingBlockMax& blockMax() const { return *blockMax_; }
+
+    float blockUB(std::size_t block) const { return blockUBs_[block]; }
+
+    /**
+     * @return the upper bound of a doc with term frequency @p tf, or
+     *         @p defaultUB if @p tf is too large to be kept
+     */
+    float tfUB(count_t tf, float defaultUB) const
+    {
+        return tf < tfUBs_.size() ? tfUBs_[tf] : defaultUB;
+    }
+
+private:
+    boost::shared_ptr<const PostingBlockMax> blockMax_;
+
+    std::vector<float> blockUBs_;
+
+    std::vector<float> tfUBs_;
+};
+
+template <typename UBFunction>
+bool PostingBlockUB::init(
+    const boost::shared_ptr<const PostingBlockMax>& blockMax,
+    UBFunction getUB)
+{
+    blockMax_.reset();
+
+    const count_t tfNum = std::min<count_t>(blockMax->maxTf(), TF_UB_NUM - 1) + 1;
+    tfUBs_.resize(tfNum);
+    for (count_t tf = 0; tf < tfNum; ++tf)
+    {
+        if (!getUB(static_cast<float>(tf), tfUBs_[tf]))
+            return false;
+    }
+
+    const std::vector<PostingBlock>& blocks = blockMax->blocks();
+    blockUBs_.resize(blocks.size());
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+    {
+        const count_t maxTf = blocks[i].maxTf;
+        if (maxTf < tfNum)
+        {
+            blockUBs_[i] = tfUBs_[maxTf];
+        }
+        else if (!getUB(static_cast<float>(maxTf), blockUBs_[i]))
+        {
+            return false;
+        }
+    }
+
+    blockMax_ = blockMax;
+    return true;
+}
+
+} // namespace sf1r
+
+#endif // SF1R_POSTING_BLOCK_MAX_H
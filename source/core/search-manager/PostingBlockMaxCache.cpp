@@ -0,0 +1,22 @@
+#include "PostingBlockMaxCache.h"
+#include <sstream>
+
+namespace sf1r
+{
+
+PostingBlockMaxCache::PostingBlockMaxCache(std::size_t maxBytes)
+    : SizedLRUCache<value_type>("posting block max", maxBytes)
+{
+}
+
+PostingBlockMaxCache::key_type PostingBlockMaxCache::getKey(
+    const std::string& property,
+    termid_t termId,
+    uint64_t indexGeneration)
+{
+    std::ostringstream oss;
+    oss << property << '\t' << termId << '\t' << indexGeneration;
+    return oss.str();
+}
+
+} // namespace sf1r
@@ -0,0 +1,45 @@
+/**
+ * @file PostingBlockMaxCache.h
+ * @brief the block max metadata of the term postings, shared by the queries.
+ */
+
+#ifndef SF1R_POSTING_BLOCK_MAX_CACHE_H
+#define SF1R_POSTING_BLOCK_MAX_CACHE_H
+
+#include "PostingBlockMax.h"
+#include "SizedLRUCache.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <string>
+
+namespace sf1r
+{
+
+/**
+ * The metadata is built by scanning the whole postings of a term, so it is
+ * cached for the later queries on the same term.
+ *
+ * The key contains the generation of the index, so that the metadata built
+ * before the indexed postings are changed is not used. The postings
+ * appended since are after the last block, they are bounded by the upper
+ * bound of the whole postings.
+ */
+class PostingBlockMaxCache
+    : public SizedLRUCache<boost::shared_ptr<const PostingBlockMax> >
+{
+public:
+    explicit PostingBlockMaxCache(std::size_t maxBytes);
+
+    /**
+     * @param indexGeneration InvertedIndexManager::getIndexGeneration()
+     */
+    static key_type getKey(
+        const std::string& property,
+        termid_t termId,
+        uint64_t indexGeneration);
+};
+
+} // namespace sf1r
+
+#endif // SF1R_POSTING_BLOCK_MAX_CACHE_H
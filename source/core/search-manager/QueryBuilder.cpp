@@ -13,6 +13,9 @@
 #include "PersonalSearchDocumentIterator.h"
 #include "VirtualTermDocumentIterator.h"
 #include "FilterCache.h"
+#include "FilterBitsetCache.h"
+#include "PostingBlockMaxCache.h"
+#include "BlockMaxWANDDocumentIterator.h"
 
 #include <common/TermTypeDetector.h>
 
@@ -42,12 +45,18 @@ QueryBuilder::QueryBuilder(
     const boost::shared_ptr<DocumentManager> documentManager,
     const boost::shared_ptr<InvertedIndexManager> indexManager,
     const schema_map& schemaMap,
-    size_t filterCacheNum
+    size_t filterCacheNum,
+    bool enableBlockMaxWAND,
+    size_t filterBitsetCacheBytes,
+    size_t blockMaxCacheBytes
 )
     :documentManagerPtr_(documentManager)
     ,indexManagerPtr_(indexManager)
     ,schemaMap_(schemaMap)
     ,filterCache_(new FilterCache(filterCacheNum))
+    ,filterBitsetCache_(new FilterBitsetCache(filterBitsetCacheBytes))
+    ,enableBlockMaxWAND_(enableBlockMaxWAND)
+    ,blockMaxCache_(new PostingBlockMaxCache(blockMaxCacheBytes))
 {
     if (indexManager)
         pIndexReader_ = (indexManager->pIndexReader_);
@@ -60,6 +69,8 @@ QueryBuilder::~QueryBuilder()
 void QueryBuilder::reset_cache()
 {
     filterCache_->clear();
+    filterBitsetCache_->clear();
+    blockMaxCache_->clear();
 }
 
 bool QueryBuilder::do_process_filtertree(
@@ -159,6 +170,29 @@ bool QueryBuilder::prepare_filter(
 {
     return do_process_filtertree(conditionsTree_, pFilterBitmapx);
 }
+
+bool QueryBuilder::prepare_filter_bitset(
+        const ConditionsNode& conditionsTree_,
+        boost::shared_ptr<const Bitset>& pFilterBitset)
+{
+    const FilterBitsetCache::key_type key = FilterBitsetCache::getKey(conditionsTree_);
+    if (filterBitsetCache_->get(key, pFilterBitset))
+        return true;
+
+    // a bitset built before reset_cache() misses the docs indexed since
+    const std::size_t clearCount = filterBitsetCache_->getClearCount();
+    boost::shared_ptr<InvertedIndexManager::FilterBitmapT> pFilterBitmap;
+    if (!do_process_filtertree(conditionsTree_, pFilterBitmap) || !pFilterBitmap)
+        return false;
+
+    boost::shared_ptr<Bitset> pBitset(new Bitset);
+    pBitset->decompress(*pFilterBitmap);
+    pFilterBitset = pBitset;
+
+    const std::size_t bytes = pFilterBitmap->sizeInBits() / 8 + sizeof(Bitset);
+    filterBitsetCache_->set(key, pFilterBitset, bytes, clearCount);
+    return true;
+}
 /*
 void QueryBuilder::do_process_node(
     QueryFiltering::FilteringTreeValue &filteringTreeRules
@@ -1449,7 +1483,18 @@ bool QueryBuilder::do_prepare_for_property_(
 #ifdef VERBOSE_SERACH_MANAGER
         cout<<"WAND query "<<property<<endl;
 #endif
-        DocumentIterator* pIterator = new WANDDocumentIterator();
+        DocumentIterator* pIterator = NULL;
+        if (enableBlockMaxWAND_)
+        {
+            const uint64_t indexGeneration =
+                indexManagerPtr_ ? indexManagerPtr_->getIndexGeneration() : 0;
+            pIterator = new BlockMaxWANDDocumentIterator(
+                blockMaxCache_.get(), indexGeneration);
+        }
+        else
+        {
+            pIterator = new WANDDocumentIterator();
+        }
         pIterator->setMissRate(queryTree->children_.size());
         bool ret = false;
         try
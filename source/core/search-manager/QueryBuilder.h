@@ -26,12 +26,18 @@
 
 #include <vector>
 
+namespace izenelib { namespace ir { namespace indexmanager {
+class Bitset;
+} } }
+
 using namespace izenelib::ir::indexmanager;
 using namespace sf1r::QueryFiltering;
 
 namespace sf1r
 {
 class FilterCache;
+class FilterBitsetCache;
+class PostingBlockMaxCache;
 typedef DocumentIterator* DocumentIteratorPointer;
 class QueryBuilder
 {
@@ -41,11 +47,17 @@ public:
     typedef boost::unordered_map<std::string, PropertyConfig> schema_map;
     typedef schema_map::const_iterator schema_iterator;
 
+    enum { DEFAULT_FILTER_BITSET_CACHE_BYTES = 64 << 20 };
+    enum { DEFAULT_BLOCK_MAX_CACHE_BYTES = 32 << 20 };
+
     QueryBuilder(
         const boost::shared_ptr<DocumentManager> documentManager,
         const boost::shared_ptr<InvertedIndexManager> indexManager,
         const schema_map& schemaMap,
-        size_t filterCacheNum
+        size_t filterCacheNum,
+        bool enableBlockMaxWAND = false,
+        size_t filterBitsetCacheBytes = DEFAULT_FILTER_BITSET_CACHE_BYTES,
+        size_t blockMaxCacheBytes = DEFAULT_BLOCK_MAX_CACHE_BYTES
     );
 
     ~QueryBuilder();
@@ -90,6 +102,14 @@ public:
         const ConditionsNode& conditionsTree_,
         boost::shared_ptr<InvertedIndexManager::FilterBitmapT>& pFilterBitmapx);
 
+    /**
+     * Like prepare_filter(), but gives the decompressed bitset, which is
+     * shared with the other queries of the same filter tree.
+     */
+    bool prepare_filter_bitset(
+        const ConditionsNode& conditionsTree_,
+        boost::shared_ptr<const Bitset>& pFilterBitset);
+
 
     /*
     *@brief Generate Filter, filter will be released by the user.
@@ -221,6 +241,14 @@ private:
     const schema_map& schemaMap_;
 
     boost::scoped_ptr<FilterCache> filterCache_;
+
+    boost::scoped_ptr<FilterBitsetCache> filterBitsetCache_;
+
+    /// whether the WAND query uses BlockMaxWANDDocumentIterator, which
+    /// returns fewer docs than WANDDocumentIterator
+    const bool enableBlockMaxWAND_;
+
+    boost::scoped_ptr<PostingBlockMaxCache> blockMaxCache_;
 };
 
 }
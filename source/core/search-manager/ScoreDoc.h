@@ -10,9 +10,14 @@ namespace sf1r
 {
 struct ScoreDoc
 {
+    /// the sort properties having their keys in ScoreDoc::sortKeys at most
+    enum { kMaxSortKeyNum = 2 };
+
     explicit ScoreDoc(docid_t id = 0, double s = 0.0)
         : docId(id), score(s), custom_score(0.0), geo_dist(0.0)
-    {}
+    {
+        sortKeys[0] = sortKeys[1] = 0;
+    }
 
     ~ScoreDoc()
     {
@@ -22,6 +27,8 @@ struct ScoreDoc
     double score;
     double custom_score;
     double geo_dist;
+    /// filled by Sorter::fillSortKeys()
+    uint64_t sortKeys[kMaxSortKeyNum];
 };
 } // namespace sf1r
 #endif // SF1R_SEARCH_MANAGER_SCORE_DOC_H
@@ -1,5 +1,7 @@
 #include "ScoreDocEvaluator.h"
 #include "ScoreDoc.h"
+#include "DocumentIterator.h"
+#include <mining-manager/group-manager/GroupFilter.h>
 
 using namespace sf1r;
 
@@ -13,6 +15,7 @@ ScoreDocEvaluator::ScoreDocEvaluator(
         CustomRankerPtr customRanker,
         GeoLocationRankerPtr geoLocationRanker)
     : productScorer_(productScorer)
+    , isDocIteratorBound_(productScorer && productScorer->isDocIteratorBound())
     , customRanker_(customRanker)
     , geoLocationRanker_(geoLocationRanker)
 {
@@ -39,3 +42,68 @@ void ScoreDocEvaluator::evaluate(ScoreDoc& scoreDoc)
         scoreDoc.geo_dist = geoLocationRanker_->evaluate(scoreDoc.docId);
     }
 }
+
+void ScoreDocEvaluator::evaluate(ScoreDoc* scoreDocs, std::size_t num)
+{
+    if (productScorer_)
+    {
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            scoreDocs[i].score = productScorer_->score(scoreDocs[i].docId);
+        }
+    }
+    else
+    {
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            scoreDocs[i].score = kDefaultScore;
+        }
+    }
+
+    if (customRanker_)
+    {
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            scoreDocs[i].custom_score = customRanker_->evaluate(scoreDocs[i].docId);
+        }
+    }
+
+    if (geoLocationRanker_)
+    {
+        for (std::size_t i = 0; i < num; ++i)
+        {
+            scoreDocs[i].geo_dist = geoLocationRanker_->evaluate(scoreDocs[i].docId);
+        }
+    }
+}
+
+std::size_t ScoreDocEvaluator::gather(
+        DocumentIterator& docIterator,
+        docid_t& curDocId,
+        docid_t endDocId,
+        faceted::GroupFilter* groupFilter,
+        ScoreDoc* scoreDocs,
+        std::size_t num)
+{
+    std::size_t gatherNum = 0;
+    for (; curDocId < endDocId && gatherNum < num;
+         curDocId = docIterator.next() ? docIterator.doc() : MAX_DOC_ID)
+    {
+        if (groupFilter && !groupFilter->test(curDocId))
+            continue;
+
+        scoreDocs[gatherNum] = ScoreDoc(curDocId);
+        if (isDocIteratorBound_)
+        {
+            evaluate(scoreDocs[gatherNum]);
+        }
+        ++gatherNum;
+    }
+
+    if (!isDocIteratorBound_ && gatherNum > 0)
+    {
+        evaluate(scoreDocs, gatherNum);
+    }
+
+    return gatherNum;
+}
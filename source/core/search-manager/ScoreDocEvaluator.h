@@ -16,6 +16,12 @@
 namespace sf1r
 {
 struct ScoreDoc;
+class DocumentIterator;
+
+namespace faceted
+{
+class GroupFilter;
+}
 
 class ScoreDocEvaluator
 {
@@ -27,9 +33,37 @@ public:
 
     void evaluate(ScoreDoc& scoreDoc);
 
+    /**
+     * evaluate the block @p scoreDocs[0, num), one ranker after another.
+     */
+    void evaluate(ScoreDoc* scoreDocs, std::size_t num);
+
+    /**
+     * gather the block @p scoreDocs[0, num) from @p docIterator, skipping
+     * the docs not passing @p groupFilter, and evaluate it. The scores
+     * reading the iterator, like the relevance, are evaluated doc by doc
+     * while the iterator is at each doc, the others block by block.
+     *
+     * @param curDocId the doc @p docIterator is at, it is moved to the
+     *        first doc not gathered, or MAX_DOC_ID if exhausted
+     * @param endDocId the docs from @p endDocId are not gathered
+     * @param groupFilter it could be NULL to gather all docs
+     * @return the number of docs gathered
+     */
+    std::size_t gather(
+            DocumentIterator& docIterator,
+            docid_t& curDocId,
+            docid_t endDocId,
+            faceted::GroupFilter* groupFilter,
+            ScoreDoc* scoreDocs,
+            std::size_t num);
+
 private:
     boost::scoped_ptr<ProductScorer> productScorer_;
 
+    /// whether @c productScorer_ reads the doc iterator
+    const bool isDocIteratorBound_;
+
     CustomRankerPtr customRanker_;
 
     GeoLocationRankerPtr geoLocationRanker_;
@@ -25,7 +25,8 @@ QueryBuilder* SearchFactory::createQueryBuilder(
     return new QueryBuilder(documentManager_,
                             indexManager_,
                             schemaMap,
-                            config_.filterCacheNum_);
+                            config_.filterCacheNum_,
+                            config_.enable_block_max_wand_);
 }
 
 SearchBase* SearchFactory::createSearchBase(
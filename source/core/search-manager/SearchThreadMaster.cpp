@@ -2,6 +2,7 @@
 #include "SearchThreadWorker.h"
 #include "SearchManagerPreProcessor.h"
 #include "SearchThreadParam.h"
+#include "SearchThreadShared.h"
 #include "HitQueue.h"
 
 #include <common/PropSharedLockSet.h>
@@ -15,7 +16,9 @@
 
 using namespace sf1r;
 
-#define PARALLEL_THRESHOLD 80000
+// the docs each thread takes at a time, the range [0, maxDocId+1) is
+// searched in parallel once it has two morsels
+#define MORSEL_DOC_NUM 32768
 
 static izenelib::util::CpuTopologyT s_cpu_topology_info;
 static int s_round = 0;
@@ -52,12 +55,17 @@ void SearchThreadMaster::prepareThreadParams(
     std::size_t runningNode = 0;
     getThreadInfo_(distSearchInfo, threadNum, runningNode);
 
-    // in order to split the whole docid range [0, maxDocId+1) to N threads,
-    // the average docs num for each thread is round_up((maxDocId+1)/N),
-    // which equals to round_down(maxDocId/N) + 1,
-    // then the docid range for each thread is [i*avg, (i+1)*avg).
-    docid_t maxDocId = documentManagerPtr_->getMaxDocId();
-    std::size_t averageDocNum = maxDocId/threadNum + 1;
+    // instead of a fixed range per thread, the threads take the morsels of
+    // [0, maxDocId+1) one by one, so that a thread owning the dense part
+    // of the postings doesn't keep the others waiting.
+    const std::size_t docNum = documentManagerPtr_->getMaxDocId() + 1;
+    boost::shared_ptr<SearchThreadShared> shared(
+        new SearchThreadShared(docNum, MORSEL_DOC_NUM));
+    threadNum = std::min(threadNum, shared->morselNum());
+    if (threadNum < 1)
+    {
+        threadNum = 1;
+    }
 
     const SearchThreadParam initParam(&actionOperation,
                                       &distSearchInfo,
@@ -68,8 +76,13 @@ void SearchThreadMaster::prepareThreadParams(
     for (std::size_t i = 0; i < threadNum; ++i)
     {
         threadParams[i].threadId   = i;
-        threadParams[i].docIdBegin = i * averageDocNum;
-        threadParams[i].docIdEnd   = (i+1) * averageDocNum;
+        threadParams[i].docIdBegin = 0;
+        threadParams[i].docIdEnd   = docNum;
+
+        if (threadNum > 1)
+        {
+            threadParams[i].shared = shared;
+        }
     }
 
     if (threadNum > 1)
@@ -110,18 +123,27 @@ bool SearchThreadMaster::mergeThreadParams(
     std::list<const faceted::OntologyRep*> otherAttrReps;
     boost::shared_ptr<HitQueue> masterQueue(masterParam.scoreItemQueue);
 
-    for (std::size_t i = 1; i < threadNum; ++i)
+    // pop() gives the lowest one first, each list is in ascending order
+    std::vector<std::vector<ScoreDoc> > sortedLists(threadNum);
+
+    for (std::size_t i = 0; i < threadNum; ++i)
     {
         SearchThreadParam& param = threadParams[i];
         if (!param.isSuccess)
             return false;
 
-        masterTotalCount += param.totalCount;
+        std::vector<ScoreDoc>& sortedList = sortedLists[i];
+        sortedList.reserve(param.scoreItemQueue->size());
         while (param.scoreItemQueue->size() > 0)
         {
-            masterQueue->insert(param.scoreItemQueue->pop());
+            sortedList.push_back(param.scoreItemQueue->pop());
         }
 
+        if (i == 0)
+            continue;
+
+        masterTotalCount += param.totalCount;
+
         float lowValue = param.propertyRange.lowValue_;
         float highValue = param.propertyRange.highValue_;
 
@@ -144,6 +166,44 @@ bool SearchThreadMaster::mergeThreadParams(
         otherAttrReps.push_back(&param.attrRep);
     }
 
+    // the ranks of a string property might be respaced between the thread
+    // searches, then the lists in an old epoch are keyed and sorted again,
+    // the locks are held till the master queue has filled the keys too
+    PropSharedLockSet propSharedLockSet;
+    const boost::shared_ptr<Sorter>& masterSorter = masterParam.pSorter;
+    if (masterSorter && masterSorter->sortKeyNum() > 0)
+    {
+        masterSorter->lockSortKeys(propSharedLockSet);
+        const uint64_t sortKeyEpoch = masterSorter->sortKeyEpoch();
+
+        for (std::size_t i = 0; i < threadNum; ++i)
+        {
+            if (threadParams[i].sortKeyEpoch == sortKeyEpoch)
+                continue;
+
+            std::vector<ScoreDoc>& sortedList = sortedLists[i];
+            for (std::vector<ScoreDoc>::iterator it = sortedList.begin();
+                 it != sortedList.end(); ++it)
+            {
+                masterSorter->fillSortKeys(*it);
+            }
+            std::sort(sortedList.begin(), sortedList.end(),
+                      boost::bind(&HitQueue::lessThan, masterQueue.get(), _1, _2));
+        }
+    }
+
+    std::vector<ScoreDoc> topK;
+    mergeTopK(sortedLists,
+              boost::bind(&HitQueue::lessThan, masterQueue.get(), _1, _2),
+              masterParam.heapSize,
+              topK);
+
+    for (std::vector<ScoreDoc>::const_iterator it = topK.begin();
+         it != topK.end(); ++it)
+    {
+        masterQueue->insert(*it);
+    }
+
     int& attrGroupNum = masterParam.actionOperation->actionItem_.groupParam_.attrGroupNum_;
     std::swap(attrGroupNum, masterParam.originAttrGroupNum);
     masterAttrRep.merge(attrGroupNum, otherAttrReps);
@@ -236,7 +296,6 @@ void SearchThreadMaster::getThreadInfo_(
     std::size_t& threadNum,
     std::size_t& runningNode)
 {
-    docid_t maxDocId = documentManagerPtr_->getMaxDocId();
     threadNum = s_cpunum;
     runningNode = 0;
 
@@ -252,7 +311,6 @@ void SearchThreadMaster::getThreadInfo_(
     }
 
     if (!isParallelEnabled_ ||
-        maxDocId < PARALLEL_THRESHOLD ||
         distSearchInfo.isOptionGatherInfo())
     {
         threadNum = 1;
@@ -23,6 +23,7 @@ class SearchKeywordOperation;
 class Sorter;
 class HitQueue;
 class DistKeywordSearchInfo;
+class SearchThreadShared;
 
 struct SearchThreadParam
 {
@@ -43,12 +44,18 @@ struct SearchThreadParam
 
     std::size_t heapSize;
     boost::shared_ptr<HitQueue> scoreItemQueue;
+    /// Sorter::sortKeyEpoch() of the keys in scoreItemQueue
+    uint64_t sortKeyEpoch;
 
     int runningNode;
     std::size_t threadId;
     std::size_t docIdBegin;
     std::size_t docIdEnd;
 
+    /// when set, the thread takes morsels from it instead of searching
+    /// [docIdBegin, docIdEnd)
+    boost::shared_ptr<SearchThreadShared> shared;
+
     bool isSuccess;
 
     SearchThreadParam(
@@ -61,6 +68,7 @@ struct SearchThreadParam
         , totalCount(0)
         , originAttrGroupNum(0)
         , heapSize(_heapSize)
+        , sortKeyEpoch(0)
         , runningNode(_runningNode)
         , threadId(0)
         , docIdBegin(0)
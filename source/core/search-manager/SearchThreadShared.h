@@ -0,0 +1,153 @@
+/**
+ * @file SearchThreadShared.h
+ * @brief the state shared by the threads of one search.
+ */
+
+#ifndef SF1R_SEARCH_THREAD_SHARED_H
+#define SF1R_SEARCH_THREAD_SHARED_H
+
+#include <common/inttypes.h>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace sf1r
+{
+
+/**
+ * The docid range [0, docNum) of one search is cut into morsels of
+ * @c morselSize docs, each thread takes the next free morsel until none is
+ * left, so the threads stay busy however the postings are distributed.
+ * The morsels taken by one thread come in docid order, a doc iterator only
+ * moves forward.
+ *
+ * It also keeps the top-K threshold, the lowest score in the full score
+ * sorted heap of any thread. At least K docs score above it, so a doc
+ * scoring below it can't be in the final top-K.
+ */
+class SearchThreadShared : boost::noncopyable
+{
+public:
+    SearchThreadShared(std::size_t docNum, std::size_t morselSize)
+        : docNum_(docNum)
+        , morselSize_(std::max(morselSize, (std::size_t)1))
+        , nextMorsel_(0)
+        , threshold_(-std::numeric_limits<double>::max())
+    {
+    }
+
+    /**
+     * take the next free morsel.
+     * @return false if all the morsels are taken
+     */
+    bool nextMorsel(docid_t& begin, docid_t& end)
+    {
+        const std::size_t morsel = nextMorsel_.fetch_add(1, boost::memory_order_relaxed);
+        if (morsel >= morselNum())
+            return false;
+
+        begin = morsel * morselSize_;
+        end = std::min(begin + morselSize_, docNum_);
+        return true;
+    }
+
+    std::size_t morselNum() const
+    {
+        return (docNum_ + morselSize_ - 1) / morselSize_;
+    }
+
+    double threshold() const
+    {
+        return threshold_.load(boost::memory_order_relaxed);
+    }
+
+    /**
+     * @p score is the lowest one in a full top-K heap.
+     */
+    void raiseThreshold(double score)
+    {
+        double current = threshold_.load(boost::memory_order_relaxed);
+        while (current < score &&
+               !threshold_.compare_exchange_weak(current, score, boost::memory_order_relaxed))
+        {
+        }
+    }
+
+private:
+    const std::size_t docNum_;
+    const std::size_t morselSize_;
+    boost::atomic<std::size_t> nextMorsel_;
+    boost::atomic<double> threshold_;
+};
+
+namespace detail
+{
+/**
+ * order the lists by their last (greatest) item.
+ */
+template <typename T, typename Less>
+class ListBackLess
+{
+public:
+    ListBackLess(const std::vector<std::vector<T> >& lists, Less& less)
+        : lists_(lists), less_(less) {}
+
+    bool operator()(std::size_t i, std::size_t j) const
+    {
+        return less_(lists_[i].back(), lists_[j].back());
+    }
+
+private:
+    const std::vector<std::vector<T> >& lists_;
+    Less& less_;
+};
+}
+
+/**
+ * merge @p lists, each sorted ascending by @p less, the @p k greatest
+ * items go to @p result in ascending order. @p lists are consumed.
+ */
+template <typename T, typename Less>
+void mergeTopK(
+    std::vector<std::vector<T> >& lists,
+    Less less,
+    std::size_t k,
+    std::vector<T>& result)
+{
+    detail::ListBackLess<T, Less> listLess(lists, less);
+
+    std::vector<std::size_t> heap;
+    for (std::size_t i = 0; i < lists.size(); ++i)
+    {
+        if (!lists[i].empty())
+        {
+            heap.push_back(i);
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), listLess);
+
+    result.clear();
+    while (result.size() < k && !heap.empty())
+    {
+        std::pop_heap(heap.begin(), heap.end(), listLess);
+        std::vector<T>& list = lists[heap.back()];
+        result.push_back(list.back());
+        list.pop_back();
+
+        if (list.empty())
+        {
+            heap.pop_back();
+        }
+        else
+        {
+            std::push_heap(heap.begin(), heap.end(), listLess);
+        }
+    }
+    std::reverse(result.begin(), result.end());
+}
+
+} // namespace sf1r
+
+#endif // SF1R_SEARCH_THREAD_SHARED_H
@@ -1,6 +1,7 @@
 #include "SearchThreadWorker.h"
 #include "SearchManagerPreProcessor.h"
 #include "SearchThreadParam.h"
+#include "SearchThreadShared.h"
 #include "ScoreDocEvaluator.h"
 #include "QueryBuilder.h"
 #include "DocumentIteratorContainer.h"
@@ -8,6 +9,7 @@
 #include "AllDocumentIterator.h"
 #include "CustomRankDocumentIterator.h"
 #include "HitQueue.h"
+#include "TermUBCalculator.h"
 
 #include <common/PropSharedLockSet.h>
 #include <bundles/index/IndexBundleConfiguration.h>
@@ -29,6 +31,9 @@ using namespace sf1r;
 namespace
 {
 const int kStarSearchAttrIterDocNum = 200;
+
+// the docs evaluated together in SearchThreadWorker::doSearch_
+const std::size_t kSearchBlockDocNum = 256;
 }
 
 SearchThreadWorker::SearchThreadWorker(
@@ -260,13 +265,17 @@ bool SearchThreadWorker::search(SearchThreadParam& param)
         propertyRankers);
 
     UpperBoundInProperties ubmap;
+    TermUBCalculator ubCalculator;
     for (size_t i = 0; i < indexPropertyList.size(); ++i)
     {
         const std::string& currentProperty = indexPropertyList[i];
         ID_FREQ_MAP_T& ub = ubmap[currentProperty];
         propertyRankers[i]->calculateTermUBs(rankQueryProperties[i], ub);
+        ubCalculator.addProperty(currentProperty, propertyRankers[i].get(),
+                                 &rankQueryProperties[i]);
     }
     docIterPtr->setUB(useOriginalQuery, ubmap);
+    docIterPtr->setBlockUB(ubCalculator);
     docIterPtr->initThreshold(actionOperation.actionItem_.searchingMode_.threshold_);
 
     STOP_PROFILER(preparerank)
@@ -308,6 +317,11 @@ bool SearchThreadWorker::search(SearchThreadParam& param)
                              scoreDocEvaluator,
                              propSharedLockSet);
 
+        if (param.pSorter)
+        {
+            param.sortKeyEpoch = param.pSorter->sortKeyEpoch();
+        }
+
         if (time(NULL) - start_search > 5)
             LOG(INFO) << "dosearch cost too long, " << start_search << ", " << time(NULL);
 
@@ -394,63 +408,101 @@ bool SearchThreadWorker::doSearch_(
         }
     }
 
-    docIterator.skipTo(param.docIdBegin);
-
-    do
+    // a doc scoring below the threshold can't reach the top-K, so it skips
+    // the heap, only the score sorted queue orders by score. The threshold
+    // is the lowest score of this thread's full heap, or of any thread's
+    // heap with the shared state.
+    SearchThreadShared* shared = param.shared.get();
+    const bool isPruning = !param.pSorter && param.heapSize > 0;
+    double threshold = -std::numeric_limits<double>::max();
+
+    // the docs are gathered into filtered and scored blocks, each block is
+    // aggregated at once
+    std::vector<docid_t> blockDocs(kSearchBlockDocNum);
+    std::vector<ScoreDoc> blockItems(kSearchBlockDocNum);
+
+    // without shared state, [docIdBegin, docIdEnd) is searched at once
+    docid_t beginDocId = param.docIdBegin;
+    docid_t endDocId = param.docIdEnd;
+    bool hasRange = shared ? shared->nextMorsel(beginDocId, endDocId) : true;
+    docid_t curDocId = 0;
+    bool isStarted = false;
+
+    while (hasRange)
     {
+        if (!isStarted || curDocId < beginDocId)
+        {
+            curDocId = docIterator.skipTo(beginDocId);
+            isStarted = true;
+        }
+
+        while (curDocId < endDocId)
+        {
+            START_PROFILER(computerankscore)
 
-        docid_t curDocId = docIterator.doc();
+            const std::size_t blockSize = scoreDocEvaluator.gather(
+                docIterator, curDocId, endDocId, groupFilter,
+                &blockItems[0], kSearchBlockDocNum);
 
-        if (curDocId >= param.docIdEnd)
-            break;
+            STOP_PROFILER(computerankscore)
 
-        if (groupFilter && !groupFilter->test(curDocId))
-            continue;
+            if (blockSize == 0)
+                continue;
 
-        if (rangePropertyTable)
-        {
-            float docPropertyValue = 0;
-            if (rangePropertyTable->getFloatValue(curDocId, docPropertyValue, false))
+            for (std::size_t i = 0; i < blockSize; ++i)
             {
-                if (docPropertyValue < lowValue)
-                {
-                    lowValue = docPropertyValue;
-                }
+                blockDocs[i] = blockItems[i].docId;
+            }
 
-                if (docPropertyValue > highValue)
-                {
-                    highValue = docPropertyValue;
-                }
+            if (rangePropertyTable)
+            {
+                rangePropertyTable->updateFloatRange(&blockDocs[0], blockSize,
+                                                     lowValue, highValue, false);
             }
-        }
 
-        /// COUNT(PropertyName)  semantics
-        if (counterSize)
-        {
+            /// COUNT(PropertyName)  semantics
             for (ii = 0; ii < counterSize; ++ii)
             {
-                int32_t value;
-                if (counterTables[ii]->getInt32Value(curDocId,value, false))
-                {
-                    counterValues[ii] += value;
-                }
+                counterTables[ii]->sumInt32Values(&blockDocs[0], blockSize,
+                                                  counterValues[ii], false);
             }
-        }
 
-        ScoreDoc scoreItem(curDocId);
+            param.totalCount += blockSize;
 
-        START_PROFILER(computerankscore)
+            START_PROFILER(inserttoqueue)
+            for (std::size_t i = 0; i < blockSize; ++i)
+            {
+                const ScoreDoc& scoreItem = blockItems[i];
+                if (isPruning)
+                {
+                    if (shared)
+                    {
+                        threshold = std::max(threshold, shared->threshold());
+                    }
 
-        ++param.totalCount;
-        scoreDocEvaluator.evaluate(scoreItem);
+                    if (threshold - scoreItem.score >= std::numeric_limits<score_t>::epsilon())
+                        continue;
+                }
 
-        STOP_PROFILER(computerankscore)
+                if (param.scoreItemQueue->insert(scoreItem) && isPruning &&
+                    param.scoreItemQueue->size() >= param.heapSize)
+                {
+                    threshold = std::max(threshold, param.scoreItemQueue->top().score);
+                    if (shared)
+                    {
+                        shared->raiseThreshold(threshold);
+                    }
+                }
+            }
+            STOP_PROFILER(inserttoqueue)
+        }
+
+        // the later morsels have no doc either
+        if (curDocId == MAX_DOC_ID)
+            break;
 
-        START_PROFILER(inserttoqueue)
-        param.scoreItemQueue->insert(scoreItem);
-        STOP_PROFILER(inserttoqueue)
+        hasRange = shared && shared->nextMorsel(beginDocId, endDocId);
     }
-    while (docIterator.next());
 
     if (rangePropertyTable && lowValue <= highValue)
     {
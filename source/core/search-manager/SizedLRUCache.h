@@ -0,0 +1,196 @@
+/**
+ * @file SizedLRUCache.h
+ * @brief an LRU cache bounded by the memory taken by its values, shared by
+ * the queries.
+ */
+
+#ifndef SF1R_SIZED_LRU_CACHE_H
+#define SF1R_SIZED_LRU_CACHE_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <glog/logging.h>
+
+#include <list>
+#include <string>
+
+namespace sf1r
+{
+
+struct SizedLRUCacheStats
+{
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+    std::size_t entries;
+    std::size_t bytes;
+
+    SizedLRUCacheStats()
+        : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+
+    double hitRate() const
+    {
+        const std::size_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / lookups : 0;
+    }
+};
+
+/**
+ * The values are shared pointers to the data never modified once cached,
+ * so a query holds the cached one as it is, and it stays valid after being
+ * evicted or cleared.
+ * The least recently used values are evicted to keep the total size under
+ * @c maxBytes.
+ *
+ * A value built from the data before clear() must not be cached after it,
+ * so the caller takes getClearCount() before building a value, and set()
+ * drops the value if the cache is cleared meanwhile.
+ */
+template <typename ValueT>
+class SizedLRUCache : boost::noncopyable
+{
+public:
+    typedef std::string key_type;
+    typedef ValueT value_type;
+
+public:
+    /**
+     * @param name the name in the log
+     */
+    SizedLRUCache(const std::string& name, std::size_t maxBytes)
+        : name_(name)
+        , maxBytes_(maxBytes)
+        , clearCount_(0)
+    {
+    }
+
+    bool get(const key_type& key, value_type& value)
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        typename entry_map::iterator it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            ++stats_.misses;
+            return false;
+        }
+
+        ++stats_.hits;
+        lruList_.splice(lruList_.begin(), lruList_, it->second.lruPos);
+        value = it->second.value;
+        return true;
+    }
+
+    /// the times of clear() called
+    std::size_t getClearCount() const
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        return clearCount_;
+    }
+
+    /**
+     * @param bytes the memory taken by @p value
+     * @param clearCount getClearCount() before @p value is built
+     */
+    void set(
+        const key_type& key,
+        const value_type& value,
+        std::size_t bytes,
+        std::size_t clearCount)
+    {
+        if (!value || bytes > maxBytes_)
+            return;
+
+        boost::mutex::scoped_lock lock(mutex_);
+
+        // built from the data before clear()
+        if (clearCount != clearCount_)
+            return;
+
+        // another query may have built the same value meanwhile
+        if (entries_.find(key) != entries_.end())
+            return;
+
+        evict_(maxBytes_ - bytes);
+
+        lruList_.push_front(key);
+        Entry& entry = entries_[key];
+        entry.value = value;
+        entry.bytes = bytes;
+        entry.lruPos = lruList_.begin();
+
+        ++stats_.entries;
+        stats_.bytes += bytes;
+    }
+
+    void clear()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+
+        LOG(INFO) << "clear " << name_ << " cache, entries: " << stats_.entries
+                  << ", bytes: " << stats_.bytes
+                  << ", hits: " << stats_.hits
+                  << ", misses: " << stats_.misses
+                  << ", evictions: " << stats_.evictions
+                  << ", hit rate: " << stats_.hitRate();
+
+        lruList_.clear();
+        entries_.clear();
+        stats_.entries = 0;
+        stats_.bytes = 0;
+        ++clearCount_;
+    }
+
+    SizedLRUCacheStats getStats() const
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        return stats_;
+    }
+
+private:
+    void evict_(std::size_t maxBytes)
+    {
+        while (stats_.bytes > maxBytes && !lruList_.empty())
+        {
+            typename entry_map::iterator it = entries_.find(lruList_.back());
+            stats_.bytes -= it->second.bytes;
+            --stats_.entries;
+            ++stats_.evictions;
+
+            entries_.erase(it);
+            lruList_.pop_back();
+        }
+    }
+
+private:
+    typedef std::list<key_type> lru_list;
+
+    struct Entry
+    {
+        value_type value;
+        std::size_t bytes;
+        typename lru_list::iterator lruPos;
+    };
+
+    typedef boost::unordered_map<key_type, Entry> entry_map;
+
+    const std::string name_;
+
+    const std::size_t maxBytes_;
+
+    /// the most recently used at front
+    lru_list lruList_;
+
+    entry_map entries_;
+
+    SizedLRUCacheStats stats_;
+
+    std::size_t clearCount_;
+
+    mutable boost::mutex mutex_;
+};
+
+} // namespace sf1r
+
+#endif // SF1R_SIZED_LRU_CACHE_H
@@ -1,5 +1,6 @@
 #include "SortPropertyComparator.h"
 #include <common/RTypeStringPropTable.h>
+#include <common/PropSharedLockSet.h>
 
 namespace sf1r
 {
@@ -74,6 +75,57 @@ int SortPropertyComparator::compareImplDefault(const ScoreDoc& doc1, const Score
 {
     return 0;
 }
+bool SortPropertyComparator::hasSortKey() const
+{
+    if (comparator_ == &SortPropertyComparator::compareImplNumeric)
+        return numericPropTable_ && numericPropTable_->hasSortKey();
+
+    if (comparator_ == &SortPropertyComparator::compareImplRTypeString)
+        return RTypePropTable_.get() != NULL;
+
+    return true;
+}
+
+uint64_t SortPropertyComparator::getSortKey(const ScoreDoc& doc) const
+{
+    if (comparator_ == &SortPropertyComparator::compareImplNumeric)
+    {
+        if (doc.docId >= size_) return kInvalidSortKey;
+        return numericPropTable_->getSortKey(doc.docId, false);
+    }
+
+    if (comparator_ == &SortPropertyComparator::compareImplRTypeString)
+    {
+        if (doc.docId >= size_) return kInvalidSortKey;
+        return RTypePropTable_->getSortKey(doc.docId, false);
+    }
+
+    if (comparator_ == &SortPropertyComparator::compareImplUnknown)
+        return doubleSortKey(doc.score);
+
+    if (comparator_ == &SortPropertyComparator::compareImplCustomRanking)
+        return doubleSortKey(doc.custom_score);
+
+    if (comparator_ == &SortPropertyComparator::compareImplGeoLocation)
+        return doubleSortKey(doc.geo_dist);
+
+    return kInvalidSortKey;
+}
+
+uint64_t SortPropertyComparator::getSortKeyEpoch() const
+{
+    if (RTypePropTable_)
+        return RTypePropTable_->getRankEpoch(false);
+
+    return 0;
+}
+
+void SortPropertyComparator::insertSharedLock(PropSharedLockSet& propSharedLockSet) const
+{
+    propSharedLockSet.insertSharedLock(numericPropTable_.get());
+    propSharedLockSet.insertSharedLock(RTypePropTable_.get());
+}
+
 int SortPropertyComparator::compareImplRTypeString(const ScoreDoc& doc1, const ScoreDoc& doc2) const
 {
     if (doc1.docId >= size_ || doc2.docId >= size_) return 0;
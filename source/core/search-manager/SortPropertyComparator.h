@@ -12,18 +12,41 @@
 #include "ScoreDoc.h"
 #include "CustomRanker.h"
 
+#include <common/SortKey.h>
 #include <boost/shared_ptr.hpp>
 
 namespace sf1r
 {
 
 class RTypeStringPropTable;
+class PropSharedLockSet;
 
 class SortPropertyComparator
 {
 public:
     int compare(const ScoreDoc& doc1, const ScoreDoc& doc2) const;
 
+    /**
+     * whether getSortKey() orders the docs like compare().
+     */
+    bool hasSortKey() const;
+
+    /**
+     * @return the key of @p doc, encoded by SortKey.h
+     */
+    uint64_t getSortKey(const ScoreDoc& doc) const;
+
+    /**
+     * the keys got in different epochs can't be compared, as the ranks of
+     * a string property might be respaced in between.
+     */
+    uint64_t getSortKeyEpoch() const;
+
+    /**
+     * hold the read lock of the property table in @p propSharedLockSet.
+     */
+    void insertSharedLock(PropSharedLockSet& propSharedLockSet) const;
+
 private:
     boost::shared_ptr<NumericPropertyTableBase> numericPropTable_;
     boost::shared_ptr<RTypeStringPropTable> RTypePropTable_;
@@ -69,6 +69,7 @@ Sorter::Sorter(NumericPropertyTableBuilder* numericTableBuilder)
     , ppSortProperties_(0)
     , reverseMul_(0)
     , nNumProperties_(0)
+    , sortKeyNum_(0)
 {
 }
 
@@ -79,6 +80,7 @@ Sorter::Sorter(NumericPropertyTableBuilder* numericTableBuilder,
     , ppSortProperties_(0)
     , reverseMul_(0)
     , nNumProperties_(0)
+    , sortKeyNum_(0)
 {
 }
 
@@ -181,6 +183,20 @@ void Sorter::createComparators(PropSharedLockSet& propSharedLockSet)
     {
         reverseMul_[i] = ppSortProperties_[i]->isReverse() ? -1 : 1;
     }
+
+    sortKeyNum_ = 0;
+    if (nNumProperties_ <= ScoreDoc::kMaxSortKeyNum)
+    {
+        for (i = 0; i < nNumProperties_; ++i)
+        {
+            if (!ppSortProperties_[i]->pComparator_->hasSortKey())
+                break;
+        }
+        if (i == nNumProperties_)
+        {
+            sortKeyNum_ = nNumProperties_;
+        }
+    }
 }
 
 
@@ -155,6 +155,53 @@ public:
     /// it will generate SortPropertyComparator for internal usage
     void createComparators(PropSharedLockSet& propSharedLockSet);
 
+    /// the number of keys filled by fillSortKeys(), 0 if the docs could
+    /// only be compared by lessThan()
+    std::size_t sortKeyNum() const
+    {
+        return sortKeyNum_;
+    }
+
+    /// the key of the @p i th sort property of @p doc, in the order of
+    /// lessThan(), i must be less than sortKeyNum()
+    uint64_t getSortKey(const ScoreDoc& doc, std::size_t i) const
+    {
+        const uint64_t key = ppSortProperties_[i]->pComparator_->getSortKey(doc);
+        return ppSortProperties_[i]->isReverse() ? ~key : key;
+    }
+
+    /// fill @p doc.sortKeys, comparing them in order, then the docid, gives
+    /// the order of lessThan()
+    void fillSortKeys(ScoreDoc& doc) const
+    {
+        for (std::size_t i = 0; i < sortKeyNum_; ++i)
+        {
+            doc.sortKeys[i] = getSortKey(doc, i);
+        }
+    }
+
+    /// the keys filled in different epochs can't be compared, the caller
+    /// holds the locks of lockSortKeys()
+    uint64_t sortKeyEpoch() const
+    {
+        uint64_t epoch = 0;
+        for (std::size_t i = 0; i < sortKeyNum_; ++i)
+        {
+            epoch += ppSortProperties_[i]->pComparator_->getSortKeyEpoch();
+        }
+        return epoch;
+    }
+
+    /// hold the read locks of the tables giving the keys, so that the
+    /// keys filled meanwhile are in one epoch
+    void lockSortKeys(PropSharedLockSet& propSharedLockSet) const
+    {
+        for (std::size_t i = 0; i < sortKeyNum_; ++i)
+        {
+            ppSortProperties_[i]->pComparator_->insertSharedLock(propSharedLockSet);
+        }
+    }
+
 private:
     SortPropertyComparator* createNumericComparator_(
         const std::string& propName,
@@ -176,6 +223,8 @@ private:
 
     std::size_t nNumProperties_;
 
+    std::size_t sortKeyNum_;
+
     DocumentManager* documentManagerPtr_;
 
     friend class SearchManager;
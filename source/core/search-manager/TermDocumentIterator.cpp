@@ -1,4 +1,6 @@
 #include "TermDocumentIterator.h"
+#include "PostingBlockMaxCache.h"
+#include "TermUBCalculator.h"
 
 #include <index-manager/InvertedIndexManager.h>
 
@@ -8,6 +10,7 @@
 #include <util/profiler/ProfilerGroup.h>
 
 #include <boost/assert.hpp>
+#include <boost/bind.hpp>
 
 using namespace izenelib::ir::indexmanager;
 
@@ -191,6 +194,68 @@ void TermDocumentIterator::ensureTermDocReader_()
     }
 }
 
+bool TermDocumentIterator::getBlockUB(
+    const TermUBCalculator& ubCalculator,
+    PostingBlockMaxCache* blockMaxCache,
+    uint64_t indexGeneration,
+    PostingBlockUB& blockUB)
+{
+    if (isNumericFilter_ || !pTermDocReader_)
+        return false;
+
+    // a single block is no tighter than the bound of the whole postings
+    if (df_ <= PostingBlockMax::BLOCK_SIZE)
+        return false;
+
+    const PostingBlockMaxCache::key_type key =
+        PostingBlockMaxCache::getKey(property_, termId_, indexGeneration);
+    PostingBlockMaxCache::value_type blockMax;
+
+    if (!blockMaxCache || !blockMaxCache->get(key, blockMax))
+    {
+        const std::size_t clearCount =
+            blockMaxCache ? blockMaxCache->getClearCount() : 0;
+        boost::shared_ptr<PostingBlockMax> newBlockMax(new PostingBlockMax);
+        if (!buildBlockMax_(*newBlockMax))
+            return false;
+
+        blockMax = newBlockMax;
+        if (blockMaxCache)
+        {
+            blockMaxCache->set(key, blockMax, blockMax->bytes() + key.size(),
+                               clearCount);
+        }
+    }
+
+    return blockUB.init(blockMax,
+                        boost::bind(&TermUBCalculator::getUB, &ubCalculator,
+                                    boost::cref(property_), termIndex_, _1, _2));
+}
+
+bool TermDocumentIterator::buildBlockMax_(PostingBlockMax& blockMax)
+{
+    // a separate reader, as pTermDocReader_ is being iterated
+    TermReader* pTermReader = pIndexReader_->getTermReader(colID_);
+    if (!pTermReader)
+        return false;
+
+    bool result = false;
+    Term term(property_.c_str(), termId_);
+    if (pTermReader->seek(&term))
+    {
+        TermDocFreqs* pTermDocReader = pTermReader->termDocFreqs();
+        if (pTermDocReader)
+        {
+            blockMax.build(*pTermDocReader);
+            delete pTermDocReader;
+            result = true;
+        }
+    }
+
+    delete pTermReader;
+    return result;
+}
+
 void TermDocumentIterator::df_cmtf(
     DocumentFrequencyInProperties& dfmap,
     CollectionTermFrequencyInProperties& ctfmap,
@@ -8,6 +8,7 @@
 #define TERM_DOCUMENT_ITERATOR_H
 
 #include "DocumentIterator.h"
+#include "PostingBlockMax.h"
 #include <common/TermTypeDetector.h>
 
 #include <ir/index_manager/index/AbsTermReader.h>
@@ -120,6 +121,12 @@ public:
     {
         return ub_;
     }
+
+    bool getBlockUB(
+        const TermUBCalculator& ubCalculator,
+        PostingBlockMaxCache* blockMaxCache,
+        uint64_t indexGeneration,
+        PostingBlockUB& blockUB);
     
     const char* getProperty()
     {
@@ -149,6 +156,10 @@ private:
 
     void ensureTermDocReader_();
 
+protected:
+    /// build @p blockMax by scanning the whole postings of the term
+    virtual bool buildBlockMax_(PostingBlockMax& blockMax);
+
 protected:
     termid_t termId_;
 
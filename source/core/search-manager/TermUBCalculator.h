@@ -0,0 +1,62 @@
+/**
+ * @file TermUBCalculator.h
+ * @brief calculate the upper bound of a query term in a doc by its term
+ * frequency, using the property rankers of the query.
+ */
+
+#ifndef SF1R_TERM_UB_CALCULATOR_H
+#define SF1R_TERM_UB_CALCULATOR_H
+
+#include <ranking-manager/PropertyRanker.h>
+#include <ranking-manager/RankQueryProperty.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace sf1r
+{
+
+/**
+ * The rankers and the query properties are not owned, they should be
+ * alive while this calculator is used.
+ */
+class TermUBCalculator
+{
+public:
+    void addProperty(
+        const std::string& property,
+        const PropertyRanker* ranker,
+        const RankQueryProperty* queryProperty)
+    {
+        properties_[property] = std::make_pair(ranker, queryProperty);
+    }
+
+    /**
+     * @return false if the property is not added, or its ranker does not
+     *         support the upper bound by term frequency
+     */
+    bool getUB(
+        const std::string& property,
+        unsigned int termIndex,
+        float tf,
+        float& ub) const
+    {
+        property_map::const_iterator it = properties_.find(property);
+        if (it == properties_.end())
+            return false;
+
+        return it->second.first->calculateTermUB(*it->second.second,
+                                                 termIndex, tf, ub);
+    }
+
+private:
+    typedef std::map<std::string,
+                     std::pair<const PropertyRanker*, const RankQueryProperty*> > property_map;
+
+    property_map properties_;
+};
+
+} // namespace sf1r
+
+#endif // SF1R_TERM_UB_CALCULATOR_H
@@ -17,7 +17,7 @@ public:
     ZambeziFilter(
             const DocumentManager& documentManager,
             const boost::shared_ptr<faceted::GroupFilter>& groupFilter,
-            const boost::shared_ptr<izenelib::ir::indexmanager::Bitset>& filterBitset)
+            const boost::shared_ptr<const izenelib::ir::indexmanager::Bitset>& filterBitset)
         : documentManager_(documentManager)
         , groupFilter_(groupFilter)
         , filterBitset_(filterBitset)
@@ -59,7 +59,7 @@ private:
     bool reverse_;
     const DocumentManager& documentManager_;
     boost::shared_ptr<faceted::GroupFilter> groupFilter_;
-    boost::shared_ptr<izenelib::ir::indexmanager::Bitset> filterBitset_;
+    boost::shared_ptr<const izenelib::ir::indexmanager::Bitset> filterBitset_;
 };
 
 } // namespace sf1r
@@ -5,12 +5,14 @@
 #include "Sorter.h"
 #include "QueryBuilder.h"
 #include "HitQueue.h"
+#include "SearchThreadShared.h"
 #include <la-manager/AttrTokenizeWrapper.h>
 #include <query-manager/SearchKeywordOperation.h>
 #include <query-manager/QueryTypeDef.h> // FilteringType
 #include <common/ResultType.h>
 #include <common/ResourceManager.h>
 #include <common/PropSharedLockSet.h>
+#include <common/SortKey.h>
 #include <document-manager/DocumentManager.h>
 #include <mining-manager/MiningManager.h>
 #include <index-manager/zambezi-manager/ZambeziManager.h>
@@ -18,15 +20,15 @@
 #include <mining-manager/group-manager/GroupFilterBuilder.h>
 #include <mining-manager/group-manager/GroupFilter.h>
 #include <mining-manager/product-scorer/ProductScorer.h>
-#include <mining-manager/util/convert_ustr.h>
 #include <ir/index_manager/utility/Bitset.h>
 #include <util/ClockTimer.h>
 #include <glog/logging.h>
 #include <iostream>
-#include <set>
 #include <math.h>
 #include <algorithm>
 #include <boost/scoped_ptr.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
 
 namespace sf1r
 {
@@ -46,6 +48,334 @@ const izenelib::util::UString kAttrExcludeMerchant =
     izenelib::util::UString("淘宝网", kEncodeType);
 
 const izenelib::util::UString::CharT kUCharSpace = ' ';
+
+// the candidates are ranked by more threads only if each thread gets so many
+const std::size_t kMinThreadCandidateNum = 5e4;
+
+// zambezi retrieves the docs in docid order, not by score, the candidates
+// ranked for each doc of the page when the page order only depends on the
+// relevance score
+const std::size_t kCandidateNumPerResult = 200;
+const std::size_t kMinZambeziCandidateNum = 2e4;
+
+std::size_t getCandidateNum(std::size_t heapSize, bool isFullRank)
+{
+    if (isFullRank)
+        return kZambeziTopKNum;
+
+    return std::min(kZambeziTopKNum,
+                    std::max(kMinZambeziCandidateNum, heapSize * kCandidateNumPerResult));
+}
+
+/**
+ * only @p passNum of @p candidateNum candidates passed the group filter,
+ * the candidates to fill the page at the same pass rate, at least twice as
+ * many as before.
+ */
+std::size_t growCandidateNum(
+    std::size_t candidateNum,
+    std::size_t heapSize,
+    std::size_t passNum)
+{
+    const double needNum = static_cast<double>(candidateNum) *
+        heapSize * kCandidateNumPerResult / std::max<std::size_t>(passNum, 1);
+
+    if (needNum >= kZambeziTopKNum)
+        return kZambeziTopKNum;
+
+    return std::min(kZambeziTopKNum,
+                    std::max(2 * candidateNum, static_cast<std::size_t>(needNum)));
+}
+
+// the candidates filtered and ranked by one thread
+struct CandidateRange
+{
+    std::size_t begin;
+    std::size_t end;
+    faceted::GroupFilter* groupFilter;
+    std::size_t totalCount;
+    // in ascending order
+    std::vector<ScoreDoc> topDocs;
+
+    CandidateRange() : begin(0), end(0), groupFilter(NULL), totalCount(0) {}
+};
+
+// shared by the threads
+struct CandidateContext
+{
+    const std::vector<docid_t>& candidates;
+    const std::vector<float>& scores;
+    const std::size_t heapSize;
+    const Sorter* sorter;
+    CustomRankerPtr customRanker;
+    GeoLocationRankerPtr geoLocationRanker;
+
+    CandidateContext(
+        const std::vector<docid_t>& candidates,
+        const std::vector<float>& scores,
+        std::size_t heapSize,
+        const Sorter* sorter,
+        const CustomRankerPtr& customRanker,
+        const GeoLocationRankerPtr& geoLocationRanker)
+        : candidates(candidates)
+        , scores(scores)
+        , heapSize(heapSize)
+        , sorter(sorter)
+        , customRanker(customRanker)
+        , geoLocationRanker(geoLocationRanker)
+    {
+    }
+};
+
+// the order of ScoreDoc::sortKeys, a strict weak ordering
+template <std::size_t KeyNum>
+struct SortKeyLess
+{
+    bool operator()(const ScoreDoc& o1, const ScoreDoc& o2) const
+    {
+        return SortKeyQueue<KeyNum>::lessThan(o1, o2);
+    }
+};
+
+// the comparators behind Sorter::lessThan() don't always give a strict
+// weak ordering, only the heap algorithms are safe with it
+class SorterLess
+{
+public:
+    explicit SorterLess(Sorter* sorter) : sorter_(sorter) {}
+
+    bool operator()(const ScoreDoc& o1, const ScoreDoc& o2) const
+    {
+        return sorter_->lessThan(o1, o2);
+    }
+
+private:
+    Sorter* sorter_;
+};
+
+template <typename Less>
+class GreaterThan
+{
+public:
+    explicit GreaterThan(const Less& less) : less_(less) {}
+
+    bool operator()(const ScoreDoc& o1, const ScoreDoc& o2) const
+    {
+        return less_(o2, o1);
+    }
+
+private:
+    Less less_;
+};
+
+/**
+ * Keeps the @p k greatest docs by @p less. The docs are buffered, each time
+ * the buffer is full it is cut back to the top k by nth_element(), which
+ * costs linear time in the docs pushed instead of a heap insert per doc.
+ * The k-th doc of the last cut rejects the lower docs before buffering.
+ */
+template <typename Less>
+class TopDocsSelector
+{
+public:
+    TopDocsSelector(std::size_t k, const Less& less, bool isStrictOrder)
+        : k_(k)
+        , bufferSize_(std::max<std::size_t>(2 * k, 1024))
+        , less_(less)
+        , isStrictOrder_(isStrictOrder)
+        , hasThreshold_(false)
+    {
+        docs_.reserve(bufferSize_);
+    }
+
+    void push(const ScoreDoc& doc)
+    {
+        if (hasThreshold_ && !less_(threshold_, doc))
+            return;
+
+        docs_.push_back(doc);
+        if (docs_.size() >= bufferSize_)
+        {
+            shrink_();
+        }
+    }
+
+    /// the top docs in ascending order
+    void getTopDocs(std::vector<ScoreDoc>& topDocs)
+    {
+        shrink_();
+        if (isStrictOrder_)
+        {
+            std::sort(docs_.begin(), docs_.end(), less_);
+        }
+        else
+        {
+            std::make_heap(docs_.begin(), docs_.end(), less_);
+            std::sort_heap(docs_.begin(), docs_.end(), less_);
+        }
+        topDocs.swap(docs_);
+    }
+
+private:
+    void shrink_()
+    {
+        if (docs_.size() <= k_)
+            return;
+
+        docs_.erase(docs_.begin() + cut_(), docs_.end());
+    }
+
+    /// move the top k docs to the front, return k
+    std::size_t cut_()
+    {
+        if (k_ == 0)
+            return 0;
+
+        const GreaterThan<Less> greater(less_);
+        if (isStrictOrder_)
+        {
+            std::nth_element(docs_.begin(), docs_.begin() + k_ - 1, docs_.end(), greater);
+        }
+        else
+        {
+            std::partial_sort(docs_.begin(), docs_.begin() + k_, docs_.end(), greater);
+        }
+        threshold_ = docs_[k_ - 1];
+        hasThreshold_ = true;
+        return k_;
+    }
+
+private:
+    const std::size_t k_;
+    const std::size_t bufferSize_;
+    const Less less_;
+    const bool isStrictOrder_;
+    std::vector<ScoreDoc> docs_;
+    bool hasThreshold_;
+    // the lowest of the top k docs at the last cut
+    ScoreDoc threshold_;
+};
+
+template <typename Less>
+void rankCandidateRange(
+    const CandidateContext& context,
+    const Less& less,
+    bool isStrictOrder,
+    CandidateRange& range)
+{
+    TopDocsSelector<Less> selector(context.heapSize, less, isStrictOrder);
+
+    for (std::size_t i = range.begin; i < range.end; ++i)
+    {
+        docid_t docId = context.candidates[i];
+
+        if (range.groupFilter && !range.groupFilter->test(docId))
+            continue;
+
+        ScoreDoc scoreItem(docId, context.scores[i]);
+
+        if (context.customRanker)
+        {
+            scoreItem.custom_score = context.customRanker->evaluate(docId);
+        }
+
+        if (context.geoLocationRanker)
+        {
+            scoreItem.geo_dist = context.geoLocationRanker->evaluate(docId);
+        }
+
+        if (context.sorter)
+        {
+            context.sorter->fillSortKeys(scoreItem);
+        }
+        else
+        {
+            scoreItem.sortKeys[0] = doubleSortKey(scoreItem.score);
+        }
+
+        selector.push(scoreItem);
+        ++range.totalCount;
+    }
+
+    selector.getTopDocs(range.topDocs);
+}
+
+/**
+ * rank each range in its own thread, the top docs of all ranges go to
+ * @p topDocs in ascending order.
+ */
+template <typename Less>
+void rankCandidates(
+    const CandidateContext& context,
+    const Less& less,
+    bool isStrictOrder,
+    std::vector<CandidateRange>& ranges,
+    std::vector<ScoreDoc>& topDocs)
+{
+    boost::thread_group threads;
+    for (std::size_t i = 1; i < ranges.size(); ++i)
+    {
+        threads.create_thread(boost::bind(&rankCandidateRange<Less>,
+                                          boost::cref(context),
+                                          boost::cref(less),
+                                          isStrictOrder,
+                                          boost::ref(ranges[i])));
+    }
+    rankCandidateRange(context, less, isStrictOrder, ranges[0]);
+    threads.join_all();
+
+    std::vector<std::vector<ScoreDoc> > sortedLists(ranges.size());
+    for (std::size_t i = 0; i < ranges.size(); ++i)
+    {
+        sortedLists[i].swap(ranges[i].topDocs);
+    }
+    mergeTopK(sortedLists, less, context.heapSize, topDocs);
+}
+
+/**
+ * a set of the non-zero ids, in open addressing with linear probing, for
+ * the few distinct ids among the docs of a page.
+ */
+class IdSet
+{
+public:
+    /// at most @p maxSize ids are inserted
+    explicit IdSet(std::size_t maxSize)
+        : size_(0)
+    {
+        std::size_t capacity = 16;
+        while (capacity < maxSize * 2)
+        {
+            capacity <<= 1;
+        }
+        mask_ = capacity - 1;
+        ids_.resize(capacity);
+    }
+
+    /// @return true if @p id is inserted, false if it already exists
+    bool insert(uint32_t id)
+    {
+        for (std::size_t i = (id * 2654435761U) & mask_; ; i = (i + 1) & mask_)
+        {
+            if (ids_[i] == id)
+                return false;
+
+            if (ids_[i] == 0)
+            {
+                ids_[i] = id;
+                ++size_;
+                return true;
+            }
+        }
+    }
+
+    std::size_t size() const { return size_; }
+
+private:
+    std::size_t mask_;
+    std::size_t size_;
+    std::vector<uint32_t> ids_;
+};
 }
 
 bool DocLess(const ScoreDoc& o1, const ScoreDoc& o2)
@@ -84,7 +414,7 @@ void ZambeziSearch::setMiningManager(
 
 void ZambeziSearch::normalizeTopDocs_(
     const boost::scoped_ptr<ProductScorer>& productScorer,
-    boost::scoped_ptr<HitQueue>& scoreItemQueue,
+    const std::vector<ScoreDoc>& topDocs,
     std::vector<ScoreDoc>& resultList)
 {
     izenelib::util::ClockTimer timer;
@@ -92,10 +422,9 @@ void ZambeziSearch::normalizeTopDocs_(
     std::vector<float> topRelevanceScores;
     std::vector<float> topProductScores;
 
-    unsigned int scoreSize = scoreItemQueue->size();
-    for (int i = scoreSize - 1; i >= 0; --i)
+    for (std::size_t i = 0; i < topDocs.size(); ++i)
     {
-        const ScoreDoc& scoreItem = scoreItemQueue->pop();
+        const ScoreDoc& scoreItem = topDocs[i];
         topDocids.push_back(scoreItem.docId);
         float productScore = 0;
         productScore = productScorer->score(scoreItem.docId);
@@ -126,6 +455,65 @@ void ZambeziSearch::normalizeTopDocs_(
             << "Docs cost:" << timer.elapsed() << " seconds";
 }
 
+bool ZambeziSearch::retrieveCandidates_(
+    izenelib::ir::Zambezi::Algorithm algorithm,
+    const std::string& query,
+    const std::vector<std::pair<std::string, int> >& tokenList,
+    const std::vector<std::string>& propertyList,
+    const ZambeziFilter& filter,
+    std::size_t candidateNum,
+    std::vector<docid_t>& candidates,
+    std::vector<float>& scores)
+{
+    candidates.clear();
+    scores.clear();
+
+    zambeziManager_->search(algorithm, tokenList, propertyList,
+                            &filter, candidateNum, candidates, scores);
+
+    if (candidates.empty() && zambeziManager_->isAttrTokenize())
+    {
+        std::vector<std::pair<std::string, int> > subTokenList;
+        AttrTokenizeWrapper::get()->attr_tokenize(query, subTokenList, true); // kevin'dict
+        if (subTokenList.empty())
+        {
+            LOG(INFO) << "empty search result for query: " << query;
+            return false;
+        }
+        zambeziManager_->search(algorithm, subTokenList, propertyList,
+                                &filter, candidateNum, candidates, scores);
+    }
+
+    if (candidates.empty())
+    {
+        LOG(INFO) << "empty search result for query: " << query;
+        return false;
+    }
+
+    if (candidates.size() != scores.size())
+    {
+        LOG(WARNING) << "mismatch size of candidate docid and score";
+        return false;
+    }
+
+    //normalize relevance scores
+    if (zambeziManager_->isAttrTokenize() && tokenList.size() > 1)
+    {
+        float normalizerScore = 0;
+        for (std::vector<std::pair<std::string, int> >::const_iterator it = tokenList.begin();
+                it != tokenList.end(); ++it)
+        {
+            normalizerScore += it->second;
+        }
+        for (std::vector<float>::iterator it = scores.begin(); it != scores.end(); ++it)
+        {
+            *it /= normalizerScore;
+        }
+    }
+
+    return true;
+}
+
 bool ZambeziSearch::search(
     const SearchKeywordOperation& actionOperation,
     KeywordSearchResult& searchResult,
@@ -165,14 +553,13 @@ bool ZambeziSearch::search(
     ConditionsNode& filterTree =
         actionOperation.actionItem_.filterTree_;
 
-    boost::shared_ptr<InvertedIndexManager::FilterBitmapT> filterBitmap;
-    boost::shared_ptr<izenelib::ir::indexmanager::Bitset> filterBitset;
+    boost::shared_ptr<const izenelib::ir::indexmanager::Bitset> filterBitset;
 
-    if (!filterTree.empty())
+    if (!filterTree.empty() &&
+        !queryBuilder_.prepare_filter_bitset(filterTree, filterBitset))
     {
-        queryBuilder_.prepare_filter(filterTree, filterBitmap);
-        filterBitset.reset(new izenelib::ir::indexmanager::Bitset);
-        filterBitset->decompress(*filterBitmap);
+        LOG(WARNING) << "failed to prepare the filter for query: " << query;
+        return false;
     }
     //Query Analyzer
     getAnalyzedQuery_(query, searchResult.analyzedQuery_);
@@ -187,53 +574,6 @@ bool ZambeziSearch::search(
     if (tokenList.empty())
         return false;
 
-    ZambeziFilter filter(documentManager_, groupFilter, filterBitset);
-
-    zambeziManager_->search(algorithm, tokenList, search_in_properties,
-                            &filter, kZambeziTopKNum, candidates, scores);
-
-    if (candidates.empty() && zambeziManager_->isAttrTokenize())
-    {
-        std::vector<std::pair<std::string, int> > subTokenList;
-        AttrTokenizeWrapper::get()->attr_tokenize(query, subTokenList, true); // kevin'dict
-        if (subTokenList.empty())
-        {
-            LOG(INFO) << "empty search result for query: " << query;
-            return false;
-        }
-        zambeziManager_->search(algorithm, subTokenList, search_in_properties,
-                                &filter, kZambeziTopKNum, candidates, scores);
-    }
-
-    if (candidates.empty())
-    {
-        LOG(INFO) << "empty search result for query: " << query;
-        return false;
-    }
-
-    if (candidates.size() != scores.size())
-    {
-        LOG(WARNING) << "mismatch size of candidate docid and score";
-        return false;
-    }
-
-    //normalize relevance scores
-    if (zambeziManager_->isAttrTokenize() && tokenList.size() > 1)
-    {
-        float normalizerScore = 0;
-        for (std::vector<std::pair<std::string, int> >::const_iterator it = tokenList.begin();
-                it != tokenList.end(); ++it)
-        {
-            normalizerScore += it->second;
-        }
-        for (std::vector<float>::iterator it = scores.begin(); it != scores.end(); ++it)
-        {
-            *it /= normalizerScore;
-        }
-    }
-
-    izenelib::util::ClockTimer timer;
-
     boost::shared_ptr<Sorter> sorter;
     CustomRankerPtr customRanker;
     GeoLocationRankerPtr geoLocationRanker;
@@ -243,73 +583,121 @@ bool ZambeziSearch::search(
                                 customRanker,
                                 geoLocationRanker);
 
-    boost::scoped_ptr<HitQueue> scoreItemQueue;
     const std::size_t heapSize = limit + offset;
 
-    if (sorter)
-    {
-        scoreItemQueue.reset(new PropertySortedHitQueue(sorter,
-                                                        heapSize,
-                                                        propSharedLockSet));
-    }
-    else
-    {
-        scoreItemQueue.reset(new ScoreSortedHitQueue(heapSize));
-    }
+    // the order by sort properties and the group counts need all the docs,
+    // so does the total count unless adaptiveCandidate is configured, then
+    // it only counts the candidates retrieved for the page
+    const bool isFullRank = !zambeziManager_->isAdaptiveCandidate() || sorter ||
+        !groupParam.groupProps_.empty() || !groupParam.autoSelectLimits_.empty();
+    std::size_t candidateNum = getCandidateNum(heapSize, isFullRank);
 
-    if (groupFilterBuilder_)
+    ZambeziFilter filter(documentManager_, groupFilter, filterBitset);
+
+    if (!retrieveCandidates_(algorithm, query, tokenList, search_in_properties,
+                             filter, candidateNum, candidates, scores))
+        return false;
+
+    izenelib::util::ClockTimer timer;
+
+    if (sorter)
     {
-        groupFilter.reset(
-            groupFilterBuilder_->createFilter(groupParam, propSharedLockSet));
+        sorter->createComparators(propSharedLockSet);
     }
 
-    // reset relevance score
-    const std::size_t candNum = candidates.size();
+    std::vector<boost::shared_ptr<faceted::GroupFilter> > threadGroupFilters;
+    std::size_t threadNum = 1;
+    std::vector<ScoreDoc> topDocs;
     std::size_t totalCount = 0;
 
+    while (true)
     {
-        for (size_t i = 0; i < candNum; ++i)
+        if (groupFilterBuilder_)
         {
-            docid_t docId = candidates[i];
+            groupFilter.reset(
+                groupFilterBuilder_->createFilter(groupParam, propSharedLockSet));
+        }
 
-            if (groupFilter && !groupFilter->test(docId))
-                continue;
+        // CustomRanker::evaluate() keeps its result in the syntax tree, so it
+        // can't be shared by threads
+        const std::size_t candNum = candidates.size();
+        threadNum = 1;
+        if (!customRanker)
+        {
+            threadNum = std::min<std::size_t>(boost::thread::hardware_concurrency(),
+                                              candNum / kMinThreadCandidateNum);
+            threadNum = std::max<std::size_t>(threadNum, 1);
+        }
 
-            ScoreDoc scoreItem(docId, scores[i]);
+        // the group counters of each thread are merged in the end
+        threadGroupFilters.clear();
+        std::vector<CandidateRange> ranges(threadNum);
+        for (std::size_t i = 0; i < threadNum; ++i)
+        {
+            CandidateRange& range = ranges[i];
+            range.begin = candNum * i / threadNum;
+            range.end = candNum * (i + 1) / threadNum;
+            range.groupFilter = groupFilter.get();
 
-            if (customRanker)
+            if (i > 0 && groupFilter)
             {
-                scoreItem.custom_score = customRanker->evaluate(docId);
+                threadGroupFilters.push_back(boost::shared_ptr<faceted::GroupFilter>(
+                    groupFilterBuilder_->createFilter(groupParam, propSharedLockSet)));
+                range.groupFilter = threadGroupFilters.back().get();
             }
+        }
 
-            if (geoLocationRanker)
-            {
-                scoreItem.geo_dist = geoLocationRanker->evaluate(docId);
-            }
+        CandidateContext context(candidates, scores, heapSize,
+                                 sorter.get(), customRanker, geoLocationRanker);
 
-            scoreItemQueue->insert(scoreItem);
+        // without sorter, the score is the sort key
+        if (!sorter || sorter->sortKeyNum() == 1)
+        {
+            rankCandidates(context, SortKeyLess<1>(), true, ranges, topDocs);
+        }
+        else if (sorter->sortKeyNum() == 2)
+        {
+            rankCandidates(context, SortKeyLess<2>(), true, ranges, topDocs);
+        }
+        else
+        {
+            rankCandidates(context, SorterLess(sorter.get()), false, ranges, topDocs);
+        }
 
-            ++totalCount;
+        totalCount = 0;
+        for (std::size_t i = 0; i < threadNum; ++i)
+        {
+            totalCount += ranges[i].totalCount;
         }
+
+        // the page is full, or there is no more doc to retrieve
+        if (topDocs.size() >= heapSize || candNum < candidateNum ||
+            candidateNum >= kZambeziTopKNum)
+            break;
+
+        // the group labels filtered out too many docs
+        candidateNum = growCandidateNum(candidateNum, heapSize, totalCount);
+        LOG(INFO) << "only " << totalCount << " of " << candNum
+                  << " candidates are left by group filter, retrieve "
+                  << candidateNum << " candidates again";
+
+        if (!retrieveCandidates_(algorithm, query, tokenList, search_in_properties,
+                                 filter, candidateNum, candidates, scores))
+            return false;
     }
 
     std::vector<ScoreDoc> resultList;
-    unsigned int scoreSize = scoreItemQueue->size();
+    const std::size_t scoreSize = topDocs.size();
     if (!sorter && productScorer) // productScorer; //!sorter
     {
         LOG(INFO) << "do normalize top docs ...";
         normalizeTopDocs_(productScorer,
-                        scoreItemQueue,
+                        topDocs,
                         resultList);
     }
     else
     {
-        resultList.resize(scoreSize);
-        for (int i = scoreSize - 1; i >= 0; --i)
-        {
-            const ScoreDoc& scoreItem = scoreItemQueue->pop();
-            resultList[i] = scoreItem;
-        }
+        resultList.assign(topDocs.rbegin(), topDocs.rend());
     }
     /// end
 
@@ -367,6 +755,14 @@ bool ZambeziSearch::search(
 
         sf1r::faceted::OntologyRep tempAttrRep;
         groupFilter->getGroupRep(searchResult.groupRep_, tempAttrRep);
+
+        for (std::size_t i = 0; i < threadGroupFilters.size(); ++i)
+        {
+            faceted::GroupRep threadGroupRep;
+            faceted::OntologyRep threadAttrRep;
+            threadGroupFilters[i]->getGroupRep(threadGroupRep, threadAttrRep);
+            searchResult.groupRep_.merge(threadGroupRep);
+        }
     }
 
     if (originIsAttrGroup)
@@ -384,6 +780,7 @@ bool ZambeziSearch::search(
     }
 
     LOG(INFO) << "in zambezi ranking, total count: " << totalCount
+              << ", thread num: " << threadNum
               << ", costs :" << timer.elapsed() << " seconds";
 
     return true;
@@ -404,7 +801,8 @@ void ZambeziSearch::getTopLabels_(
     typedef std::vector<std::pair<faceted::PropValueTable::pvid_t, faceted::GroupPathScoreInfo> > TopCatIdsT;
     TopCatIdsT topCateIds;
     const std::size_t topNum = docIdList.size();
-    std::set<faceted::PropValueTable::pvid_t> rootCateIds;
+    IdSet cateIds(topNum);
+    IdSet rootCateIds(kRootCateNum);
 
     for (std::size_t i = 0; i < topNum; ++i)
     {
@@ -414,39 +812,22 @@ void ZambeziSearch::getTopLabels_(
         category_id_t catId =
             categoryValueTable_->getFirstValueId(docIdList[i]);
 
-        if (catId != 0)
+        if (catId != 0 && cateIds.insert(catId))
         {
-            bool is_exist = false;
-            for (TopCatIdsT::const_iterator cit = topCateIds.begin();
-                 cit != topCateIds.end(); ++cit)
-            {
-                if (cit->first == catId)
-                {
-                    is_exist = true;
-                    break;
-                }
-            }
-            if (!is_exist)
-            {
-                topCateIds.push_back(std::make_pair(catId, faceted::GroupPathScoreInfo(rankScoreList[i], docIdList[i])));
+            topCateIds.push_back(std::make_pair(catId, faceted::GroupPathScoreInfo(rankScoreList[i], docIdList[i])));
 
-                category_id_t rootId = categoryValueTable_->getRootValueId(catId);
-                rootCateIds.insert(rootId);
-            }
+            category_id_t rootId = categoryValueTable_->getRootValueId(catId);
+            rootCateIds.insert(rootId);
         }
     }
 
     faceted::GroupParam::GroupPathScoreVec& topLabels = topLabelMap[kTopLabelPropName];
+    topLabels.reserve(topLabels.size() + topCateIds.size());
     for (TopCatIdsT::const_iterator idIt =
              topCateIds.begin(); idIt != topCateIds.end(); ++idIt)
     {
-        std::vector<izenelib::util::UString> ustrPath;
-        categoryValueTable_->propValuePath(idIt->first, ustrPath, false);
-
-        std::vector<std::string> path;
-        convert_to_str_vector(ustrPath, path);
-
-        topLabels.push_back(std::make_pair(path, idIt->second));
+        topLabels.push_back(std::make_pair(std::vector<std::string>(), idIt->second));
+        categoryValueTable_->propValuePath(idIt->first, topLabels.back().first, false);
     }
 
     LOG(INFO) << "get top label num: "<< topLabels.size()
@@ -32,8 +32,8 @@ class ZambeziManager;
 class PropSharedLockSet;
 class ZambeziScoreNormalizer;
 class ProductScorer;
-class HitQueue;
 class ScoreDoc;
+class ZambeziFilter;
 
 namespace faceted
 {
@@ -67,9 +67,24 @@ private:
     //     std::vector<float>& productScores,
     //     PropSharedLockSet &sharedLockSet);
     
+    /**
+     * retrieve at most @p candidateNum candidates of @p tokenList, or of the
+     * attr sub tokens if @p tokenList gets nothing.
+     * @return false if no candidate is found
+     */
+    bool retrieveCandidates_(
+        izenelib::ir::Zambezi::Algorithm algorithm,
+        const std::string& query,
+        const std::vector<std::pair<std::string, int> >& tokenList,
+        const std::vector<std::string>& propertyList,
+        const ZambeziFilter& filter,
+        std::size_t candidateNum,
+        std::vector<docid_t>& candidates,
+        std::vector<float>& scores);
+
     void normalizeTopDocs_(
         const boost::scoped_ptr<ProductScorer>& productScorer, 
-        boost::scoped_ptr<HitQueue>& scoreItemQueue,
+        const std::vector<ScoreDoc>& topDocs,
         std::vector<ScoreDoc>& resultList);
 
     void getTopLabels_(
@@ -12,7 +12,9 @@ bool SlimRecommend::recommend(const std::string & title,
     boost::shared_lock<boost::shared_mutex> lock(_rw_mutex);
 
     if (!title.empty()) {
-        int clusterID = laser_->getClustering(title);
+        // tokenized once, shared by clustering and scoring
+        laser::TokenizeCache::TokenVectorPtr vec = laser_->tokenize(title);
+        int clusterID = laser_->getClustering(*vec);
 
         if (clusterID == -1) {
             clusterID = _similar_cluster.size() - 1;
@@ -36,17 +38,22 @@ bool SlimRecommend::recommend(const std::string & title,
         }
 
         // clusters is ready and not empty...
-        boost::unordered_map<int, float> vec;
-        tokenizer_->tokenize(title, vec);
+        if (NULL == scratch_.get()) {
+            scratch_.reset(new TitleScratch());
+        }
+        TitleScratch & scratch = *scratch_;
+        scratch.assign(*vec);
 
         priority_queue queue;
 
+        ADVector advec;
         for (int i = 0; i != (int)clusters.size(); ++i) {
-            ADVector advec;
+            advec.clear();
             if (indexManager_->get(clusters[i], advec)) {
-                topN(vec, advec, topn, queue);
+                topN(scratch, advec, topn, queue);
             }
         }
+        scratch.clear();
 
         if (queue.empty()) {
             return false;
@@ -77,23 +84,15 @@ bool SlimRecommend::recommend(const std::string & title,
     }
 }
 
-void SlimRecommend::topN(boost::unordered_map<int, float> & title_vec,
-                         ADVector & advec,
+void SlimRecommend::topN(const TitleScratch & title,
+                         const ADVector & advec,
                          int topn,
                          priority_queue & queue)
 {
     for (int i = 0; i != (int)advec.size(); ++i) {
-        AD & ad = advec[i];
-        docid_t & docid = ad.first;
-        std::vector<std::pair<int, float> > & vec = ad.second;
-
-        float score = 0.0;
-        for (int i = 0; i != (int)vec.size(); ++i) {
-            boost::unordered_map<int, float>::iterator p = title_vec.find(vec[i].first);
-            if (p != title_vec.end()) {
-                score += p->second * vec[i].second;
-            }
-        }
+        const AD & ad = advec[i];
+        const docid_t & docid = ad.first;
+        const float score = title.dot(ad.second);
 
         if ((int)queue.size() >= topn) {
             if (score > queue.top().second) {
@@ -6,6 +6,8 @@
 #include <common/inttypes.h>
 #include <laser-manager/LaserManager.h>
 #include <laser-manager/AdIndexManager.h>
+#include "TitleScratch.h"
+#include <boost/thread/tss.hpp>
 #include <util/functional.h>
 #include <common/inttypes.h>
 #include <queue>
@@ -13,8 +15,9 @@
 namespace sf1r { namespace slim {
 
 class SlimRecommend {
-    typedef std::pair<docid_t, std::vector<std::pair<int, float> > > AD;
-    typedef std::vector<AD> ADVector;
+    // candidates are views into the ad index, nothing is copied
+    typedef laser::AdIndexManager::AdViewVector ADVector;
+    typedef ADVector::value_type AD;
 
     typedef izenelib::util::second_greater<std::pair<docid_t, float> > greater_than;
     typedef std::priority_queue<std::pair<docid_t, float>, std::vector<std::pair<docid_t, float> >, greater_than> priority_queue;
@@ -40,8 +43,8 @@ public:
                    int topn,
                    std::vector<docid_t> & itemList);
 
-    void topN(boost::unordered_map<int, float> & title_vec,
-              ADVector & advec,
+    void topN(const TitleScratch & title,
+              const ADVector & advec,
               int topn,
               priority_queue & queue);
 
@@ -54,6 +57,9 @@ private:
     boost::shared_mutex & _rw_mutex;
 
     LaserManager * laser_;
+
+    // one dense title vector per recommend thread
+    boost::thread_specific_ptr<TitleScratch> scratch_;
 };
 
 }}
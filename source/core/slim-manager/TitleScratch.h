@@ -0,0 +1,97 @@
+#ifndef SF1R_SLIM_TITLE_SCRATCH_H
+#define SF1R_SLIM_TITLE_SCRATCH_H
+
+#include <vector>
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include <laser-manager/AdVectorArena.h>
+
+namespace sf1r { namespace slim {
+
+/*
+ * The title vector of one request scattered into a dense array indexed by
+ * term, so scoring an ad is a gather-multiply over its terms instead of a
+ * hash probe per term. Ad vectors are sorted by term, terms outside the
+ * title's [min, max] range are skipped without touching the array.
+ *
+ * A term repeated in the title keeps its last weight, as in the title map
+ * SlimRecommend used before.
+ *
+ * The array only grows and is zero except for the current title, assign()
+ * clears the previous title's terms, keep one scratch per thread.
+ */
+class TitleScratch : boost::noncopyable
+{
+public:
+    TitleScratch()
+        : minIndex_(0)
+        , maxIndex_(-1)
+    {
+    }
+
+public:
+    void assign(const std::vector<std::pair<int, float> >& title)
+    {
+        clear();
+        for (std::size_t i = 0; i < title.size(); ++i)
+        {
+            const int index = title[i].first;
+            if (index < 0)
+                continue;
+            if ((std::size_t)index >= weight_.size())
+            {
+                weight_.resize(index + 1, 0.0);
+            }
+            if (terms_.empty())
+            {
+                minIndex_ = maxIndex_ = index;
+            }
+            minIndex_ = std::min(minIndex_, index);
+            maxIndex_ = std::max(maxIndex_, index);
+            weight_[index] = title[i].second;
+            terms_.push_back(index);
+        }
+    }
+
+    void clear()
+    {
+        for (std::size_t i = 0; i < terms_.size(); ++i)
+        {
+            weight_[terms_[i]] = 0.0;
+        }
+        terms_.clear();
+        minIndex_ = 0;
+        maxIndex_ = -1;
+    }
+
+    bool empty() const
+    {
+        return terms_.empty();
+    }
+
+    float dot(const laser::AdVectorView& ad) const
+    {
+        laser::AdVectorView::const_iterator it = ad.begin();
+        const laser::AdVectorView::const_iterator end = ad.end();
+        while (it != end && it->first < minIndex_)
+        {
+            ++it;
+        }
+        float score = 0.0;
+        for (; it != end && it->first <= maxIndex_; ++it)
+        {
+            score += weight_[it->first] * it->second;
+        }
+        return score;
+    }
+
+private:
+    std::vector<float> weight_;
+    std::vector<int> terms_;
+    int minIndex_;
+    int maxIndex_;
+};
+
+}}
+
+#endif
@@ -62,7 +62,8 @@ int main(int argc, char * argv[])
         Configuration::get()->getMinClusteringDocNum(),
         Configuration::get()->getMaxClusteringDocNum(),
         Configuration::get()->getClusteringResultTermNumLimit(),
-        Configuration::get()->getClusteringExecThreadnum());
+        Configuration::get()->getClusteringExecThreadnum(),
+        Configuration::get()->getClusteringTokenizeThreadnum());
     pca->run();
     delete pca;
     return 0;
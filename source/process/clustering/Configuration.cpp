@@ -106,6 +106,14 @@ void Configuration::parseServerCfg(properties& props)
     getValue(props, "clustering.result.mintermnum", clusteringResultMintermnum);
 
     getValue(props, "clustering.exec.threadnum", clusteringExecThreadnum);
+
+    // optional
+    std::string tokenizeThreadnum;
+    clusteringTokenizeThreadnum = 0;
+    if (props.getValue("clustering.exec.tokenizethreadnum", tokenizeThreadnum))
+    {
+        clusteringTokenizeThreadnum = atoi(tokenizeThreadnum.c_str());
+    }
 }
 }
 }
@@ -91,6 +91,16 @@ public:
         this->clusteringExecThreadnum = clusteringExecThreadnum;
     }
 
+    int getClusteringTokenizeThreadnum() const
+    {
+        return clusteringTokenizeThreadnum;
+    }
+
+    void setClusteringTokenizeThreadnum(int clusteringTokenizeThreadnum)
+    {
+        this->clusteringTokenizeThreadnum = clusteringTokenizeThreadnum;
+    }
+
     int getClusteringResultMintermnum() const
     {
         return clusteringResultMintermnum;
@@ -159,6 +169,8 @@ private:
     unsigned int clusteringResultMintermnum;
     //the thread number for clustering
     unsigned int clusteringExecThreadnum;
+    //the thread number for title tokenizing, 0 for the same as clusteringExecThreadnum
+    unsigned int clusteringTokenizeThreadnum;
 };
 
 } //namespace conf
@@ -507,6 +507,20 @@ void initializeDriverRouter(::izenelib::driver::Router& router, IService* servic
             recommendHandler.get()
         );
         recommendHandler.release();
+
+        handler_ptr batchRecommendHandler(
+            new handler_type(
+                laser,
+                &LaserController::batch_recommend
+            )
+        );
+
+        router.map(
+            controllerName,
+            "batch_recommend",
+            batchRecommendHandler.get()
+        );
+        batchRecommendHandler.release();
     }
 
     {
@@ -1201,6 +1201,7 @@ void CollectionConfig::parseIndexBundleParam(const ticpp::Element * index, Colle
     params.Get("Sia/refreshsearchcache", indexBundleConfig.refreshSearchCache_);
     params.Get<time_t>("Sia/refreshcacheinterval", indexBundleConfig.refreshCacheInterval_);
     params.Get<std::size_t>("Sia/filtercachenum", indexBundleConfig.filterCacheNum_);
+    params.Get("Sia/enable_block_max_wand", indexBundleConfig.enable_block_max_wand_);
     params.Get<std::size_t>("Sia/mastersearchcachenum", indexBundleConfig.masterSearchCacheNum_);
     params.Get<std::size_t>("Sia/topknum", indexBundleConfig.topKNum_);
     params.Get<std::size_t>("Sia/sortcacheupdateinterval", indexBundleConfig.sortCacheUpdateInterval_);
@@ -1455,6 +1456,8 @@ void CollectionConfig::parseMiningBundleParam(const ticpp::Element * mining, Col
     params.Get<int>("LaserPara/kvport", mining_config.laser_param.kvport);
     params.GetString("LaserPara/mqaddr", mining_config.laser_param.mqaddr);
     params.Get<int>("LaserPara/mqport", mining_config.laser_param.mqport);
+    params.Get<int>("LaserPara/coarseClusteringNum", mining_config.laser_param.coarseClusteringNum);
+    params.Get<int>("LaserPara/coarseClusteringProbe", mining_config.laser_param.coarseClusteringProbe);
     LOG(INFO)<<mining_config.laser_param.modelType;
 
     std::set<std::string> directories;
@@ -1866,6 +1869,7 @@ void CollectionConfig::parseZambeziNode(
         throw XmlConfigParserException(message.str());
     }
 	getAttribute_ByteSize(zambeziNode, "vocabSize", zambeziConfig.vocabSize, false);
+    getAttribute(zambeziNode, "adaptiveCandidate", zambeziConfig.adaptiveCandidate, false);
 
     zambeziConfig.isEnable = true;
     //zambeziConfig.indexFilePath = collectionMeta.indexBundleConfig_->collPath_.getCollectionDataPath();
@@ -108,6 +108,12 @@ void CollectionHandler::laserRecommend(::izenelib::driver::Request& request, ::i
     handler.recommend();
 }
 
+void CollectionHandler::laserBatchRecommend(::izenelib::driver::Request& request, ::izenelib::driver::Response& response)
+{
+    LaserHandler handler(request, response, *this);
+    handler.batchRecommend();
+}
+
 void CollectionHandler::slimRecommend(::izenelib::driver::Request& request, ::izenelib::driver::Response& response)
 {
     SlimHandler handler(request, response, *this);
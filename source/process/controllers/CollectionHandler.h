@@ -45,6 +45,7 @@ public:
     bool destroy(const ::izenelib::driver::Value& document);
     
     void laserRecommend(::izenelib::driver::Request& request, ::izenelib::driver::Response& response);
+    void laserBatchRecommend(::izenelib::driver::Request& request, ::izenelib::driver::Response& response);
     void slimRecommend(::izenelib::driver::Request& request, ::izenelib::driver::Response& response);
 
     //////////////////////////////////////////
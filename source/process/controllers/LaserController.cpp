@@ -8,4 +8,9 @@ void LaserController::recommend()
     collectionHandler_->laserRecommend(request(), response());
 }
 
+void LaserController::batch_recommend()
+{
+    collectionHandler_->laserBatchRecommend(request(), response());
+}
+
 }
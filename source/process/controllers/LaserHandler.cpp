@@ -48,6 +48,37 @@ void LaserHandler::recommend()
     }
 }
 
+void LaserHandler::batchRecommend()
+{
+    LaserManager* laserManager = miningSearchService_->GetMiningManager()->GetLaserManager();
+    laser::LaserBatchRecommendParam param;
+    if (parseSelect_()  && parseLaserBatchRecommendParam_(param))
+    {
+        std::vector<RawTextResultFromAIA> result;
+        laserManager->recommend(param, actionItem_, result);
+        
+        // one {text, resources} per input text, in the input order
+        DocumentsRenderer renderer(miningSchema_);
+        Value& resources = response_[driver::Keys::resources];
+        resources.reset<Value::ArrayType>();
+        for (std::size_t i = 0; i < result.size(); ++i)
+        {
+            Value& userResult = resources();
+            userResult[driver::Keys::text] = param.texts_[i];
+            if (!result[i].error_.empty())
+            {
+                response_.addWarning(result[i].error_);
+                userResult[driver::Keys::resources].reset<Value::ArrayType>();
+                continue;
+            }
+            renderer.renderDocuments(
+                actionItem_.displayPropertyList_,
+                result[i],
+                userResult[driver::Keys::resources]);
+        }
+    }
+}
+
 bool LaserHandler::parseSelect_()
 {
     using std::swap;
@@ -78,4 +109,21 @@ bool LaserHandler::parseLaserRecommendParam_(laser::LaserRecommendParam& param)
     return true;
 }
 
+bool LaserHandler::parseLaserBatchRecommendParam_(laser::LaserBatchRecommendParam& param)
+{
+    const Value& recommendParam = request_[driver::Keys::recommend];
+    const Value& texts = recommendParam[driver::Keys::text];
+    if (texts.type() != Value::kArrayType)
+    {
+        response_.addError("Require an array of texts in recommend.text");
+        return false;
+    }
+    for (std::size_t i = 0; i < texts.size(); ++i)
+    {
+        param.texts_.push_back(asString(texts(i)));
+    }
+    param.topN_ = asInt(recommendParam[driver::Keys::topn]);
+    return true;
+}
+
 }
@@ -19,10 +19,12 @@ public:
 
 public:
     void recommend();
+    void batchRecommend();
 
 private:
     bool parseSelect_();
     bool parseLaserRecommendParam_(laser::LaserRecommendParam& param);
+    bool parseLaserBatchRecommendParam_(laser::LaserBatchRecommendParam& param);
 private:
     ::izenelib::driver::Request& request_;
     ::izenelib::driver::Response& response_;
@@ -0,0 +1,471 @@
+#include "LaserBench.h"
+
+#include <laser-manager/AdIndexManager.h>
+#include <laser-manager/LaserRecommend.h>
+#include <laser-manager/LaserModelDB.h>
+#include <laser-manager/LaserModelFile.h>
+#include <laser-manager/LaserOnlineModel.h>
+#include <laser-manager/LaserGenericModel.h>
+#include <laser-manager/LSHIndexModel.h>
+#include <laser-manager/HierarchicalModel.h>
+#include <laser-manager/TopnClusteringModel.h>
+#include <laser-manager/EpochManager.h>
+#include <laser-manager/context/ContextStore.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <glog/logging.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+
+namespace sf1r { namespace laser { namespace bench {
+
+// ads indexed at once, like LaserIndexTask
+static const std::size_t INDEX_BATCH_SIZE = 1024;
+// similar clusterings of TopnClusteringModel
+static const std::size_t SIMILAR_CLUSTERING_NUM = 3;
+
+static bool sameTerm(const std::pair<int, float>& lv, const std::pair<int, float>& rv)
+{
+    return lv.first == rv.first;
+}
+
+std::string BenchOptions::dataSignature() const
+{
+    std::stringstream ss;
+    ss << "ads=" << adNum << " users=" << userNum << " clusterings=" << clusteringNum
+        << " AD_FD=" << AD_FD << " USER_FD=" << USER_FD << " adTerms=" << adTermNum
+        << " userClusterings=" << userClusteringNum << " seed=" << seed;
+    return ss.str();
+}
+
+std::string userName(const std::size_t i)
+{
+    std::stringstream ss;
+    ss << "user" << i;
+    return ss.str();
+}
+
+SyntheticData::SyntheticData(const BenchOptions& options)
+    : options_(options)
+    , rand_(options.seed)
+{
+}
+
+bool SyntheticData::generate()
+{
+    const std::string done = options_.workdir + "/synthetic.done";
+    const std::string signature = options_.dataSignature();
+    if (boost::filesystem::exists(done))
+    {
+        std::ifstream ifs(done.c_str());
+        std::string line;
+        std::getline(ifs, line);
+        if (line == signature)
+        {
+            LOG(INFO)<<"reuse synthetic data in "<<options_.workdir;
+            return true;
+        }
+        LOG(ERROR)<<options_.workdir<<" holds data of other options: "<<line;
+        return false;
+    }
+    if (boost::filesystem::exists(options_.workdir) &&
+        !boost::filesystem::is_empty(options_.workdir))
+    {
+        LOG(ERROR)<<options_.workdir<<" is not empty";
+        return false;
+    }
+    boost::filesystem::create_directories(modelDir());
+    boost::filesystem::create_directories(sysDir());
+
+    LOG(INFO)<<"generate synthetic data, "<<signature;
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    if (!generateAdIndex() ||
+        !generateOfflineModel() ||
+        !generateOnlineModel() ||
+        !generateContextStore() ||
+        !generateTopnModel())
+    {
+        return false;
+    }
+    std::ofstream ofs(done.c_str(), std::ofstream::trunc);
+    ofs << signature << std::endl;
+    boost::posix_time::ptime etime = boost::posix_time::microsec_clock::local_time();
+    LOG(INFO)<<"synthetic data generated in "<<(etime - stime).total_milliseconds()<<"ms";
+    return ofs.good();
+}
+
+float SyntheticData::random()
+{
+    return (rand_r(&rand_) % 2000) / 1000.0 - 1.0;
+}
+
+void SyntheticData::randomVector(const std::size_t n, std::vector<float>& vec)
+{
+    vec.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        vec[i] = random();
+    }
+}
+
+bool SyntheticData::generateAdIndex()
+{
+    AdIndexManager index(options_.workdir, options_.clusteringNum);
+    std::vector<AdIndexManager::IndexItem> batch;
+    for (std::size_t docid = 0; docid < options_.adNum; ++docid)
+    {
+        batch.push_back(AdIndexManager::IndexItem());
+        AdIndexManager::IndexItem& item = batch.back();
+        item.docid = docid;
+        item.clusteringId = 0 == options_.clusteringNum ?
+            AdIndexManager::NO_CLUSTERING : docid % options_.clusteringNum;
+        for (std::size_t k = 0; k < options_.adTermNum; ++k)
+        {
+            item.vec.push_back(std::make_pair((int)(rand_r(&rand_) % options_.AD_FD),
+                (float)(rand_r(&rand_) % 1000 + 1) / 1000));
+        }
+        std::sort(item.vec.begin(), item.vec.end());
+        std::vector<std::pair<int, float> >::iterator end = std::unique(item.vec.begin(), item.vec.end(), sameTerm);
+        item.vec.erase(end, item.vec.end());
+        if (batch.size() == INDEX_BATCH_SIZE)
+        {
+            index.index(batch);
+            batch.clear();
+        }
+    }
+    index.index(batch);
+    index.setLastDocId(options_.adNum);
+    index.postIndex();
+    return true;
+}
+
+bool SyntheticData::generateOfflineModel()
+{
+    std::vector<float> alpha;
+    randomVector(options_.USER_FD, alpha);
+    std::vector<float> beta;
+    randomVector(options_.AD_FD, beta);
+    std::vector<float> betaStable;
+    randomVector(options_.adNum, betaStable);
+    std::vector<std::vector<float> > conjunction(options_.USER_FD);
+    for (std::size_t i = 0; i < conjunction.size(); ++i)
+    {
+        randomVector(options_.AD_FD, conjunction[i]);
+    }
+    std::vector<std::vector<float> > conjunctionStable(options_.adNum);
+    for (std::size_t i = 0; i < conjunctionStable.size(); ++i)
+    {
+        randomVector(options_.USER_FD, conjunctionStable[i]);
+    }
+    // section order of LaserOfflineModel::load
+    LaserModelFileWriter writer(modelDir() + "offline-model.bin");
+    writer.addSection(alpha);
+    writer.addSection(beta);
+    writer.addSection(betaStable);
+    writer.addSection(conjunction);
+    writer.addSection(conjunctionStable);
+    if (!writer.commit())
+    {
+        LOG(ERROR)<<"save synthetic offline-model failed";
+        return false;
+    }
+    return true;
+}
+
+bool SyntheticData::generateOnlineModel()
+{
+    std::vector<float> eta;
+    std::vector<LaserOnlineModel> perItem;
+    perItem.reserve(options_.adNum);
+    for (std::size_t i = 0; i < options_.adNum; ++i)
+    {
+        randomVector(options_.USER_FD, eta);
+        perItem.push_back(LaserOnlineModel(random(), eta));
+    }
+    LaserModelFileWriter itemWriter(modelDir() + "per-item-online-model.bin");
+    itemWriter.addSection(perItem);
+
+    std::vector<LaserOnlineModel> perClustering;
+    perClustering.reserve(options_.clusteringNum);
+    for (std::size_t i = 0; i < options_.clusteringNum; ++i)
+    {
+        randomVector(options_.USER_FD, eta);
+        perClustering.push_back(LaserOnlineModel(random(), eta));
+    }
+    LaserModelFileWriter clusteringWriter(modelDir() + "per-clustering-online-model.bin");
+    clusteringWriter.addSection(perClustering);
+    if (!itemWriter.commit() || !clusteringWriter.commit())
+    {
+        LOG(ERROR)<<"save synthetic online model failed";
+        return false;
+    }
+    return true;
+}
+
+bool SyntheticData::generateContextStore()
+{
+    context::ContextStoreBuilder builder(options_.USER_FD);
+    std::vector<float> context;
+    for (std::size_t i = 0; i < options_.userNum; ++i)
+    {
+        randomVector(options_.USER_FD, context);
+        builder.add(userName(i), context);
+    }
+    return builder.save(contextStore());
+}
+
+bool SyntheticData::generateTopnModel()
+{
+    if (0 == options_.clusteringNum)
+    {
+        return true;
+    }
+    // closed before the model opens them
+    LaserModelDB<std::string, LaserOnlineModel> userDb(modelDir() + "per-user-online-model");
+    LaserModelDB<std::string, std::vector<std::pair<int, float> > > clusteringDb(
+        modelDir() + "per-user-topn-clustering");
+    std::vector<float> eta;
+    std::vector<std::pair<int, float> > topn;
+    for (std::size_t i = 0; i < options_.userNum; ++i)
+    {
+        const std::string user = userName(i);
+        // the per-user model scores the ad terms
+        randomVector(options_.AD_FD, eta);
+        if (!userDb.update(user, LaserOnlineModel(random(), eta)))
+        {
+            LOG(ERROR)<<"save synthetic per-user-online-model failed";
+            return false;
+        }
+        topn.clear();
+        for (std::size_t k = 0; k < options_.userClusteringNum; ++k)
+        {
+            topn.push_back(std::make_pair((int)(rand_r(&rand_) % options_.clusteringNum), random()));
+        }
+        if (!clusteringDb.update(user, topn))
+        {
+            LOG(ERROR)<<"save synthetic per-user-topn-clustering failed";
+            return false;
+        }
+    }
+    return true;
+}
+
+BenchResult::BenchResult()
+    : indexLoadMs(0)
+    , modelLoadMs(0)
+    , rssKb(0)
+    , requests(0)
+    , failed(0)
+    , seconds(0)
+    , qps(0)
+    , meanUs(0)
+    , p50Us(0)
+    , p90Us(0)
+    , p99Us(0)
+    , p999Us(0)
+    , maxUs(0)
+{
+}
+
+std::string BenchResult::toJson(const BenchOptions& options) const
+{
+    std::stringstream ss;
+    ss << "{\"model\":\"" << model << "\""
+        << ",\"ads\":" << options.adNum
+        << ",\"users\":" << options.userNum
+        << ",\"clusterings\":" << options.clusteringNum
+        << ",\"AD_FD\":" << options.AD_FD
+        << ",\"USER_FD\":" << options.USER_FD
+        << ",\"threads\":" << options.threadNum
+        << ",\"topn\":" << options.topn
+        << ",\"index_load_ms\":" << indexLoadMs
+        << ",\"model_load_ms\":" << modelLoadMs
+        << ",\"rss_kb\":" << rssKb
+        << ",\"requests\":" << requests
+        << ",\"failed\":" << failed
+        << ",\"seconds\":" << seconds
+        << ",\"qps\":" << qps
+        << ",\"mean_us\":" << meanUs
+        << ",\"p50_us\":" << p50Us
+        << ",\"p90_us\":" << p90Us
+        << ",\"p99_us\":" << p99Us
+        << ",\"p999_us\":" << p999Us
+        << ",\"max_us\":" << maxUs
+        << "}";
+    return ss.str();
+}
+
+LoadGenerator::LoadGenerator(const BenchOptions& options, const SyntheticData& data)
+    : options_(options)
+    , data_(data)
+    , similarClustering_(options.clusteringNum)
+{
+    for (std::size_t i = 0; i < similarClustering_.size(); ++i)
+    {
+        for (std::size_t k = 1; k <= SIMILAR_CLUSTERING_NUM && k < similarClustering_.size(); ++k)
+        {
+            similarClustering_[i].push_back((i + k) % similarClustering_.size());
+        }
+    }
+}
+
+LaserModel* LoadGenerator::createModel(const std::string& modelType, const AdIndexManager& index) const
+{
+    // as LaserModelFactory, the user context comes from the store file
+    const docid_t adDimension = index.getLastDocId();
+    const std::string kvaddr = data_.contextStore();
+    const std::string mqaddr = "127.0.0.1";
+    if ("LaserGenericModel" == modelType)
+    {
+        return new LaserGenericModel(index, kvaddr, 0, mqaddr, 0,
+            data_.modelDir(), data_.sysDir(), adDimension, options_.AD_FD, options_.USER_FD);
+    }
+    else if ("TopnClusteringModel" == modelType)
+    {
+        return new TopnClusteringModel(index, similarClustering_, data_.modelDir(), data_.sysDir());
+    }
+    else if ("HierarchicalModel" == modelType)
+    {
+        return new HierarchicalModel(index, kvaddr, 0, mqaddr, 0,
+            data_.modelDir(), data_.sysDir(), adDimension, similarClustering_.size(),
+            options_.AD_FD, options_.USER_FD);
+    }
+    else if ("LSHIndexModel" == modelType)
+    {
+        return new LSHIndexModel(index, kvaddr, 0, mqaddr, 0,
+            data_.modelDir(), data_.sysDir(), adDimension, options_.AD_FD, options_.USER_FD);
+    }
+    LOG(ERROR)<<"No Laser model for type = "<<modelType;
+    return NULL;
+}
+
+bool LoadGenerator::run(const std::string& modelType, BenchResult& result)
+{
+    result = BenchResult();
+    result.model = modelType;
+    if (0 == options_.clusteringNum &&
+        ("TopnClusteringModel" == modelType || "HierarchicalModel" == modelType))
+    {
+        LOG(ERROR)<<modelType<<" needs clusterings";
+        return false;
+    }
+
+    const long rss = residentKb();
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    AdIndexManager* index = new AdIndexManager(options_.workdir, options_.clusteringNum);
+    boost::posix_time::ptime etime = boost::posix_time::microsec_clock::local_time();
+    result.indexLoadMs = (etime - stime).total_microseconds() / 1000.0;
+
+    stime = etime;
+    LaserModel* model = createModel(modelType, *index);
+    etime = boost::posix_time::microsec_clock::local_time();
+    result.modelLoadMs = (etime - stime).total_microseconds() / 1000.0;
+    if (NULL == model)
+    {
+        delete index;
+        return false;
+    }
+    result.rssKb = residentKb() - rss;
+
+    {
+        LaserRecommend recommend(model);
+        std::vector<uint32_t> warmup;
+        std::size_t failed = 0;
+        request(recommend, 0, options_.warmupNum, warmup, failed);
+
+        const std::size_t threadNum = std::max(options_.threadNum, (std::size_t)1);
+        std::vector<std::vector<uint32_t> > latency(threadNum);
+        std::vector<std::size_t> threadFailed(threadNum, 0);
+        boost::thread_group threads;
+        stime = boost::posix_time::microsec_clock::local_time();
+        for (std::size_t i = 0; i < threadNum; ++i)
+        {
+            const std::size_t requestNum = options_.requestNum / threadNum +
+                (i < options_.requestNum % threadNum ? 1 : 0);
+            threads.create_thread(boost::bind(&LoadGenerator::request, this,
+                boost::cref(recommend), i + 1, requestNum,
+                boost::ref(latency[i]), boost::ref(threadFailed[i])));
+        }
+        threads.join_all();
+        etime = boost::posix_time::microsec_clock::local_time();
+        result.seconds = (etime - stime).total_microseconds() / 1000000.0;
+
+        std::vector<uint32_t> all;
+        for (std::size_t i = 0; i < threadNum; ++i)
+        {
+            all.insert(all.end(), latency[i].begin(), latency[i].end());
+            result.failed += threadFailed[i];
+        }
+        result.requests = all.size();
+        if (!all.empty())
+        {
+            std::sort(all.begin(), all.end());
+            double sum = 0;
+            for (std::size_t i = 0; i < all.size(); ++i)
+            {
+                sum += all[i];
+            }
+            result.meanUs = sum / all.size();
+            result.p50Us = all[all.size() * 50 / 100];
+            result.p90Us = all[all.size() * 90 / 100];
+            result.p99Us = all[all.size() * 99 / 100];
+            result.p999Us = all[all.size() * 999 / 1000];
+            result.maxUs = all.back();
+        }
+        if (result.seconds > 0)
+        {
+            result.qps = result.requests / result.seconds;
+        }
+    }
+    // the recommend retired the model, nothing reads it any more
+    EpochManager::get()->reclaim();
+    delete index;
+    return true;
+}
+
+void LoadGenerator::request(const LaserRecommend& recommend,
+    const std::size_t threadId,
+    const std::size_t requestNum,
+    std::vector<uint32_t>& latency,
+    std::size_t& failed) const
+{
+    unsigned int seed = options_.seed + threadId;
+    latency.reserve(requestNum);
+    std::vector<docid_t> items;
+    std::vector<float> scores;
+    for (std::size_t i = 0; i < requestNum; ++i)
+    {
+        const std::string user = userName(rand_r(&seed) % std::max(options_.userNum, (std::size_t)1));
+        items.clear();
+        scores.clear();
+        boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+        const bool ret = recommend.recommend(user, items, scores, options_.topn);
+        boost::posix_time::ptime etime = boost::posix_time::microsec_clock::local_time();
+        latency.push_back((etime - stime).total_microseconds());
+        if (!ret || items.empty())
+        {
+            ++failed;
+        }
+    }
+}
+
+long residentKb()
+{
+    std::ifstream ifs("/proc/self/status");
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        if (0 == line.compare(0, 6, "VmRSS:"))
+        {
+            return atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+} } }
@@ -0,0 +1,164 @@
+#ifndef SF1R_LASER_BENCH_H
+#define SF1R_LASER_BENCH_H
+#include <string>
+#include <vector>
+#include <common/inttypes.h>
+
+namespace sf1r { namespace laser {
+class AdIndexManager;
+class LaserModel;
+class LaserRecommend;
+} }
+
+namespace sf1r { namespace laser { namespace bench {
+
+struct BenchOptions
+{
+    // everything generated goes here, see SyntheticData
+    std::string workdir;
+    std::size_t adNum;
+    std::size_t userNum;
+    std::size_t clusteringNum;
+    std::size_t AD_FD;
+    std::size_t USER_FD;
+    // nonzero terms per ad
+    std::size_t adTermNum;
+    // clusterings per user of TopnClusteringModel
+    std::size_t userClusteringNum;
+    std::size_t threadNum;
+    // per model, warm up requests are not measured
+    std::size_t requestNum;
+    std::size_t warmupNum;
+    std::size_t topn;
+    unsigned int seed;
+
+    BenchOptions()
+        : adNum(50000)
+        , userNum(20000)
+        , clusteringNum(500)
+        , AD_FD(2000)
+        , USER_FD(100)
+        , adTermNum(16)
+        , userClusteringNum(5)
+        , threadNum(8)
+        , requestNum(2000)
+        , warmupNum(100)
+        , topn(20)
+        , seed(17)
+    {
+    }
+
+    // the options that shape the generated data
+    std::string dataSignature() const;
+};
+
+std::string userName(const std::size_t i);
+
+/*
+ * Random models, ad index and user contexts in the layout the laser models
+ * load from:
+ *
+ *   workdir/index/                AdIndexManager, clustering i % clusteringNum
+ *   workdir/model/                offline and per-item online model, per-clustering
+ *                                 online model, per-user models of TopnClusteringModel
+ *   workdir/sys/                  the (empty) original model databases
+ *   workdir/user-context.store    dense USER_FD contexts of every user
+ *
+ * The data is generated once, later runs with the same options reuse it.
+ */
+class SyntheticData
+{
+public:
+    SyntheticData(const BenchOptions& options);
+
+public:
+    bool generate();
+
+    std::string modelDir() const
+    {
+        return options_.workdir + "/model/";
+    }
+
+    std::string sysDir() const
+    {
+        return options_.workdir + "/sys/";
+    }
+
+    std::string contextStore() const
+    {
+        return options_.workdir + "/user-context.store";
+    }
+
+private:
+    bool generateAdIndex();
+    bool generateOfflineModel();
+    bool generateOnlineModel();
+    bool generateContextStore();
+    bool generateTopnModel();
+
+    // uniform in [-1, 1)
+    float random();
+    void randomVector(const std::size_t n, std::vector<float>& vec);
+
+private:
+    const BenchOptions& options_;
+    unsigned int rand_;
+};
+
+struct BenchResult
+{
+    std::string model;
+    double indexLoadMs;
+    double modelLoadMs;
+    // resident memory taken by the ad index and the model
+    long rssKb;
+    std::size_t requests;
+    std::size_t failed;
+    double seconds;
+    double qps;
+    double meanUs;
+    double p50Us;
+    double p90Us;
+    double p99Us;
+    double p999Us;
+    double maxUs;
+
+    BenchResult();
+
+    // one line of json
+    std::string toJson(const BenchOptions& options) const;
+};
+
+/*
+ * Loads one model type from the synthetic data like LaserModelFactory,
+ * then drives LaserRecommend::recommend from threadNum threads, each
+ * request for a random user.
+ */
+class LoadGenerator
+{
+public:
+    LoadGenerator(const BenchOptions& options, const SyntheticData& data);
+
+public:
+    bool run(const std::string& modelType, BenchResult& result);
+
+private:
+    LaserModel* createModel(const std::string& modelType, const AdIndexManager& index) const;
+    void request(const LaserRecommend& recommend,
+        const std::size_t threadId,
+        const std::size_t requestNum,
+        std::vector<uint32_t>& latency,
+        std::size_t& failed) const;
+
+private:
+    const BenchOptions& options_;
+    const SyntheticData& data_;
+    // TopnClusteringModel keeps a reference
+    std::vector<std::vector<int> > similarClustering_;
+};
+
+// VmRSS of this process
+long residentKb();
+
+} } }
+#endif
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+#include "LaserBench.h"
+#include <glog/logging.h>
+
+using namespace sf1r::laser::bench;
+
+void printHelp()
+{
+    std::cout << "./laserBench -d workdir [options]\n"
+        << "\t-d\tworkdir of the synthetic data, generated on the first run\n"
+        << "\t-m\tmodels, comma separated, default LaserGenericModel,LSHIndexModel,HierarchicalModel,TopnClusteringModel\n"
+        << "\t-a\tad number\n"
+        << "\t-u\tuser number\n"
+        << "\t-c\tclustering number\n"
+        << "\t-A\tad feature dimension\n"
+        << "\t-U\tuser feature dimension\n"
+        << "\t-k\tterms per ad\n"
+        << "\t-t\tthread number\n"
+        << "\t-n\trequests per model\n"
+        << "\t-w\twarm up requests per model\n"
+        << "\t-N\ttop n of each request\n"
+        << "\t-s\trandom seed\n"
+        << "\t-v\tkeep the INFO log of every request\n"
+        << "One line of json per model goes to stdout.\n";
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    std::string models = "LaserGenericModel,LSHIndexModel,HierarchicalModel,TopnClusteringModel";
+    bool verbose = false;
+    int c = '?';
+    while ((c = getopt(argc, argv, "d:m:a:u:c:A:U:k:t:n:w:N:s:vh")) != -1)
+    {
+        switch (c)
+        {
+        case 'd':
+            options.workdir = optarg;
+            break;
+        case 'm':
+            models = optarg;
+            break;
+        case 'a':
+            options.adNum = atol(optarg);
+            break;
+        case 'u':
+            options.userNum = atol(optarg);
+            break;
+        case 'c':
+            options.clusteringNum = atol(optarg);
+            break;
+        case 'A':
+            options.AD_FD = atol(optarg);
+            break;
+        case 'U':
+            options.USER_FD = atol(optarg);
+            break;
+        case 'k':
+            options.adTermNum = atol(optarg);
+            break;
+        case 't':
+            options.threadNum = atol(optarg);
+            break;
+        case 'n':
+            options.requestNum = atol(optarg);
+            break;
+        case 'w':
+            options.warmupNum = atol(optarg);
+            break;
+        case 'N':
+            options.topn = atol(optarg);
+            break;
+        case 's':
+            options.seed = atol(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            printHelp();
+            return 1;
+        }
+    }
+    if (options.workdir.empty() || 0 == options.AD_FD || 0 == options.USER_FD || 0 == options.userNum)
+    {
+        printHelp();
+        return 1;
+    }
+
+    SyntheticData data(options);
+    if (!data.generate())
+    {
+        std::cerr << "generate synthetic data in " << options.workdir << " failed" << std::endl;
+        return 1;
+    }
+
+    // recommend logs every request at INFO
+    if (!verbose)
+    {
+        FLAGS_minloglevel = google::WARNING;
+    }
+    LoadGenerator generator(options, data);
+    int ret = 0;
+    std::stringstream ss(models);
+    std::string model;
+    while (std::getline(ss, model, ','))
+    {
+        BenchResult result;
+        if (!generator.run(model, result))
+        {
+            std::cerr << "benchmark " << model << " failed" << std::endl;
+            ret = 1;
+            continue;
+        }
+        std::cout << result.toJson(options) << std::endl;
+    }
+    return ret;
+}
@@ -0,0 +1,73 @@
+#ifndef CSC_MATRIX_H_
+#define CSC_MATRIX_H_
+
+#include <vector>
+
+#include "csr_matrix.h"
+
+namespace slim { namespace model {
+
+// column-major copy of a csr_matrix, _indices are the rows of each column
+class csc_matrix {
+public:
+    csc_matrix(const csr_matrix & X) {
+        _M = X._M;
+        _N = X._N;
+
+        _size = X._size;
+
+        _indptr.assign(_N + 1, 0);
+        _indices.resize(_size);
+        _data.resize(_size);
+
+        csr_tocsc(X);
+    }
+
+    void csr_tocsc(const csr_matrix & X) {
+        // compute number of non-zero entries per column of X
+        for (int i = 0; i != _size; ++i) {
+            _indptr[X._indices[i] + 1] += 1;
+        }
+
+        // cumsum the nnz per column to get indptr
+        for (int i = 0; i != _N; ++i) {
+            _indptr[i + 1] += _indptr[i];
+        }
+
+        // rows are visited in order, so every column stays sorted by row
+        std::vector<int> next(_indptr.begin(), _indptr.end() - 1);
+        for (int row = 0; row != _M; ++row) {
+            for (int j = X._indptr[row]; j != X._indptr[row + 1]; ++j) {
+                int dest = next[X._indices[j]]++;
+
+                _indices[dest] = row;
+                _data[dest] = X._data[j];
+            }
+        }
+    }
+
+    int m() {
+        return _M;
+    }
+
+    int n() {
+        return _N;
+    }
+
+    int size() {
+        return _size;
+    }
+
+    std::vector<double> _data;
+    std::vector<int> _indices;
+    std::vector<int> _indptr;
+
+    int _M;
+    int _N;
+
+    int _size;
+};
+
+}}
+
+#endif
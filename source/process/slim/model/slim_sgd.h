@@ -7,6 +7,7 @@
 #include <algorithm>
 
 #include "csr_matrix.h"
+#include "csc_matrix.h"
 #include "weight_vector.h"
 
 namespace slim { namespace model {
@@ -34,6 +35,39 @@ public:
     }
 
     void fit(csr_matrix & X, int column, weight_vector & w, double & intercept) {
+        std::vector<double> q(X.n(), 0.0);
+        std::vector<double> y(X.m(), 0.0);
+        get_y(X, y, column);
+
+        _fit(X, column, w, intercept, y, q);
+    }
+
+    // y and q are the caller's buffers, reused across columns: y must be
+    // zero and of size X.m(), it is zero again on return, q is resized
+    // to X.n() and zeroed here.
+    void fit(csr_matrix & X,
+             csc_matrix & XT,
+             int column,
+             weight_vector & w,
+             double & intercept,
+             std::vector<double> & y,
+             std::vector<double> & q) {
+        q.assign(X.n(), 0.0);
+        get_y(XT, y, column);
+
+        _fit(X, column, w, intercept, y, q);
+
+        for (int i = XT._indptr[column]; i != XT._indptr[column + 1]; ++i) {
+            y[XT._indices[i]] = 0.0;
+        }
+    }
+
+    void _fit(csr_matrix & X,
+              int column,
+              weight_vector & w,
+              double & intercept,
+              const std::vector<double> & y,
+              std::vector<double> & q) {
         w.clear(X.n());
         intercept = 0.0;
 
@@ -43,20 +77,22 @@ public:
         double p;
         double update;
 
-        std::vector<double> q(X.n(), 0.0);
-        std::vector<double> y(X.m(), 0.0);
-        get_y(X, y, column);
+        const bool l2 = _penalty_type == "l2" || _penalty_type == "elasticnet";
+        const bool l1 = _penalty_type == "l1" || _penalty_type == "elasticnet";
+        // pow() dominates a step on short rows, the default power_t is 0.25
+        const bool quarter = _power_t == 0.25;
 
-        // scanning 1M instances before convergence
-        _n_iter = 1000000 / X.m() + 1;
-        for (int i = 0; i != _n_iter; ++i) {
+        // scanning 1M instances before convergence, the model is shared
+        // by the training threads, so the count is not stored in it
+        const int n_iter = 1000000 / X.m() + 1;
+        for (int i = 0; i != n_iter; ++i) {
             for (int j = 0; j != X.m(); ++j) {
-                eta = _eta0 / pow(t, _power_t);
+                eta = quarter ? _eta0 / std::sqrt(std::sqrt(t)) : _eta0 / pow(t, _power_t);
 
                 p = w.dot(X, j) + intercept;
                 update = -eta * dloss(p, y[j]);
 
-                if (_penalty_type == "l2" || _penalty_type == "elasticnet") {
+                if (l2) {
                     w.scale(1.0 - ((1.0 - _l1_ratio) * eta * _alpha));
                 }
 
@@ -69,7 +105,7 @@ public:
                     }
                 }
 
-                if (_penalty_type == "l1" || _penalty_type == "elasticnet") {
+                if (l1) {
                     u += (_l1_ratio * eta * _alpha);
                     l1penalty(w, q, X, j, u);
                 }
@@ -92,6 +128,12 @@ public:
         }
     }
 
+    void get_y(csc_matrix & XT, std::vector<double> & y, int column) {
+        for (int i = XT._indptr[column]; i != XT._indptr[column + 1]; ++i) {
+            y[XT._indices[i]] = XT._data[i];
+        }
+    }
+
     double loss(double p, double y) {
         return 0.5 * (p - y) * (p - y);
     }
@@ -120,7 +162,6 @@ public:
     bool _fit_intercept;
     double _alpha;
     double _l1_ratio;
-    int _n_iter;
     double _eta0;
     double _power_t;
 };
@@ -3,12 +3,17 @@
 
 #include "slim_sgd.h"
 #include "csr_matrix.h"
+#include "csc_matrix.h"
 #include "weight_vector.h"
 
 #include <vector>
 #include <queue>
+#include <algorithm>
+#include <iostream>
 
 #include <boost/thread/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace slim { namespace model {
 
@@ -20,32 +25,46 @@ public:
     }
 };
 
+// columns of one thread, merged into the shared result after join
+typedef std::vector<std::pair<int, std::vector<int> > > slim_thread_result;
+
 class slim_thread {
 public:
-    slim_thread(int start_column,
-                int end_column,
+    slim_thread(boost::atomic<int> & next_column,
                 slim_sgd & model,
                 csr_matrix & X,
+                csc_matrix & XT,
                 int top_n,
-                std::vector<std::vector<int> > & similar_cluster,
-                boost::mutex & similar_cluster_mutex)
-        : start_column(start_column),
-          end_column(end_column),
+                slim_thread_result & result)
+        : next_column(next_column),
           model(model),
           X(X),
+          XT(XT),
           top_n(top_n),
-          _similar_cluster(similar_cluster),
-          _similar_cluster_mutex(similar_cluster_mutex)
+          _result(result)
     {
     }
 
+    // columns differ a lot in cost, so threads take small chunks until
+    // none is left instead of a fixed share each
     void operator()()
     {
-        for (int i = start_column; i != end_column; ++i) {
-            model.fit(X, i, w, intercept);
-            _find_top_n(w._w, i);
+        std::vector<double> y(X.m(), 0.0);
+        std::vector<double> q;
+        int columns = 0;
+        for (;;) {
+            int start_column = next_column.fetch_add(COLUMN_CHUNK);
+            if (start_column >= X.n()) {
+                break;
+            }
+            int end_column = std::min(start_column + COLUMN_CHUNK, X.n());
+            for (int i = start_column; i != end_column; ++i) {
+                model.fit(X, XT, i, w, intercept, y, q);
+                _find_top_n(w._w, i);
+            }
+            columns += end_column - start_column;
         }
-        std::cout << start_column << "->" << end_column << " finished!" << std::endl;
+        std::cout << columns << " columns finished!" << std::endl;
     }
 
     void _find_top_n(std::vector<double> & v, int col)
@@ -64,29 +83,28 @@ public:
             }
         }
 
-        _similar_cluster_mutex.lock();
-
+        _result.push_back(std::make_pair(col, std::vector<int>()));
+        std::vector<int> & top = _result.back().second;
         int top_size = pq.size();
-        _similar_cluster[col].resize(top_size);
+        top.resize(top_size);
         while (!pq.empty()) {
-            _similar_cluster[col][--top_size] = pq.top().second;
+            top[--top_size] = pq.top().second;
             pq.pop();
         }
-
-        _similar_cluster_mutex.unlock();
     }
 
-    int start_column;
-    int end_column;
+    static const int COLUMN_CHUNK = 16;
+
+    boost::atomic<int> & next_column;
     slim_sgd & model;
     csr_matrix & X;
+    csc_matrix & XT;
     int top_n;
 
     weight_vector w;
     double intercept;
 
-    std::vector<std::vector<int> > & _similar_cluster;
-    boost::mutex & _similar_cluster_mutex;
+    slim_thread_result & _result;
 };
 
 class slim_thread_manager {
@@ -101,48 +119,41 @@ public:
           model(model),
           X(X),
           top_n(top_n),
+          next_column(0),
           _similar_cluster(similar_cluster),
           _similar_cluster_mutex(similar_cluster_mutex)
     {
     }
 
     void start() {
-        if (X.n() < thread_num) {
-            threads.create_thread(slim_thread(0,
-                                              X.n(),
-                                              model,
-                                              X,
-                                              top_n,
-                                              _similar_cluster,
-                                              _similar_cluster_mutex));
-        } else {
-            int average_task_num = X.n() / thread_num;
-            int extra_num = X.n() % thread_num;
-
-            int start = 0;
-            threads.create_thread(slim_thread(start,
-                                              start + average_task_num + extra_num,
+        // the target column of every fit is read from the column-major copy
+        XT.reset(new csc_matrix(X));
+        next_column.store(0);
+
+        int n = std::max(1, std::min(thread_num, X.n()));
+        results.clear();
+        results.resize(n);
+        for (int i = 0; i != n; ++i) {
+            threads.create_thread(slim_thread(next_column,
                                               model,
                                               X,
+                                              *XT,
                                               top_n,
-                                              _similar_cluster,
-                                              _similar_cluster_mutex));
-            start += average_task_num + extra_num;
-            while (start != X.n()) {
-                threads.create_thread(slim_thread(start,
-                                                  start + average_task_num,
-                                                  model,
-                                                  X,
-                                                  top_n,
-                                                  _similar_cluster,
-                                                  _similar_cluster_mutex));
-                start += average_task_num;
-            }
+                                              results[i]));
         }
     }
 
     void join() {
         threads.join_all();
+
+        boost::mutex::scoped_lock lock(_similar_cluster_mutex);
+        for (int i = 0; i != (int)results.size(); ++i) {
+            for (int j = 0; j != (int)results[i].size(); ++j) {
+                _similar_cluster[results[i][j].first].swap(results[i][j].second);
+            }
+        }
+        results.clear();
+        XT.reset();
     }
 
     int thread_num;
@@ -150,6 +161,9 @@ public:
     csr_matrix & X;
     int top_n;
 
+    boost::scoped_ptr<csc_matrix> XT;
+    boost::atomic<int> next_column;
+    std::vector<slim_thread_result> results;
     boost::thread_group threads;
 
     std::vector<std::vector<int> > & _similar_cluster;
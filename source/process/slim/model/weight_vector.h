@@ -20,21 +20,45 @@ public:
         _w.resize(size, 0.0);
     }
 
+    // the row's values are scaled once, the index gathers of four
+    // entries are independent so they overlap instead of serializing
     void add(csr_matrix & X, int row, double c) {
-        for (int i = X._indptr[row]; i != X._indptr[row + 1]; ++i) {
-            int idx = X._indices[i];
-            double val = X._data[i];
-            _w[idx] += val * (c / _w_scale);
+        const int * idx = &X._indices[0];
+        const double * val = &X._data[0];
+        double * w = &_w[0];
+        const double s = c / _w_scale;
+
+        int i = X._indptr[row];
+        const int end = X._indptr[row + 1];
+        for (; i + 4 <= end; i += 4) {
+            w[idx[i]] += val[i] * s;
+            w[idx[i + 1]] += val[i + 1] * s;
+            w[idx[i + 2]] += val[i + 2] * s;
+            w[idx[i + 3]] += val[i + 3] * s;
+        }
+        for (; i != end; ++i) {
+            w[idx[i]] += val[i] * s;
         }
     }
 
     double dot(csr_matrix & X, int row) {
-        double innerprod = 0.0;
-        for (int i = X._indptr[row]; i != X._indptr[row + 1]; ++i) {
-            int idx = X._indices[i];
-            double val = X._data[i];
-            innerprod += _w[idx] * val;
+        const int * idx = &X._indices[0];
+        const double * val = &X._data[0];
+        const double * w = &_w[0];
+
+        double p0 = 0.0, p1 = 0.0, p2 = 0.0, p3 = 0.0;
+        int i = X._indptr[row];
+        const int end = X._indptr[row + 1];
+        for (; i + 4 <= end; i += 4) {
+            p0 += w[idx[i]] * val[i];
+            p1 += w[idx[i + 1]] * val[i + 1];
+            p2 += w[idx[i + 2]] * val[i + 2];
+            p3 += w[idx[i + 3]] * val[i + 3];
+        }
+        for (; i != end; ++i) {
+            p0 += w[idx[i]] * val[i];
         }
+        double innerprod = (p0 + p1) + (p2 + p3);
         innerprod *= _w_scale;
         return innerprod;
     }
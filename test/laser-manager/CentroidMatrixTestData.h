@@ -0,0 +1,80 @@
+/**
+ * @file CentroidMatrixTestData.h
+ * @brief the centroids and documents to test and benchmark CentroidMatrix.
+ */
+
+#ifndef SF1R_CENTROID_MATRIX_TEST_DATA_H
+#define SF1R_CENTROID_MATRIX_TEST_DATA_H
+
+#include <laser-manager/CentroidMatrix.h>
+#include <cstdlib>
+#include <vector>
+
+namespace sf1r { namespace laser { namespace test {
+
+typedef CentroidMatrix::TokenSparseVector TokenSparseVector;
+typedef CentroidMatrix::TokenVector TokenVector;
+
+const std::size_t DIM = 20000;
+const std::size_t CENTROID_NUM = 1000;
+const std::size_t CENTROID_TERM_NUM = 400;
+const std::size_t DOC_TERM_NUM = 12;
+
+/*
+ * Centroids draw their terms from a topic of related terms, like the
+ * clustering result of titles, documents mostly from one centroid.
+ */
+inline void makeCentroids(std::vector<TokenVector>& centroids)
+{
+    srand(7);
+    centroids.assign(CENTROID_NUM, TokenVector(DIM, 0));
+    for (std::size_t i = 0; i < CENTROID_NUM; ++i)
+    {
+        const std::size_t topic = (i % 50) * (DIM / 50);
+        for (std::size_t k = 0; k < CENTROID_TERM_NUM; ++k)
+        {
+            const std::size_t t = k % 2 ? rand() % DIM : topic + rand() % (DIM / 50);
+            centroids[i][t] = (rand() % 1000) / 1000.0;
+        }
+    }
+}
+
+inline void makeDoc(const std::vector<TokenVector>& centroids, TokenSparseVector& doc)
+{
+    doc.clear();
+    const TokenVector& from = centroids[rand() % centroids.size()];
+    for (std::size_t k = 0; k < DOC_TERM_NUM; ++k)
+    {
+        std::size_t t = rand() % DIM;
+        for (std::size_t retry = 0; retry < 64 && 0 == from[t] && k % 4; ++retry)
+        {
+            t = rand() % DIM;
+        }
+        doc.push_back(std::make_pair(t, 1.0 + (rand() % 100) / 100.0));
+    }
+}
+
+// LaserManager::assignClustering_ before the centroid matrix
+inline std::size_t scalarAssign(const std::vector<TokenVector>& centroids, const TokenSparseVector& v)
+{
+    float maxSim = 0.0;
+    std::size_t maxId = -1;
+    for (std::size_t i = 0; i < centroids.size(); ++i)
+    {
+        float sim = 0.0;
+        for (TokenSparseVector::const_iterator it = v.begin(); it != v.end(); ++it)
+        {
+            sim += centroids[i][it->first] * it->second;
+        }
+        if (sim > maxSim)
+        {
+            maxSim = sim;
+            maxId = i;
+        }
+    }
+    return maxId;
+}
+
+} } }
+
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @file ContextStoreTestData.h
+ * @brief the user contexts and the model over them to test and benchmark ContextStore.
+ */
+
+#ifndef SF1R_LASER_CONTEXT_STORE_TEST_DATA_H
+#define SF1R_LASER_CONTEXT_STORE_TEST_DATA_H
+
+#include <laser-manager/context/ContextStore.h>
+#include <laser-manager/LaserModel.h>
+#include <cstdlib>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sf1r { namespace laser { namespace context { namespace test {
+
+const std::string STORE = "./t_ContextStore.store";
+const std::size_t DIM = 128;
+const std::size_t USER_NUM = 50000;
+const std::size_t AD_NUM = 5000;
+const std::size_t TOPN = 20;
+
+inline std::string user(std::size_t i)
+{
+    std::stringstream ss;
+    ss << "user" << i;
+    return ss.str();
+}
+
+// about one in four users has a sparse context
+inline std::vector<float> makeContext(std::size_t seed)
+{
+    std::vector<float> context(DIM, 0.0);
+    const bool sparse = 0 == seed % 4;
+    for (std::size_t k = 0; k < DIM; ++k)
+    {
+        if (sparse && 0 != (seed + k) % 16)
+            continue;
+        context[k] = ((seed * 31 + k * 17) % 2000) / 1000.0 - 1.0;
+    }
+    return context;
+}
+
+// zipf-like, most requests come from a small set of active users
+inline std::size_t skewed(unsigned int& seed)
+{
+    const double r = (double)rand_r(&seed) / RAND_MAX;
+    return (std::size_t)(USER_NUM * std::pow(r, 3)) % USER_NUM;
+}
+
+inline bool buildStore(std::size_t userNum, bool compact)
+{
+    ContextStoreBuilder builder(DIM, compact);
+    for (std::size_t i = 0; i < userNum; ++i)
+    {
+        if (!builder.add(user(i), makeContext(i)))
+            return false;
+    }
+    return builder.save(STORE);
+}
+
+/*
+ * Linear model over dense user contexts read from the store, every user
+ * gets all the ads as candidates like LaserGenericModel.
+ */
+class StoreModel : public LaserModel
+{
+public:
+    StoreModel(const ContextStore& store)
+        : store_(store)
+        , weights_(AD_NUM, std::vector<float>(DIM))
+    {
+        srand(17);
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            for (std::size_t k = 0; k < DIM; ++k)
+            {
+                weights_[i][k] = (rand() % 2000) / 1000.0 - 1.0;
+            }
+        }
+    }
+
+public:
+    virtual bool candidate(
+        const std::string& text,
+        const std::size_t ncandidate,
+        const std::vector<std::pair<int, float> >& context,
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        std::vector<float>& score) const
+    {
+        return false;
+    }
+
+    virtual bool candidate(
+        const std::string& text,
+        const std::size_t ncandidate,
+        const std::vector<float>& context,
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        std::vector<float>& score) const
+    {
+        ad.resize(AD_NUM);
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            ad[i].first = i;
+        }
+        score.assign(ad.size(), 0);
+        return true;
+    }
+
+    virtual float score(
+        const std::string& text,
+        const std::vector<std::pair<int, float> >& context,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const
+    {
+        return 0;
+    }
+
+    virtual float score(
+        const std::string& text,
+        const std::vector<float>& context,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const
+    {
+        return score + dot(weights_[ad.first], context);
+    }
+
+    virtual void score(
+        const std::vector<std::string>& text,
+        const std::vector<std::vector<float> >& context,
+        const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        const std::vector<std::size_t>& offset,
+        const std::vector<std::size_t>& user,
+        std::vector<float>& score) const
+    {
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            for (std::size_t k = offset[i]; k < offset[i + 1]; ++k)
+            {
+                score[k] += dot(weights_[ad[i].first], context[user[k]]);
+            }
+        }
+    }
+
+    virtual bool context(const std::string& text, std::vector<std::pair<int, float> >& context) const
+    {
+        return store_.context(text, context);
+    }
+
+    virtual bool context(const std::string& text, std::vector<float>& context) const
+    {
+        return store_.context(text, context);
+    }
+
+    virtual void dispatch(const std::string& method, msgpack::rpc::request& req)
+    {
+    }
+
+private:
+    const ContextStore& store_;
+    std::vector<std::vector<float> > weights_;
+};
+
+} } } }
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * @file LaserModelCacheTestData.h
+ * @brief the user models and ads to test and benchmark LaserModelCache.
+ */
+
+#ifndef SF1R_LASER_MODEL_CACHE_TEST_DATA_H
+#define SF1R_LASER_MODEL_CACHE_TEST_DATA_H
+
+#include <laser-manager/LaserModelCache.h>
+#include <laser-manager/LaserOnlineModel.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sf1r { namespace laser { namespace test {
+
+typedef LaserModelDB<std::string, LaserOnlineModel> UserDB;
+typedef LaserModelCache<std::string, LaserOnlineModel> UserCache;
+
+const std::size_t USER_NUM = 200;
+const std::size_t AD_DIM = 256;
+const std::size_t AD_NUM = 1000;
+// requests come from the hot users
+const std::size_t HOT_USER_NUM = 50;
+
+inline std::string user(std::size_t i)
+{
+    std::stringstream ss;
+    ss << "user" << i;
+    return ss.str();
+}
+
+inline LaserOnlineModel makeModel(std::size_t seed)
+{
+    srand(seed);
+    std::vector<float> eta(AD_DIM);
+    for (std::size_t k = 0; k < AD_DIM; ++k)
+    {
+        eta[k] = (rand() % 2000) / 1000.0 - 1.0;
+    }
+    return LaserOnlineModel(seed / 100.0, eta);
+}
+
+class DBFixture
+{
+public:
+    DBFixture()
+        : path_("./t_LaserModelCache.db")
+    {
+        boost::filesystem::remove_all(path_);
+        db_ = new UserDB(path_);
+        for (std::size_t i = 0; i < USER_NUM; ++i)
+        {
+            db_->update(user(i), makeModel(i));
+        }
+    }
+
+    ~DBFixture()
+    {
+        delete db_;
+        boost::filesystem::remove_all(path_);
+    }
+
+protected:
+    const std::string path_;
+    UserDB* db_;
+};
+
+// user ids drawn from a zipf(1) distribution over all the users
+class ZipfUsers
+{
+public:
+    ZipfUsers(std::size_t n)
+        : cdf_(n)
+    {
+        double sum = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            sum += 1.0 / (i + 1);
+            cdf_[i] = sum;
+        }
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            cdf_[i] /= sum;
+        }
+    }
+
+    std::size_t next() const
+    {
+        const double r = (double)rand() / RAND_MAX;
+        return std::min<std::size_t>(std::lower_bound(cdf_.begin(), cdf_.end(), r) - cdf_.begin(), cdf_.size() - 1);
+    }
+
+private:
+    std::vector<double> cdf_;
+};
+
+inline void makeAds(std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad)
+{
+    srand(11);
+    ad.resize(AD_NUM);
+    for (std::size_t i = 0; i < AD_NUM; ++i)
+    {
+        ad[i].first = i;
+        for (std::size_t k = 0; k < 16; ++k)
+        {
+            ad[i].second.push_back(std::make_pair(rand() % AD_DIM, 1.0));
+        }
+    }
+}
+
+} } }
+
+#endif
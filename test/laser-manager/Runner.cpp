@@ -0,0 +1,2 @@
+#define BOOST_TEST_MODULE Laser Manager
+#include <TestRunner.inl>
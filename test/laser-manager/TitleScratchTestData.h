@@ -0,0 +1,53 @@
+/**
+ * @file TitleScratchTestData.h
+ * @brief the titles and ads to test and benchmark TitleScratch.
+ */
+
+#ifndef SF1R_TITLE_SCRATCH_TEST_DATA_H
+#define SF1R_TITLE_SCRATCH_TEST_DATA_H
+
+#include <laser-manager/AdVectorArena.h>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace sf1r { namespace slim { namespace test {
+
+typedef std::vector<std::pair<int, float> > Vector;
+
+const std::size_t DICT_SIZE = 100000;
+const std::size_t AD_TERM_NUM = 30;
+const std::size_t TITLE_TERM_NUM = 15;
+
+// sorted like Tokenizer output, terms skewed to the head of the dictionary
+inline Vector makeVector(std::size_t n)
+{
+    Vector vec;
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        const double r = (double)rand() / RAND_MAX;
+        vec.push_back(std::make_pair((int)(DICT_SIZE * r * r) % DICT_SIZE, 1.0 / n));
+    }
+    std::sort(vec.begin(), vec.end());
+    return vec;
+}
+
+// SlimRecommend::topN before the scratch, one hash probe per ad term
+inline float hashDot(const boost::unordered_map<int, float>& title, const laser::AdVectorView& ad)
+{
+    float score = 0.0;
+    for (std::size_t i = 0; i < ad.size(); ++i)
+    {
+        boost::unordered_map<int, float>::const_iterator p = title.find(ad[i].first);
+        if (p != title.end())
+        {
+            score += p->second * ad[i].second;
+        }
+    }
+    return score;
+}
+
+} } }
+
+#endif
@@ -0,0 +1,72 @@
+/**
+ * @file TokenizeCacheTestData.h
+ * @brief the titles and the skewed workload to test and benchmark TokenizeCache.
+ */
+
+#ifndef SF1R_LASER_TOKENIZE_CACHE_TEST_DATA_H
+#define SF1R_LASER_TOKENIZE_CACHE_TEST_DATA_H
+
+#include <laser-manager/TokenizeCache.h>
+#include <boost/atomic.hpp>
+#include <cstdlib>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace sf1r { namespace laser { namespace test {
+
+typedef TokenizeCache::TokenSparseVector Vector;
+
+const std::size_t TITLE_NUM = 20000;
+const std::size_t CACHE_SIZE = 5000;
+const std::size_t TERM_NUM = 12;
+const std::size_t THREAD_NUM = 4;
+
+inline std::string title(std::size_t i)
+{
+    std::stringstream ss;
+    ss << "title of ad " << i;
+    return ss.str();
+}
+
+// stands in for the pca, the cache does not care where vectors come from
+inline Vector tokenize(std::size_t i)
+{
+    Vector vec;
+    for (std::size_t k = 0; k < TERM_NUM; ++k)
+    {
+        vec.push_back(std::make_pair((int)(i * TERM_NUM + k), 1.0 / TERM_NUM));
+    }
+    return vec;
+}
+
+// zipf-like, most requests hit a small set of popular titles
+inline std::size_t skewed(unsigned int& seed)
+{
+    const double r = (double)rand_r(&seed) / RAND_MAX;
+    return (std::size_t)(TITLE_NUM * std::pow(r, 4)) % TITLE_NUM;
+}
+
+inline void request(TokenizeCache& cache,
+    const std::vector<std::string>& titles,
+    unsigned int seed,
+    std::size_t n,
+    boost::atomic<std::size_t>& mismatch)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const std::size_t t = skewed(seed);
+        TokenizeCache::TokenVectorPtr vec = cache.get(titles[t]);
+        if (NULL == vec.get())
+        {
+            Vector tks = tokenize(t);
+            vec = cache.insert(titles[t], tks);
+        }
+        if (vec->size() != TERM_NUM || (*vec)[0].first != (int)(t * TERM_NUM))
+            ++mismatch;
+    }
+}
+} } }
+
+#endif
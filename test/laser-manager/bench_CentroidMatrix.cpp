@@ -0,0 +1,67 @@
+///
+/// @file bench_CentroidMatrix.cpp
+/// @brief benchmark nearest centroid assignment against the scalar scan
+///
+
+#include "CentroidMatrixTestData.h"
+#include <laser-manager/CentroidMatrix.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::test;
+
+namespace
+{
+long elapsed(const boost::posix_time::ptime& stime)
+{
+    return (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+}
+}
+
+BOOST_AUTO_TEST_SUITE(CentroidMatrixBench)
+
+BOOST_AUTO_TEST_CASE(assignMillionDocuments)
+{
+    const std::size_t DOC_NUM = 1000000;
+    const std::size_t SCALAR_DOC_NUM = 10000;
+    std::vector<TokenVector> centroids;
+    makeCentroids(centroids);
+    std::vector<TokenSparseVector> docs(DOC_NUM);
+    for (std::size_t i = 0; i < DOC_NUM; ++i)
+    {
+        makeDoc(centroids, docs[i]);
+    }
+
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    std::size_t checksum = 0;
+    for (std::size_t i = 0; i < SCALAR_DOC_NUM; ++i)
+    {
+        checksum += scalarAssign(centroids, docs[i]);
+    }
+    const long scalarTime = elapsed(stime);
+
+    CentroidMatrix exact(centroids);
+    stime = boost::posix_time::microsec_clock::local_time();
+    for (std::size_t i = 0; i < DOC_NUM; ++i)
+    {
+        checksum += exact.assign(docs[i]);
+    }
+    const long exactTime = elapsed(stime);
+
+    CentroidMatrix coarse(centroids, 32, 4);
+    stime = boost::posix_time::microsec_clock::local_time();
+    for (std::size_t i = 0; i < DOC_NUM; ++i)
+    {
+        checksum += coarse.assign(docs[i]);
+    }
+    const long coarseTime = elapsed(stime);
+
+    BOOST_TEST_MESSAGE(DOC_NUM << " documents x " << CENTROID_NUM << " centroids, scalar scan: "
+        << scalarTime * (DOC_NUM / SCALAR_DOC_NUM) << "ms (extrapolated from "
+        << SCALAR_DOC_NUM << "), centroid matrix: " << exactTime
+        << "ms, coarse quantizer: " << coarseTime << "ms");
+    BOOST_CHECK_NE(checksum, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
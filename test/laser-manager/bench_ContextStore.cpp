@@ -0,0 +1,113 @@
+///
+/// @file bench_ContextStore.cpp
+/// @brief benchmark recommend with per-user context read from the embedded
+///        user context store
+///
+
+#include "ContextStoreTestData.h"
+#include <laser-manager/LaserRecommend.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::context;
+using namespace sf1r::laser::context::test;
+
+namespace
+{
+const std::size_t THREAD_NUM = 4;
+const std::size_t REQUEST_NUM = 2000;
+const std::size_t LOOKUP_NUM = 500000;
+
+void request(const LaserRecommend& recommend,
+    unsigned int seed,
+    std::size_t n,
+    std::vector<double>& latency,
+    std::size_t& found)
+{
+    std::vector<docid_t> items;
+    std::vector<float> scores;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        // one in ten requests is from a user the store does not know
+        const std::string text = 0 == i % 10 ? user(USER_NUM + i) : user(skewed(seed));
+        items.clear();
+        scores.clear();
+        boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+        if (recommend.recommend(text, items, scores, TOPN))
+            ++found;
+        latency.push_back((boost::posix_time::microsec_clock::local_time() - stime).total_microseconds());
+    }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ContextStoreBench)
+
+BOOST_AUTO_TEST_CASE(recommendBenchmark)
+{
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    BOOST_REQUIRE(buildStore(USER_NUM, true));
+    const long buildTime = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+    stime = boost::posix_time::microsec_clock::local_time();
+    ContextStore store;
+    BOOST_REQUIRE(store.open(STORE));
+    const long openTime = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+    const std::size_t fileSize = boost::filesystem::file_size(STORE);
+    BOOST_TEST_MESSAGE(USER_NUM << " users x " << DIM << " dims, build: " << buildTime << "ms, open: "
+        << openTime << "ms, " << (double)fileSize / USER_NUM << " bytes per user against "
+        << DIM * sizeof(float) << " as floats");
+
+    // raw lookups
+    std::vector<std::string> users;
+    for (std::size_t i = 0; i < USER_NUM; ++i)
+    {
+        users.push_back(user(i));
+    }
+    unsigned int seed = 1;
+    std::size_t found = 0;
+    std::vector<float> context;
+    stime = boost::posix_time::microsec_clock::local_time();
+    for (std::size_t i = 0; i < LOOKUP_NUM; ++i)
+    {
+        if (store.context(users[skewed(seed)], context))
+            ++found;
+    }
+    const long lookupTime = (boost::posix_time::microsec_clock::local_time() - stime).total_microseconds();
+    BOOST_CHECK_EQUAL(found, LOOKUP_NUM);
+    BOOST_TEST_MESSAGE(LOOKUP_NUM << " dense lookups: " << lookupTime * 1000.0 / LOOKUP_NUM << "ns per lookup");
+
+    // recommend on several threads, like the rpc workers
+    LaserRecommend recommend(new StoreModel(store));
+    std::vector<std::vector<double> > latency(THREAD_NUM);
+    std::vector<std::size_t> hit(THREAD_NUM, 0);
+    stime = boost::posix_time::microsec_clock::local_time();
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        threads.create_thread(boost::bind(request, boost::cref(recommend), (unsigned int)(i + 1),
+            REQUEST_NUM / THREAD_NUM, boost::ref(latency[i]), boost::ref(hit[i])));
+    }
+    threads.join_all();
+    const long time = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+
+    std::vector<double> all;
+    std::size_t hits = 0;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        all.insert(all.end(), latency[i].begin(), latency[i].end());
+        hits += hit[i];
+    }
+    std::sort(all.begin(), all.end());
+    BOOST_CHECK_EQUAL(hits, REQUEST_NUM - REQUEST_NUM / 10);
+    BOOST_TEST_MESSAGE(REQUEST_NUM << " recommends x " << AD_NUM << " ads on " << THREAD_NUM << " threads: "
+        << time << "ms, qps: " << REQUEST_NUM * 1000.0 / std::max(time, 1L)
+        << ", p50: " << all[all.size() / 2] << "us, p99: " << all[all.size() * 99 / 100] << "us");
+    store.close();
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+///
+/// @file bench_LaserModelCache.cpp
+/// @brief benchmark per-request user model lookup and a skewed user workload
+///
+
+#include "LaserModelCacheTestData.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <sstream>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::test;
+
+namespace
+{
+const std::size_t REQUEST_NUM = 200;
+const std::size_t LOOKUP_NUM = 100000;
+
+std::string percentiles(std::vector<long>& latency)
+{
+    std::sort(latency.begin(), latency.end());
+    std::stringstream ss;
+    ss << "p50 " << latency[latency.size() / 2] << "us, p90 " << latency[latency.size() * 9 / 10]
+        << "us, p99 " << latency[latency.size() * 99 / 100] << "us, max " << latency.back() << "us";
+    return ss.str();
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(LaserModelCacheBench, DBFixture)
+
+BOOST_AUTO_TEST_CASE(skewedWorkload)
+{
+    const ZipfUsers zipf(USER_NUM);
+    std::vector<std::string> requests(LOOKUP_NUM);
+    srand(7);
+    for (std::size_t i = 0; i < LOOKUP_NUM; ++i)
+    {
+        requests[i] = user(zipf.next());
+    }
+
+    std::vector<long> dbLatency(LOOKUP_NUM);
+    for (std::size_t i = 0; i < LOOKUP_NUM; ++i)
+    {
+        boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+        LaserOnlineModel model;
+        BOOST_REQUIRE(db_->get(requests[i], model));
+        dbLatency[i] = (boost::posix_time::microsec_clock::local_time() - stime).total_microseconds();
+    }
+
+    UserCache cache(*db_, HOT_USER_NUM);
+    std::vector<long> cacheLatency(LOOKUP_NUM);
+    for (std::size_t i = 0; i < LOOKUP_NUM; ++i)
+    {
+        boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+        BOOST_REQUIRE(cache.get(requests[i]));
+        cacheLatency[i] = (boost::posix_time::microsec_clock::local_time() - stime).total_microseconds();
+    }
+
+    UserCache::Stats stats = cache.stats();
+    BOOST_TEST_MESSAGE(LOOKUP_NUM << " zipf lookups over " << USER_NUM << " users, cache of "
+        << HOT_USER_NUM << ", hit rate " << stats.hitRate() << ", evictions " << stats.evictions);
+    BOOST_TEST_MESSAGE("db: " << percentiles(dbLatency));
+    BOOST_TEST_MESSAGE("cache: " << percentiles(cacheLatency));
+}
+
+/*
+ * the user model read and decoded from the db for every candidate, against
+ * once per request through the cache.
+ */
+BOOST_AUTO_TEST_CASE(scoreRequests)
+{
+    std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > > ad;
+    makeAds(ad);
+    static const std::vector<std::pair<int, float> > context;
+
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    float perCandidate = 0;
+    for (std::size_t r = 0; r < REQUEST_NUM; ++r)
+    {
+        const std::string text = user(r % HOT_USER_NUM);
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            LaserOnlineModel model;
+            if (db_->get(text, model))
+            {
+                perCandidate += model.score(text, context, ad[i], 0);
+            }
+        }
+    }
+    const long perCandidateTime = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+
+    UserCache cache(*db_, HOT_USER_NUM);
+    stime = boost::posix_time::microsec_clock::local_time();
+    float perRequest = 0;
+    for (std::size_t r = 0; r < REQUEST_NUM; ++r)
+    {
+        const std::string text = user(r % HOT_USER_NUM);
+        UserCache::ValuePtr model = cache.get(text);
+        for (std::size_t i = 0; model && i < ad.size(); ++i)
+        {
+            perRequest += model->score(text, context, ad[i], 0);
+        }
+    }
+    const long perRequestTime = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+
+    BOOST_TEST_MESSAGE(REQUEST_NUM << " requests x " << AD_NUM << " candidates, user model per candidate: "
+        << perCandidateTime << "ms, per request: " << perRequestTime << "ms");
+    BOOST_CHECK_CLOSE(perRequest, perCandidate, 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,87 @@
+///
+/// @file bench_TitleScratch.cpp
+/// @brief benchmark slim title scoring with a dense scratch against hash probing
+///
+
+#include <slim-manager/TitleScratch.h>
+#include "TitleScratchTestData.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <cmath>
+
+using namespace sf1r::laser;
+using namespace sf1r::slim;
+using namespace sf1r::slim::test;
+
+namespace
+{
+const std::size_t AD_NUM = 5000;
+const std::size_t TITLE_NUM = 500;
+}
+
+BOOST_AUTO_TEST_SUITE(TitleScratchBench)
+
+BOOST_AUTO_TEST_CASE(scoreBenchmark)
+{
+    srand(17);
+    AdVectorArena arena;
+    for (std::size_t i = 0; i < AD_NUM; ++i)
+    {
+        arena.append(i, makeVector(AD_TERM_NUM));
+    }
+    std::vector<AdVectorView> ads(AD_NUM);
+    for (std::size_t i = 0; i < AD_NUM; ++i)
+    {
+        arena.get(i, ads[i]);
+    }
+    std::vector<Vector> titles(TITLE_NUM);
+    for (std::size_t i = 0; i < TITLE_NUM; ++i)
+    {
+        titles[i] = makeVector(TITLE_TERM_NUM);
+    }
+
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    std::vector<float> hashScore;
+    hashScore.reserve(TITLE_NUM * AD_NUM);
+    for (std::size_t t = 0; t < TITLE_NUM; ++t)
+    {
+        boost::unordered_map<int, float> title;
+        for (std::size_t k = 0; k < titles[t].size(); ++k)
+        {
+            title[titles[t][k].first] = titles[t][k].second;
+        }
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            hashScore.push_back(hashDot(title, ads[i]));
+        }
+    }
+    const long hashTime = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+
+    stime = boost::posix_time::microsec_clock::local_time();
+    std::vector<float> denseScore;
+    denseScore.reserve(TITLE_NUM * AD_NUM);
+    TitleScratch scratch;
+    for (std::size_t t = 0; t < TITLE_NUM; ++t)
+    {
+        scratch.assign(titles[t]);
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            denseScore.push_back(scratch.dot(ads[i]));
+        }
+    }
+    scratch.clear();
+    const long denseTime = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+
+    BOOST_REQUIRE_EQUAL(hashScore.size(), denseScore.size());
+    std::size_t mismatch = 0;
+    for (std::size_t i = 0; i < hashScore.size(); ++i)
+    {
+        if (std::fabs(hashScore[i] - denseScore[i]) > 1e-5)
+            ++mismatch;
+    }
+    BOOST_CHECK_EQUAL(mismatch, 0U);
+    BOOST_TEST_MESSAGE(TITLE_NUM << " titles x " << AD_NUM << " ads, hash probe: "
+        << hashTime << "ms, dense scratch: " << denseTime << "ms");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
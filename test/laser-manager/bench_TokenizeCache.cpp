@@ -0,0 +1,52 @@
+///
+/// @file bench_TokenizeCache.cpp
+/// @brief benchmark concurrent tokenized title lookups on a skewed title workload
+///
+
+#include "TokenizeCacheTestData.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::test;
+
+namespace
+{
+const std::size_t REQUEST_NUM = 200000;
+}
+
+BOOST_AUTO_TEST_SUITE(TokenizeCacheBench)
+
+BOOST_AUTO_TEST_CASE(concurrentThroughput)
+{
+    std::vector<std::string> titles;
+    for (std::size_t i = 0; i < TITLE_NUM; ++i)
+    {
+        titles.push_back(title(i));
+    }
+    TokenizeCache cache(CACHE_SIZE);
+    boost::atomic<std::size_t> mismatch(0);
+
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        threads.create_thread(boost::bind(request, boost::ref(cache), boost::cref(titles),
+            (unsigned int)(i + 1), REQUEST_NUM / THREAD_NUM, boost::ref(mismatch)));
+    }
+    threads.join_all();
+    const long ms = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+
+    BOOST_CHECK_EQUAL(mismatch.load(), 0U);
+    BOOST_CHECK(cache.size() <= CACHE_SIZE);
+    const TokenizeCache::Stats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, REQUEST_NUM);
+    BOOST_CHECK(stats.hitRate() > 0.5);
+    BOOST_TEST_MESSAGE(REQUEST_NUM << " requests on " << THREAD_NUM << " threads: " << ms
+        << "ms, hit rate: " << stats.hitRate() << ", evictions: " << stats.evictions);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
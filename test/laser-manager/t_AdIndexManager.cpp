@@ -0,0 +1,185 @@
+///
+/// @file t_AdIndexManager.cpp
+/// @brief test the delta segments of the ad index, replayed on open,
+///        compacted into the base files, and a crash in between
+///
+
+#include <laser-manager/AdIndexManager.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace sf1r::laser;
+
+namespace
+{
+typedef std::vector<std::pair<int, float> > Vector;
+
+const std::string WORKDIR = "./t_AdIndexManager";
+const std::string INDEXDIR = WORKDIR + "/index/";
+const std::size_t CLUSTERING_NUM = 8;
+// AdIndexManager compacts after this many segments
+const std::size_t MAX_DELTA_NUM = 16;
+
+Vector makeVector(docid_t docid)
+{
+    Vector vec;
+    for (std::size_t k = 0; k < docid % 7 + 1; ++k)
+    {
+        vec.push_back(std::make_pair(docid * 13 + k, docid + k / 10.0));
+    }
+    return vec;
+}
+
+std::size_t clusteringOf(docid_t docid)
+{
+    return docid % CLUSTERING_NUM;
+}
+
+// docs [begin, end) in one batch, then saved like LaserIndexTask::postProcess
+void indexDocs(AdIndexManager& manager, docid_t begin, docid_t end)
+{
+    std::vector<AdIndexManager::IndexItem> batch(end - begin);
+    for (docid_t docid = begin; docid < end; ++docid)
+    {
+        AdIndexManager::IndexItem& item = batch[docid - begin];
+        item.docid = docid;
+        item.clusteringId = clusteringOf(docid);
+        item.vec = makeVector(docid);
+    }
+    manager.index(batch);
+    manager.setLastDocId(end);
+    manager.postIndex();
+}
+
+std::string deltaFile(std::size_t seq)
+{
+    std::stringstream ss;
+    ss << INDEXDIR << "delta." << seq;
+    return ss.str();
+}
+
+// every doc in [0, docNum) once in its clustering, with its vector
+void checkIndex(const AdIndexManager& manager, docid_t docNum)
+{
+    BOOST_CHECK_EQUAL(manager.getLastDocId(), docNum);
+    std::size_t total = 0;
+    for (std::size_t c = 0; c < CLUSTERING_NUM; ++c)
+    {
+        std::vector<docid_t> docids;
+        BOOST_REQUIRE(manager.get(c, docids));
+        std::sort(docids.begin(), docids.end());
+        BOOST_CHECK(std::adjacent_find(docids.begin(), docids.end()) == docids.end());
+        for (std::size_t i = 0; i < docids.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(clusteringOf(docids[i]), c);
+        }
+        total += docids.size();
+    }
+    BOOST_CHECK_EQUAL(total, docNum);
+    for (docid_t docid = 0; docid < docNum; ++docid)
+    {
+        Vector vec;
+        BOOST_REQUIRE(manager.get(docid, vec));
+        BOOST_CHECK(vec == makeVector(docid));
+        std::size_t clustering = 0;
+        BOOST_REQUIRE(manager.get(docid, clustering));
+        BOOST_CHECK_EQUAL(clustering, clusteringOf(docid));
+    }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(AdIndexManagerTest)
+
+BOOST_AUTO_TEST_CASE(replayDeltas)
+{
+    boost::filesystem::remove_all(WORKDIR);
+    {
+        AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+        indexDocs(manager, 0, 100);
+        indexDocs(manager, 100, 150);
+        // nothing new, no segment
+        manager.postIndex();
+        indexDocs(manager, 150, 151);
+    }
+    BOOST_CHECK(boost::filesystem::exists(deltaFile(0)));
+    BOOST_CHECK(boost::filesystem::exists(deltaFile(2)));
+    BOOST_CHECK(!boost::filesystem::exists(deltaFile(3)));
+    {
+        AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+        checkIndex(manager, 151);
+        indexDocs(manager, 151, 200);
+    }
+    AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+    checkIndex(manager, 200);
+    boost::filesystem::remove_all(WORKDIR);
+}
+
+BOOST_AUTO_TEST_CASE(dropCorruptDelta)
+{
+    boost::filesystem::remove_all(WORKDIR);
+    {
+        AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+        indexDocs(manager, 0, 50);
+        indexDocs(manager, 50, 100);
+        indexDocs(manager, 100, 150);
+    }
+    {
+        const std::size_t size = boost::filesystem::file_size(deltaFile(1));
+        std::fstream fs(deltaFile(1).c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(size - 1);
+        fs.put('x');
+    }
+    // the segments from the corrupt one on are dropped, indexed again later
+    AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+    checkIndex(manager, 50);
+    BOOST_CHECK(!boost::filesystem::exists(deltaFile(1)));
+    BOOST_CHECK(!boost::filesystem::exists(deltaFile(2)));
+    boost::filesystem::remove_all(WORKDIR);
+}
+
+BOOST_AUTO_TEST_CASE(crashBeforeDeltaBase)
+{
+    boost::filesystem::remove_all(WORKDIR);
+    const std::string backup = WORKDIR + ".backup/";
+    boost::filesystem::remove_all(backup);
+    boost::filesystem::create_directories(backup);
+    docid_t docNum = 0;
+    {
+        AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+        for (std::size_t seq = 0; seq < MAX_DELTA_NUM; ++seq, docNum += 10)
+        {
+            indexDocs(manager, docNum, docNum + 10);
+        }
+        for (std::size_t seq = 0; seq < MAX_DELTA_NUM; ++seq)
+        {
+            boost::filesystem::copy_file(deltaFile(seq), backup + deltaFile(seq).substr(INDEXDIR.size()));
+        }
+        // compacts into the base files
+        indexDocs(manager, docNum, docNum + 10);
+        docNum += 10;
+    }
+    BOOST_CHECK(boost::filesystem::exists(INDEXDIR + "delta-base"));
+    BOOST_CHECK(!boost::filesystem::exists(deltaFile(0)));
+
+    // as if it crashed after the base files were written
+    boost::filesystem::remove(INDEXDIR + "delta-base");
+    for (std::size_t seq = 0; seq < MAX_DELTA_NUM; ++seq)
+    {
+        boost::filesystem::copy_file(backup + deltaFile(seq).substr(INDEXDIR.size()), deltaFile(seq));
+    }
+    {
+        AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+        checkIndex(manager, docNum);
+        indexDocs(manager, docNum, docNum + 10);
+        docNum += 10;
+    }
+    AdIndexManager manager(WORKDIR, CLUSTERING_NUM);
+    checkIndex(manager, docNum);
+    boost::filesystem::remove_all(WORKDIR);
+    boost::filesystem::remove_all(backup);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,211 @@
+///
+/// @file t_AdVectorArena.cpp
+/// @brief test concurrent appends, views and persistence of the ad vector arena
+///
+
+#include <laser-manager/AdVectorArena.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <fstream>
+
+using namespace sf1r::laser;
+
+namespace
+{
+typedef std::vector<std::pair<int, float> > Vector;
+
+const std::size_t DOC_NUM = 20000;
+const std::size_t WRITER_NUM = 4;
+
+// deterministic content, so readers can check any vector they see
+Vector makeVector(docid_t docid, std::size_t version = 0)
+{
+    Vector vec;
+    const std::size_t size = (docid + version) % 17;
+    for (std::size_t k = 0; k < size; ++k)
+    {
+        vec.push_back(std::make_pair(docid * 31 + k, docid + version + k / 10.0));
+    }
+    return vec;
+}
+
+bool equal(const AdVectorView& view, const Vector& vec)
+{
+    return view.size() == vec.size() && std::equal(view.begin(), view.end(), vec.begin());
+}
+
+void appendAll(AdVectorArena* arena, std::size_t writer)
+{
+    for (docid_t docid = writer; docid < DOC_NUM; docid += WRITER_NUM)
+    {
+        arena->append(docid, makeVector(docid));
+    }
+}
+
+void readAll(const AdVectorArena* arena, boost::atomic<bool>* stop, std::size_t* bad)
+{
+    AdVectorView view;
+    while (!stop->load())
+    {
+        for (docid_t docid = 0; docid < DOC_NUM; docid += 7)
+        {
+            // either not yet published or complete
+            if (arena->get(docid, view) && !view.empty() && !equal(view, makeVector(docid)))
+            {
+                ++*bad;
+            }
+        }
+    }
+}
+
+class ArenaFixture
+{
+public:
+    ArenaFixture()
+        : path_("./t_AdVectorArena")
+    {
+        boost::filesystem::remove_all(path_);
+        boost::filesystem::create_directories(path_);
+    }
+
+    ~ArenaFixture()
+    {
+        boost::filesystem::remove_all(path_);
+    }
+
+protected:
+    const std::string path_;
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(AdVectorArenaTest, ArenaFixture)
+
+BOOST_AUTO_TEST_CASE(appendAndGet)
+{
+    AdVectorArena arena;
+    AdVectorView view;
+    BOOST_CHECK(!arena.get(3, view));
+    BOOST_CHECK(arena.append(3, makeVector(3)));
+    BOOST_CHECK_EQUAL(arena.size(), 4U);
+    BOOST_REQUIRE(arena.get(3, view));
+    BOOST_CHECK(equal(view, makeVector(3)));
+    // docids below the largest one exist and are empty
+    BOOST_CHECK(arena.get(1, view));
+    BOOST_CHECK(view.empty());
+
+    // appending again replaces the vector, the old view stays readable
+    AdVectorView old;
+    arena.get(3, old);
+    BOOST_CHECK(arena.append(3, makeVector(3, 5)));
+    BOOST_REQUIRE(arena.get(3, view));
+    BOOST_CHECK(equal(view, makeVector(3, 5)));
+    BOOST_CHECK(equal(old, makeVector(3)));
+    BOOST_CHECK_EQUAL(arena.garbage(), makeVector(3).size());
+
+    // the same vector again keeps its range
+    BOOST_CHECK(arena.append(3, makeVector(3, 5)));
+    AdVectorView same;
+    BOOST_REQUIRE(arena.get(3, same));
+    BOOST_CHECK(same.begin() == view.begin());
+    BOOST_CHECK_EQUAL(arena.garbage(), makeVector(3).size());
+}
+
+BOOST_AUTO_TEST_CASE(concurrentAppend)
+{
+    AdVectorArena arena;
+    boost::atomic<bool> stop(false);
+    std::size_t bad = 0;
+    boost::thread reader(boost::bind(readAll, &arena, &stop, &bad));
+    std::vector<boost::thread*> writers;
+    for (std::size_t i = 0; i < WRITER_NUM; ++i)
+    {
+        writers.push_back(new boost::thread(boost::bind(appendAll, &arena, i)));
+    }
+    for (std::size_t i = 0; i < WRITER_NUM; ++i)
+    {
+        writers[i]->join();
+        delete writers[i];
+    }
+    stop.store(true);
+    reader.join();
+
+    BOOST_CHECK_EQUAL(bad, 0U);
+    BOOST_CHECK_EQUAL(arena.size(), DOC_NUM);
+    AdVectorView view;
+    for (docid_t docid = 0; docid < DOC_NUM; ++docid)
+    {
+        BOOST_REQUIRE(arena.get(docid, view));
+        BOOST_CHECK(equal(view, makeVector(docid)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(saveAndLoad)
+{
+    const std::string filename = path_ + "/ad-arena";
+    {
+        AdVectorArena arena;
+        for (docid_t docid = 0; docid < DOC_NUM; ++docid)
+        {
+            arena.append(docid, makeVector(docid));
+        }
+        // replaced vectors are compacted away in the file, and held in
+        // memory until the next load
+        arena.append(10, makeVector(10, 1));
+        BOOST_REQUIRE(arena.save(filename));
+        BOOST_CHECK_EQUAL(arena.garbage(), makeVector(10).size());
+        BOOST_REQUIRE(arena.load(filename));
+        BOOST_CHECK_EQUAL(arena.garbage(), 0U);
+    }
+
+    AdVectorArena arena;
+    BOOST_REQUIRE(arena.load(filename));
+    BOOST_CHECK_EQUAL(arena.size(), DOC_NUM);
+    AdVectorView view;
+    for (docid_t docid = 0; docid < DOC_NUM; ++docid)
+    {
+        BOOST_REQUIRE(arena.get(docid, view));
+        BOOST_CHECK(equal(view, makeVector(docid, 10 == docid ? 1 : 0)));
+    }
+
+    // appends shadow the mapped base and survive the next save
+    arena.append(20, makeVector(20, 2));
+    arena.append(DOC_NUM, makeVector(DOC_NUM));
+    BOOST_REQUIRE(arena.get(20, view));
+    BOOST_CHECK(equal(view, makeVector(20, 2)));
+    BOOST_REQUIRE(arena.save(filename));
+
+    AdVectorArena reloaded;
+    BOOST_REQUIRE(reloaded.load(filename));
+    BOOST_CHECK_EQUAL(reloaded.size(), DOC_NUM + 1);
+    BOOST_REQUIRE(reloaded.get(20, view));
+    BOOST_CHECK(equal(view, makeVector(20, 2)));
+    BOOST_REQUIRE(reloaded.get(DOC_NUM, view));
+    BOOST_CHECK(equal(view, makeVector(DOC_NUM)));
+}
+
+BOOST_AUTO_TEST_CASE(rejectCorruptFile)
+{
+    const std::string filename = path_ + "/ad-arena";
+    {
+        AdVectorArena arena;
+        for (docid_t docid = 0; docid < 100; ++docid)
+        {
+            arena.append(docid, makeVector(docid));
+        }
+        BOOST_REQUIRE(arena.save(filename));
+    }
+    {
+        std::fstream fs(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(boost::filesystem::file_size(filename) - 3);
+        fs.put('x');
+    }
+    AdVectorArena arena;
+    BOOST_CHECK(!arena.load(filename));
+    BOOST_CHECK(!arena.load(path_ + "/missing"));
+    BOOST_CHECK_EQUAL(arena.size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
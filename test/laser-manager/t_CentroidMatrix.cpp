@@ -0,0 +1,82 @@
+///
+/// @file t_CentroidMatrix.cpp
+/// @brief test nearest centroid assignment
+///
+
+#include "CentroidMatrixTestData.h"
+#include <laser-manager/CentroidMatrix.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::test;
+
+namespace
+{
+float similarity(const TokenVector& centroid, const TokenSparseVector& v)
+{
+    float sim = 0.0;
+    for (std::size_t k = 0; k < v.size(); ++k)
+    {
+        sim += centroid[v[k].first] * v[k].second;
+    }
+    return sim;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(CentroidMatrixTest)
+
+BOOST_AUTO_TEST_CASE(sameAsScalarScan)
+{
+    std::vector<TokenVector> centroids;
+    makeCentroids(centroids);
+    CentroidMatrix matrix(centroids);
+    BOOST_CHECK_EQUAL(matrix.size(), CENTROID_NUM);
+    BOOST_CHECK_EQUAL(matrix.dimension(), DIM);
+
+    TokenSparseVector doc;
+    for (std::size_t i = 0; i < 2000; ++i)
+    {
+        makeDoc(centroids, doc);
+        const std::size_t expect = scalarAssign(centroids, doc);
+        const std::size_t id = matrix.assign(doc);
+        if (expect != id)
+        {
+            // only near ties may differ by rounding
+            BOOST_REQUIRE(id < CENTROID_NUM);
+            BOOST_CHECK_CLOSE(similarity(centroids[id], doc), similarity(centroids[expect], doc), 1e-3);
+        }
+    }
+
+    BOOST_CHECK_EQUAL(matrix.assign(TokenSparseVector()), (std::size_t)-1);
+    // unknown terms and no positive similarity
+    doc.assign(1, std::make_pair((int)DIM + 10, 1.0f));
+    BOOST_CHECK_EQUAL(matrix.assign(doc), (std::size_t)-1);
+}
+
+BOOST_AUTO_TEST_CASE(coarseQuantizer)
+{
+    std::vector<TokenVector> centroids;
+    makeCentroids(centroids);
+    CentroidMatrix matrix(centroids, 32, 4);
+    BOOST_CHECK_EQUAL(matrix.size(), CENTROID_NUM);
+
+    std::size_t hit = 0;
+    const std::size_t DOC_NUM = 2000;
+    TokenSparseVector doc;
+    for (std::size_t i = 0; i < DOC_NUM; ++i)
+    {
+        makeDoc(centroids, doc);
+        const std::size_t expect = scalarAssign(centroids, doc);
+        const std::size_t exactId = matrix.assignExact(doc);
+        BOOST_REQUIRE(exactId < CENTROID_NUM);
+        BOOST_CHECK_CLOSE(similarity(centroids[exactId], doc), similarity(centroids[expect], doc), 1e-3);
+        if (matrix.assign(doc) == expect)
+        {
+            ++hit;
+        }
+    }
+    BOOST_TEST_MESSAGE("coarse quantizer recall: " << (float)hit / DOC_NUM);
+    BOOST_CHECK_GT(hit, DOC_NUM / 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,273 @@
+///
+/// @file t_ContextStore.cpp
+/// @brief test the embedded user context store and recommend with per-user
+///        context read from it
+///
+
+#include "ContextStoreTestData.h"
+#include <laser-manager/context/KVClient.h>
+#include <laser-manager/LaserRecommend.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::context;
+using namespace sf1r::laser::context::test;
+
+BOOST_AUTO_TEST_SUITE(ContextStoreTest)
+
+BOOST_AUTO_TEST_CASE(buildAndLookup)
+{
+    for (int compact = 0; compact < 2; ++compact)
+    {
+        BOOST_REQUIRE(buildStore(1000, compact));
+        ContextStore store;
+        BOOST_REQUIRE(store.open(STORE));
+        BOOST_CHECK_EQUAL(store.size(), 1000U);
+        BOOST_CHECK_EQUAL(store.dimension(), DIM);
+
+        std::vector<float> dense;
+        std::vector<std::pair<int, float> > sparse;
+        for (std::size_t i = 0; i < 1000; ++i)
+        {
+            const std::vector<float> expect = makeContext(i);
+            BOOST_REQUIRE(store.context(user(i), dense));
+            BOOST_REQUIRE(store.context(user(i), sparse));
+            BOOST_REQUIRE_EQUAL(dense.size(), DIM);
+            std::size_t nnz = 0;
+            for (std::size_t k = 0; k < DIM; ++k)
+            {
+                // half floats keep 11 bits of mantissa
+                const float eps = compact ? std::fabs(expect[k]) / 1024 : 0.0;
+                BOOST_REQUIRE(std::fabs(dense[k] - expect[k]) <= eps);
+                if (0 != expect[k])
+                {
+                    BOOST_REQUIRE(nnz < sparse.size());
+                    BOOST_REQUIRE_EQUAL(sparse[nnz].first, (int)k);
+                    BOOST_REQUIRE_EQUAL(sparse[nnz].second, dense[k]);
+                    ++nnz;
+                }
+            }
+            BOOST_CHECK_EQUAL(sparse.size(), nnz);
+        }
+        BOOST_CHECK(!store.context("unknown", dense));
+        BOOST_CHECK(dense.empty());
+        BOOST_CHECK(!store.context(user(1000), sparse));
+    }
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_CASE(sparseAndDuplicate)
+{
+    ContextStoreBuilder builder(DIM, false);
+    std::vector<std::pair<int, float> > context;
+    context.push_back(std::make_pair(7, 1.0));
+    context.push_back(std::make_pair(3, 0.5));
+    context.push_back(std::make_pair(7, 0.25));
+    BOOST_CHECK(builder.add("a", context));
+    // the last one wins
+    context.push_back(std::make_pair(100, 2.0));
+    BOOST_CHECK(builder.add("a", context));
+    context.push_back(std::make_pair(DIM, 1.0));
+    BOOST_CHECK(!builder.add("b", context));
+    BOOST_CHECK(!builder.add("c", std::vector<float>(DIM + 1)));
+    BOOST_CHECK(builder.add("empty", std::vector<float>(DIM)));
+    BOOST_REQUIRE(builder.save(STORE));
+
+    ContextStore store;
+    BOOST_REQUIRE(store.open(STORE));
+    BOOST_CHECK_EQUAL(store.size(), 2U);
+    std::vector<std::pair<int, float> > res;
+    BOOST_REQUIRE(store.context("a", res));
+    BOOST_REQUIRE_EQUAL(res.size(), 3U);
+    BOOST_CHECK_EQUAL(res[0].first, 3);
+    BOOST_CHECK_EQUAL(res[0].second, 0.5);
+    BOOST_CHECK_EQUAL(res[1].first, 7);
+    BOOST_CHECK_EQUAL(res[1].second, 1.25);
+    BOOST_CHECK_EQUAL(res[2].first, 100);
+    std::vector<float> dense;
+    BOOST_REQUIRE(store.context("a", dense));
+    BOOST_REQUIRE_EQUAL(dense.size(), DIM);
+    BOOST_CHECK_EQUAL(dense[7], 1.25);
+    BOOST_CHECK_EQUAL(dense[8], 0.0);
+    BOOST_REQUIRE(store.context("empty", res));
+    BOOST_CHECK(res.empty());
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_CASE(exactByDefault)
+{
+    ContextStoreBuilder builder(DIM);
+    std::vector<float> context(DIM, 0.0);
+    context[1] = 0.1;
+    context[2] = 1.0 / 3;
+    context[3] = 12345.678;
+    BOOST_REQUIRE(builder.add("a", context));
+    BOOST_REQUIRE(builder.save(STORE));
+
+    ContextStore store;
+    BOOST_REQUIRE(store.open(STORE));
+    std::vector<float> res;
+    BOOST_REQUIRE(store.context("a", res));
+    BOOST_CHECK(res == context);
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_CASE(loadText)
+{
+    const std::string text = "./t_ContextStore.txt";
+    {
+        std::ofstream ofs(text.c_str());
+        ofs << "dense\t";
+        for (std::size_t k = 0; k < DIM; ++k)
+        {
+            ofs << (k == 5 ? 0.5 : 0.0) << (k + 1 == DIM ? "\n" : " ");
+        }
+        ofs << "sparse\t1:0.25 9:-1.5\r\n";
+        ofs << "short\t1 2 3\n";
+        ofs << "broken\t1:x\n";
+        ofs << "\n";
+        ofs << "notab\n";
+    }
+    BOOST_REQUIRE(ContextStore::build(text, STORE, DIM));
+    ContextStore store;
+    BOOST_REQUIRE(store.open(STORE));
+    BOOST_CHECK_EQUAL(store.size(), 2U);
+    std::vector<std::pair<int, float> > res;
+    BOOST_REQUIRE(store.context("dense", res));
+    BOOST_REQUIRE_EQUAL(res.size(), 1U);
+    BOOST_CHECK_EQUAL(res[0].first, 5);
+    BOOST_CHECK_EQUAL(res[0].second, 0.5);
+    BOOST_REQUIRE(store.context("sparse", res));
+    BOOST_REQUIRE_EQUAL(res.size(), 2U);
+    BOOST_CHECK_EQUAL(res[1].first, 9);
+    BOOST_CHECK_EQUAL(res[1].second, -1.5);
+    BOOST_CHECK(!store.context("short", res));
+    BOOST_CHECK(!store.context("broken", res));
+    boost::filesystem::remove(text);
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_CASE(rejectCorruptFile)
+{
+    BOOST_REQUIRE(buildStore(100, true));
+    const std::size_t size = boost::filesystem::file_size(STORE);
+    {
+        std::fstream fs(STORE.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(size - 3);
+        fs.put('x');
+    }
+    ContextStore store;
+    BOOST_CHECK(!store.open(STORE));
+    BOOST_CHECK(!store.isOpen());
+    std::vector<float> context;
+    BOOST_CHECK(!store.context(user(0), context));
+
+    boost::filesystem::resize_file(STORE, size / 2);
+    BOOST_CHECK(!store.open(STORE));
+    BOOST_CHECK(!store.open("./t_ContextStore.missing"));
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_CASE(rejectIndexOutOfDimension)
+{
+    // a sparse context valid in a larger dimension, the checksum does not
+    // cover the header, so a smaller dimension there passes the crc
+    ContextStoreBuilder builder(2 * DIM);
+    std::vector<std::pair<int, float> > context;
+    context.push_back(std::make_pair(3, 0.5));
+    context.push_back(std::make_pair(DIM + 7, 1.0));
+    BOOST_REQUIRE(builder.add("a", context));
+    BOOST_REQUIRE(builder.save(STORE));
+    ContextStore store;
+    BOOST_REQUIRE(store.open(STORE));
+    store.close();
+
+    {
+        ContextStore::Header header;
+        std::fstream fs(STORE.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        fs.read(reinterpret_cast<char*>(&header), sizeof(header));
+        header.dimension = DIM;
+        fs.seekp(0);
+        fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    BOOST_CHECK(!store.open(STORE));
+    BOOST_CHECK(!store.isOpen());
+    std::vector<float> dense;
+    BOOST_CHECK(!store.context("a", dense));
+    BOOST_CHECK(dense.empty());
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_CASE(kvClient)
+{
+    const std::string text = "./t_ContextStore.txt";
+    {
+        std::ofstream ofs(text.c_str());
+        ofs << "sparse\t1:0.1 9:-1.5\n";
+    }
+    {
+        KVClient client(text, 0, DIM);
+        std::vector<std::pair<int, float> > res;
+        BOOST_REQUIRE(client.context("sparse", res));
+        BOOST_REQUIRE_EQUAL(res.size(), 2U);
+        BOOST_CHECK_EQUAL(res[0].second, 0.1f);
+        BOOST_CHECK(!client.context("unknown", res));
+    }
+    {
+        // a remote kv server is rejected, every user misses
+        KVClient client("127.0.0.1", 18181, DIM);
+        std::vector<float> res;
+        BOOST_CHECK(!client.context("sparse", res));
+    }
+    {
+        // the store does not match USER_FD
+        KVClient client(text + ".store", 0, 2 * DIM);
+        std::vector<float> res;
+        BOOST_CHECK(!client.context("sparse", res));
+    }
+    boost::filesystem::remove(text);
+    boost::filesystem::remove(text + ".store");
+}
+
+BOOST_AUTO_TEST_CASE(recommendFromStore)
+{
+    const std::size_t userNum = 1000;
+    BOOST_REQUIRE(buildStore(userNum, false));
+    ContextStore store;
+    BOOST_REQUIRE(store.open(STORE));
+    LaserRecommend recommend(new StoreModel(store));
+    const StoreModel expected(store);
+
+    std::vector<docid_t> items;
+    std::vector<float> scores;
+    for (std::size_t i = 0; i < userNum; i += 20)
+    {
+        items.clear();
+        scores.clear();
+        BOOST_REQUIRE(recommend.recommend(user(i), items, scores, TOPN));
+        BOOST_REQUIRE_EQUAL(items.size(), TOPN);
+        BOOST_REQUIRE_EQUAL(scores.size(), TOPN);
+
+        // the best ad against the context the user was built with
+        const std::vector<float> context = makeContext(i);
+        float best = 0;
+        for (std::size_t k = 0; k < AD_NUM; ++k)
+        {
+            const float score = expected.score(user(i), context,
+                std::make_pair((docid_t)k, std::vector<std::pair<int, float> >()), 0);
+            best = 0 == k ? score : std::max(best, score);
+        }
+        // recommend returns the sigmoid of the score
+        BOOST_CHECK_CLOSE(*std::max_element(scores.begin(), scores.end()), 1.0 / (1 + std::exp(-best)), 1e-3);
+    }
+    BOOST_CHECK(!recommend.recommend(user(userNum), items, scores, TOPN));
+    store.close();
+    boost::filesystem::remove(STORE);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
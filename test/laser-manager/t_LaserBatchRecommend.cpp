@@ -0,0 +1,384 @@
+///
+/// @file t_LaserBatchRecommend.cpp
+/// @brief compare batched and single recommend against scalar scoring
+///
+
+#include <laser-manager/LaserRecommend.h>
+#include <laser-manager/LaserModel.h>
+#include <laser-manager/LaserGenericModel.h>
+#include <laser-manager/LaserOnlineModel.h>
+#include <laser-manager/LaserModelFile.h>
+#include <laser-manager/AdIndexManager.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+using namespace sf1r::laser;
+
+namespace
+{
+const std::size_t AD_NUM = 20000;
+const std::size_t DIM = 128;
+const std::size_t USER_NUM = 64;
+const std::size_t TOPN = 20;
+
+/*
+ * Linear model over dense user contexts, every user gets all the ads as
+ * candidates like LaserGenericModel.
+ */
+class LinearModel : public LaserModel
+{
+public:
+    LinearModel()
+        : weights_(AD_NUM, std::vector<float>(DIM))
+    {
+        srand(17);
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            for (std::size_t k = 0; k < DIM; ++k)
+            {
+                weights_[i][k] = (rand() % 2000) / 1000.0 - 1.0;
+            }
+        }
+    }
+
+public:
+    virtual bool candidate(
+        const std::string& text,
+        const std::size_t ncandidate,
+        const std::vector<std::pair<int, float> >& context,
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        std::vector<float>& score) const
+    {
+        return false;
+    }
+
+    virtual bool candidate(
+        const std::string& text,
+        const std::size_t ncandidate,
+        const std::vector<float>& context,
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        std::vector<float>& score) const
+    {
+        ad.resize(AD_NUM);
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            ad[i].first = i;
+        }
+        score.assign(ad.size(), 0);
+        return true;
+    }
+
+    virtual float score(
+        const std::string& text,
+        const std::vector<std::pair<int, float> >& context,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const
+    {
+        return 0;
+    }
+
+    virtual float score(
+        const std::string& text,
+        const std::vector<float>& context,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const
+    {
+        return score + dot(weights_[ad.first], context);
+    }
+
+    virtual void score(
+        const std::vector<std::string>& text,
+        const std::vector<std::vector<float> >& context,
+        const std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        const std::vector<std::size_t>& offset,
+        const std::vector<std::size_t>& user,
+        std::vector<float>& score) const
+    {
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            const std::vector<float>& w = weights_[ad[i].first];
+            std::size_t k = offset[i];
+            for (; k + 4 <= offset[i + 1]; k += 4)
+            {
+                const float* x[4];
+                for (std::size_t j = 0; j < 4; ++j)
+                {
+                    x[j] = context[user[k + j]].data();
+                }
+                float res[4];
+                dot4(w.data(), x, w.size(), res);
+                for (std::size_t j = 0; j < 4; ++j)
+                {
+                    score[k + j] += res[j];
+                }
+            }
+            for (; k < offset[i + 1]; ++k)
+            {
+                score[k] += dot(w, context[user[k]]);
+            }
+        }
+    }
+
+    virtual bool isSharedCandidate() const
+    {
+        return true;
+    }
+
+    virtual bool context(const std::string& text, std::vector<std::pair<int, float> >& context) const
+    {
+        return false;
+    }
+
+    virtual bool context(const std::string& text, std::vector<float>& context) const
+    {
+        // "nocontext" users have no context, like a miss in the kv store
+        if (0 == text.find("nocontext"))
+        {
+            return false;
+        }
+        std::size_t seed = boost::hash<std::string>()(text);
+        context.resize(DIM);
+        for (std::size_t k = 0; k < DIM; ++k)
+        {
+            boost::hash_combine(seed, k);
+            context[k] = (seed % 2000) / 1000.0 - 1.0;
+        }
+        return true;
+    }
+
+    virtual void dispatch(const std::string& method, msgpack::rpc::request& req)
+    {
+    }
+
+    const std::vector<float>& weights(const docid_t ad) const
+    {
+        return weights_[ad];
+    }
+
+private:
+    std::vector<std::vector<float> > weights_;
+};
+
+bool greaterScore(const std::pair<float, docid_t>& lv, const std::pair<float, docid_t>& rv)
+{
+    return lv.first > rv.first;
+}
+
+/*
+ * Top n of one user by a plain scalar dot product, independent of the
+ * model's batch score, with the sigmoid LaserRecommend applies.
+ */
+void scalarTopN(const LinearModel& model,
+    const std::string& user,
+    std::vector<docid_t>& items,
+    std::vector<float>& scores)
+{
+    items.clear();
+    scores.clear();
+    std::vector<float> context;
+    if (!model.context(user, context))
+    {
+        return;
+    }
+    std::vector<std::pair<float, docid_t> > all(AD_NUM);
+    for (std::size_t i = 0; i < AD_NUM; ++i)
+    {
+        const std::vector<float>& w = model.weights(i);
+        double score = 0;
+        for (std::size_t k = 0; k < DIM; ++k)
+        {
+            score += (double)w[k] * context[k];
+        }
+        all[i] = std::make_pair((float)score, (docid_t)i);
+    }
+    std::partial_sort(all.begin(), all.begin() + TOPN, all.end(), greaterScore);
+    for (std::size_t i = 0; i < TOPN; ++i)
+    {
+        items.push_back(all[i].second);
+        scores.push_back(1.0 / (1 + std::exp(-all[i].first)));
+    }
+}
+
+float randWeight()
+{
+    return (rand() % 2000) / 1000.0 - 1.0;
+}
+
+std::vector<float> randVector(std::size_t n)
+{
+    std::vector<float> vec(n);
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        vec[k] = randWeight();
+    }
+    return vec;
+}
+
+/*
+ * Write the localized online and offline models, which LaserGenericModel
+ * loads instead of building them from the original models.
+ */
+void writeGenericModel(const std::string& workdir,
+    std::size_t adNum,
+    std::size_t AD_FD,
+    std::size_t USER_FD)
+{
+    std::vector<LaserOnlineModel> adDb;
+    for (std::size_t i = 0; i < adNum; ++i)
+    {
+        adDb.push_back(LaserOnlineModel(randWeight(), randVector(USER_FD)));
+    }
+    LaserModelFileWriter online(workdir + "/per-item-online-model.bin");
+    online.addSection(adDb);
+    BOOST_REQUIRE(online.commit());
+
+    std::vector<float> alpha = randVector(USER_FD);
+    std::vector<float> beta = randVector(AD_FD);
+    std::vector<float> betaStable = randVector(adNum);
+    std::vector<std::vector<float> > conjunction;
+    for (std::size_t i = 0; i < USER_FD; ++i)
+    {
+        conjunction.push_back(randVector(AD_FD));
+    }
+    std::vector<std::vector<float> > conjunctionStable;
+    for (std::size_t i = 0; i < adNum; ++i)
+    {
+        conjunctionStable.push_back(randVector(USER_FD));
+    }
+    LaserModelFileWriter offline(workdir + "/offline-model.bin");
+    offline.addSection(alpha);
+    offline.addSection(beta);
+    offline.addSection(betaStable);
+    offline.addSection(conjunction);
+    offline.addSection(conjunctionStable);
+    BOOST_REQUIRE(offline.commit());
+}
+
+std::vector<std::string> makeUsers(std::size_t n)
+{
+    std::vector<std::string> users;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        std::stringstream ss;
+        ss << "user" << i;
+        users.push_back(ss.str());
+    }
+    return users;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(LaserBatchRecommendTest)
+
+BOOST_AUTO_TEST_CASE(sameAsScalarScore)
+{
+    LinearModel* model = new LinearModel();
+    LaserRecommend recommend(model);
+    std::vector<std::string> users = makeUsers(USER_NUM + 3);
+    users.push_back("nocontext");
+
+    std::vector<std::vector<docid_t> > batchItems;
+    std::vector<std::vector<float> > batchScores;
+    BOOST_REQUIRE(recommend.recommend(users, batchItems, batchScores, TOPN));
+    BOOST_REQUIRE_EQUAL(batchItems.size(), users.size());
+
+    std::vector<docid_t> expectItems;
+    std::vector<float> expectScores;
+    std::vector<docid_t> singleItems;
+    std::vector<float> singleScores;
+    for (std::size_t u = 0; u < users.size(); ++u)
+    {
+        scalarTopN(*model, users[u], expectItems, expectScores);
+        singleItems.clear();
+        singleScores.clear();
+        BOOST_CHECK_EQUAL(recommend.recommend(users[u], singleItems, singleScores, TOPN), !expectItems.empty());
+
+        BOOST_REQUIRE_EQUAL(batchItems[u].size(), expectItems.size());
+        BOOST_REQUIRE_EQUAL(singleItems.size(), expectItems.size());
+        for (std::size_t i = 0; i < expectItems.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(batchItems[u][i], expectItems[i]);
+            BOOST_CHECK_CLOSE(batchScores[u][i], expectScores[i], 1e-3);
+            BOOST_CHECK_EQUAL(singleItems[i], expectItems[i]);
+            BOOST_CHECK_CLOSE(singleScores[i], expectScores[i], 1e-3);
+        }
+    }
+    BOOST_CHECK(batchItems.back().empty());
+    BOOST_CHECK_EQUAL(batchItems.front().size(), TOPN);
+}
+
+BOOST_AUTO_TEST_CASE(noContext)
+{
+    LaserRecommend recommend(new LinearModel());
+    std::vector<std::string> users(2, "nocontext");
+    std::vector<std::vector<docid_t> > items;
+    std::vector<std::vector<float> > scores;
+    BOOST_CHECK(!recommend.recommend(users, items, scores, TOPN));
+}
+
+BOOST_AUTO_TEST_CASE(genericModelBatchScore)
+{
+    const std::string workdir = "./laser_batch_score";
+    const std::size_t GENERIC_AD_NUM = 64;
+    const std::size_t AD_FD = 8;
+    const std::size_t USER_FD = 16;
+    boost::filesystem::remove_all(workdir);
+    boost::filesystem::create_directories(workdir);
+    srand(29);
+    writeGenericModel(workdir, GENERIC_AD_NUM, AD_FD, USER_FD);
+    {
+        AdIndexManager adIndexer(workdir, 0);
+        LaserGenericModel model(adIndexer, "", 0, "localhost", 0,
+            workdir, workdir + "/sys", GENERIC_AD_NUM, AD_FD, USER_FD);
+
+        // 4-user blocks plus a remainder, and one user without context
+        std::vector<std::string> text = makeUsers(7);
+        std::vector<std::vector<float> > context;
+        for (std::size_t u = 0; u + 1 < text.size(); ++u)
+        {
+            context.push_back(randVector(USER_FD));
+        }
+        context.push_back(std::vector<float>());
+
+        // the ads beyond the model keep their scores
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > > ad;
+        for (std::size_t i = 0; i < GENERIC_AD_NUM + 2; ++i)
+        {
+            ad.push_back(std::make_pair(i, std::vector<std::pair<int, float> >(1, std::make_pair(0, 1.0F))));
+        }
+        std::vector<std::size_t> offset(1, 0);
+        std::vector<std::size_t> user;
+        std::vector<float> score;
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            // a single user for some ads, without the merged weights
+            const std::size_t userNum = 0 == i % 5 ? 1 : text.size();
+            for (std::size_t u = 0; u < userNum; ++u)
+            {
+                user.push_back((i + u) % text.size());
+                score.push_back(randWeight());
+            }
+            offset.push_back(user.size());
+        }
+
+        std::vector<float> batchScore(score);
+        model.score(text, context, ad, offset, user, batchScore);
+
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            for (std::size_t k = offset[i]; k < offset[i + 1]; ++k)
+            {
+                const std::size_t u = user[k];
+                const float singleScore = model.score(text[u], context[u], ad[i], score[k]);
+                BOOST_CHECK_SMALL(batchScore[k] - singleScore, 1e-4F);
+            }
+        }
+    }
+    boost::filesystem::remove_all(workdir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
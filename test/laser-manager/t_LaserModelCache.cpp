@@ -0,0 +1,252 @@
+///
+/// @file t_LaserModelCache.cpp
+/// @brief test the decoded model cache
+///
+
+#include "LaserModelCacheTestData.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+#include <sstream>
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::test;
+
+namespace
+{
+
+/*
+ * In-memory db which runs a hook once between reading a value and
+ * returning it, to update the key in the middle of a cache miss.
+ */
+class RacyDB
+{
+public:
+    bool get(const std::string& key, LaserOnlineModel& value)
+    {
+        std::map<std::string, LaserOnlineModel>::const_iterator it = models_.find(key);
+        if (models_.end() == it)
+        {
+            return false;
+        }
+        value = it->second;
+        if (hook_)
+        {
+            boost::function<void()> hook;
+            hook.swap(hook_);
+            hook();
+        }
+        return true;
+    }
+
+    bool update(const std::string& key, const LaserOnlineModel& value)
+    {
+        models_[key] = value;
+        return true;
+    }
+
+    void setHook(const boost::function<void()>& hook)
+    {
+        hook_ = hook;
+    }
+
+private:
+    std::map<std::string, LaserOnlineModel> models_;
+    boost::function<void()> hook_;
+};
+
+typedef LaserModelCache<std::string, LaserOnlineModel, RacyDB> RacyCache;
+
+void updateModel(RacyCache* cache, const std::string& key, std::size_t seed)
+{
+    cache->update(key, makeModel(seed));
+}
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(LaserModelCacheTest, DBFixture)
+
+BOOST_AUTO_TEST_CASE(readThrough)
+{
+    UserCache cache(*db_, 10);
+    UserCache::ValuePtr model = cache.get(user(3));
+    BOOST_REQUIRE(model);
+    BOOST_CHECK(model->eta() == makeModel(3).eta());
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+    // the second get is served by the cache
+    BOOST_CHECK_EQUAL(cache.get(user(3)).get(), model.get());
+
+    BOOST_CHECK(!cache.get("nobody"));
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(leastRecentlyUsedEviction)
+{
+    UserCache cache(*db_, 3);
+    UserCache::ValuePtr first = cache.get(user(0));
+    UserCache::ValuePtr second = cache.get(user(1));
+    cache.get(user(2));
+    // touch user0, user1 becomes the oldest and goes first
+    BOOST_CHECK_EQUAL(cache.get(user(0)).get(), first.get());
+    cache.get(user(3));
+    BOOST_CHECK_EQUAL(cache.size(), 3U);
+    BOOST_CHECK_EQUAL(cache.get(user(0)).get(), first.get());
+    // the evicted value stays valid for its holder, get() reloads it
+    UserCache::ValuePtr reloaded = cache.get(user(1));
+    BOOST_CHECK_NE(reloaded.get(), second.get());
+    BOOST_CHECK(second->eta() == makeModel(1).eta());
+    BOOST_CHECK(reloaded->eta() == makeModel(1).eta());
+    BOOST_CHECK_EQUAL(cache.size(), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(updateWritesThrough)
+{
+    UserCache cache(*db_, 10);
+    UserCache::ValuePtr old = cache.get(user(5));
+    BOOST_REQUIRE(cache.update(user(5), makeModel(1000)));
+    UserCache::ValuePtr model = cache.get(user(5));
+    BOOST_REQUIRE(model);
+    BOOST_CHECK(model->eta() == makeModel(1000).eta());
+    BOOST_CHECK(old->eta() == makeModel(5).eta());
+
+    LaserOnlineModel stored;
+    BOOST_REQUIRE(db_->get(user(5), stored));
+    BOOST_CHECK(stored.eta() == makeModel(1000).eta());
+}
+
+BOOST_AUTO_TEST_CASE(dbFailedToOpen)
+{
+    // a regular file where the leveldb directory should be
+    const std::string path = "./t_LaserModelCache.file";
+    {
+        std::ofstream ofs(path.c_str());
+        ofs << "not a db";
+    }
+    {
+        UserDB db(path);
+        BOOST_CHECK(!db.isOpen());
+        LaserOnlineModel model;
+        BOOST_CHECK(!db.get(user(1), model));
+        BOOST_CHECK(!db.update(user(1), makeModel(1)));
+        BOOST_CHECK(!(db.begin() != db.end()));
+
+        UserCache cache(db, 10);
+        BOOST_CHECK(!cache.get(user(1)));
+        BOOST_CHECK(!cache.update(user(1), makeModel(1)));
+    }
+    boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_CASE(updateDuringMiss)
+{
+    RacyDB db;
+    db.update(user(1), makeModel(1));
+    db.update(user(2), makeModel(2));
+    RacyCache cache(db, 10);
+
+    // the miss read the old model before the update, it is returned but
+    // not cached
+    db.setHook(boost::bind(updateModel, &cache, user(1), 1001));
+    RacyCache::ValuePtr old = cache.get(user(1));
+    BOOST_REQUIRE(old);
+    BOOST_CHECK(old->eta() == makeModel(1).eta());
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    RacyCache::ValuePtr model = cache.get(user(1));
+    BOOST_REQUIRE(model);
+    BOOST_CHECK(model->eta() == makeModel(1001).eta());
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+
+    // the same for the multi-get
+    std::vector<std::string> keys;
+    keys.push_back(user(2));
+    std::vector<RacyCache::ValuePtr> values;
+    db.setHook(boost::bind(updateModel, &cache, user(2), 1002));
+    cache.get(keys, values);
+    BOOST_REQUIRE(values[0]);
+    BOOST_CHECK(values[0]->eta() == makeModel(2).eta());
+    model = cache.get(user(2));
+    BOOST_REQUIRE(model);
+    BOOST_CHECK(model->eta() == makeModel(1002).eta());
+}
+
+BOOST_AUTO_TEST_CASE(multiGet)
+{
+    UserCache cache(*db_, 10);
+    UserCache::ValuePtr cached = cache.get(user(1));
+    std::vector<std::string> keys;
+    keys.push_back(user(1));
+    keys.push_back("nobody");
+    keys.push_back(user(2));
+    std::vector<UserCache::ValuePtr> values;
+    cache.get(keys, values);
+    BOOST_REQUIRE_EQUAL(values.size(), keys.size());
+    BOOST_CHECK_EQUAL(values[0].get(), cached.get());
+    BOOST_CHECK(!values[1]);
+    BOOST_REQUIRE(values[2]);
+    BOOST_CHECK(values[2]->eta() == makeModel(2).eta());
+
+    UserCache::Stats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits, 1U);
+    BOOST_CHECK_EQUAL(stats.misses, 3U);
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+    // user2 was loaded by the multi-get
+    BOOST_CHECK_EQUAL(cache.get(user(2)).get(), values[2].get());
+    BOOST_CHECK_EQUAL(cache.stats().hits, 2U);
+}
+
+BOOST_AUTO_TEST_CASE(skewedWorkload)
+{
+    const std::size_t lookupNum = 2000;
+    const ZipfUsers zipf(USER_NUM);
+    UserCache cache(*db_, HOT_USER_NUM);
+    srand(7);
+    for (std::size_t i = 0; i < lookupNum; ++i)
+    {
+        const std::string key = user(zipf.next());
+        UserCache::ValuePtr model = cache.get(key);
+        BOOST_REQUIRE(model);
+        LaserOnlineModel expected;
+        BOOST_REQUIRE(db_->get(key, expected));
+        BOOST_CHECK(model->eta() == expected.eta());
+    }
+
+    UserCache::Stats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, lookupNum);
+    BOOST_CHECK_EQUAL(stats.misses - stats.evictions, HOT_USER_NUM);
+    // the hottest quarter of the users take about 3/4 of the lookups
+    BOOST_CHECK_GT(stats.hitRate(), 0.5);
+}
+
+/*
+ * TopnClusteringModel::score used to read and decode the user model from
+ * the db for every candidate, now once per request through the cache.
+ */
+BOOST_AUTO_TEST_CASE(scoreRequests)
+{
+    std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > > ad;
+    makeAds(ad);
+    static const std::vector<std::pair<int, float> > context;
+
+    UserCache cache(*db_, HOT_USER_NUM);
+    for (std::size_t r = 0; r < 2 * HOT_USER_NUM; ++r)
+    {
+        const std::string text = user(r % HOT_USER_NUM);
+        LaserOnlineModel expected;
+        BOOST_REQUIRE(db_->get(text, expected));
+        UserCache::ValuePtr model = cache.get(text);
+        BOOST_REQUIRE(model);
+        for (std::size_t i = 0; i < ad.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(model->score(text, context, ad[i], 0), expected.score(text, context, ad[i], 0));
+        }
+    }
+    BOOST_CHECK_EQUAL(cache.stats().misses, HOT_USER_NUM);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
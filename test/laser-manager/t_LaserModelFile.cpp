@@ -0,0 +1,156 @@
+///
+/// @file t_LaserModelFile.cpp
+/// @brief test the mmap-able laser model file format
+///
+
+#include <laser-manager/LaserModelFile.h>
+#include <laser-manager/LaserOnlineModel.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/vector.hpp>
+#include <fstream>
+
+using namespace sf1r::laser;
+namespace bfs = boost::filesystem;
+
+namespace
+{
+const std::string TEST_DIR = "laser_model_file_test";
+const std::string TEST_FILE = TEST_DIR + "/model.bin";
+
+void prepareDir()
+{
+    bfs::remove_all(TEST_DIR);
+    bfs::create_directories(TEST_DIR);
+}
+
+void saveLegacyModel(const std::string& filename, const std::vector<LaserOnlineModel>& models)
+{
+    std::ofstream ofs(filename.c_str(), std::ofstream::binary | std::ofstream::trunc);
+    boost::archive::binary_oarchive oa(ofs);
+    oa << models;
+}
+
+void checkModels(const std::vector<LaserOnlineModel>& models,
+    const std::vector<LaserOnlineModel>& models2)
+{
+    BOOST_REQUIRE_EQUAL(models2.size(), models.size());
+    for (std::size_t i = 0; i < models.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(models2[i].delta(), models[i].delta());
+        BOOST_CHECK(models2[i].eta() == models[i].eta());
+    }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(LaserModelFileTest)
+
+BOOST_AUTO_TEST_CASE(roundTrip)
+{
+    prepareDir();
+    std::vector<float> alpha;
+    for (int i = 0; i < 13; ++i)
+        alpha.push_back(i * 0.5);
+    std::vector<std::vector<float> > mat(7);
+    for (int i = 0; i < 7; ++i)
+        mat[i].assign(i + 1, i);
+    std::vector<LaserOnlineModel> models;
+    for (int i = 0; i < 5; ++i)
+        models.push_back(LaserOnlineModel(i, std::vector<float>(9, i * 2)));
+
+    LaserModelFileWriter writer(TEST_FILE);
+    writer.addSection(alpha);
+    writer.addSection(mat);
+    writer.addSection(models);
+    BOOST_CHECK(writer.commit());
+    BOOST_CHECK(!bfs::exists(TEST_FILE + ".tmp"));
+
+    LaserModelFileReader reader;
+    BOOST_REQUIRE(reader.open(TEST_FILE));
+    BOOST_CHECK_EQUAL(reader.sectionNum(), 3U);
+
+    std::vector<float> alpha2;
+    BOOST_CHECK(reader.load(0, alpha2));
+    BOOST_CHECK(alpha == alpha2);
+
+    // ragged rows are padded to the widest one
+    std::vector<std::vector<float> > mat2;
+    BOOST_CHECK(reader.load(1, mat2));
+    BOOST_REQUIRE_EQUAL(mat2.size(), mat.size());
+    for (std::size_t i = 0; i < mat.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(mat2[i].size(), 7U);
+        BOOST_CHECK(std::equal(mat[i].begin(), mat[i].end(), mat2[i].begin()));
+    }
+
+    std::vector<LaserOnlineModel> models2;
+    BOOST_CHECK(reader.load(2, models2));
+    BOOST_REQUIRE_EQUAL(models2.size(), models.size());
+    for (std::size_t i = 0; i < models.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(models2[i].delta(), models[i].delta());
+        BOOST_CHECK(models2[i].eta() == models[i].eta());
+    }
+    bfs::remove_all(TEST_DIR);
+}
+
+BOOST_AUTO_TEST_CASE(checksumMismatch)
+{
+    prepareDir();
+    std::vector<float> alpha(1024, 1.0);
+    LaserModelFileWriter writer(TEST_FILE);
+    writer.addSection(alpha);
+    BOOST_REQUIRE(writer.commit());
+
+    {
+        std::fstream fs(TEST_FILE.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        fs.seekp(bfs::file_size(TEST_FILE) - 16);
+        const float bad = 2.0;
+        fs.write(reinterpret_cast<const char*>(&bad), sizeof(bad));
+    }
+
+    LaserModelFileReader reader;
+    BOOST_CHECK(!reader.open(TEST_FILE));
+    BOOST_CHECK(!reader.open(TEST_DIR + "/not-exist.bin"));
+    bfs::remove_all(TEST_DIR);
+}
+
+BOOST_AUTO_TEST_CASE(legacyArchive)
+{
+    prepareDir();
+    const std::string name = "per-item-online-model";
+    std::vector<LaserOnlineModel> models;
+    for (int i = 0; i < 5; ++i)
+        models.push_back(LaserOnlineModel(i, std::vector<float>(9, i * 3)));
+
+    BOOST_CHECK(legacyModelPath(TEST_DIR, name).empty());
+
+    // the path under workdir
+    saveLegacyModel(TEST_DIR + "/" + name, models);
+    BOOST_REQUIRE_EQUAL(legacyModelPath(TEST_DIR, name), TEST_DIR + "/" + name);
+    std::vector<LaserOnlineModel> models2;
+    BOOST_CHECK(loadLegacyModel(legacyModelPath(TEST_DIR, name), models2));
+    checkModels(models, models2);
+
+    // the path without separator saved by older versions
+    bfs::remove(TEST_DIR + "/" + name);
+    saveLegacyModel(TEST_DIR + name, models);
+    BOOST_REQUIRE_EQUAL(legacyModelPath(TEST_DIR, name), TEST_DIR + name);
+    std::vector<LaserOnlineModel> models3;
+    BOOST_CHECK(loadLegacyModel(legacyModelPath(TEST_DIR, name), models3));
+    checkModels(models, models3);
+    bfs::remove(TEST_DIR + name);
+
+    // not an archive
+    {
+        std::ofstream ofs((TEST_DIR + "/" + name).c_str());
+        ofs << "not an archive";
+    }
+    std::vector<LaserOnlineModel> models4;
+    BOOST_CHECK(!loadLegacyModel(TEST_DIR + "/" + name, models4));
+    BOOST_CHECK(!loadLegacyModel(TEST_DIR + "/not-exist", models4));
+    bfs::remove_all(TEST_DIR);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
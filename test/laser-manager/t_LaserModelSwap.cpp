@@ -0,0 +1,281 @@
+///
+/// @file t_LaserModelSwap.cpp
+/// @brief stress test model reloads under recommend traffic
+///
+
+#include <laser-manager/LaserRecommend.h>
+#include <laser-manager/LaserModel.h>
+#include <laser-manager/EpochManager.h>
+#include <laser-manager/EpochRowTable.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <cmath>
+
+using namespace sf1r::laser;
+
+namespace
+{
+const std::size_t MODEL_SIZE = 4096;
+const std::size_t AD_NUM = 256;
+const float POISON = -1.0;
+
+boost::atomic<int> gAliveModels(0);
+
+/*
+ * Every weight of a FakeModel equals its generation, and the destructor
+ * poisons them. A recommend that mixes two models, or reads a deleted
+ * one, returns scores that differ from each other.
+ */
+class FakeModel : public LaserModel
+{
+public:
+    FakeModel(float generation)
+        : weights_(MODEL_SIZE, generation)
+    {
+        ++gAliveModels;
+    }
+
+    ~FakeModel()
+    {
+        std::fill(weights_.begin(), weights_.end(), POISON);
+        --gAliveModels;
+    }
+
+public:
+    virtual bool candidate(
+        const std::string& text,
+        const std::size_t ncandidate,
+        const std::vector<std::pair<int, float> >& context,
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        std::vector<float>& score) const
+    {
+        return false;
+    }
+
+    virtual bool candidate(
+        const std::string& text,
+        const std::size_t ncandidate,
+        const std::vector<float>& context,
+        std::vector<std::pair<docid_t, std::vector<std::pair<int, float> > > >& ad,
+        std::vector<float>& score) const
+    {
+        static const std::vector<std::pair<int, float> > empty;
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            ad.push_back(std::make_pair(i, empty));
+        }
+        score.assign(ad.size(), 0);
+        return true;
+    }
+
+    virtual float score(
+        const std::string& text,
+        const std::vector<std::pair<int, float> >& context,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const
+    {
+        return 0;
+    }
+
+    virtual float score(
+        const std::string& text,
+        const std::vector<float>& context,
+        const std::pair<docid_t, std::vector<std::pair<int, float> > >& ad,
+        const float score) const
+    {
+        const float weight = weights_[ad.first * 13 % MODEL_SIZE];
+        if (context.empty() || context[0] != weight)
+        {
+            // context came from another model
+            return POISON - ad.first;
+        }
+        return weight;
+    }
+
+    virtual bool context(const std::string& text, std::vector<std::pair<int, float> >& context) const
+    {
+        return false;
+    }
+
+    virtual bool context(const std::string& text, std::vector<float>& context) const
+    {
+        context.assign(8, weights_[0]);
+        return true;
+    }
+
+    virtual void dispatch(const std::string& method, msgpack::rpc::request& req)
+    {
+    }
+
+private:
+    std::vector<float> weights_;
+};
+
+void recommendLoop(const LaserRecommend& recommend,
+    const boost::atomic<bool>& stop,
+    boost::atomic<int>& errors,
+    boost::atomic<int>& requests)
+{
+    while (!stop.load())
+    {
+        std::vector<docid_t> itemList;
+        std::vector<float> itemScoreList;
+        if (!recommend.recommend("user", itemList, itemScoreList, 10) ||
+            itemScoreList.size() != 10)
+        {
+            ++errors;
+            continue;
+        }
+        for (std::size_t i = 1; i < itemScoreList.size(); ++i)
+        {
+            if (itemScoreList[i] != itemScoreList[0])
+            {
+                ++errors;
+                break;
+            }
+        }
+        ++requests;
+    }
+}
+
+typedef EpochRowTable<std::vector<float> > RowTable;
+
+// every weight of a row equals its generation, see FakeModel
+void readRowLoop(const RowTable& table,
+    const boost::atomic<bool>& stop,
+    boost::atomic<int>& errors,
+    boost::atomic<int>& requests)
+{
+    while (!stop.load())
+    {
+        EpochManager::ReadGuard guard(*EpochManager::get());
+        for (std::size_t i = 0; i < table.size(); ++i)
+        {
+            const std::vector<float>& row = table[i];
+            for (std::size_t k = 1; k < row.size(); ++k)
+            {
+                if (row[k] != row[0])
+                {
+                    ++errors;
+                    break;
+                }
+            }
+        }
+        ++requests;
+    }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(LaserModelSwapTest)
+
+BOOST_AUTO_TEST_CASE(reloadUnderTraffic)
+{
+    const std::size_t READER_NUM = 8;
+    const std::size_t RELOAD_NUM = 20000;
+    boost::atomic<bool> stop(false);
+    boost::atomic<int> errors(0);
+    boost::atomic<int> requests(0);
+    {
+        LaserRecommend recommend(new FakeModel(1));
+        boost::thread_group readers;
+        for (std::size_t i = 0; i < READER_NUM; ++i)
+        {
+            readers.create_thread(boost::bind(recommendLoop,
+                boost::cref(recommend), boost::cref(stop),
+                boost::ref(errors), boost::ref(requests)));
+        }
+        for (std::size_t i = 0; i < RELOAD_NUM; ++i)
+        {
+            recommend.swapModel(new FakeModel(2 + i % 100));
+        }
+        stop.store(true);
+        readers.join_all();
+    }
+    EpochManager::get()->reclaim();
+
+    BOOST_TEST_MESSAGE("recommend requests: " << requests.load());
+    BOOST_CHECK_EQUAL(errors.load(), 0);
+    BOOST_CHECK_GT(requests.load(), 0);
+    BOOST_CHECK_EQUAL(gAliveModels.load(), 0);
+    BOOST_CHECK_EQUAL(EpochManager::get()->retiredNum(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(updateRowsUnderTraffic)
+{
+    const std::size_t READER_NUM = 8;
+    const std::size_t UPDATE_NUM = 200000;
+    const std::size_t ROW_SIZE = 64;
+    boost::atomic<bool> stop(false);
+    boost::atomic<int> errors(0);
+    boost::atomic<int> requests(0);
+    {
+        std::vector<std::vector<float> > rows(AD_NUM, std::vector<float>(ROW_SIZE, 1));
+        RowTable table(rows);
+        BOOST_CHECK(rows.empty());
+        BOOST_CHECK_EQUAL(table.size(), AD_NUM);
+
+        boost::thread_group readers;
+        for (std::size_t i = 0; i < READER_NUM; ++i)
+        {
+            readers.create_thread(boost::bind(readRowLoop,
+                boost::cref(table), boost::cref(stop),
+                boost::ref(errors), boost::ref(requests)));
+        }
+        for (std::size_t i = 0; i < UPDATE_NUM; ++i)
+        {
+            table.update(i * 13 % AD_NUM, std::vector<float>(ROW_SIZE, 2 + i % 100));
+        }
+        stop.store(true);
+        readers.join_all();
+
+        table.copyTo(rows);
+        BOOST_CHECK_EQUAL(rows.size(), AD_NUM);
+        for (std::size_t i = 0; i < AD_NUM; ++i)
+        {
+            BOOST_CHECK_EQUAL(rows[i][0], table[i][0]);
+        }
+    }
+    EpochManager::get()->reclaim();
+
+    BOOST_TEST_MESSAGE("read requests: " << requests.load());
+    BOOST_CHECK_EQUAL(errors.load(), 0);
+    BOOST_CHECK_GT(requests.load(), 0);
+    BOOST_CHECK_EQUAL(EpochManager::get()->retiredNum(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(overflowReaders)
+{
+    const std::size_t OVERFLOW_NUM = 8;
+    EpochManager manager;
+    {
+        // nested guards more than the slots
+        std::vector<EpochManager::ReadGuard*> guards;
+        for (std::size_t i = 0; i < EpochManager::SLOT_NUM + OVERFLOW_NUM; ++i)
+        {
+            guards.push_back(new EpochManager::ReadGuard(manager));
+        }
+        BOOST_CHECK_EQUAL(manager.overflowNum(), OVERFLOW_NUM);
+
+        // release the slots, the overflow readers still pin the model
+        for (std::size_t i = 0; i < EpochManager::SLOT_NUM; ++i)
+        {
+            delete guards[i];
+        }
+        manager.retire(new FakeModel(1));
+        BOOST_CHECK_EQUAL(manager.retiredNum(), 1U);
+        BOOST_CHECK_EQUAL(gAliveModels.load(), 1);
+
+        for (std::size_t i = EpochManager::SLOT_NUM; i < guards.size(); ++i)
+        {
+            delete guards[i];
+        }
+    }
+    BOOST_CHECK_EQUAL(manager.overflowNum(), 0U);
+
+    manager.reclaim();
+    BOOST_CHECK_EQUAL(manager.retiredNum(), 0U);
+    BOOST_CHECK_EQUAL(gAliveModels.load(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
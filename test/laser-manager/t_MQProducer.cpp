@@ -0,0 +1,256 @@
+///
+/// @file t_MQProducer.cpp
+/// @brief test batching, overflow policies and shutdown of the laser mq producer,
+///        and compare the cost on the calling thread against a synchronous round trip
+///
+
+#include <laser-manager/context/MQProducer.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <sstream>
+
+using namespace sf1r::laser::context;
+
+namespace
+{
+const std::size_t THREAD_NUM = 4;
+const std::size_t MESSAGE_NUM = 1000;
+// one round trip to the sink
+const long RTT_US = 100;
+
+std::string topic(std::size_t i)
+{
+    std::stringstream ss;
+    ss << i;
+    return ss.str();
+}
+
+/*
+ * Local stand-in for the mq rpc server, every batch costs one round trip
+ * and may be held back until the test opens the gate.
+ */
+class Sink
+{
+public:
+    Sink()
+        : open_(true)
+        , batches_(0)
+        , maxBatch_(0)
+    {
+    }
+
+public:
+    bool send(const std::vector<MQMessage>& batch)
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!open_)
+        {
+            cond_.wait(lock);
+        }
+        boost::this_thread::sleep(boost::posix_time::microseconds(RTT_US));
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            topics_.push_back(batch[i].topic);
+            data_.push_back(batch[i].data);
+        }
+        ++batches_;
+        maxBatch_ = std::max(maxBatch_, batch.size());
+        return true;
+    }
+
+    void close()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        open_ = false;
+    }
+
+    void open()
+    {
+        boost::mutex::scoped_lock lock(mutex_);
+        open_ = true;
+        cond_.notify_all();
+    }
+
+    std::vector<std::string> topics_;
+    std::vector<std::string> data_;
+    std::size_t batches_;
+    std::size_t maxBatch_;
+
+private:
+    bool open_;
+    boost::mutex mutex_;
+    boost::condition_variable cond_;
+};
+
+MQProducer::Options options(std::size_t capacity, std::size_t batchSize,
+    std::size_t lingerMs, MQProducer::OverflowPolicy policy)
+{
+    MQProducer::Options options;
+    options.capacity = capacity;
+    options.batchSize = batchSize;
+    options.lingerMs = lingerMs;
+    options.policy = policy;
+    return options;
+}
+
+void produce(MQProducer& producer, std::size_t id, std::size_t n)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        producer.push("publish", topic(id * n + i));
+    }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(MQProducerTest)
+
+BOOST_AUTO_TEST_CASE(batchBySize)
+{
+    Sink sink;
+    MQProducer producer(boost::bind(&Sink::send, &sink, _1), options(1000, 10, 10000, MQProducer::BLOCK));
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        BOOST_REQUIRE(producer.push("publish", topic(i), "x", 1));
+    }
+    producer.flush();
+    BOOST_REQUIRE_EQUAL(sink.topics_.size(), 100U);
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        BOOST_CHECK_EQUAL(sink.topics_[i], topic(i));
+        BOOST_CHECK_EQUAL(sink.data_[i], "x");
+    }
+    BOOST_CHECK_EQUAL(sink.maxBatch_, 10U);
+    const MQProducer::Counters c = producer.counters();
+    BOOST_CHECK_EQUAL(c.enqueued, 100U);
+    BOOST_CHECK_EQUAL(c.flushed, 100U);
+    BOOST_CHECK_EQUAL(c.batches, sink.batches_);
+    BOOST_CHECK(c.batches <= 11);
+}
+
+BOOST_AUTO_TEST_CASE(batchByTime)
+{
+    Sink sink;
+    MQProducer producer(boost::bind(&Sink::send, &sink, _1), options(1000, 1000, 20, MQProducer::DROP));
+    for (std::size_t i = 0; i < 5; ++i)
+    {
+        producer.push("publish", topic(i));
+    }
+    // no flush, the linger time alone sends the partial batch
+    boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+    BOOST_CHECK_EQUAL(producer.counters().flushed, 5U);
+    BOOST_CHECK_EQUAL(producer.counters().batches, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(dropOnOverflow)
+{
+    Sink sink;
+    sink.close();
+    MQProducer producer(boost::bind(&Sink::send, &sink, _1), options(8, 4, 0, MQProducer::DROP));
+    std::size_t pushed = 0;
+    for (std::size_t i = 0; i < 100; ++i)
+    {
+        if (producer.push("publish", topic(i)))
+            ++pushed;
+    }
+    // the ring and at most one batch in flight
+    BOOST_CHECK(pushed >= 8 && pushed <= 12);
+    MQProducer::Counters c = producer.counters();
+    BOOST_CHECK_EQUAL(c.enqueued, pushed);
+    BOOST_CHECK_EQUAL(c.dropped, 100 - pushed);
+
+    sink.open();
+    producer.flush();
+    c = producer.counters();
+    BOOST_CHECK_EQUAL(c.flushed, pushed);
+    BOOST_CHECK_EQUAL(sink.topics_.size(), pushed);
+}
+
+BOOST_AUTO_TEST_CASE(blockOnOverflow)
+{
+    Sink sink;
+    MQProducer producer(boost::bind(&Sink::send, &sink, _1), options(8, 4, 1, MQProducer::BLOCK));
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        threads.create_thread(boost::bind(produce, boost::ref(producer), i, MESSAGE_NUM));
+    }
+    threads.join_all();
+    producer.flush();
+
+    const MQProducer::Counters c = producer.counters();
+    BOOST_CHECK_EQUAL(c.dropped, 0U);
+    BOOST_CHECK_EQUAL(c.flushed, THREAD_NUM * MESSAGE_NUM);
+    BOOST_CHECK(sink.maxBatch_ <= 4);
+    // nothing lost, nothing repeated, each thread in its own order
+    std::vector<std::size_t> last(THREAD_NUM, 0);
+    std::vector<bool> seen(THREAD_NUM * MESSAGE_NUM, false);
+    for (std::size_t i = 0; i < sink.topics_.size(); ++i)
+    {
+        const std::size_t t = atoi(sink.topics_[i].c_str());
+        BOOST_REQUIRE(t < seen.size() && !seen[t]);
+        seen[t] = true;
+        const std::size_t id = t / MESSAGE_NUM;
+        BOOST_CHECK(0 == t % MESSAGE_NUM || last[id] + 1 == t);
+        last[id] = t;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shutdownDelivers)
+{
+    Sink sink;
+    MQProducer producer(boost::bind(&Sink::send, &sink, _1), options(100, 50, 10000, MQProducer::DROP));
+    for (std::size_t i = 0; i < 7; ++i)
+    {
+        producer.push("publish", topic(i));
+    }
+    producer.shutdown();
+    BOOST_CHECK_EQUAL(sink.topics_.size(), 7U);
+    BOOST_CHECK(!producer.push("publish", topic(7)));
+    BOOST_CHECK_EQUAL(producer.counters().dropped, 1U);
+    producer.flush();
+    producer.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(callerLatency)
+{
+    std::vector<double> sync;
+    std::vector<double> async;
+    {
+        // publish before the producer, one round trip per message
+        Sink sink;
+        std::vector<MQMessage> batch(1);
+        for (std::size_t i = 0; i < MESSAGE_NUM; ++i)
+        {
+            batch[0].topic = topic(i);
+            boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+            sink.send(batch);
+            sync.push_back((boost::posix_time::microsec_clock::local_time() - stime).total_microseconds());
+        }
+    }
+    boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+    Sink sink;
+    MQProducer producer(boost::bind(&Sink::send, &sink, _1));
+    for (std::size_t i = 0; i < MESSAGE_NUM; ++i)
+    {
+        const std::string t = topic(i);
+        boost::posix_time::ptime stime = boost::posix_time::microsec_clock::local_time();
+        producer.push("publish", t);
+        async.push_back((boost::posix_time::microsec_clock::local_time() - stime).total_microseconds());
+    }
+    producer.flush();
+    const long total = (boost::posix_time::microsec_clock::local_time() - stime).total_milliseconds();
+    BOOST_CHECK_EQUAL(producer.counters().flushed, MESSAGE_NUM);
+
+    std::sort(sync.begin(), sync.end());
+    std::sort(async.begin(), async.end());
+    BOOST_CHECK(async[MESSAGE_NUM / 2] < sync[MESSAGE_NUM / 2]);
+    BOOST_TEST_MESSAGE(MESSAGE_NUM << " messages, " << RTT_US << "us sink round trip, sync p50: "
+        << sync[MESSAGE_NUM / 2] << "us p99: " << sync[MESSAGE_NUM * 99 / 100]
+        << "us, enqueue p50: " << async[MESSAGE_NUM / 2] << "us p99: " << async[MESSAGE_NUM * 99 / 100]
+        << "us, all flushed in " << total << "ms with " << producer.counters().batches << " batches");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
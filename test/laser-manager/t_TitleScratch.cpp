@@ -0,0 +1,93 @@
+///
+/// @file t_TitleScratch.cpp
+/// @brief test slim title scoring with a dense scratch
+///
+
+#include <slim-manager/TitleScratch.h>
+#include "TitleScratchTestData.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+#include <cmath>
+
+using namespace sf1r::laser;
+using namespace sf1r::slim;
+using namespace sf1r::slim::test;
+
+BOOST_AUTO_TEST_SUITE(TitleScratchTest)
+
+BOOST_AUTO_TEST_CASE(dot)
+{
+    AdVectorArena arena;
+    Vector ad;
+    ad.push_back(std::make_pair(1, 2.0));
+    ad.push_back(std::make_pair(5, 1.0));
+    ad.push_back(std::make_pair(9, 3.0));
+    ad.push_back(std::make_pair(20, 4.0));
+    arena.append(0, ad);
+    AdVectorView view;
+    BOOST_REQUIRE(arena.get(0, view));
+
+    TitleScratch scratch;
+    BOOST_CHECK(scratch.empty());
+    BOOST_CHECK_EQUAL(scratch.dot(view), 0.0);
+
+    Vector title;
+    title.push_back(std::make_pair(5, 0.5));
+    title.push_back(std::make_pair(9, 0.25));
+    title.push_back(std::make_pair(12, 1.0));
+    scratch.assign(title);
+    BOOST_CHECK_CLOSE(scratch.dot(view), 0.5 * 1.0 + 0.25 * 3.0, 1e-4);
+
+    // a new title replaces the old one completely
+    title.clear();
+    title.push_back(std::make_pair(1, 1.0));
+    scratch.assign(title);
+    BOOST_CHECK_CLOSE(scratch.dot(view), 2.0, 1e-4);
+
+    // a repeated term keeps its last weight, like the title map did
+    title.clear();
+    title.push_back(std::make_pair(5, 0.5));
+    title.push_back(std::make_pair(5, 0.25));
+    scratch.assign(title);
+    BOOST_CHECK_CLOSE(scratch.dot(view), 0.25, 1e-4);
+    boost::unordered_map<int, float> map;
+    for (std::size_t k = 0; k < title.size(); ++k)
+    {
+        map[title[k].first] = title[k].second;
+    }
+    BOOST_CHECK_CLOSE(scratch.dot(view), hashDot(map, view), 1e-4);
+    scratch.clear();
+    BOOST_CHECK_EQUAL(scratch.dot(view), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(sameAsHashProbe)
+{
+    const std::size_t adNum = 500;
+    const std::size_t titleNum = 50;
+    srand(17);
+    AdVectorArena arena;
+    for (std::size_t i = 0; i < adNum; ++i)
+    {
+        arena.append(i, makeVector(AD_TERM_NUM));
+    }
+
+    TitleScratch scratch;
+    for (std::size_t t = 0; t < titleNum; ++t)
+    {
+        const Vector vec = makeVector(TITLE_TERM_NUM);
+        boost::unordered_map<int, float> title;
+        for (std::size_t k = 0; k < vec.size(); ++k)
+        {
+            title[vec[k].first] = vec[k].second;
+        }
+        scratch.assign(vec);
+        for (std::size_t i = 0; i < adNum; ++i)
+        {
+            AdVectorView ad;
+            BOOST_REQUIRE(arena.get(i, ad));
+            BOOST_CHECK_SMALL(scratch.dot(ad) - hashDot(title, ad), 1e-5f);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,170 @@
+///
+/// @file t_TokenizeCache.cpp
+/// @brief test the tokenized title cache and count allocations of a cached lookup
+///
+
+#include "TokenizeCacheTestData.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+boost::atomic<std::size_t> allocNum(0);
+}
+
+// every allocation of this test binary is counted
+void* operator new(std::size_t size)
+{
+    ++allocNum;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (NULL == p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+using namespace sf1r::laser;
+using namespace sf1r::laser::test;
+
+namespace
+{
+// every title collides
+uint64_t sameHash(const std::string& title)
+{
+    return 42;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(TokenizeCacheTest)
+
+BOOST_AUTO_TEST_CASE(getAndInsert)
+{
+    TokenizeCache cache(64);
+    BOOST_CHECK(NULL == cache.get("a").get());
+
+    Vector vec = tokenize(1);
+    TokenizeCache::TokenVectorPtr res = cache.insert("a", vec);
+    BOOST_CHECK(vec.empty());
+    BOOST_REQUIRE(NULL != res.get());
+    BOOST_CHECK(tokenize(1) == *res);
+    BOOST_CHECK(res == cache.get("a"));
+
+    // the first insert wins
+    vec = tokenize(2);
+    BOOST_CHECK(tokenize(1) == *cache.insert("a", vec));
+
+    const TokenizeCache::Stats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits, 1U);
+    BOOST_CHECK_EQUAL(stats.misses, 1U);
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(hashCollision)
+{
+    TokenizeCache cache(64, sameHash);
+    Vector vec = tokenize(1);
+    cache.insert("a", vec);
+    BOOST_CHECK(NULL == cache.get("b").get());
+    BOOST_CHECK(tokenize(1) == *cache.get("a"));
+
+    // the colliding title replaces the cached one instead of getting its tokens
+    vec = tokenize(2);
+    BOOST_CHECK(tokenize(2) == *cache.insert("b", vec));
+    BOOST_CHECK(tokenize(2) == *cache.get("b"));
+    BOOST_CHECK(NULL == cache.get("a").get());
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(evict)
+{
+    TokenizeCache cache(CACHE_SIZE);
+    for (std::size_t i = 0; i < TITLE_NUM; ++i)
+    {
+        Vector vec = tokenize(i);
+        cache.insert(title(i), vec);
+        // keep the first title hot
+        BOOST_REQUIRE(NULL != cache.get(title(0)).get());
+    }
+    BOOST_CHECK(cache.size() <= CACHE_SIZE);
+    BOOST_CHECK(cache.size() > CACHE_SIZE / 2);
+    BOOST_CHECK_EQUAL(cache.stats().evictions, TITLE_NUM - cache.size());
+    BOOST_CHECK(NULL != cache.get(title(TITLE_NUM - 1)).get());
+
+    // an evicted vector stays valid for whoever still holds it
+    TokenizeCache small(0);
+    Vector vec = tokenize(3);
+    TokenizeCache::TokenVectorPtr res = small.insert("b", vec);
+    BOOST_CHECK(tokenize(3) == *res);
+    BOOST_CHECK(NULL == small.get("b").get());
+}
+
+BOOST_AUTO_TEST_CASE(allocationPerRequest)
+{
+    // titles are spread over shards by hash, stay clear of the capacity
+    const std::size_t titleNum = CACHE_SIZE / 4;
+    TokenizeCache cache(CACHE_SIZE);
+    std::vector<std::string> titles;
+    for (std::size_t i = 0; i < titleNum; ++i)
+    {
+        titles.push_back(title(i));
+        Vector vec = tokenize(i);
+        cache.insert(titles[i], vec);
+    }
+
+    const std::size_t n = 10000;
+    std::size_t start = allocNum.load();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        TokenizeCache::TokenVectorPtr vec = cache.get(titles[i % titleNum]);
+        BOOST_REQUIRE(NULL != vec.get());
+    }
+    const std::size_t hitAlloc = allocNum.load() - start;
+
+    start = allocNum.load();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        Vector vec = tokenize(i % titleNum);
+    }
+    const std::size_t tokenizeAlloc = allocNum.load() - start;
+
+    BOOST_CHECK_EQUAL(hitAlloc, 0U);
+    BOOST_TEST_MESSAGE("allocations per request, cached: " << (double)hitAlloc / n
+        << ", building the vector alone: " << (double)tokenizeAlloc / n);
+}
+
+BOOST_AUTO_TEST_CASE(concurrentLookups)
+{
+    const std::size_t requestNum = 20000;
+    std::vector<std::string> titles;
+    for (std::size_t i = 0; i < TITLE_NUM; ++i)
+    {
+        titles.push_back(title(i));
+    }
+    TokenizeCache cache(CACHE_SIZE);
+    boost::atomic<std::size_t> mismatch(0);
+
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        threads.create_thread(boost::bind(request, boost::ref(cache), boost::cref(titles),
+            (unsigned int)(i + 1), requestNum / THREAD_NUM, boost::ref(mismatch)));
+    }
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(mismatch.load(), 0U);
+    BOOST_CHECK(cache.size() <= CACHE_SIZE);
+    const TokenizeCache::Stats stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, requestNum);
+    BOOST_CHECK(stats.hitRate() > 0.5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+///
+/// @file t_PropValueTable.cpp
+/// @brief test the value paths and the doc labels in PropValueTable
+///
+
+#include <mining-manager/group-manager/PropValueTable.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace sf1r::faceted;
+using izenelib::util::UString;
+
+namespace
+{
+const UString::EncodingType ENCODING_TYPE = UString::UTF_8;
+
+PropValueTable::pvid_t insertPath(
+    PropValueTable& table,
+    const std::string& parent,
+    const std::string& child)
+{
+    std::vector<UString> path;
+    path.push_back(UString(parent, ENCODING_TYPE));
+    if (!child.empty())
+    {
+        path.push_back(UString(child, ENCODING_TYPE));
+    }
+    return table.insertPropValueId(path);
+}
+
+void checkPath(
+    const PropValueTable& table,
+    PropValueTable::pvid_t pvId,
+    const std::string& parent,
+    const std::string& child)
+{
+    std::vector<std::string> path;
+    table.propValuePath(pvId, path);
+
+    BOOST_REQUIRE_EQUAL(path.size(), 2U);
+    BOOST_CHECK_EQUAL(path[0], parent);
+    BOOST_CHECK_EQUAL(path[1], child);
+}
+}
+
+BOOST_AUTO_TEST_SUITE(PropValueTableTest)
+
+BOOST_AUTO_TEST_CASE(checkPathStr)
+{
+    PropValueTable table("", "Category");
+    PropValueTable::pvid_t phoneId = insertPath(table, "digital", "phone");
+    PropValueTable::pvid_t pcId = insertPath(table, "digital", "pc");
+
+    // the second time from the cache
+    for (int i = 0; i < 2; ++i)
+    {
+        checkPath(table, phoneId, "digital", "phone");
+        checkPath(table, pcId, "digital", "pc");
+    }
+
+    // a value inserted after the cache is filled
+    PropValueTable::pvid_t shirtId = insertPath(table, "cloth", "shirt");
+    checkPath(table, shirtId, "cloth", "shirt");
+
+    std::vector<std::string> path(1, "not empty");
+    table.propValuePath(0, path);
+    BOOST_CHECK(path.empty());
+
+    // the ids are reused after clear
+    table.clear();
+    PropValueTable::pvid_t bookId = insertPath(table, "book", "novel");
+    BOOST_CHECK_EQUAL(bookId, phoneId);
+    checkPath(table, bookId, "book", "novel");
+}
+
+BOOST_AUTO_TEST_CASE(checkTestDoc)
+{
+    PropValueTable table("", "Category");
+    PropValueTable::pvid_t phoneId = insertPath(table, "digital", "phone");
+    PropValueTable::pvid_t digitalId = table.getRootValueId(phoneId);
+    PropValueTable::pvid_t shirtId = insertPath(table, "cloth", "shirt");
+    PropValueTable::pvid_t clothId = table.getRootValueId(shirtId);
+
+    std::vector<PropValueTable::pvid_t> idList;
+    idList.push_back(phoneId);
+    table.setPropIdList(1, idList);
+    idList.push_back(shirtId);
+    table.setPropIdList(2, idList);
+
+    BOOST_CHECK(table.testDoc(1, phoneId));
+    BOOST_CHECK(table.testDoc(1, digitalId));
+    BOOST_CHECK(!table.testDoc(1, shirtId));
+    BOOST_CHECK(!table.testDoc(1, clothId));
+
+    BOOST_CHECK(table.testDoc(2, digitalId));
+    BOOST_CHECK(table.testDoc(2, clothId));
+
+    // no values
+    BOOST_CHECK(!table.testDoc(3, digitalId));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,2 @@
+#define BOOST_TEST_MODULE Search Manager
+#include <TestRunner.inl>
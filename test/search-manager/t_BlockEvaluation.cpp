@@ -0,0 +1,361 @@
+///
+/// @file t_BlockEvaluation.cpp
+/// @brief test the block reads of the numeric property tables used by the
+/// block evaluation in SearchThreadWorker, and compare them with the per
+/// doc reads on match-all and broad queries, and rank the docs scored by
+/// their iterator in blocks
+///
+
+#include <common/NumericPropertyTable.h>
+#include <search-manager/ScoreDocEvaluator.h>
+#include <search-manager/ScoreDoc.h>
+#include <search-manager/DocumentIterator.h>
+#include <mining-manager/product-scorer/RelevanceScorer.h>
+#include <mining-manager/product-scorer/ProductScoreSum.h>
+#include <ranking-manager/RankQueryProperty.h>
+#include <ranking-manager/PropertyRanker.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdlib.h>
+
+using namespace sf1r;
+
+namespace
+{
+const std::size_t DOC_NUM = 2000000;
+const std::size_t BLOCK_DOC_NUM = 256;
+const int REPEAT_NUM = 5;
+
+// like DocumentManager, the tables are used through the base class
+NumericPropertyTableBase* createTable(PropertyDataType type)
+{
+    switch (type)
+    {
+    case INT32_PROPERTY_TYPE:
+        return new NumericPropertyTable<int32_t>(type);
+    case INT64_PROPERTY_TYPE:
+        return new NumericPropertyTable<int64_t>(type);
+    case FLOAT_PROPERTY_TYPE:
+        return new NumericPropertyTable<float>(type);
+    case DOUBLE_PROPERTY_TYPE:
+        return new NumericPropertyTable<double>(type);
+    default:
+        return NULL;
+    }
+}
+
+struct Tables
+{
+    boost::scoped_ptr<NumericPropertyTableBase> price;
+    boost::scoped_ptr<NumericPropertyTableBase> count;
+
+    Tables(PropertyDataType priceType, PropertyDataType countType)
+        : price(createTable(priceType))
+        , count(createTable(countType))
+    {
+        unsigned int seed = 3;
+        for (docid_t docId = 1; docId <= DOC_NUM; ++docId)
+        {
+            // some docs have no value
+            if (rand_r(&seed) % 10)
+            {
+                price->setFloatValue(docId, (rand_r(&seed) % 100000) / 100.0);
+            }
+            if (rand_r(&seed) % 10)
+            {
+                count->setInt32Value(docId, rand_r(&seed) % 1000 - 100);
+            }
+        }
+    }
+};
+
+struct Aggregation
+{
+    float lowValue;
+    float highValue;
+    uint32_t sum;
+
+    Aggregation()
+        : lowValue(std::numeric_limits<float>::max())
+        , highValue(-std::numeric_limits<float>::max())
+        , sum(0)
+    {
+    }
+
+    bool operator==(const Aggregation& other) const
+    {
+        return lowValue == other.lowValue && highValue == other.highValue &&
+            sum == other.sum;
+    }
+};
+
+// the reads of the doc-at-a-time loop
+void aggregateDocs(const NumericPropertyTableBase& price,
+                   const NumericPropertyTableBase& count,
+                   const std::vector<docid_t>& docs,
+                   Aggregation& result)
+{
+    for (std::size_t i = 0; i < docs.size(); ++i)
+    {
+        float value = 0;
+        if (price.getFloatValue(docs[i], value, false))
+        {
+            if (value < result.lowValue)
+                result.lowValue = value;
+            if (value > result.highValue)
+                result.highValue = value;
+        }
+
+        int32_t n = 0;
+        if (count.getInt32Value(docs[i], n, false))
+        {
+            result.sum += n;
+        }
+    }
+}
+
+void aggregateBlocks(const NumericPropertyTableBase& price,
+                     const NumericPropertyTableBase& count,
+                     const std::vector<docid_t>& docs,
+                     Aggregation& result)
+{
+    for (std::size_t i = 0; i < docs.size(); i += BLOCK_DOC_NUM)
+    {
+        const std::size_t num = std::min(BLOCK_DOC_NUM, docs.size() - i);
+        price.updateFloatRange(&docs[i], num, result.lowValue, result.highValue, false);
+        count.sumInt32Values(&docs[i], num, result.sum, false);
+    }
+}
+
+double seconds(const boost::posix_time::ptime& start)
+{
+    return (boost::posix_time::microsec_clock::local_time() - start)
+        .total_microseconds() / 1e6;
+}
+
+void compare(const char* query, const Tables& tables, const std::vector<docid_t>& docs)
+{
+    Aggregation docResult;
+    Aggregation blockResult;
+    double docSeconds = 0;
+    double blockSeconds = 0;
+
+    for (int r = 0; r < REPEAT_NUM; ++r)
+    {
+        docResult = Aggregation();
+        boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+        aggregateDocs(*tables.price, *tables.count, docs, docResult);
+        docSeconds += seconds(start);
+
+        blockResult = Aggregation();
+        start = boost::posix_time::microsec_clock::local_time();
+        aggregateBlocks(*tables.price, *tables.count, docs, blockResult);
+        blockSeconds += seconds(start);
+    }
+
+    BOOST_CHECK(docResult == blockResult);
+    BOOST_TEST_MESSAGE(query << ": " << docs.size() << " docs, "
+                       << docs.size() * REPEAT_NUM / docSeconds / 1e6 << "M docs/s per doc, "
+                       << docs.size() * REPEAT_NUM / blockSeconds / 1e6 << "M docs/s in blocks");
+}
+
+double relevanceOf(docid_t docId)
+{
+    return (docId * 7919) % 1000;
+}
+
+/// the docs of a term in memory, scored by the doc it is at, like the
+/// iterators of a keyword search
+class ScoreDocIterator : public DocumentIterator
+{
+public:
+    explicit ScoreDocIterator(const std::vector<docid_t>& docs)
+        : docs_(docs), pos_(0), isStarted_(false) {}
+
+    void add(DocumentIterator* pDocIterator) {}
+
+    bool next()
+    {
+        if (isStarted_ && pos_ < docs_.size())
+        {
+            ++pos_;
+        }
+        isStarted_ = true;
+        return pos_ < docs_.size();
+    }
+
+    docid_t doc()
+    {
+        return pos_ < docs_.size() ? docs_[pos_] : MAX_DOC_ID;
+    }
+
+    void doc_item(RankDocumentProperty& rankDocumentProperty, unsigned propIndex = 0) {}
+
+    void df_cmtf(DocumentFrequencyInProperties& dfmap,
+                 CollectionTermFrequencyInProperties& ctfmap,
+                 MaxTermFrequencyInProperties& maxtfmap) {}
+
+    count_t tf()
+    {
+        return 1;
+    }
+
+    double score(
+        const std::vector<RankQueryProperty>& rankQueryProperties,
+        const std::vector<boost::shared_ptr<PropertyRanker> >& propertyRankers)
+    {
+        // past the last doc, it has nothing to score
+        return pos_ < docs_.size() ? relevanceOf(docs_[pos_]) : -1;
+    }
+
+private:
+    const std::vector<docid_t>& docs_;
+    std::size_t pos_;
+    bool isStarted_;
+};
+
+/// a score of the doc alone, which could be evaluated in blocks
+class DocScorer : public ProductScorer
+{
+public:
+    virtual score_t score(docid_t docId)
+    {
+        return docId % 5;
+    }
+};
+
+bool greaterScore(const ScoreDoc& x, const ScoreDoc& y)
+{
+    return x.score > y.score;
+}
+
+/// the top @p topNum docs gathered in blocks as SearchThreadWorker does
+std::vector<ScoreDoc> rankDocs(
+    ScoreDocEvaluator& evaluator,
+    DocumentIterator& docIterator,
+    docid_t endDocId,
+    std::size_t topNum)
+{
+    std::vector<ScoreDoc> block(BLOCK_DOC_NUM);
+    std::vector<ScoreDoc> result;
+    docid_t curDocId = docIterator.next() ? docIterator.doc() : MAX_DOC_ID;
+    while (curDocId < endDocId)
+    {
+        const std::size_t num = evaluator.gather(docIterator, curDocId, endDocId,
+                                                 NULL, &block[0], block.size());
+        result.insert(result.end(), block.begin(), block.begin() + num);
+    }
+    std::stable_sort(result.begin(), result.end(), greaterScore);
+    result.resize(std::min(topNum, result.size()));
+    return result;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(BlockEvaluationTest)
+
+BOOST_AUTO_TEST_CASE(testBlockReads)
+{
+    NumericPropertyTable<int32_t> table(INT32_PROPERTY_TYPE);
+    table.setInt32Value(1, 5);
+    table.setInt32Value(3, -2);
+    table.setInt32Value(4, 7);
+
+    // doc 2 has no value, doc 10 is out of the table
+    const docid_t docs[] = {1, 2, 3, 4, 10};
+    uint32_t sum = 1;
+    table.sumInt32Values(docs, 5, sum, true);
+    BOOST_CHECK_EQUAL(sum, 11U);
+
+    float lowValue = std::numeric_limits<float>::max();
+    float highValue = -lowValue;
+    table.updateFloatRange(docs, 2, lowValue, highValue, true);
+    BOOST_CHECK_EQUAL(lowValue, 5);
+    BOOST_CHECK_EQUAL(highValue, 5);
+    table.updateFloatRange(docs, 5, lowValue, highValue, true);
+    BOOST_CHECK_EQUAL(lowValue, -2);
+    BOOST_CHECK_EQUAL(highValue, 7);
+
+    // nothing changes without value
+    lowValue = 100;
+    highValue = 100;
+    table.updateFloatRange(docs + 1, 1, lowValue, highValue, true);
+    BOOST_CHECK_EQUAL(lowValue, 100);
+    BOOST_CHECK_EQUAL(highValue, 100);
+}
+
+BOOST_AUTO_TEST_CASE(testMatchAllAndBroadQuery)
+{
+    const Tables tables(FLOAT_PROPERTY_TYPE, INT32_PROPERTY_TYPE);
+
+    // "*", every doc
+    std::vector<docid_t> allDocs;
+    allDocs.reserve(DOC_NUM);
+    for (docid_t docId = 1; docId <= DOC_NUM; ++docId)
+    {
+        allDocs.push_back(docId);
+    }
+    compare("match all", tables, allDocs);
+
+    // a common term, a third of the docs
+    unsigned int seed = 5;
+    std::vector<docid_t> broadDocs;
+    for (docid_t docId = 1; docId <= DOC_NUM; ++docId)
+    {
+        if (rand_r(&seed) % 3 == 0)
+        {
+            broadDocs.push_back(docId);
+        }
+    }
+    compare("broad query", tables, broadDocs);
+}
+
+BOOST_AUTO_TEST_CASE(testRankIteratorScoredDocs)
+{
+    std::vector<docid_t> docs;
+    for (docid_t docId = 1; docId <= 10000; docId += 3)
+    {
+        docs.push_back(docId);
+    }
+    const docid_t endDocId = 9000;
+    const std::size_t topNum = 20;
+
+    std::vector<ScoreDoc> expected;
+    for (std::size_t i = 0; i < docs.size() && docs[i] < endDocId; ++i)
+    {
+        expected.push_back(ScoreDoc(docs[i], relevanceOf(docs[i]) * 0.01 + docs[i] % 5));
+    }
+    std::stable_sort(expected.begin(), expected.end(), greaterScore);
+    expected.resize(topNum);
+
+    const std::vector<RankQueryProperty> rankQueryProps;
+    const std::vector<boost::shared_ptr<PropertyRanker> > propRankers;
+    ScoreDocIterator docIterator(docs);
+
+    // the relevance with another score, as the product ranking does
+    ProductScoreSum* scoreSum = new ProductScoreSum;
+    scoreSum->addScorer(new RelevanceScorer(docIterator, rankQueryProps, propRankers));
+    scoreSum->addScorer(new DocScorer);
+    BOOST_CHECK(scoreSum->isDocIteratorBound());
+
+    ScoreDocEvaluator evaluator(scoreSum, CustomRankerPtr(), GeoLocationRankerPtr());
+    const std::vector<ScoreDoc> result = rankDocs(evaluator, docIterator, endDocId, topNum);
+
+    BOOST_REQUIRE_EQUAL(result.size(), topNum);
+    for (std::size_t i = 0; i < topNum; ++i)
+    {
+        BOOST_CHECK_EQUAL(result[i].docId, expected[i].docId);
+        BOOST_CHECK_CLOSE(result[i].score, expected[i].score, 1e-4);
+    }
+
+    // the scores of the doc alone are still evaluated in blocks
+    ScoreDocIterator docOnlyIterator(docs);
+    ScoreDocEvaluator docOnlyEvaluator(new DocScorer, CustomRankerPtr(), GeoLocationRankerPtr());
+    const std::vector<ScoreDoc> docOnlyResult = rankDocs(docOnlyEvaluator, docOnlyIterator, endDocId, 1);
+    BOOST_REQUIRE_EQUAL(docOnlyResult.size(), 1U);
+    BOOST_CHECK_EQUAL(docOnlyResult[0].score, 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
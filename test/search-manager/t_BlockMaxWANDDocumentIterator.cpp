@@ -0,0 +1,632 @@
+///
+/// @file t_BlockMaxWANDDocumentIterator.cpp
+/// @brief test the block-max WAND returns the same docs as WAND without the
+/// block upper bounds, and with them drops only the WAND docs which could
+/// not exceed the threshold, compare their latency, test the block max of
+/// the term postings is cached by the index generation
+///
+
+#include <search-manager/BlockMaxWANDDocumentIterator.h>
+#include <search-manager/PostingBlockMax.h>
+#include <search-manager/PostingBlockMaxCache.h>
+#include <search-manager/TermDocumentIterator.h>
+#include <search-manager/TermUBCalculator.h>
+#include <index-manager/InvertedIndexManager.h>
+#include <ranking-manager/PropertyRanker.h>
+#include <util/ClockTimer.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/random.hpp>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+using namespace sf1r;
+
+namespace
+{
+const docid_t TEST_MAX_DOC_ID = 2000000;
+const std::size_t SEGMENT_DOC_NUM = 4096;
+const float THRESHOLDS[] = {0.3F, 0.5F, 0.7F};
+const std::size_t THRESHOLD_NUM = sizeof(THRESHOLDS) / sizeof(THRESHOLDS[0]);
+
+struct Posting
+{
+    std::vector<docid_t> docs;
+    std::vector<count_t> tfs;
+    count_t maxTf;
+    float weight;
+};
+
+/// the upper bound by term frequency, it increases with tf like BM25
+float getTfUB(float weight, float tf)
+{
+    return weight * tf / (tf + 1.2F);
+}
+
+class TfUBFunction
+{
+public:
+    explicit TfUBFunction(float weight) : weight_(weight) {}
+
+    bool operator()(float tf, float& ub) const
+    {
+        ub = getTfUB(weight_, tf);
+        return true;
+    }
+
+private:
+    float weight_;
+};
+
+/// the postings of a term in memory
+class PostingDocIterator : public DocumentIterator
+{
+public:
+    explicit PostingDocIterator(const Posting& posting)
+        : posting_(posting), pos_(0), isStarted_(false) {}
+
+    void add(DocumentIterator* pDocIterator) {}
+
+    bool next()
+    {
+        if (isStarted_)
+        {
+            ++pos_;
+        }
+        isStarted_ = true;
+        return pos_ < posting_.docs.size();
+    }
+
+    docid_t doc()
+    {
+        return posting_.docs[pos_];
+    }
+
+    void doc_item(RankDocumentProperty& rankDocumentProperty, unsigned propIndex = 0) {}
+
+    void df_cmtf(DocumentFrequencyInProperties& dfmap,
+                 CollectionTermFrequencyInProperties& ctfmap,
+                 MaxTermFrequencyInProperties& maxtfmap) {}
+
+    count_t tf()
+    {
+        return posting_.tfs[pos_];
+    }
+
+    count_t freq()
+    {
+        return tf();
+    }
+
+    docid_t skipTo(docid_t target)
+    {
+        const std::vector<docid_t>& docs = posting_.docs;
+        const std::size_t from = isStarted_ ? pos_ : 0;
+        isStarted_ = true;
+
+        pos_ = std::lower_bound(docs.begin() + std::min(from, docs.size()),
+                                docs.end(), target) - docs.begin();
+        return pos_ < docs.size() ? docs[pos_] : MAX_DOC_ID;
+    }
+
+    float getUB()
+    {
+        return getTfUB(posting_.weight, posting_.maxTf);
+    }
+
+    bool getBlockUB(const TermUBCalculator& ubCalculator,
+                    PostingBlockMaxCache* blockMaxCache,
+                    uint64_t indexGeneration,
+                    PostingBlockUB& blockUB)
+    {
+        PostingDocIterator termDocs(posting_);
+        boost::shared_ptr<PostingBlockMax> blockMax(new PostingBlockMax);
+        blockMax->build(termDocs);
+
+        return blockUB.init(blockMax, TfUBFunction(posting_.weight));
+    }
+
+private:
+    const Posting& posting_;
+    std::size_t pos_;
+    bool isStarted_;
+};
+
+/// the upper bound by term frequency in the ranker of a property
+class TfUBRanker : public PropertyRanker
+{
+public:
+    explicit TfUBRanker(float weight) : weight_(weight) {}
+
+    float getScore(const RankQueryProperty& queryProperty,
+                   const RankDocumentProperty& documentProperty) const
+    {
+        return 0;
+    }
+
+    bool calculateTermUB(const RankQueryProperty& queryProperty,
+                         unsigned int termIndex,
+                         float tf,
+                         float& ub) const
+    {
+        ub = getTfUB(weight_, tf);
+        return true;
+    }
+
+    PropertyRanker* clone() const
+    {
+        return new TfUBRanker(*this);
+    }
+
+private:
+    float weight_;
+};
+
+/// the term iterator whose block max is built from the postings in memory
+class PostingTermDocIterator : public TermDocumentIterator
+{
+public:
+    PostingTermDocIterator(const Posting& posting, const std::string& property)
+        : TermDocumentIterator(1, 1, NULL, property, 1, 0, false)
+        , posting_(posting)
+        , buildNum_(0)
+    {
+        boost::shared_ptr<InvertedIndexManager::FilterBitmapT> bitmap(
+            new InvertedIndexManager::FilterBitmapT);
+        for (std::size_t i = 0; i < posting.docs.size(); ++i)
+        {
+            bitmap->set(posting.docs[i]);
+        }
+        set(new InvertedIndexManager::FilterTermDocFreqsT(bitmap));
+    }
+
+    std::size_t buildNum() const { return buildNum_; }
+
+protected:
+    bool buildBlockMax_(PostingBlockMax& blockMax)
+    {
+        ++buildNum_;
+        PostingDocIterator termDocs(posting_);
+        blockMax.build(termDocs);
+        return true;
+    }
+
+private:
+    const Posting& posting_;
+    std::size_t buildNum_;
+};
+
+void checkBlockUB(const PostingBlockUB& blockUB, const Posting& posting)
+{
+    PostingDocIterator termDocs(posting);
+    PostingBlockMax goldBlockMax;
+    goldBlockMax.build(termDocs);
+
+    const std::vector<PostingBlock>& goldBlocks = goldBlockMax.blocks();
+    BOOST_REQUIRE(!blockUB.empty());
+    BOOST_REQUIRE_EQUAL(blockUB.blockMax().blocks().size(), goldBlocks.size());
+
+    for (std::size_t i = 0; i < goldBlocks.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(blockUB.blockMax().blocks()[i].lastDoc, goldBlocks[i].lastDoc);
+        BOOST_CHECK_EQUAL(blockUB.blockUB(i), getTfUB(posting.weight, goldBlocks[i].maxTf));
+    }
+}
+
+/**
+ * The docs are indexed in segments, such as by time or by source, and the
+ * term frequencies are similar in the same segment.
+ */
+void createPostings(std::size_t termNum, std::size_t docNum, std::vector<Posting>& postings)
+{
+    boost::mt19937 engine(termNum);
+    boost::uniform_int<docid_t> docDist(1, TEST_MAX_DOC_ID);
+    boost::uniform_real<float> realDist(0, 1);
+
+    postings.resize(termNum);
+    for (std::size_t i = 0; i < termNum; ++i)
+    {
+        Posting& posting = postings[i];
+        const std::size_t df = docNum / (i + 1);
+
+        posting.docs.clear();
+        for (std::size_t j = 0; j < df; ++j)
+        {
+            posting.docs.push_back(docDist(engine));
+        }
+        std::sort(posting.docs.begin(), posting.docs.end());
+        posting.docs.erase(std::unique(posting.docs.begin(), posting.docs.end()),
+                           posting.docs.end());
+
+        std::vector<float> segmentMeans(TEST_MAX_DOC_ID / SEGMENT_DOC_NUM + 1);
+        for (std::size_t j = 0; j < segmentMeans.size(); ++j)
+        {
+            const float r = realDist(engine);
+            segmentMeans[j] = r * r * r * 8;
+        }
+
+        posting.tfs.resize(posting.docs.size());
+        posting.maxTf = 0;
+        for (std::size_t j = 0; j < posting.docs.size(); ++j)
+        {
+            const float mean = segmentMeans[posting.docs[j] / SEGMENT_DOC_NUM];
+            const count_t tf = 1 + static_cast<count_t>(
+                -std::log(1 - realDist(engine)) * mean);
+            posting.tfs[j] = tf;
+            posting.maxTf = std::max(posting.maxTf, tf);
+        }
+
+        posting.weight = std::log(static_cast<float>(TEST_MAX_DOC_ID) / df);
+    }
+}
+
+void initIterator(const std::vector<Posting>& postings, float threshold,
+                  bool isBlockUB, WANDDocumentIterator& iterator)
+{
+    for (std::size_t i = 0; i < postings.size(); ++i)
+    {
+        iterator.add(new PostingDocIterator(postings[i]));
+    }
+    iterator.setMissRate(postings.size());
+
+    UpperBoundInProperties ubmap;
+    iterator.setUB(false, ubmap);
+
+    if (isBlockUB)
+    {
+        TermUBCalculator ubCalculator;
+        iterator.setBlockUB(ubCalculator);
+    }
+    iterator.initThreshold(threshold);
+}
+
+void iterateDocs(DocumentIterator& iterator, std::vector<docid_t>& docs)
+{
+    docs.clear();
+    while (iterator.next())
+    {
+        docs.push_back(iterator.doc());
+    }
+}
+
+float getThreshold(const std::vector<Posting>& postings, float threshold)
+{
+    float sumUB = 0;
+    for (std::size_t i = 0; i < postings.size(); ++i)
+    {
+        sumUB += getTfUB(postings[i].weight, postings[i].maxTf);
+    }
+    return sumUB * threshold;
+}
+
+/// the sum of the upper bounds by term frequency in each doc
+void getDocUBs(const std::vector<Posting>& postings, std::map<docid_t, float>& docUBs)
+{
+    docUBs.clear();
+    for (std::size_t i = 0; i < postings.size(); ++i)
+    {
+        const Posting& posting = postings[i];
+        for (std::size_t j = 0; j < posting.docs.size(); ++j)
+        {
+            docUBs[posting.docs[j]] += getTfUB(posting.weight, posting.tfs[j]);
+        }
+    }
+}
+
+/**
+ * Each doc returned by the block-max WAND is returned by WAND, and a WAND
+ * doc is dropped only if its doc upper bound could not exceed the threshold.
+ */
+void checkWANDDocs(const std::vector<docid_t>& wandDocs,
+                   const std::vector<docid_t>& bmwDocs,
+                   const std::map<docid_t, float>& docUBs,
+                   float threshold)
+{
+    BOOST_CHECK(std::includes(wandDocs.begin(), wandDocs.end(),
+                              bmwDocs.begin(), bmwDocs.end()));
+
+    std::vector<docid_t> wrongDocs;
+    for (std::size_t i = 0; i < wandDocs.size(); ++i)
+    {
+        const docid_t doc = wandDocs[i];
+        const bool isReturned = std::binary_search(bmwDocs.begin(), bmwDocs.end(), doc);
+        std::map<docid_t, float>::const_iterator it = docUBs.find(doc);
+        BOOST_REQUIRE(it != docUBs.end());
+
+        if (isReturned != (it->second > threshold))
+        {
+            wrongDocs.push_back(doc);
+        }
+    }
+    BOOST_CHECK_EQUAL(wrongDocs.size(), 0U);
+}
+
+void filterByDocUB(const std::vector<docid_t>& docs,
+                   const std::map<docid_t, float>& docUBs,
+                   float threshold,
+                   std::vector<docid_t>& result)
+{
+    result.clear();
+    for (std::size_t i = 0; i < docs.size(); ++i)
+    {
+        std::map<docid_t, float>::const_iterator it = docUBs.find(docs[i]);
+        if (it != docUBs.end() && it->second > threshold)
+        {
+            result.push_back(docs[i]);
+        }
+    }
+}
+
+void checkBlockMaxWAND(std::size_t termNum, std::size_t docNum, float threshold)
+{
+    std::vector<Posting> postings;
+    createPostings(termNum, docNum, postings);
+
+    std::vector<docid_t> wandDocs, bmwDocs, goldDocs;
+    {
+        WANDDocumentIterator wandIter;
+        initIterator(postings, threshold, false, wandIter);
+        iterateDocs(wandIter, wandDocs);
+    }
+    {
+        BlockMaxWANDDocumentIterator bmwIter;
+        initIterator(postings, threshold, true, bmwIter);
+        iterateDocs(bmwIter, bmwDocs);
+    }
+
+    std::map<docid_t, float> docUBs;
+    getDocUBs(postings, docUBs);
+    const float realThreshold = getThreshold(postings, threshold);
+    checkWANDDocs(wandDocs, bmwDocs, docUBs, realThreshold);
+
+    std::vector<docid_t> allDocs;
+    for (std::map<docid_t, float>::const_iterator it = docUBs.begin();
+         it != docUBs.end(); ++it)
+    {
+        allDocs.push_back(it->first);
+    }
+    filterByDocUB(allDocs, docUBs, realThreshold, goldDocs);
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(bmwDocs.begin(), bmwDocs.end(),
+                                  goldDocs.begin(), goldDocs.end());
+}
+}
+
+BOOST_AUTO_TEST_SUITE(BlockMaxWANDDocumentIteratorTest)
+
+BOOST_AUTO_TEST_CASE(testBuildBlocks)
+{
+    Posting posting;
+    for (docid_t doc = 1; doc <= 300; ++doc)
+    {
+        posting.docs.push_back(doc * 2);
+        posting.tfs.push_back(doc % 100 + 1);
+    }
+    posting.tfs[200] = 500;
+
+    PostingDocIterator termDocs(posting);
+    PostingBlockMax blockMax;
+    blockMax.build(termDocs);
+
+    const std::vector<PostingBlock>& blocks = blockMax.blocks();
+    BOOST_REQUIRE_EQUAL(blocks.size(), 3U);
+    BOOST_CHECK_EQUAL(blocks[0].lastDoc, 256U);
+    BOOST_CHECK_EQUAL(blocks[0].maxTf, 100U);
+    BOOST_CHECK_EQUAL(blocks[1].lastDoc, 512U);
+    BOOST_CHECK_EQUAL(blocks[1].maxTf, 500U);
+    BOOST_CHECK_EQUAL(blocks[2].lastDoc, 600U);
+    BOOST_CHECK_EQUAL(blockMax.docNum(), 300U);
+    BOOST_CHECK_EQUAL(blockMax.maxTf(), 500U);
+
+    BOOST_CHECK_EQUAL(blockMax.findBlock(1, 0), 0U);
+    BOOST_CHECK_EQUAL(blockMax.findBlock(257, 0), 1U);
+    BOOST_CHECK_EQUAL(blockMax.findBlock(512, 1), 1U);
+    BOOST_CHECK_EQUAL(blockMax.findBlock(513, 0), 2U);
+    BOOST_CHECK_EQUAL(blockMax.findBlock(601, 2), 3U);
+
+    PostingBlockUB blockUB;
+    BOOST_CHECK(blockUB.empty());
+    BOOST_REQUIRE(blockUB.init(boost::shared_ptr<const PostingBlockMax>(
+        new PostingBlockMax(blockMax)), TfUBFunction(1)));
+    BOOST_CHECK_EQUAL(blockUB.blockUB(1), getTfUB(1, 500));
+    BOOST_CHECK_EQUAL(blockUB.tfUB(3, 0), getTfUB(1, 3));
+    BOOST_CHECK_EQUAL(blockUB.tfUB(500, 2), 2);
+}
+
+BOOST_AUTO_TEST_CASE(testWithoutBlockUB)
+{
+    for (std::size_t termNum = 2; termNum <= 8; ++termNum)
+    {
+        std::vector<Posting> postings;
+        createPostings(termNum, 20000, postings);
+
+        for (std::size_t i = 0; i < THRESHOLD_NUM; ++i)
+        {
+            std::vector<docid_t> wandDocs, bmwDocs;
+            {
+                WANDDocumentIterator wandIter;
+                initIterator(postings, THRESHOLDS[i], false, wandIter);
+                iterateDocs(wandIter, wandDocs);
+            }
+            {
+                BlockMaxWANDDocumentIterator bmwIter;
+                initIterator(postings, THRESHOLDS[i], false, bmwIter);
+                iterateDocs(bmwIter, bmwDocs);
+            }
+
+            BOOST_CHECK_EQUAL_COLLECTIONS(bmwDocs.begin(), bmwDocs.end(),
+                                          wandDocs.begin(), wandDocs.end());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testWithBlockUB)
+{
+    for (std::size_t termNum = 2; termNum <= 8; ++termNum)
+    {
+        for (std::size_t i = 0; i < THRESHOLD_NUM; ++i)
+        {
+            checkBlockMaxWAND(termNum, 20000, THRESHOLDS[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testSkipTo)
+{
+    std::vector<Posting> postings;
+    createPostings(4, 20000, postings);
+
+    std::vector<docid_t> allDocs;
+    {
+        BlockMaxWANDDocumentIterator bmwIter;
+        initIterator(postings, 0.3F, true, bmwIter);
+        iterateDocs(bmwIter, allDocs);
+    }
+    BOOST_REQUIRE(!allDocs.empty());
+
+    BlockMaxWANDDocumentIterator bmwIter;
+    initIterator(postings, 0.3F, true, bmwIter);
+
+    docid_t lastDoc = 0;
+    for (docid_t target = 1; target < TEST_MAX_DOC_ID; target += 99991)
+    {
+        // the iterator could not skip backward
+        target = std::max(target, lastDoc + 1);
+
+        std::vector<docid_t>::const_iterator it =
+            std::lower_bound(allDocs.begin(), allDocs.end(), target);
+        const docid_t goldDoc = it != allDocs.end() ? *it : MAX_DOC_ID;
+
+        BOOST_CHECK_EQUAL(bmwIter.skipTo(target), goldDoc);
+        if (goldDoc == MAX_DOC_ID)
+            break;
+
+        // continue from the doc skipped to
+        lastDoc = goldDoc;
+        if (++it != allDocs.end())
+        {
+            BOOST_REQUIRE(bmwIter.next());
+            BOOST_CHECK_EQUAL(bmwIter.doc(), *it);
+            lastDoc = *it;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testTermBlockUBCache)
+{
+    std::vector<Posting> postings;
+    createPostings(1, 2000, postings);
+    const Posting& posting = postings[0];
+    BOOST_REQUIRE_GT(posting.docs.size(), std::size_t(PostingBlockMax::BLOCK_SIZE));
+
+    const std::string property("title");
+    TfUBRanker ranker(posting.weight);
+    RankQueryProperty queryProperty;
+    TermUBCalculator ubCalculator;
+    ubCalculator.addProperty(property, &ranker, &queryProperty);
+
+    PostingTermDocIterator termIter(posting, property);
+    PostingBlockMaxCache blockMaxCache(1 << 20);
+
+    // built on each call without the cache
+    {
+        PostingBlockUB blockUB;
+        BOOST_REQUIRE(termIter.getBlockUB(ubCalculator, NULL, 1, blockUB));
+        BOOST_REQUIRE(termIter.getBlockUB(ubCalculator, NULL, 1, blockUB));
+        BOOST_CHECK_EQUAL(termIter.buildNum(), 2U);
+        checkBlockUB(blockUB, posting);
+    }
+
+    // built once in the same generation
+    {
+        PostingBlockUB blockUB;
+        BOOST_REQUIRE(termIter.getBlockUB(ubCalculator, &blockMaxCache, 1, blockUB));
+        BOOST_REQUIRE(termIter.getBlockUB(ubCalculator, &blockMaxCache, 1, blockUB));
+        BOOST_CHECK_EQUAL(termIter.buildNum(), 3U);
+        checkBlockUB(blockUB, posting);
+
+        const SizedLRUCacheStats stats = blockMaxCache.getStats();
+        BOOST_CHECK_EQUAL(stats.hits, 1U);
+        BOOST_CHECK_EQUAL(stats.misses, 1U);
+        BOOST_CHECK_EQUAL(stats.entries, 1U);
+    }
+
+    // built again once the index generation is increased
+    {
+        PostingBlockUB blockUB;
+        BOOST_REQUIRE(termIter.getBlockUB(ubCalculator, &blockMaxCache, 2, blockUB));
+        BOOST_CHECK_EQUAL(termIter.buildNum(), 4U);
+        checkBlockUB(blockUB, posting);
+        BOOST_CHECK_EQUAL(blockMaxCache.getStats().entries, 2U);
+    }
+
+    // not built for a property without the ranker
+    {
+        PostingTermDocIterator otherIter(posting, "content");
+        PostingBlockUB blockUB;
+        BOOST_CHECK(!otherIter.getBlockUB(ubCalculator, &blockMaxCache, 2, blockUB));
+        BOOST_CHECK(blockUB.empty());
+    }
+
+    // not built for the postings in a single block
+    {
+        Posting shortPosting;
+        shortPosting.docs.assign(posting.docs.begin(),
+                                 posting.docs.begin() + PostingBlockMax::BLOCK_SIZE);
+        shortPosting.tfs.assign(posting.tfs.begin(),
+                                posting.tfs.begin() + PostingBlockMax::BLOCK_SIZE);
+        shortPosting.maxTf = posting.maxTf;
+        shortPosting.weight = posting.weight;
+
+        PostingTermDocIterator shortIter(shortPosting, property);
+        PostingBlockUB blockUB;
+        BOOST_CHECK(!shortIter.getBlockUB(ubCalculator, &blockMaxCache, 2, blockUB));
+        BOOST_CHECK_EQUAL(shortIter.buildNum(), 0U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testLatency)
+{
+    const std::size_t docNum = 400000;
+    const float threshold = 0.5F;
+
+    for (std::size_t termNum = 2; termNum <= 8; ++termNum)
+    {
+        std::vector<Posting> postings;
+        createPostings(termNum, docNum, postings);
+
+        std::vector<docid_t> wandDocs, bmwDocs;
+        double wandSeconds = 0, bmwSeconds = 0, buildSeconds = 0;
+        {
+            WANDDocumentIterator wandIter;
+            initIterator(postings, threshold, false, wandIter);
+
+            izenelib::util::ClockTimer timer;
+            iterateDocs(wandIter, wandDocs);
+            wandSeconds = timer.elapsed();
+        }
+        {
+            BlockMaxWANDDocumentIterator bmwIter;
+
+            // the blocks are built without the cache, on each query
+            izenelib::util::ClockTimer buildTimer;
+            initIterator(postings, threshold, true, bmwIter);
+            buildSeconds = buildTimer.elapsed();
+
+            izenelib::util::ClockTimer timer;
+            iterateDocs(bmwIter, bmwDocs);
+            bmwSeconds = timer.elapsed();
+        }
+
+        std::map<docid_t, float> docUBs;
+        getDocUBs(postings, docUBs);
+        checkWANDDocs(wandDocs, bmwDocs, docUBs, getThreshold(postings, threshold));
+
+        BOOST_TEST_MESSAGE(termNum << " terms, WAND: " << wandDocs.size()
+                           << " docs in " << wandSeconds << "s, block-max WAND: "
+                           << bmwDocs.size() << " docs in " << bmwSeconds << "s"
+                           << " + " << buildSeconds << "s to build the blocks");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
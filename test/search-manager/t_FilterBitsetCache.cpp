@@ -0,0 +1,128 @@
+///
+/// @file t_FilterBitsetCache.cpp
+/// @brief test the LRU eviction, the stats and the keys of FilterBitsetCache
+///
+
+#include <search-manager/FilterBitsetCache.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace sf1r;
+using izenelib::ir::indexmanager::Bitset;
+
+namespace
+{
+FilterBitsetCache::value_type createBitset(std::size_t docId)
+{
+    boost::shared_ptr<Bitset> bitset(new Bitset(docId + 1));
+    bitset->set(docId);
+    return bitset;
+}
+
+QueryFiltering::FilteringType createFiltering(const std::string& property)
+{
+    QueryFiltering::FilteringType filtering;
+    filtering.operation_ = QueryFiltering::GREATER_THAN;
+    filtering.property_ = property;
+    filtering.values_.push_back(PropertyValue(int64_t(10)));
+    return filtering;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(FilterBitsetCacheTest)
+
+BOOST_AUTO_TEST_CASE(testEvict)
+{
+    FilterBitsetCache cache(300);
+    FilterBitsetCache::value_type value;
+
+    BOOST_CHECK(!cache.get("a", value));
+    cache.set("a", createBitset(1), 100, 0);
+    cache.set("b", createBitset(2), 100, 0);
+    cache.set("c", createBitset(3), 100, 0);
+
+    // "a" is used more recently than "b"
+    BOOST_CHECK(cache.get("a", value));
+    BOOST_CHECK(value->test(1));
+
+    cache.set("d", createBitset(4), 100, 0);
+    BOOST_CHECK(!cache.get("b", value));
+    BOOST_CHECK(cache.get("a", value));
+    BOOST_CHECK(cache.get("c", value));
+    BOOST_CHECK(cache.get("d", value));
+
+    // larger than the whole cache
+    cache.set("e", createBitset(5), 301, 0);
+    BOOST_CHECK(!cache.get("e", value));
+
+    FilterBitsetCacheStats stats = cache.getStats();
+    BOOST_CHECK_EQUAL(stats.hits, 4U);
+    BOOST_CHECK_EQUAL(stats.misses, 3U);
+    BOOST_CHECK_EQUAL(stats.evictions, 1U);
+    BOOST_CHECK_EQUAL(stats.entries, 3U);
+    BOOST_CHECK_EQUAL(stats.bytes, 300U);
+    BOOST_CHECK_CLOSE(stats.hitRate(), 4.0 / 7, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(testShare)
+{
+    FilterBitsetCache cache(1000);
+    FilterBitsetCache::value_type value1;
+    FilterBitsetCache::value_type value2;
+
+    cache.set("a", createBitset(7), 100, 0);
+    BOOST_CHECK(cache.get("a", value1));
+    BOOST_CHECK(cache.get("a", value2));
+    BOOST_CHECK_EQUAL(value1.get(), value2.get());
+
+    // the first bitset built is kept
+    cache.set("a", createBitset(8), 100, 0);
+    BOOST_CHECK(cache.get("a", value2));
+    BOOST_CHECK_EQUAL(value1.get(), value2.get());
+
+    // the bitset held by a query stays valid after clear
+    cache.clear();
+    BOOST_CHECK(!cache.get("a", value2));
+    BOOST_CHECK(value1->test(7));
+    BOOST_CHECK_EQUAL(cache.getStats().entries, 0U);
+    BOOST_CHECK_EQUAL(cache.getStats().bytes, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(testClearWhileBuilding)
+{
+    FilterBitsetCache cache(1000);
+    FilterBitsetCache::value_type value;
+
+    // the bitset is built before clear, but set after it
+    const std::size_t clearCount = cache.getClearCount();
+    cache.clear();
+    BOOST_CHECK_EQUAL(cache.getClearCount(), clearCount + 1);
+    cache.set("a", createBitset(1), 100, clearCount);
+    BOOST_CHECK(!cache.get("a", value));
+    BOOST_CHECK_EQUAL(cache.getStats().entries, 0U);
+
+    cache.set("a", createBitset(2), 100, cache.getClearCount());
+    BOOST_CHECK(cache.get("a", value));
+    BOOST_CHECK(value->test(2));
+}
+
+BOOST_AUTO_TEST_CASE(testGetKey)
+{
+    ConditionsNode tree1;
+    tree1.conditionLeafList_.push_back(createFiltering("price"));
+    tree1.conditionLeafList_.push_back(createFiltering("score"));
+
+    ConditionsNode tree2 = tree1;
+    BOOST_CHECK_EQUAL(FilterBitsetCache::getKey(tree1), FilterBitsetCache::getKey(tree2));
+
+    tree2.setRelation("or");
+    BOOST_CHECK_NE(FilterBitsetCache::getKey(tree1), FilterBitsetCache::getKey(tree2));
+
+    ConditionsNode tree3;
+    tree3.conditionLeafList_.push_back(createFiltering("price"));
+    ConditionsNode child;
+    child.conditionLeafList_.push_back(createFiltering("score"));
+    tree3.conditionsNodeList_.push_back(child);
+    BOOST_CHECK_NE(FilterBitsetCache::getKey(tree1), FilterBitsetCache::getKey(tree3));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
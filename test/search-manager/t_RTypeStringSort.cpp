@@ -0,0 +1,224 @@
+///
+/// @file t_RTypeStringSort.cpp
+/// @brief test the rank-encoded values of RTypeStringPropTable used to sort
+/// by a string property, their epochs, and time sorting the hits by title
+///
+
+#include <common/RTypeStringPropTable.h>
+#include <search-manager/SortPropertyComparator.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace sf1r;
+
+namespace
+{
+const std::string TEST_DIR = "./rtype_string_sort";
+const std::size_t TITLE_DOC_NUM = 1000000;
+
+const char* WORDS[] = {
+    "apple", "iphone", "case", "black", "white", "cotton", "shirt", "men",
+    "women", "kids", "shoes", "running", "leather", "bag", "phone", "charger",
+    "usb", "cable", "laptop", "stand", "book", "red", "blue", "dress"
+};
+const std::size_t WORD_NUM = sizeof(WORDS) / sizeof(WORDS[0]);
+
+std::string randomTitle(unsigned int& seed)
+{
+    std::string title;
+    const std::size_t wordNum = rand_r(&seed) % 5 + 1;
+    for (std::size_t i = 0; i < wordNum; ++i)
+    {
+        if (i) title += ' ';
+        title += WORDS[rand_r(&seed) % WORD_NUM];
+    }
+    return title;
+}
+
+// compare by ranks, like SortPropertyComparator
+class RankLess
+{
+public:
+    explicit RankLess(RTypeStringPropTable& table) : table_(table) {}
+
+    bool operator()(docid_t lhs, docid_t rhs) const
+    {
+        return table_.compareValues(lhs, rhs, false) < 0;
+    }
+
+private:
+    RTypeStringPropTable& table_;
+};
+
+// compare by strings copied out of memory, as the table did before
+class StringLess
+{
+public:
+    explicit StringLess(const std::vector<std::string>& titles) : titles_(titles) {}
+
+    bool operator()(docid_t lhs, docid_t rhs) const
+    {
+        const std::string lv = titles_[lhs];
+        const std::string rv = titles_[rhs];
+        return lv < rv;
+    }
+
+private:
+    const std::vector<std::string>& titles_;
+};
+
+// the table is on the stack of the test
+struct NullDeleter
+{
+    void operator()(const void*) const {}
+};
+
+double seconds(const boost::posix_time::ptime& start)
+{
+    return (boost::posix_time::microsec_clock::local_time() - start)
+        .total_microseconds() / 1e6;
+}
+
+struct TableFixture
+{
+    TableFixture()
+    {
+        boost::filesystem::remove_all(TEST_DIR);
+        boost::filesystem::create_directories(TEST_DIR);
+    }
+
+    ~TableFixture()
+    {
+        boost::filesystem::remove_all(TEST_DIR);
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(RTypeStringSortTest, TableFixture)
+
+BOOST_AUTO_TEST_CASE(testCompareValues)
+{
+    RTypeStringPropTable table(STRING_PROPERTY_TYPE);
+    // a new table has no max docid yet, like DocumentManager it is used anyway
+    table.init(TEST_DIR + "/title");
+
+    // some values before sort is enabled, some after
+    table.updateRTypeString(1, "banana");
+    table.updateRTypeString(2, "apple");
+    table.updateRTypeString(4, "cherry");
+    table.enableSort();
+    table.updateRTypeString(5, "apple");
+    table.updateRTypeString(6, "apples");
+    table.updateRTypeString(7, "a");
+    table.updateRTypeString(8, "zoo");
+    table.updateRTypeString(9, "blueberry");
+
+    BOOST_CHECK_EQUAL(table.compareValues(2, 5, true), 0);
+    BOOST_CHECK_LT(table.compareValues(7, 2, true), 0);
+    BOOST_CHECK_LT(table.compareValues(2, 6, true), 0);
+    BOOST_CHECK_LT(table.compareValues(6, 1, true), 0);
+    BOOST_CHECK_LT(table.compareValues(1, 9, true), 0);
+    BOOST_CHECK_LT(table.compareValues(9, 4, true), 0);
+    BOOST_CHECK_GT(table.compareValues(8, 4, true), 0);
+
+    // doc 3 has no value, it goes first
+    BOOST_CHECK_LT(table.compareValues(3, 7, true), 0);
+    BOOST_CHECK_GT(table.compareValues(7, 3, true), 0);
+    // out of the table
+    BOOST_CHECK_LT(table.compareValues(100, 7, true), 0);
+
+    // an updated doc takes its new rank
+    table.updateRTypeString(8, "aa");
+    BOOST_CHECK_LT(table.compareValues(8, 2, true), 0);
+    BOOST_CHECK_GT(table.compareValues(8, 7, true), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testRespaceRanks)
+{
+    RTypeStringPropTable table(STRING_PROPERTY_TYPE);
+    table.init(TEST_DIR + "/respace");
+    table.enableSort();
+
+    // each value goes right after "a", halving the same gap every time
+    std::vector<std::string> values;
+    std::string value = "a";
+    for (docid_t docId = 1; docId <= 200; ++docId)
+    {
+        value += 'z';
+        values.push_back(value);
+    }
+    table.updateRTypeString(202, "a");
+    table.updateRTypeString(201, "b");
+    const uint64_t firstEpoch = table.getRankEpoch(true);
+    for (docid_t docId = 200; docId >= 1; --docId)
+    {
+        table.updateRTypeString(docId, values[docId-1]);
+    }
+
+    for (docid_t docId = 1; docId < 200; ++docId)
+    {
+        BOOST_CHECK_LT(table.compareValues(docId, docId+1, true), 0);
+        BOOST_CHECK_LT(table.getSortKey(docId, true), table.getSortKey(docId+1, true));
+    }
+    BOOST_CHECK_LT(table.compareValues(200, 201, true), 0);
+    BOOST_CHECK_LT(table.compareValues(202, 1, true), 0);
+
+    // the ranks were respaced, the keys got before are of an old epoch
+    const uint64_t epoch = table.getRankEpoch(true);
+    BOOST_CHECK_GT(epoch, firstEpoch);
+    BOOST_CHECK_LT(table.getSortKey(200, true), table.getSortKey(201, true));
+
+    // a value ranked between its neighbours doesn't change the epoch
+    table.updateRTypeString(202, "c");
+    BOOST_CHECK_EQUAL(table.getRankEpoch(true), epoch);
+    BOOST_CHECK_LT(table.getSortKey(201, true), table.getSortKey(202, true));
+
+    SortPropertyComparator comparator(
+        boost::shared_ptr<RTypeStringPropTable>(&table, NullDeleter()));
+    BOOST_CHECK(comparator.hasSortKey());
+    BOOST_CHECK_EQUAL(comparator.getSortKeyEpoch(), epoch);
+}
+
+BOOST_AUTO_TEST_CASE(testSortTitles)
+{
+    RTypeStringPropTable table(STRING_PROPERTY_TYPE);
+    table.init(TEST_DIR + "/title");
+
+    unsigned int seed = 9;
+    std::vector<std::string> titles(TITLE_DOC_NUM + 1);
+    for (docid_t docId = 1; docId <= TITLE_DOC_NUM; ++docId)
+    {
+        titles[docId] = randomTitle(seed);
+        table.updateRTypeString(docId, titles[docId]);
+    }
+
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+    table.enableSort();
+    const double loadSeconds = seconds(start);
+
+    std::vector<docid_t> hits;
+    for (docid_t docId = 1; docId <= TITLE_DOC_NUM; ++docId)
+    {
+        hits.push_back(docId);
+    }
+    std::random_shuffle(hits.begin(), hits.end());
+    std::vector<docid_t> stringHits(hits);
+
+    start = boost::posix_time::microsec_clock::local_time();
+    std::stable_sort(hits.begin(), hits.end(), RankLess(table));
+    const double rankSeconds = seconds(start);
+
+    start = boost::posix_time::microsec_clock::local_time();
+    std::stable_sort(stringHits.begin(), stringHits.end(), StringLess(titles));
+    const double stringSeconds = seconds(start);
+
+    BOOST_CHECK(hits == stringHits);
+    BOOST_TEST_MESSAGE("sort " << TITLE_DOC_NUM << " hits by title, load: "
+                       << loadSeconds << "s, by rank: " << rankSeconds
+                       << "s, by string: " << stringSeconds << "s");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,362 @@
+///
+/// @file t_SearchThreadShared.cpp
+/// @brief test the morsels, the top-K threshold and the k-way merge shared
+/// by the search threads, and compare morsels with a fixed split on skewed
+/// postings
+///
+
+#include <search-manager/SearchThreadShared.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+using namespace sf1r;
+
+namespace
+{
+const std::size_t THREAD_NUM = 4;
+const std::size_t TOP_K = 100;
+
+struct Hit
+{
+    docid_t docId;
+    double score;
+
+    Hit(docid_t id = 0, double s = 0) : docId(id), score(s) {}
+};
+
+// the order of ScoreSortedHitQueue, the lower docid wins a tie
+bool hitLess(const Hit& h1, const Hit& h2)
+{
+    if (h1.score != h2.score)
+        return h1.score < h2.score;
+    return h1.docId > h2.docId;
+}
+
+bool hitEqual(const Hit& h1, const Hit& h2)
+{
+    return h1.docId == h2.docId && h1.score == h2.score;
+}
+
+// the postings of a popular term, 90% of the docs are in the first 10% of
+// the docid range, like the docs indexed in one busy day
+void skewedPostings(std::size_t docNum, std::vector<docid_t>& postings)
+{
+    unsigned int seed = 7;
+    const std::size_t denseEnd = docNum / 10;
+    for (docid_t docId = 0; docId < docNum; ++docId)
+    {
+        const unsigned int r = rand_r(&seed) % 100;
+        if ((docId < denseEnd && r < 90) || (docId >= denseEnd && r < 1))
+        {
+            postings.push_back(docId);
+        }
+    }
+}
+
+// some work per doc, as a ranker would do
+double score(docid_t docId)
+{
+    double s = 0;
+    for (int i = 1; i <= 64; ++i)
+    {
+        s += std::sin(docId * 0.001 * i) / i;
+    }
+    return s;
+}
+
+struct Worker
+{
+    const std::vector<docid_t>* postings;
+    SearchThreadShared* shared;
+    docid_t begin;
+    docid_t end;
+
+    std::vector<Hit> heap;  // min heap of hitLess
+    std::size_t scored;
+    std::size_t pruned;
+    std::size_t morsels;
+
+    Worker() : postings(NULL), shared(NULL), begin(0), end(0),
+        scored(0), pruned(0), morsels(0) {}
+
+    static bool heapLess(const Hit& h1, const Hit& h2)
+    {
+        return hitLess(h2, h1);
+    }
+
+    void insert(const Hit& hit)
+    {
+        if (heap.size() < TOP_K)
+        {
+            heap.push_back(hit);
+            std::push_heap(heap.begin(), heap.end(), heapLess);
+        }
+        else if (hitLess(heap.front(), hit))
+        {
+            std::pop_heap(heap.begin(), heap.end(), heapLess);
+            heap.back() = hit;
+            std::push_heap(heap.begin(), heap.end(), heapLess);
+        }
+        else
+        {
+            return;
+        }
+
+        if (shared && heap.size() == TOP_K)
+        {
+            shared->raiseThreshold(heap.front().score);
+        }
+    }
+
+    // like SearchThreadWorker::doSearch_, the iterator only moves forward
+    void run()
+    {
+        std::vector<docid_t>::const_iterator it = postings->begin();
+        docid_t rangeBegin = begin;
+        docid_t rangeEnd = end;
+        bool hasRange = shared ? shared->nextMorsel(rangeBegin, rangeEnd) : true;
+        while (hasRange)
+        {
+            ++morsels;
+            it = std::lower_bound(it, postings->end(), rangeBegin);
+            for (; it != postings->end() && *it < rangeEnd; ++it)
+            {
+                Hit hit(*it, score(*it));
+                ++scored;
+                if (shared && shared->threshold() > hit.score)
+                {
+                    ++pruned;
+                    continue;
+                }
+                insert(hit);
+            }
+            hasRange = shared && shared->nextMorsel(rangeBegin, rangeEnd);
+        }
+    }
+
+    void sortedHits(std::vector<Hit>& hits) const
+    {
+        hits = heap;
+        std::sort(hits.begin(), hits.end(), hitLess);
+    }
+};
+
+void takeMorsels(SearchThreadShared* shared,
+                 std::vector<std::pair<docid_t, docid_t> >* ranges)
+{
+    docid_t begin = 0, end = 0;
+    while (shared->nextMorsel(begin, end))
+    {
+        ranges->push_back(std::make_pair(begin, end));
+    }
+}
+
+// run the workers, return the seconds taken
+double runWorkers(std::vector<Worker>& workers)
+{
+    const boost::posix_time::ptime start =
+        boost::posix_time::microsec_clock::local_time();
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < workers.size(); ++i)
+    {
+        threads.create_thread(boost::bind(&Worker::run, &workers[i]));
+    }
+    threads.join_all();
+    return (boost::posix_time::microsec_clock::local_time() - start)
+        .total_microseconds() / 1e6;
+}
+
+void mergeWorkers(const std::vector<Worker>& workers, std::vector<Hit>& result)
+{
+    std::vector<std::vector<Hit> > lists(workers.size());
+    for (std::size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].sortedHits(lists[i]);
+    }
+    mergeTopK(lists, hitLess, TOP_K, result);
+}
+
+// the most docs scored by a thread over the average
+double imbalance(const std::vector<Worker>& workers)
+{
+    std::size_t total = 0;
+    std::size_t most = 0;
+    for (std::size_t i = 0; i < workers.size(); ++i)
+    {
+        total += workers[i].scored;
+        most = std::max(most, workers[i].scored);
+    }
+    return total ? most * workers.size() / (double)total : 1;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(SearchThreadSharedTest)
+
+BOOST_AUTO_TEST_CASE(testMorsels)
+{
+    const std::size_t docNum = 100003;
+    const std::size_t morselSize = 1000;
+    SearchThreadShared shared(docNum, morselSize);
+    BOOST_CHECK_EQUAL(shared.morselNum(), 101U);
+
+    std::vector<std::vector<std::pair<docid_t, docid_t> > > taken(THREAD_NUM);
+    boost::thread_group threads;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        threads.create_thread(boost::bind(&takeMorsels, &shared, &taken[i]));
+    }
+    threads.join_all();
+
+    std::vector<std::pair<docid_t, docid_t> > all;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        // in docid order for each thread
+        for (std::size_t j = 1; j < taken[i].size(); ++j)
+        {
+            BOOST_CHECK_LE(taken[i][j-1].second, taken[i][j].first);
+        }
+        all.insert(all.end(), taken[i].begin(), taken[i].end());
+    }
+
+    // [0, docNum) is covered exactly once
+    std::sort(all.begin(), all.end());
+    BOOST_REQUIRE_EQUAL(all.size(), shared.morselNum());
+    docid_t next = 0;
+    for (std::size_t i = 0; i < all.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(all[i].first, next);
+        BOOST_CHECK_GT(all[i].second, all[i].first);
+        next = all[i].second;
+    }
+    BOOST_CHECK_EQUAL(next, docNum);
+
+    docid_t begin = 0, end = 0;
+    BOOST_CHECK(!shared.nextMorsel(begin, end));
+}
+
+BOOST_AUTO_TEST_CASE(testThreshold)
+{
+    SearchThreadShared shared(10, 1);
+    BOOST_CHECK_LT(shared.threshold(), -1e300);
+
+    shared.raiseThreshold(0.5);
+    BOOST_CHECK_EQUAL(shared.threshold(), 0.5);
+    shared.raiseThreshold(0.2);
+    BOOST_CHECK_EQUAL(shared.threshold(), 0.5);
+    shared.raiseThreshold(-3);
+    BOOST_CHECK_EQUAL(shared.threshold(), 0.5);
+    shared.raiseThreshold(1.25);
+    BOOST_CHECK_EQUAL(shared.threshold(), 1.25);
+}
+
+BOOST_AUTO_TEST_CASE(testMergeTopK)
+{
+    unsigned int seed = 11;
+    std::vector<std::vector<Hit> > lists(5);
+    std::vector<Hit> all;
+    for (std::size_t i = 0; i < lists.size(); ++i)
+    {
+        // list 3 stays empty
+        const std::size_t size = i == 3 ? 0 : rand_r(&seed) % 300;
+        for (std::size_t j = 0; j < size; ++j)
+        {
+            // few distinct scores, the docid decides the ties
+            Hit hit(i * 1000 + j, rand_r(&seed) % 20);
+            lists[i].push_back(hit);
+            all.push_back(hit);
+        }
+        std::sort(lists[i].begin(), lists[i].end(), hitLess);
+    }
+    std::sort(all.begin(), all.end(), hitLess);
+
+    for (std::size_t k = 0; k <= all.size() + 1; k += 37)
+    {
+        std::vector<std::vector<Hit> > copy(lists);
+        std::vector<Hit> result;
+        mergeTopK(copy, hitLess, k, result);
+
+        const std::size_t expectSize = std::min(k, all.size());
+        BOOST_REQUIRE_EQUAL(result.size(), expectSize);
+        BOOST_CHECK(std::equal(result.begin(), result.end(),
+                               all.end() - expectSize, hitEqual));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testSkewedPostings)
+{
+    const std::size_t docNum = 2000000;
+    const std::size_t morselSize = 32768;
+    std::vector<docid_t> postings;
+    skewedPostings(docNum, postings);
+
+    // the result of one thread
+    std::vector<Worker> single(1);
+    single[0].postings = &postings;
+    single[0].end = docNum;
+    const double singleSeconds = runWorkers(single);
+    std::vector<Hit> expect;
+    single[0].sortedHits(expect);
+
+    // a fixed docid range per thread, as before
+    std::vector<Worker> fixed(THREAD_NUM);
+    const std::size_t averageDocNum = (docNum - 1) / THREAD_NUM + 1;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        fixed[i].postings = &postings;
+        fixed[i].begin = i * averageDocNum;
+        fixed[i].end = (i + 1) * averageDocNum;
+    }
+    const double fixedSeconds = runWorkers(fixed);
+    std::vector<Hit> fixedResult;
+    mergeWorkers(fixed, fixedResult);
+
+    // morsels and the shared threshold
+    SearchThreadShared shared(docNum, morselSize);
+    std::vector<Worker> morsel(THREAD_NUM);
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        morsel[i].postings = &postings;
+        morsel[i].shared = &shared;
+    }
+    const double morselSeconds = runWorkers(morsel);
+    std::vector<Hit> morselResult;
+    mergeWorkers(morsel, morselResult);
+
+    std::size_t pruned = 0;
+    std::size_t morselNum = 0;
+    for (std::size_t i = 0; i < THREAD_NUM; ++i)
+    {
+        pruned += morsel[i].pruned;
+        morselNum += morsel[i].morsels;
+    }
+
+    BOOST_TEST_MESSAGE("postings: " << postings.size()
+                       << ", single thread: " << singleSeconds << "s"
+                       << ", fixed split: " << fixedSeconds << "s, imbalance "
+                       << imbalance(fixed)
+                       << ", morsels: " << morselSeconds << "s, imbalance "
+                       << imbalance(morsel) << ", pruned " << pruned);
+
+    BOOST_REQUIRE_EQUAL(expect.size(), TOP_K);
+    BOOST_CHECK(std::equal(fixedResult.begin(), fixedResult.end(), expect.begin(), hitEqual));
+    BOOST_REQUIRE_EQUAL(morselResult.size(), TOP_K);
+    BOOST_CHECK(std::equal(morselResult.begin(), morselResult.end(), expect.begin(), hitEqual));
+    BOOST_CHECK_EQUAL(morselNum, shared.morselNum());
+
+    // the first thread of the fixed split gets nearly all the postings
+    BOOST_CHECK_GT(imbalance(fixed), 3);
+
+    // only a machine with more cores would show the threads sharing the work
+    if (boost::thread::hardware_concurrency() >= THREAD_NUM)
+    {
+        BOOST_CHECK_LT(imbalance(morsel), 2);
+        BOOST_CHECK_LT(morselSeconds, fixedSeconds);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,254 @@
+///
+/// @file t_SortKeyQueue.cpp
+/// @brief test the sort keys filled by Sorter and the hit queues comparing
+/// them, and time them against Sorter::lessThan()
+///
+
+#include <search-manager/HitQueue.h>
+#include <search-manager/PriorityQueue.h>
+#include <search-manager/NumericPropertyTableBuilder.h>
+#include <common/NumericPropertyTable.h>
+#include <common/PropSharedLockSet.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <stdlib.h>
+
+using namespace sf1r;
+
+namespace
+{
+const std::size_t DOC_NUM = 1000000;
+const std::size_t TOP_K = 100;
+
+class TableBuilder : public NumericPropertyTableBuilder
+{
+public:
+    boost::shared_ptr<NumericPropertyTableBase>& createPropertyTable(
+        const std::string& propertyName)
+    {
+        return tables_[propertyName];
+    }
+
+private:
+    std::map<std::string, boost::shared_ptr<NumericPropertyTableBase> > tables_;
+};
+
+// the docs "price" ascending, then "rating" descending
+struct SortFixture
+{
+    TableBuilder builder;
+    boost::shared_ptr<NumericPropertyTableBase> price;
+    boost::shared_ptr<NumericPropertyTableBase> rating;
+
+    SortFixture()
+        : price(new NumericPropertyTable<int32_t>(INT32_PROPERTY_TYPE))
+        , rating(new NumericPropertyTable<float>(FLOAT_PROPERTY_TYPE))
+    {
+        builder.createPropertyTable("price") = price;
+        builder.createPropertyTable("rating") = rating;
+
+        unsigned int seed = 13;
+        for (docid_t docId = 1; docId <= DOC_NUM; ++docId)
+        {
+            // few prices, so that the rating decides often
+            price->setInt32Value(docId, rand_r(&seed) % 2000 - 1000);
+            rating->setFloatValue(docId, (rand_r(&seed) % 1000) / 100.0 - 5);
+        }
+    }
+
+    boost::shared_ptr<Sorter> createSorter(std::size_t propNum) const
+    {
+        boost::shared_ptr<Sorter> sorter(new Sorter(
+            const_cast<TableBuilder*>(&builder), NULL));
+        sorter->addSortProperty(new SortProperty("price", INT32_PROPERTY_TYPE, false));
+        if (propNum > 1)
+        {
+            sorter->addSortProperty(new SortProperty("rating", FLOAT_PROPERTY_TYPE, true));
+        }
+        if (propNum > 2)
+        {
+            sorter->addSortProperty(new SortProperty("RANK", UNKNOWN_DATA_PROPERTY_TYPE,
+                                                     SortProperty::SCORE, true));
+        }
+        return sorter;
+    }
+};
+
+// the heap before the sort keys, comparing through Sorter::lessThan()
+class SorterQueue : public sf1r::PriorityQueue<ScoreDoc>
+{
+public:
+    SorterQueue(const boost::shared_ptr<Sorter>& sorter, std::size_t size)
+        : sorter_(sorter)
+    {
+        initialize(size);
+    }
+
+protected:
+    bool lessThan(ScoreDoc o1, ScoreDoc o2)
+    {
+        return sorter_->lessThan(o1, o2);
+    }
+
+private:
+    boost::shared_ptr<Sorter> sorter_;
+};
+
+class SorterLess
+{
+public:
+    explicit SorterLess(const boost::shared_ptr<Sorter>& sorter)
+        : sorter_(sorter) {}
+
+    bool operator()(const ScoreDoc& o1, const ScoreDoc& o2) const
+    {
+        return sorter_->lessThan(o1, o2);
+    }
+
+private:
+    boost::shared_ptr<Sorter> sorter_;
+};
+
+double seconds(const boost::posix_time::ptime& start)
+{
+    return (boost::posix_time::microsec_clock::local_time() - start)
+        .total_microseconds() / 1e6;
+}
+
+template <typename Queue>
+double insertAll(Queue& queue, const std::vector<ScoreDoc>& docs)
+{
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+    for (std::size_t i = 0; i < docs.size(); ++i)
+    {
+        queue.insert(docs[i]);
+    }
+    return seconds(start);
+}
+
+template <typename Queue>
+void popAll(Queue& queue, std::vector<docid_t>& docs)
+{
+    docs.clear();
+    while (queue.size() > 0)
+    {
+        docs.push_back(queue.pop().docId);
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE(SortKeyQueueTest)
+
+BOOST_AUTO_TEST_CASE(testSortKey)
+{
+    const int64_t ints[] = {
+        std::numeric_limits<int64_t>::min() + 1, -1000000, -1, 0, 1, 7,
+        std::numeric_limits<int64_t>::max()
+    };
+    for (std::size_t i = 1; i < sizeof(ints) / sizeof(ints[0]); ++i)
+    {
+        BOOST_CHECK_LT(int64SortKey(ints[i-1]), int64SortKey(ints[i]));
+    }
+
+    const double doubles[] = {
+        -std::numeric_limits<double>::infinity(), -1e300, -2.5, -1e-300, 0,
+        1e-300, 0.5, 3, 1e300, std::numeric_limits<double>::infinity()
+    };
+    for (std::size_t i = 1; i < sizeof(doubles) / sizeof(doubles[0]); ++i)
+    {
+        BOOST_CHECK_LT(doubleSortKey(doubles[i-1]), doubleSortKey(doubles[i]));
+    }
+    BOOST_CHECK_EQUAL(doubleSortKey(-0.0), doubleSortKey(0.0));
+
+    // only the docs without value have the invalid key
+    BOOST_CHECK_GT(int64SortKey(std::numeric_limits<int64_t>::min()), kInvalidSortKey);
+    BOOST_CHECK_GT(doubleSortKey(-std::numeric_limits<double>::infinity()), kInvalidSortKey);
+}
+
+BOOST_AUTO_TEST_CASE(testFillSortKeys)
+{
+    SortFixture fixture;
+    // before the lock set holds the shared lock
+    fixture.price->clearValue(5);
+    PropSharedLockSet lockSet;
+
+    boost::shared_ptr<Sorter> sorter = fixture.createSorter(2);
+    sorter->createComparators(lockSet);
+    BOOST_CHECK_EQUAL(sorter->sortKeyNum(), 2U);
+
+    // the key order is the order of Sorter::lessThan()
+    unsigned int seed = 21;
+    for (int i = 0; i < 10000; ++i)
+    {
+        ScoreDoc doc1(rand_r(&seed) % (DOC_NUM - 5) + 6);
+        ScoreDoc doc2(rand_r(&seed) % (DOC_NUM - 5) + 6);
+        sorter->fillSortKeys(doc1);
+        sorter->fillSortKeys(doc2);
+        BOOST_CHECK_EQUAL(SortKeyQueue<2>::lessThan(doc1, doc2), sorter->lessThan(doc1, doc2));
+    }
+
+    // a doc without price goes first
+    ScoreDoc doc1(5), doc2(6);
+    sorter->fillSortKeys(doc1);
+    sorter->fillSortKeys(doc2);
+    BOOST_CHECK(SortKeyQueue<2>::lessThan(doc1, doc2));
+    BOOST_CHECK(!SortKeyQueue<2>::lessThan(doc2, doc1));
+
+    // more properties than keys
+    boost::shared_ptr<Sorter> threeSorter = fixture.createSorter(3);
+    threeSorter->createComparators(lockSet);
+    BOOST_CHECK_EQUAL(threeSorter->sortKeyNum(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(testSortedHitQueue)
+{
+    SortFixture fixture;
+
+    for (std::size_t propNum = 1; propNum <= 3; ++propNum)
+    {
+        PropSharedLockSet lockSet;
+        boost::shared_ptr<Sorter> sorter = fixture.createSorter(propNum);
+        PropertySortedHitQueue warmup(sorter, TOP_K, lockSet);
+
+        // in docid order most docs are rejected by the top, in sorted order
+        // each doc goes into the heap
+        std::vector<ScoreDoc> docs;
+        for (docid_t docId = 1; docId <= DOC_NUM; ++docId)
+        {
+            docs.push_back(ScoreDoc(docId, docId % 97));
+        }
+        std::vector<ScoreDoc> sortedDocs(docs);
+        std::sort(sortedDocs.begin(), sortedDocs.end(), SorterLess(sorter));
+
+        const std::vector<ScoreDoc>* inputs[] = {&docs, &sortedDocs};
+        const char* inputNames[] = {"docid order", "sorted order"};
+        for (std::size_t input = 0; input < 2; ++input)
+        {
+            PropertySortedHitQueue queue(sorter, TOP_K, lockSet);
+            SorterQueue sorterQueue(sorter, TOP_K);
+
+            insertAll(warmup, *inputs[input]);
+            const double queueSeconds = insertAll(queue, *inputs[input]);
+            const double sorterSeconds = insertAll(sorterQueue, *inputs[input]);
+
+            std::vector<docid_t> queueDocs;
+            std::vector<docid_t> sorterDocs;
+            BOOST_CHECK_EQUAL(queue.size(), TOP_K);
+            popAll(queue, queueDocs);
+            popAll(sorterQueue, sorterDocs);
+            BOOST_CHECK(queueDocs == sorterDocs);
+
+            BOOST_TEST_MESSAGE(propNum << " sort properties, top " << TOP_K
+                               << " of " << DOC_NUM << " docs in "
+                               << inputNames[input] << ", sort keys: "
+                               << queueSeconds << "s, Sorter::lessThan: "
+                               << sorterSeconds << "s");
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,229 @@
+///
+/// @file t_ZambeziListMerger.cpp
+/// @brief test merging the docs retrieved from several zambezi properties
+///
+
+#include <index-manager/zambezi-manager/ZambeziListMerger.h>
+#include <util/ClockTimer.h>
+#include <boost/test/unit_test.hpp>
+#include <boost/random.hpp>
+#include <algorithm>
+#include <list>
+#include <map>
+
+using namespace sf1r;
+
+namespace
+{
+const std::size_t DOC_NUM_PER_LIST = 200000;
+const docid_t MAX_DOC_ID = 1000000;
+
+struct MergeInput
+{
+    std::vector<std::vector<docid_t> > docidsList;
+    std::vector<std::vector<float> > scoresList;
+    std::vector<float> weightList;
+};
+
+void createInput(std::size_t listNum, std::size_t docNum, bool reverse, MergeInput& input)
+{
+    boost::mt19937 engine(listNum);
+    boost::uniform_int<docid_t> docDist(1, MAX_DOC_ID);
+    boost::uniform_real<float> scoreDist(0, 1);
+
+    input.docidsList.resize(listNum);
+    input.scoresList.resize(listNum);
+    input.weightList.resize(listNum);
+
+    for (std::size_t i = 0; i < listNum; ++i)
+    {
+        std::vector<docid_t>& docids = input.docidsList[i];
+        docids.clear();
+        for (std::size_t j = 0; j < docNum; ++j)
+        {
+            docids.push_back(docDist(engine));
+        }
+        std::sort(docids.begin(), docids.end());
+        docids.erase(std::unique(docids.begin(), docids.end()), docids.end());
+        if (reverse)
+        {
+            std::reverse(docids.begin(), docids.end());
+        }
+
+        input.scoresList[i].resize(docids.size());
+        for (std::size_t j = 0; j < docids.size(); ++j)
+        {
+            input.scoresList[i][j] = scoreDist(engine);
+        }
+        input.weightList[i] = i + 1;
+    }
+}
+
+void mergeByMap(const MergeInput& input, bool reverse,
+                std::vector<docid_t>& docids, std::vector<float>& scores)
+{
+    std::map<docid_t, float> docScores;
+    for (std::size_t i = 0; i < input.docidsList.size(); ++i)
+    {
+        for (std::size_t j = 0; j < input.docidsList[i].size(); ++j)
+        {
+            docScores[input.docidsList[i][j]] +=
+                input.scoresList[i][j] * input.weightList[i];
+        }
+    }
+
+    docids.clear();
+    scores.clear();
+    for (std::map<docid_t, float>::const_iterator it = docScores.begin();
+         it != docScores.end(); ++it)
+    {
+        docids.push_back(it->first);
+        scores.push_back(it->second);
+    }
+
+    if (reverse)
+    {
+        std::reverse(docids.begin(), docids.end());
+        std::reverse(scores.begin(), scores.end());
+    }
+}
+
+/// the former merge, which scans all lists for the minimum doc at each step
+void mergeByScan(const MergeInput& input,
+                 std::vector<docid_t>& docids, std::vector<float>& scores)
+{
+    const std::vector<std::vector<docid_t> >& docidsList = input.docidsList;
+    std::size_t totalCount = 0;
+    std::size_t docCount = 0;
+
+    std::list<std::pair<std::size_t, std::size_t> > existingList;
+    for (std::size_t i = 0; i < docidsList.size(); ++i)
+    {
+        if (!docidsList[i].empty())
+        {
+            totalCount += docidsList[i].size();
+            existingList.push_back(std::make_pair(i, 0));
+        }
+    }
+    docids.assign(totalCount, 0);
+    scores.assign(totalCount, 0);
+
+    std::vector<std::list<std::pair<std::size_t, std::size_t> >::iterator> minDocList;
+    while (!existingList.empty())
+    {
+        docid_t min = -1;
+        for (std::list<std::pair<std::size_t, std::size_t> >::iterator it = existingList.begin();
+             it != existingList.end(); ++it)
+        {
+            docid_t docId = docidsList[it->first][it->second];
+            if (docId < min)
+            {
+                min = docId;
+                minDocList.clear();
+            }
+            if (docId == min)
+                minDocList.push_back(it);
+        }
+
+        for (std::size_t i = 0; i < minDocList.size(); ++i)
+        {
+            std::size_t k = minDocList[i]->first;
+            std::size_t j = minDocList[i]->second++;
+            if (minDocList[i]->second == docidsList[k].size())
+                existingList.erase(minDocList[i]);
+
+            docids[docCount] = docidsList[k][j];
+            scores[docCount] += input.scoresList[k][j] * input.weightList[k];
+        }
+        ++docCount;
+    }
+
+    docids.resize(docCount);
+    scores.resize(docCount);
+}
+
+void checkMerge(std::size_t listNum, std::size_t docNum, bool reverse)
+{
+    MergeInput input;
+    createInput(listNum, docNum, reverse, input);
+
+    std::vector<docid_t> docids, goldDocids;
+    std::vector<float> scores, goldScores;
+    mergeZambeziLists(input.docidsList, input.scoresList, input.weightList,
+                      reverse, docids, scores);
+    mergeByMap(input, reverse, goldDocids, goldScores);
+
+    BOOST_CHECK_EQUAL_COLLECTIONS(docids.begin(), docids.end(),
+                                  goldDocids.begin(), goldDocids.end());
+    BOOST_REQUIRE_EQUAL(scores.size(), goldScores.size());
+    for (std::size_t i = 0; i < scores.size(); ++i)
+    {
+        BOOST_CHECK_CLOSE(scores[i], goldScores[i], 1e-4);
+    }
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ZambeziListMergerTest)
+
+BOOST_AUTO_TEST_CASE(testEmpty)
+{
+    std::vector<std::vector<docid_t> > docidsList(2);
+    std::vector<std::vector<float> > scoresList(2);
+    std::vector<float> weightList(2, 1);
+    std::vector<docid_t> docids(1, 1);
+    std::vector<float> scores(1, 1);
+
+    mergeZambeziLists(docidsList, scoresList, weightList, false, docids, scores);
+    BOOST_CHECK(docids.empty());
+    BOOST_CHECK(scores.empty());
+
+    docidsList[1].push_back(3);
+    scoresList[1].push_back(0.5);
+    weightList[1] = 2;
+    mergeZambeziLists(docidsList, scoresList, weightList, false, docids, scores);
+    BOOST_REQUIRE_EQUAL(docids.size(), 1U);
+    BOOST_CHECK_EQUAL(docids[0], 3U);
+    BOOST_CHECK_EQUAL(scores[0], 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(testMerge)
+{
+    for (std::size_t listNum = 1; listNum <= 8; ++listNum)
+    {
+        checkMerge(listNum, 1000, false);
+        checkMerge(listNum, 1000, true);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testMergeLatency)
+{
+    for (std::size_t listNum = 1; listNum <= 8; ++listNum)
+    {
+        MergeInput input;
+        createInput(listNum, DOC_NUM_PER_LIST, false, input);
+
+        std::vector<docid_t> treeDocids, scanDocids;
+        std::vector<float> treeScores, scanScores;
+
+        izenelib::util::ClockTimer treeTimer;
+        mergeZambeziLists(input.docidsList, input.scoresList, input.weightList,
+                          false, treeDocids, treeScores);
+        const double treeSeconds = treeTimer.elapsed();
+
+        izenelib::util::ClockTimer scanTimer;
+        mergeByScan(input, scanDocids, scanScores);
+        const double scanSeconds = scanTimer.elapsed();
+
+        // both sum the scores of a doc in the order of the lists
+        BOOST_CHECK(treeDocids == scanDocids);
+        BOOST_CHECK(treeScores == scanScores);
+
+        BOOST_TEST_MESSAGE("merge " << listNum << " lists of "
+                           << DOC_NUM_PER_LIST << " docs into "
+                           << treeDocids.size() << " docs, loser tree: "
+                           << treeSeconds << "s, linear scan: "
+                           << scanSeconds << "s");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()